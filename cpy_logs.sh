@@ -1,13 +1,18 @@
 #!/bin/bash
 
-# docker exec head_server cp /mnt/tmpfs/fs.log /project/scripts/logs/
-# docker exec head_server cp /mnt/tmpfs/storage_mngr.log /project/scripts/logs/
-# docker exec head_server cp /mnt/tmpfs/s_client.log /project/scripts/logs/
-# docker exec storage_server1 cp /mnt/tmpfs/storage1.log /project/scripts/logs/
-# docker exec storage_server2 cp /mnt/tmpfs/storage2.log /project/scripts/logs/
-# docker exec storage_server3 cp /mnt/tmpfs/storage3.log /project/scripts/logs/
+# saves a snapshot of the metrics of every component, the servers have to be
+# started with --metrics-port (the storage nodes listen on that port + their rank)
+# docker exec head_server curl -s localhost:9101/metrics
 
-scp head_server:/mnt/tmpfs/* ~/Documents/Licenta/Playground/Prototip/tests/test2/logs
-scp storage_s1:/mnt/tmpfs/* ~/Documents/Licenta/Playground/Prototip/tests/test2/logs
-scp storage_s2:/mnt/tmpfs/* ~/Documents/Licenta/Playground/Prototip/tests/test2/logs
-scp storage_s3:/mnt/tmpfs/* ~/Documents/Licenta/Playground/Prototip/tests/test2/logs
\ No newline at end of file
+DEST=~/Documents/Licenta/Playground/Prototip/tests/test2/logs
+FS_PORT=9100
+CACHE_PORT=9101
+STORAGE_MNGR_PORT=9102
+NODE_PORT=9200
+
+curl -s head_server:$FS_PORT/metrics > $DEST/fs.prom
+curl -s head_server:$CACHE_PORT/metrics > $DEST/cache_server.prom
+curl -s head_server:$STORAGE_MNGR_PORT/metrics > $DEST/storage_mngr.prom
+curl -s storage_s1:$((NODE_PORT + 1))/metrics > $DEST/storage1.prom
+curl -s storage_s2:$((NODE_PORT + 2))/metrics > $DEST/storage2.prom
+curl -s storage_s3:$((NODE_PORT + 3))/metrics > $DEST/storage3.prom
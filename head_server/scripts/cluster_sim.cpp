@@ -0,0 +1,139 @@
+#include "../lib/storage_server.hpp"
+#include "../lib/storage_node.hpp"
+#include "../lib/sim_transport.hpp"
+#include "../lib/cache_server.hpp"
+#include "../lib/tracing.hpp"
+#include <iostream>
+#include <filesystem>
+#include <thread>
+#include <CLI11.hpp>
+
+using namespace StorageAPI;
+
+// The whole backend in one process: the storage manager, the storage nodes as
+// threads behind a simulated network and optionally the cache server, so the
+// clients and the benchmarks can run against a cluster of any shape on a laptop.
+int main(int argc, char** argv)
+{
+    CLI::App app {"Cluster simulator."};
+    argv = app.ensure_utf8(argv);
+
+    uint8_t thread_count = 8;
+    uint16_t port = 7777;
+    int node_count = 4;
+    std::string storage_path = "/dev/shm/dfs_sim";
+    int stripe_size = 4096;
+    int replica_count = 1;
+    double hedge_percentile = 0;
+    int data_fragments = 0;
+    int parity_fragments = 2;
+    LinkProfile profile;
+    std::vector<std::string> links;
+    uint16_t cache_port = 0;
+    int cache_shards = 1;
+    uint16_t mem_port = 11211;
+    std::string file_meta = "/dev/shm/dfs_sim/file_meta";
+    std::string dir_meta = "/dev/shm/dfs_sim/dir_meta";
+    uint32_t shm_slots = 32;
+    double gc_rate = 10000;
+    std::string placement_file;
+    double rebalance_rate = 1000;
+    uint16_t metrics_port = 0;
+
+    app.add_option("-p, --port", port, "Port on which to run the storage manager.")->check(CLI::Range(1, 65535));
+    app.add_option("-t, --threads", thread_count, "Number of threads in the thread pool of each server.")->check(CLI::Range(1, 16));
+    app.add_option("-n, --nodes", node_count, "Number of storage nodes.")->check(CLI::Range(1, 256));
+    app.add_option("--storage-path", storage_path, "Directory holding a node<i> directory per storage node.");
+    app.add_option("-s, --stripe-size", stripe_size, "Stripe size to break down large files.")->check(CLI::Range(1, 131072));
+    app.add_option("-r, --replicas", replica_count, "Number of storage nodes holding a copy of each stripe.")->check(CLI::Range(1, 16));
+    app.add_option("--hedge-percentile", hedge_percentile, "Send a second read to another replica after this latency percentile (0 disables).")->check(CLI::Range(0.0, 100.0));
+    app.add_option("-k, --data-fragments", data_fragments, "Erasure code groups of this many stripes instead of replicating them (0 disables).")->check(CLI::Range(0, 64));
+    app.add_option("-m, --parity-fragments", parity_fragments, "Parity fragments per erasure coded group.")->check(CLI::Range(1, 16));
+    app.add_option("--latency-us", profile.latency_us, "One way latency of the links to the nodes.")->check(CLI::NonNegativeNumber);
+    app.add_option("--bandwidth-gbps", profile.bandwidth_gbps, "Bandwidth of the links to the nodes (0 is unlimited).")->check(CLI::NonNegativeNumber);
+    app.add_option("--jitter-us", profile.jitter_us, "Mean of the extra exponentially distributed delay of a message.")->check(CLI::NonNegativeNumber);
+    app.add_option("--link", links, "Link of one node, node:latency_us:bandwidth_gbps:jitter_us, empty fields keep the defaults.");
+    app.add_option("--cache-port", cache_port, "Port on which to run the cache server (0 disables).")->check(CLI::Range(0, 65535));
+    app.add_option("--cache-shards", cache_shards, "Cache servers splitting the namespace, on consecutive ports from --cache-port and --mport.")->check(CLI::Range(1, 64));
+    app.add_option("--mport", mem_port, "Port on which to run the MEMCACHED server of the cache server.")->check(CLI::Range(1, 65535));
+    app.add_option("--file-meta", file_meta, "A directory to store cached file metadata.");
+    app.add_option("--dir-meta", dir_meta, "A directory to store cached directory metadata.");
+    app.add_option("--shm-slots", shm_slots, "Requests in flight through the shared memory channel of the clients on this host (0 disables it).")->check(CLI::Range(0, 1024));
+    app.add_option("--gc-rate", gc_rate, "Stripes of removed files deleted per second in the background (0 for no limit).")->check(CLI::Range(0.0, 1e9));
+    app.add_option("--placement-file", placement_file, "File keeping the placement of the stripes, a change of the nodes then moves only the stripes it has to.");
+    app.add_option("--rebalance-rate", rebalance_rate, "Stripes moved to their new nodes per second in the background (0 for no limit).")->check(CLI::Range(0.0, 1e9));
+    app.add_option("--metrics-port", metrics_port, "Port serving the metrics in the Prometheus text format (0 disables).")->check(CLI::Range(0, 65535));
+    CLI11_PARSE(app, argc, argv);
+
+    try {
+        ////// LOGGER //////
+        Logging::init(spdlog::level::debug); // Set global log level, the messages are written asynchronously
+        Tracing::set_process_name("cluster_sim");
+
+        auto transport = std::make_unique<SimTransport>(node_count, profile);
+        for (const std::string& link : links)
+        {
+            size_t separator = link.find(':');
+            int node = std::stoi(link.substr(0, separator));
+            if (node < 1 || node > node_count)
+                throw std::runtime_error(std::format("main: no storage node {}", node));
+
+            LinkProfile node_profile = profile;
+            if (separator != std::string::npos)
+                node_profile.parse(link.substr(separator + 1));
+            transport->set_link(node, node_profile);
+        }
+
+        // every cache server has the metadata of its part of the namespace in directories of its own
+        std::vector<std::unique_ptr<CacheAPI::CacheServer>> cache_servers;
+        std::vector<std::thread> cache_threads;
+        for (int shard = 0; cache_port != 0 && shard < cache_shards; shard++)
+        {
+            std::string shard_suffix = cache_shards > 1 ? std::format("/shard{}", shard) : "";
+            std::filesystem::create_directories(file_meta + shard_suffix);
+            std::filesystem::create_directories(dir_meta + shard_suffix);
+            cache_servers.push_back(std::make_unique<CacheAPI::CacheServer>((int)thread_count, (uint16_t)(mem_port + shard),
+                file_meta + shard_suffix, dir_meta + shard_suffix));
+            cache_threads.emplace_back([server = cache_servers.back().get(), port = (uint16_t)(cache_port + shard)]() { server->run(port); });
+        }
+
+        // the manager owns the transport, the node threads are joined before it goes away
+        SimTransport& network = *transport;
+        std::vector<std::unique_ptr<StorageNode>> nodes;
+        std::vector<std::thread> node_threads;
+        for (int rank = 1; rank <= node_count; rank++)
+        {
+            std::string node_path = std::format("{}/node{}/", storage_path, rank);
+            std::filesystem::create_directories(node_path);
+            nodes.push_back(std::make_unique<StorageNode>(rank, node_path, stripe_size, network.get_node(rank)));
+            node_threads.emplace_back(&StorageNode::run, nodes.back().get());
+        }
+
+        std::unique_ptr<Metrics::Endpoint> metrics_endpoint;
+        if (metrics_port != 0)
+            metrics_endpoint = std::make_unique<Metrics::Endpoint>(metrics_port);
+
+        {
+            // both servers stop on SIGINT / SIGTERM
+            StorageServer object((int)thread_count, stripe_size, replica_count, hedge_percentile,
+                data_fragments, parity_fragments, std::move(transport));
+            object.set_shm_slots(shm_slots);
+            object.set_gc_rate(gc_rate);
+            object.set_placement_file(placement_file);
+            object.set_rebalance_rate(rebalance_rate);
+            object.run(port);
+
+            network.close();
+            for (auto& thread : node_threads)
+                thread.join();
+        }
+
+        for (auto& thread : cache_threads)
+            thread.join();
+    }
+    catch (std::exception& e){
+        SPDLOG_ERROR("{}", e.what());
+    }
+
+    return 0;
+}
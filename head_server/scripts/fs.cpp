@@ -3,280 +3,819 @@
 
 #define FUSE_USE_VERSION 31
 
-#include <fuse.h>
+#include <fuse_lowlevel.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <condition_variable>
+#include <deque>
+#include <thread>
 // #include "../../lib/cache_client.hpp"
 // #include "../../lib/storage_client.hpp"
-#include "../lib/cache_client.hpp"
-#include "../lib/storage_client.hpp"
-
-CacheAPI::CacheClient cache_client;
-StorageAPI::StorageClient storage_client(128 * 1024);
-std::ofstream read_log_file("/mnt/tmpfs/fs_read.log", std::ios::app);
-std::ofstream write_log_file("/mnt/tmpfs/fs_write.log", std::ios::app);
-std::ofstream cache_log_file("/mnt/tmpfs/fs_cache.log", std::ios::app);
+#include "../lib/sharded_cache_client.hpp"
+#include "../lib/sharded_storage_client.hpp"
+#include "../lib/inode_table.hpp"
+#include "../lib/tracing.hpp"
+
+// The low-level FUSE API: the kernel asks by inode number (InodeTable keeps their
+// paths) and a request is answered with fuse_reply_* whenever its result is there.
+// read, write, lookup, getattr and open are answered from the completion handlers
+// of the clients, the FUSE thread goes back to /dev/fuse as soon as the request is
+// sent, so the requests in flight are bounded by the servers and not by the FUSE
+// threads. The other operations change the namespace and wait for their reply.
+//
+// With --kernel-cache the kernel keeps the data of a file across opens and the
+// attributes and names for longer, with --writeback-cache it gathers the writes
+// too. The cache servers tell the client of every object another client changed
+// (CacheClient::watch) and the kernel drops what it kept of it.
+
+CacheAPI::ShardedCacheClient cache_client;
+StorageAPI::ShardedStorageClient storage_client(128 * 1024);
+CacheAPI::InodeTable inode_table;
+std::unique_ptr<Metrics::Endpoint> metrics_endpoint;
+struct fuse_session *session = nullptr;
+
+// seconds the kernel keeps the attributes and the names, the defaults of the high-level API,
+// kernel_cache_timeout when the cache servers tell of the changes
+static double attr_timeout = 1.0;
+static double entry_timeout = 1.0;
+static const double kernel_cache_timeout = 60.0;
+// largest read and write the kernel sends, and its readahead
+static const unsigned max_io_size = 1024 * 1024;
+// data in a request to the storage manager (StoragePacket::max_packet_size), the larger
+// reads and writes are split
+static const size_t max_request_size = 256 * 1024;
+// readahead and writeback requests the kernel keeps in flight (its default is 12)
+static const unsigned max_background = 64;
+// d_ino of the readdir entries, the inode is given by the lookup of the name
+static const ino_t unknown_inode = 0xffffffff;
 
 struct HostInfo {
 	std::string storage_address, storage_port;
+	std::vector<std::string> storage_managers; // address:port of every storage manager when there are several
 	std::string cache_address, cache_port;
-
-	HostInfo() : storage_address(""), storage_port(""), cache_address(""), cache_port("") {}
+	std::vector<std::string> cache_servers; // address:port of every cache server when the namespace is split
+	int shard_depth;
+	int negative_timeout; // ms a missing path is answered without asking, 0 to always ask
+	uint16_t metrics_port;
+	bool kernel_cache; // the page cache is kept across opens
+	bool writeback_cache; // the kernel gathers the writes in the page cache
+
+	HostInfo() : storage_address(""), storage_port(""), cache_address(""), cache_port(""), shard_depth(1), negative_timeout(1000), metrics_port(0), kernel_cache(false), writeback_cache(false) {}
 };
 
+// the clients answer an errno, or a negative value when the request itself failed
+static int to_errno(int error)
+{
+	return error < 0 ? EIO : error;
+}
 
-static int myfs_getattr(const char *path, struct stat *stat_buf, struct fuse_file_info *file_info)
-{	
-	(void) file_info;
-	Stat proto;
-	memset(stat_buf, 0, sizeof(struct stat));
-
-	std::string proto_str = cache_client.get_file(path);
-	if (proto_str.empty())
-		proto_str = cache_client.get_dir(path);
-		if (proto_str.empty())
-			return -ENOENT;		
-
-	proto.ParseFromString(proto_str);
-	Utils::proto_to_struct_stat(proto, stat_buf);
-	return 0;
+// false, and the request answered, when the kernel asks for an inode that has no path anymore
+static bool get_path(fuse_req_t req, fuse_ino_t inode, std::string& path)
+{
+	path = inode_table.get_path(inode);
+	if (path.empty())
+	{
+		fuse_reply_err(req, ENOENT);
+		return false;
+	}
+	return true;
 }
 
-static int myfs_mkdir(const char *path, mode_t mode)
+// the metadata of a file, or else of a directory
+static void get_record(const std::string& path, std::function<void(std::string)> done)
 {
-	int error = cache_client.set_dir(path, std::to_string(mode));
+	cache_client.get_file(path, [path, done] (std::string record) {
+		if (!record.empty())
+			done(std::move(record));
+		else
+			cache_client.get_dir(path, done);
+	});
+}
 
-	if (error < 0)
+static void reply_attr(fuse_req_t req, fuse_ino_t inode, const std::string& record)
+{
+	struct stat stat_buf;
+	memset(&stat_buf, 0, sizeof(struct stat));
+	if (!StatRecord::to_struct_stat(record, &stat_buf))
 	{
-		return -EIO;
+		fuse_reply_err(req, ENOENT);
+		return;
 	}
+	stat_buf.st_ino = inode;
+	fuse_reply_attr(req, &stat_buf, attr_timeout);
+}
 
-	return -error;
+// a lookup the kernel will forget, or the inode of a new object
+static bool make_entry(const std::string& path, const std::string& record, struct fuse_entry_param* entry)
+{
+	memset(entry, 0, sizeof(struct fuse_entry_param));
+	if (!StatRecord::to_struct_stat(record, &entry->attr))
+		return false;
+	entry->ino = inode_table.lookup(path);
+	entry->attr.st_ino = entry->ino;
+	entry->attr_timeout = attr_timeout;
+	entry->entry_timeout = entry_timeout;
+	return true;
 }
 
-static int myfs_unlink(const char *path)
+static void reply_entry(fuse_req_t req, const std::string& path, const std::string& record)
 {
-	// not a perfect error handling, but good enough for now
-	int error_cache = cache_client.remove_file(path);
-	int error_storage = storage_client.remove(path);
-	if (error_cache < 0 && error_storage < 0)
+	struct fuse_entry_param entry;
+	if (!make_entry(path, record, &entry))
 	{
-		return -EIO;
+		fuse_reply_err(req, ENOENT);
+		return;
 	}
+	// the kernel did not get it (the request was interrupted), so it will not forget it
+	if (fuse_reply_entry(req, &entry) != 0)
+		inode_table.forget(entry.ino, 1);
+}
+
+// The changes the cache servers tell of are handed to the kernel by a thread of their own:
+// a notification waits for the kernel, which may be waiting for the FUSE threads, and the
+// threads of the cache client are those answering them.
+struct Invalidation {
+	std::string path; // "" for ALL
+	InvalidationCode::Type code;
+};
+static std::mutex invalidation_mutex;
+static std::condition_variable invalidation_ready;
+static std::deque<Invalidation> invalidations;
+static bool invalidation_stopped = false;
+static std::thread invalidation_thread;
 
-	return 0;
+static void push_invalidation(const std::string& path, InvalidationCode::Type code)
+{
+	std::lock_guard<std::mutex> lock(invalidation_mutex);
+	if (invalidation_stopped)
+		return;
+	invalidations.push_back(Invalidation {path, code});
+	invalidation_ready.notify_one();
 }
 
-static int myfs_rmdir(const char *path)
+// the kernel answers ENOENT for what it does not hold, it is not an error
+static void invalidate_data(const std::string& path, bool attributes_only)
 {
-	int error = cache_client.remove_dir(path);
+	fuse_ino_t inode = inode_table.find(path);
+	if (inode != 0)
+		fuse_lowlevel_notify_inval_inode(session, inode, attributes_only ? -1 : 0, 0);
+}
 
-	if (error < 0)
+// the name in its parent, the parent (its size and times) and what the kernel kept of the object
+static void invalidate_entry(const std::string& path)
+{
+	size_t slash = path.rfind('/');
+	if (slash == std::string::npos || path == "/")
+		return;
+	std::string parent_path = slash == 0 ? "/" : path.substr(0, slash);
+	std::string name = path.substr(slash + 1);
+
+	fuse_ino_t parent = inode_table.find(parent_path);
+	if (parent != 0)
 	{
-		return -EIO;
+		fuse_lowlevel_notify_inval_entry(session, parent, name.c_str(), name.length());
+		fuse_lowlevel_notify_inval_inode(session, parent, -1, 0);
 	}
-
-	return -error;
+	invalidate_data(path, false);
 }
 
-static int myfs_rename(const char *old_path, const char *new_path, unsigned int flags)
+static void run_invalidations()
 {
-	int error = cache_client.rename(old_path, new_path);
+	while (true)
+	{
+		Invalidation invalidation;
+		{
+			std::unique_lock<std::mutex> lock(invalidation_mutex);
+			invalidation_ready.wait(lock, [] { return invalidation_stopped || !invalidations.empty(); });
+			if (invalidation_stopped)
+				return;
+			invalidation = std::move(invalidations.front());
+			invalidations.pop_front();
+		}
 
-	if (error < 0)
+		SPDLOG_TRACE("Invalidate {}: {}.", invalidation.path, InvalidationCode::to_string(invalidation.code));
+		switch (invalidation.code)
+		{
+			case InvalidationCode::Type::DATA:
+				invalidate_data(invalidation.path, false);
+				break;
+			case InvalidationCode::Type::ATTR:
+				invalidate_data(invalidation.path, true);
+				break;
+			case InvalidationCode::Type::ENTRY:
+				invalidate_entry(invalidation.path);
+				break;
+			default:
+				// changes were missed while a cache server was away
+				for (const std::string& path : inode_table.get_paths())
+					invalidate_entry(path);
+				fuse_lowlevel_notify_inval_inode(session, CacheAPI::InodeTable::root, 0, 0);
+				break;
+		}
+	}
+}
+
+static void stop_invalidations()
+{
 	{
-		return -EIO;
+		std::lock_guard<std::mutex> lock(invalidation_mutex);
+		invalidation_stopped = true;
+		invalidations.clear();
 	}
+	invalidation_ready.notify_one();
+	if (invalidation_thread.joinable())
+		invalidation_thread.join();
+}
 
-	return 0;
+static void myfs_lookup(fuse_req_t req, fuse_ino_t parent, const char *name)
+{
+	std::string parent_path;
+	if (!get_path(req, parent, parent_path))
+		return;
+
+	std::string path = CacheAPI::InodeTable::get_child_path(parent_path, name);
+	get_record(path, [req, path] (std::string record) { reply_entry(req, path, record); });
 }
 
-static int myfs_chmod(const char *path, mode_t mode, struct fuse_file_info *file_info)
+static void myfs_forget(fuse_req_t req, fuse_ino_t inode, uint64_t lookups)
 {
-	int error = cache_client.chmod(path, mode);
+	inode_table.forget(inode, lookups);
+	fuse_reply_none(req);
+}
 
-	if (error < 0)
+static void myfs_forget_multi(fuse_req_t req, size_t count, struct fuse_forget_data *forgets)
+{
+	for (size_t i = 0; i < count; i++)
+		inode_table.forget(forgets[i].ino, forgets[i].nlookup);
+	fuse_reply_none(req);
+}
+
+static void myfs_getattr(fuse_req_t req, fuse_ino_t inode, struct fuse_file_info *file_info)
+{
+	(void) file_info;
+	std::string path;
+	if (!get_path(req, inode, path))
+		return;
+
+	get_record(path, [req, inode] (std::string record) { reply_attr(req, inode, record); });
+}
+
+static void myfs_setattr(fuse_req_t req, fuse_ino_t inode, struct stat *attr, int to_set, struct fuse_file_info *file_info)
+{
+	(void) file_info;
+	std::string path;
+	if (!get_path(req, inode, path))
+		return;
+
+	// there is no truncate, and the times are not kept
+	int error = 0;
+	if (to_set & FUSE_SET_ATTR_SIZE)
+		error = ENOSYS;
+	if (error == 0 && (to_set & FUSE_SET_ATTR_MODE))
+		error = to_errno(cache_client.chmod(path, attr->st_mode));
+	if (error == 0 && (to_set & (FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID)))
+		error = to_errno(cache_client.chown(path,
+			(to_set & FUSE_SET_ATTR_UID) ? attr->st_uid : (uid_t) -1,
+			(to_set & FUSE_SET_ATTR_GID) ? attr->st_gid : (gid_t) -1));
+
+	if (error != 0)
 	{
-		return -EIO;
+		fuse_reply_err(req, error);
+		return;
 	}
+	get_record(path, [req, inode] (std::string record) { reply_attr(req, inode, record); });
+}
+
+static void myfs_mkdir(fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode)
+{
+	std::string parent_path;
+	if (!get_path(req, parent, parent_path))
+		return;
 
-	return 0;
+	std::string path = CacheAPI::InodeTable::get_child_path(parent_path, name);
+	int error = cache_client.set_dir(path, std::to_string(mode));
+	if (error != 0)
+	{
+		fuse_reply_err(req, to_errno(error));
+		return;
+	}
+	cache_client.get_dir(path, [req, path] (std::string record) { reply_entry(req, path, record); });
 }
 
-static int myfs_chown(const char *path, uid_t uid, gid_t gid, struct fuse_file_info *file_info)
+static void myfs_unlink(fuse_req_t req, fuse_ino_t parent, const char *name)
 {
-	int error = cache_client.chown(path, uid, gid);
+	std::string parent_path;
+	if (!get_path(req, parent, parent_path))
+		return;
+	std::string path = CacheAPI::InodeTable::get_child_path(parent_path, name);
 
-	if (error < 0)
+	// the size tells the storage manager which stripes to reclaim, it deletes them later
+	std::string record = cache_client.get_file(path);
+	int64_t file_size = StatRecord::is_valid(record) ? StatRecord::get_size(record) : -1;
+
+	// not a perfect error handling, but good enough for now
+	int error_cache = cache_client.remove_file(path);
+	int error_storage = storage_client.remove(path, file_size);
+	if (error_cache < 0 && error_storage < 0)
 	{
-		return -EIO;
+		fuse_reply_err(req, EIO);
+		return;
 	}
 
-	return 0;
+	inode_table.remove(path);
+	fuse_reply_err(req, 0);
 }
 
-static int myfs_open(const char *path, struct fuse_file_info *file_info)
+static void myfs_rmdir(fuse_req_t req, fuse_ino_t parent, const char *name)
 {
-	(void) file_info;
-	std::string res = cache_client.get_file(path);
-	if (res.empty())
-		return -ENOENT;
-	return 0;
+	std::string parent_path;
+	if (!get_path(req, parent, parent_path))
+		return;
+
+	std::string path = CacheAPI::InodeTable::get_child_path(parent_path, name);
+	int error = cache_client.remove_dir(path);
+	if (error == 0)
+		inode_table.remove(path);
+	fuse_reply_err(req, to_errno(error));
 }
 
-int myfs_release(const char *path, struct fuse_file_info *file_info)
+static void myfs_rename(fuse_req_t req, fuse_ino_t parent, const char *name, fuse_ino_t new_parent, const char *new_name, unsigned int flags)
 {
-	(void) path;
-	(void) file_info;
+	(void) flags;
+	std::string parent_path, new_parent_path;
+	if (!get_path(req, parent, parent_path) || !get_path(req, new_parent, new_parent_path))
+		return;
 
-	return 0;
+	std::string old_path = CacheAPI::InodeTable::get_child_path(parent_path, name);
+	std::string new_path = CacheAPI::InodeTable::get_child_path(new_parent_path, new_name);
+	// EXDEV for a directory that would move to another cache server, mv copies it instead
+	int error = cache_client.rename(old_path, new_path);
+	if (error == 0)
+		inode_table.rename(old_path, new_path);
+	fuse_reply_err(req, to_errno(error));
 }
 
-static int myfs_read(const char *path, char *buffer, size_t size, off_t offset, struct fuse_file_info *file_info)
+static void myfs_open(fuse_req_t req, fuse_ino_t inode, struct fuse_file_info *file_info)
 {
-	std::cout << "Read" << std::endl;
-	std::cout << "Size: " << size << std::endl;
-	std::cout << "Offset: " << offset << std::endl;
-		
-	// Utils::PerformanceTimer timer("Storage Client Read", read_log_file);
-	size_t r_size = storage_client.read(path, buffer, size, offset);	
-	// std::cout << "Request offset: " << offset << " received: " << r_size << std::endl;
-	return r_size;
+	std::string path;
+	if (!get_path(req, inode, path))
+		return;
+
+	// file_info belongs to the FUSE thread, the reply gets a copy
+	struct fuse_file_info info = *file_info;
+	HostInfo *host_info = (HostInfo*) fuse_req_userdata(req);
+	info.keep_cache = host_info->kernel_cache;
+	cache_client.get_file(path, [req, info] (std::string record) mutable {
+		if (!StatRecord::is_valid(record))
+		{
+			fuse_reply_err(req, ENOENT);
+			return;
+		}
+		// the compression policy is read once per open and handed to every write
+		info.fh = StatRecord::get_compression(record);
+		fuse_reply_open(req, &info);
+	});
 }
 
-static int myfs_write(const char *path, const char *buffer, size_t size, off_t offset, struct fuse_file_info * file_info)
+static void myfs_release(fuse_req_t req, fuse_ino_t inode, struct fuse_file_info *file_info)
 {
-	std::cout << "Write" << std::endl;
-	std::cout << "Size: " << size << std::endl;
-	std::cout << "Offset: " << offset << std::endl;
+	(void) inode;
+	(void) file_info;
+	fuse_reply_err(req, 0);
+}
 
-	// std::vector<uint8_t> vec_buffer(buffer, buffer + size);
+// spliced to /dev/fuse when the kernel allows it (FUSE_CAP_SPLICE_WRITE)
+static void reply_data(fuse_req_t req, std::vector<char>& buffer, size_t size)
+{
+	struct fuse_bufvec data = FUSE_BUFVEC_INIT(size);
+	data.buf[0].mem = buffer.data();
+	fuse_reply_data(req, &data, FUSE_BUF_SPLICE_MOVE);
+}
 
-	// return storage_client.write_stripes(path, vec_buffer, size, offset);
-	// Utils::PerformanceTimer timer("Storage Client Write", write_log_file);
-	int nbytes;
-	// {
-	nbytes = storage_client.write(path, buffer, size, offset);
-	// }
-	// std::cout << nbytes << std::endl;
+// the results of the chunks of a read or write, see max_request_size
+struct ChunkedRequest {
+	std::vector<int> results;
+	std::atomic<size_t> left;
+
+	ChunkedRequest(size_t chunks) : results(chunks), left(chunks) {}
+};
+
+static void reply_read(fuse_req_t req, const std::string& path, std::shared_ptr<std::vector<char>> buffer, size_t size, off_t offset, int r_size, uint64_t trace_id, uint64_t start)
+{
+	if (r_size < 0 || (size_t) r_size == size)
 	{
-		// Utils::PerformanceTimer timer("Cache Client Chsize", cache_log_file);
-		cache_client.chsize(path, offset + (off_t) nbytes);
+		Tracing::record(trace_id, "fuse_read", start, Tracing::now(), "offset", offset);
+		if (r_size < 0)
+			fuse_reply_err(req, -r_size);
+		else
+			reply_data(req, *buffer, r_size);
+		return;
 	}
-	return nbytes;
+
+	// the storage stops at the last stripe holding data, the zeros after it up to
+	// the end of the file were never stored
+	cache_client.get_file(path, [req, buffer, size, offset, r_size, trace_id, start] (std::string record) {
+		size_t length = r_size;
+		if (StatRecord::is_valid(record) && StatRecord::get_size(record) > offset)
+		{
+			size_t file_end = std::min<size_t>(size, StatRecord::get_size(record) - offset);
+			if (file_end > length)
+			{
+				memset(buffer->data() + length, 0, file_end - length);
+				length = file_end;
+			}
+		}
+		Tracing::record(trace_id, "fuse_read", start, Tracing::now(), "offset", offset);
+		reply_data(req, *buffer, length);
+	});
 }
 
-static int myfs_opendir(const char *path, struct fuse_file_info *file_info) 
+static void myfs_read(fuse_req_t req, fuse_ino_t inode, size_t size, off_t offset, struct fuse_file_info *file_info)
 {
-	std::string result = cache_client.get_dir(path);
-	if (result.empty())
-		return -ENOENT;
-	return 0;
+	(void) file_info;
+	std::string path;
+	if (!get_path(req, inode, path))
+		return;
+	SPDLOG_TRACE("Read {}: size {}, offset {}.", path, size, offset);
+
+	uint64_t trace_id = Tracing::start_trace();
+	uint64_t start = Tracing::now();
+	auto buffer = std::make_shared<std::vector<char>>(size);
+	if (size <= max_request_size)
+	{
+		storage_client.read(path, buffer->data(), size, offset, trace_id,
+			[req, path, buffer, size, offset, trace_id, start] (int r_size) {
+				reply_read(req, path, buffer, size, offset, r_size, trace_id, start);
+			});
+		return;
+	}
+
+	// the chunks are read at once, a chunk past the data of the file reads short
+	size_t chunks = (size + max_request_size - 1) / max_request_size;
+	auto read = std::make_shared<ChunkedRequest>(chunks);
+	for (size_t i = 0; i < chunks; i++)
+	{
+		size_t chunk_offset = i * max_request_size;
+		size_t chunk_size = std::min(max_request_size, size - chunk_offset);
+		storage_client.read(path, buffer->data() + chunk_offset, chunk_size, offset + chunk_offset, trace_id,
+			[req, path, buffer, size, offset, trace_id, start, read, i] (int r_size) {
+				read->results[i] = r_size;
+				if (--read->left > 0)
+					return;
+
+				// up to the last chunk holding data, the holes before it are zeros
+				int length = 0;
+				for (size_t j = 0; j < read->results.size(); j++)
+				{
+					if (read->results[j] < 0)
+					{
+						reply_read(req, path, buffer, size, offset, read->results[j], trace_id, start);
+						return;
+					}
+					if (read->results[j] > 0)
+						length = j * max_request_size + read->results[j];
+				}
+				for (size_t j = 0; j * max_request_size < (size_t) length; j++)
+				{
+					size_t chunk_end = std::min<size_t>((j + 1) * max_request_size, length);
+					size_t data_end = j * max_request_size + read->results[j];
+					if (data_end < chunk_end)
+						memset(buffer->data() + data_end, 0, chunk_end - data_end);
+				}
+				reply_read(req, path, buffer, size, offset, length, trace_id, start);
+			});
+	}
 }
 
-static int myfs_readdir(const char *path, void *buffer, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *file_info, enum fuse_readdir_flags flags)
+static void myfs_lseek(fuse_req_t req, fuse_ino_t inode, off_t offset, int whence, struct fuse_file_info *file_info)
 {
-	(void) offset;
 	(void) file_info;
+	if (whence != SEEK_DATA && whence != SEEK_HOLE)
+	{
+		fuse_reply_err(req, EINVAL);
+		return;
+	}
+
+	std::string path;
+	if (!get_path(req, inode, path))
+		return;
+
+	std::string record = cache_client.get_file(path);
+	if (!StatRecord::is_valid(record))
+	{
+		fuse_reply_err(req, ENOENT);
+		return;
+	}
+
+	int64_t file_size = StatRecord::get_size(record);
+	if (offset < 0 || offset >= file_size)
+	{
+		fuse_reply_err(req, ENXIO);
+		return;
+	}
+
+	off_t result = storage_client.seek(path, offset, whence, file_size);
+	if (result < 0)
+		fuse_reply_err(req, -result);
+	else
+		fuse_reply_lseek(req, result);
+}
+
+static void myfs_write_buf(fuse_req_t req, fuse_ino_t inode, struct fuse_bufvec *data, off_t offset, struct fuse_file_info *file_info)
+{
+	std::string path;
+	if (!get_path(req, inode, path))
+		return;
+	size_t size = fuse_buf_size(data);
+	SPDLOG_TRACE("Write {}: size {}, offset {}.", path, size, offset);
+
+	// with FUSE_CAP_SPLICE_READ the data is still in the pipe it was spliced to, it is
+	// copied once, here, and the request is built from it
+	auto buffer = std::make_shared<std::vector<char>>(size);
+	struct fuse_bufvec copy = FUSE_BUFVEC_INIT(size);
+	copy.buf[0].mem = buffer->data();
+	ssize_t copied = fuse_buf_copy(&copy, data, (enum fuse_buf_copy_flags) 0);
+	if (copied < 0)
+	{
+		fuse_reply_err(req, -copied);
+		return;
+	}
+
+	uint64_t trace_id = Tracing::start_trace();
+	uint64_t start = Tracing::now();
+	CompressionCode::Type compression = file_info ? CompressionCode::from_byte(file_info->fh) : CompressionCode::Type::NONE;
+	// the chunks are written at once, the size is set once they are all stored
+	size_t chunks = std::max<size_t>((copied + max_request_size - 1) / max_request_size, 1);
+	auto write = std::make_shared<ChunkedRequest>(chunks);
+	for (size_t i = 0; i < chunks; i++)
+	{
+		size_t chunk_offset = i * max_request_size;
+		size_t chunk_size = std::min<size_t>(max_request_size, copied - chunk_offset);
+		storage_client.write(path, buffer->data() + chunk_offset, chunk_size, offset + chunk_offset, compression, trace_id,
+			[req, path, buffer, copied, offset, trace_id, start, write, i] (int nbytes) {
+				write->results[i] = nbytes;
+				if (--write->left > 0)
+					return;
+
+				// the bytes written up to the first chunk that failed or was cut short
+				size_t written = 0;
+				int error = 0;
+				for (size_t j = 0; j < write->results.size(); j++)
+				{
+					size_t chunk_size = std::min<size_t>(max_request_size, copied - j * max_request_size);
+					if (write->results[j] < 0)
+						error = -write->results[j];
+					else
+						written += write->results[j];
+					if (write->results[j] < 0 || (size_t) write->results[j] < chunk_size)
+						break;
+				}
+				if (written == 0 && error != 0)
+				{
+					Tracing::record(trace_id, "fuse_write", start, Tracing::now(), "offset", offset);
+					fuse_reply_err(req, error);
+					return;
+				}
+
+				uint64_t chsize_start = Tracing::now();
+				cache_client.extend(path, offset + (off_t) written,
+					[req, written, offset, trace_id, start, chsize_start] (int error) {
+						(void) error;
+						uint64_t end = Tracing::now();
+						Tracing::record(trace_id, "chsize", chsize_start, end);
+						Tracing::record(trace_id, "fuse_write", start, end, "offset", offset);
+						fuse_reply_write(req, written);
+					});
+			});
+	}
+}
+
+// the compression policy of a file or directory is exposed as an extended attribute:
+// setfattr -n user.dfs.compression -v zstd dir, new entries inherit it from their parent
+static const char* compression_xattr = "user.dfs.compression";
+
+static void myfs_setxattr(fuse_req_t req, fuse_ino_t inode, const char *name, const char *value, size_t size, int flags)
+{
 	(void) flags;
+	if (strcmp(name, compression_xattr) != 0)
+	{
+		fuse_reply_err(req, ENOTSUP);
+		return;
+	}
 
-	Stat dir_proto;
-	std::string dir_proto_str = cache_client.get_dir(path);
-	if (dir_proto_str.empty())
-		return -ENOENT;
+	CompressionCode::Type codec = CompressionCode::from_string(std::string(value, size));
+	if (codec == CompressionCode::Type::UNKNOWN)
+	{
+		fuse_reply_err(req, EINVAL);
+		return;
+	}
 
-	dir_proto.ParseFromString(dir_proto_str);
+	std::string path;
+	if (!get_path(req, inode, path))
+		return;
+	fuse_reply_err(req, to_errno(cache_client.set_compression(path, codec)));
+}
 
-	for (const auto& entry : dir_proto.dir_list())
-		filler(buffer, entry.c_str(), nullptr, 0, FUSE_FILL_DIR_PLUS);
+static void myfs_getxattr(fuse_req_t req, fuse_ino_t inode, const char *name, size_t size)
+{
+	if (strcmp(name, compression_xattr) != 0)
+	{
+		fuse_reply_err(req, ENODATA);
+		return;
+	}
 
-	return 0;
+	std::string path;
+	if (!get_path(req, inode, path))
+		return;
+
+	std::string record = cache_client.get_file(path);
+	if (record.empty())
+		record = cache_client.get_dir(path);
+	if (!StatRecord::is_valid(record))
+	{
+		fuse_reply_err(req, ENOENT);
+		return;
+	}
+
+	std::string codec = CompressionCode::to_string(CompressionCode::from_byte(StatRecord::get_compression(record)));
+	if (size == 0)
+		fuse_reply_xattr(req, codec.length());
+	else if (size < codec.length())
+		fuse_reply_err(req, ERANGE);
+	else
+		fuse_reply_buf(req, codec.c_str(), codec.length());
 }
 
-static int myfs_releasedir(const char *path, struct fuse_file_info *file_info)
+static void myfs_opendir(fuse_req_t req, fuse_ino_t inode, struct fuse_file_info *file_info)
 {
-	(void) path;
-	(void) file_info;
-	return 0;
+	std::string path;
+	if (!get_path(req, inode, path))
+		return;
+
+	// the entries are listed once per opendir, the readdir calls go through them
+	struct fuse_file_info info = *file_info;
+	cache_client.get_dir(path, [req, info] (std::string record) mutable {
+		if (!StatRecord::is_valid(record))
+		{
+			fuse_reply_err(req, ENOENT);
+			return;
+		}
+		auto entries = new std::vector<std::string>(StatRecord::get_entries(record));
+		info.fh = (uint64_t) entries;
+		if (fuse_reply_open(req, &info) != 0)
+			delete entries;
+	});
 }
 
-static void* myfs_init(struct fuse_conn_info *connection_info, struct fuse_config *config)
+static void myfs_readdir(fuse_req_t req, fuse_ino_t inode, size_t size, off_t offset, struct fuse_file_info *file_info)
 {
-	(void) connection_info;
-	// connection_info->max_write = 1024 * 128;
-    // connection_info->max_read  = 1024 * 128;
+	(void) inode;
+	const std::vector<std::string>& entries = *(std::vector<std::string>*) file_info->fh;
 
-	HostInfo *host_info = (struct HostInfo*) fuse_get_context()->private_data;
-	if (host_info->cache_address.length() > 0 && host_info->cache_port.length() > 0)
+	struct stat entry_stat;
+	memset(&entry_stat, 0, sizeof(struct stat));
+	entry_stat.st_ino = unknown_inode;
+
+	// the offset of an entry is the index of the next one
+	std::vector<char> buffer(size);
+	size_t used = 0;
+	for (size_t i = offset; i < entries.size(); i++)
+	{
+		size_t length = fuse_add_direntry(req, buffer.data() + used, size - used, entries[i].c_str(), &entry_stat, i + 1);
+		if (length > size - used)
+			break;
+		used += length;
+	}
+	fuse_reply_buf(req, buffer.data(), used);
+}
+
+static void myfs_releasedir(fuse_req_t req, fuse_ino_t inode, struct fuse_file_info *file_info)
+{
+	(void) inode;
+	delete (std::vector<std::string>*) file_info->fh;
+	fuse_reply_err(req, 0);
+}
+
+static void myfs_init(void *userdata, struct fuse_conn_info *connection_info)
+{
+	HostInfo *host_info = (struct HostInfo*) userdata;
+	cache_client.set_subtree_depth(host_info->shard_depth);
+	cache_client.set_negative_timeout(std::chrono::milliseconds(host_info->negative_timeout));
+	if (host_info->cache_servers.size() > 0)
+	{
+		cache_client.connect(host_info->cache_servers);
+	}
+	else if (host_info->cache_address.length() > 0 && host_info->cache_port.length() > 0)
 	{
 		cache_client.connect(host_info->cache_address, host_info->cache_port);
 	}
 	else
 	{
-		cache_client.connect("127.0.0.1", "8888"); 
+		cache_client.connect("127.0.0.1", "8888");
 	}
 
-	if (host_info->storage_address.length() > 0 && host_info->storage_port.length() > 0)
+	if (host_info->storage_managers.size() > 0)
+	{
+		storage_client.connect(host_info->storage_managers);
+	}
+	else if (host_info->storage_address.length() > 0 && host_info->storage_port.length() > 0)
 	{
 		storage_client.connect(host_info->storage_address, host_info->storage_port);
 	}
 	else
 	{
-		storage_client.connect("127.0.0.1", "13337"); 
+		storage_client.connect("127.0.0.1", "13337");
+	}
+
+	// the write data is spliced from /dev/fuse into a pipe and the read replies the other way,
+	// without the copies through the buffer of the FUSE thread
+	unsigned splice = FUSE_CAP_SPLICE_READ | FUSE_CAP_SPLICE_WRITE | FUSE_CAP_SPLICE_MOVE;
+	connection_info->want |= connection_info->capable & splice;
+	connection_info->max_background = max_background;
+	connection_info->congestion_threshold = max_background * 3 / 4;
+	// max_read is a mount option, main passes it
+	connection_info->max_write = max_io_size;
+	connection_info->max_readahead = max_io_size;
+	if (host_info->writeback_cache && (connection_info->capable & FUSE_CAP_WRITEBACK_CACHE))
+		connection_info->want |= FUSE_CAP_WRITEBACK_CACHE;
+
+	// the kernel keeps what it read until a cache server tells of a change
+	if (host_info->kernel_cache || host_info->writeback_cache)
+	{
+		attr_timeout = kernel_cache_timeout;
+		entry_timeout = kernel_cache_timeout;
+		invalidation_thread = std::thread(run_invalidations);
+		cache_client.watch(push_invalidation);
 	}
-	return nullptr;
+
+	// started here and not in main, fuse_daemonize forks when it goes to the background
+	if (host_info->metrics_port != 0)
+		metrics_endpoint = std::make_unique<Metrics::Endpoint>(host_info->metrics_port);
 }
 
-static int myfs_create(const char *path, mode_t mode, struct fuse_file_info *file_info) 
+static void myfs_create(fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode, struct fuse_file_info *file_info)
 {
-	(void) file_info;
+	std::string parent_path;
+	if (!get_path(req, parent, parent_path))
+		return;
 
+	std::string path = CacheAPI::InodeTable::get_child_path(parent_path, name);
 	int error = cache_client.set_file(path, std::to_string(mode));
-
 	if (error < 0)
 	{
-		fprintf(stderr, "Error: failed to create the file, please verify the logs!");
-		return -EIO;
+		SPDLOG_ERROR("Failed to create {}.", path);
+		fuse_reply_err(req, EIO);
+		return;
+	}
+	if (error > 0)
+	{
+		fuse_reply_err(req, error);
+		return;
 	}
-	
-	return -error;
-}
 
-static int myfs_utimens(const char *path, const struct timespec tv[2], struct fuse_file_info *file_info)
-{
-	(void) path;
-	(void) tv;
-	(void) file_info;
-	return 0;
+	// the new file inherited the policy of its directory
+	std::string record = cache_client.get_file(path);
+	struct fuse_entry_param entry;
+	if (!make_entry(path, record, &entry))
+	{
+		fuse_reply_err(req, EIO);
+		return;
+	}
+	file_info->fh = StatRecord::get_compression(record);
+	if (fuse_reply_create(req, &entry, file_info) != 0)
+		inode_table.forget(entry.ino, 1);
 }
 
-static const struct fuse_operations myfs_oper = {
+static const struct fuse_lowlevel_ops myfs_oper = {
+	.init		= myfs_init,
+	.lookup		= myfs_lookup,
+	.forget		= myfs_forget,
 	.getattr	= myfs_getattr,
+	.setattr	= myfs_setattr,
 	.mkdir 		= myfs_mkdir,
 	.unlink		= myfs_unlink,
 	.rmdir		= myfs_rmdir,
 	.rename		= myfs_rename,
-	.chmod		= myfs_chmod, 
-	.chown		= myfs_chown, 
 	.open		= myfs_open,
 	.read		= myfs_read,
-    .write 	    = myfs_write,
 	.release	= myfs_release,
 	.opendir	= myfs_opendir,
 	.readdir	= myfs_readdir,
 	.releasedir = myfs_releasedir,
-	.init       = myfs_init,
+	.setxattr	= myfs_setxattr,
+	.getxattr	= myfs_getxattr,
 	.create 	= myfs_create,
-	.utimens	= myfs_utimens,
+	.write_buf	= myfs_write_buf,
+	.forget_multi = myfs_forget_multi,
+	.lseek		= myfs_lseek,
 };
 
 int main(int argc, char** argv)
 {
 	int ret;
 	HostInfo host_info;
+	Tracing::set_process_name("fs");
 	struct fuse_args args = FUSE_ARGS_INIT(0, NULL);
-	spdlog::set_level(spdlog::level::debug); // Set global log level
-	spdlog::set_pattern("(%s:%#) [%^%l%$] %v");
 	// Parse command-line arguments
     for (int i = 0; i < argc; ++i) {
         if (strcmp(argv[i], "--cache-address") == 0 && i + 1 < argc) {
@@ -287,6 +826,22 @@ int main(int argc, char** argv)
             host_info.cache_port = argv[i + 1];
             i++; 
         }
+        else if (strcmp(argv[i], "--cache-servers") == 0 && i + 1 < argc) {
+            // address:port,address:port,... in the same order on every client
+            std::stringstream servers(argv[i + 1]);
+            std::string server;
+            while (std::getline(servers, server, ','))
+                host_info.cache_servers.push_back(server);
+            i++; 
+        }
+        else if (strcmp(argv[i], "--shard-depth") == 0 && i + 1 < argc) {
+            host_info.shard_depth = atoi(argv[i + 1]); // depth of the directories the namespace is split at
+            i++; 
+        }
+        else if (strcmp(argv[i], "--negative-timeout") == 0 && i + 1 < argc) {
+            host_info.negative_timeout = atoi(argv[i + 1]);
+            i++; 
+        }
         else if (strcmp(argv[i], "--storage-address") == 0 && i + 1 < argc) {
             host_info.storage_address = argv[i + 1];
             i++; 
@@ -294,14 +849,70 @@ int main(int argc, char** argv)
         else if (strcmp(argv[i], "--storage-port") == 0 && i + 1 < argc) {
             host_info.storage_port = argv[i + 1];
             i++; 
+        }
+        else if (strcmp(argv[i], "--storage-managers") == 0 && i + 1 < argc) {
+            // address:port,address:port,... in the same order on every client
+            std::stringstream managers(argv[i + 1]);
+            std::string manager;
+            while (std::getline(managers, manager, ','))
+                host_info.storage_managers.push_back(manager);
+            i++; 
+        }
+        else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            host_info.metrics_port = atoi(argv[i + 1]);
+            i++; 
+        }
+        else if (strcmp(argv[i], "--kernel-cache") == 0) {
+            host_info.kernel_cache = true; // kept coherent by the invalidations of the cache servers
+        }
+        else if (strcmp(argv[i], "--writeback-cache") == 0) {
+            host_info.writeback_cache = true;
+        }
+        else if (strcmp(argv[i], "--trace-sample-rate") == 0 && i + 1 < argc) {
+            Tracing::set_sample_rate(atof(argv[i + 1])); // e.g. 0.001, the spans are served on /trace
+            i++; 
         }
 		else {
 			fuse_opt_add_arg(&args, argv[i]);
 		}
     }
+	fuse_opt_add_arg(&args, std::format("-omax_read={}", max_io_size).c_str());
+
+	struct fuse_cmdline_opts options;
+	if (fuse_parse_cmdline(&args, &options) != 0)
+		return 1;
+	if (options.show_help || options.mountpoint == nullptr)
+	{
+		printf("usage: %s [options] <mountpoint>\n\n", argv[0]);
+		fuse_cmdline_help();
+		fuse_lowlevel_help();
+		free(options.mountpoint);
+		fuse_opt_free_args(&args);
+		return options.show_help ? 0 : 1;
+	}
+
+	ret = 1;
+	session = fuse_session_new(&args, &myfs_oper, sizeof(myfs_oper), &host_info);
+	if (session != nullptr)
+	{
+		if (fuse_set_signal_handlers(session) == 0)
+		{
+			if (fuse_session_mount(session, options.mountpoint) == 0)
+			{
+				fuse_daemonize(options.foreground);
+				// after the fork, the thread writing the messages would stay in the parent
+				Logging::init(spdlog::level::debug); // Set global log level, the messages are written asynchronously
+				// clone_fd: every worker thread reads the requests from its own /dev/fuse descriptor
+				ret = options.singlethread ? fuse_session_loop(session) : fuse_session_loop_mt(session, 1);
+				stop_invalidations();
+				fuse_session_unmount(session);
+			}
+			fuse_remove_signal_handlers(session);
+		}
+		fuse_session_destroy(session);
+	}
 
-	ret = fuse_main(args.argc, args.argv, &myfs_oper, &host_info);
+	free(options.mountpoint);
 	fuse_opt_free_args(&args);
-	
     return ret;
 }
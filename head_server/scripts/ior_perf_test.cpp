@@ -0,0 +1,211 @@
+#include "../lib/sharded_storage_client.hpp"
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <CLI11.hpp>
+#include <mpi.h>
+
+using namespace StorageAPI;
+
+// IOR-style data benchmark, talks to the storage manager through StorageClient
+// so nothing of FUSE, the kernel or the page cache is measured.
+// usage: mpirun -n <ranks> bin/ior_perf_test -a <manager> -p <port> [options] (built with Makefile_perf)
+// or --managers address:port,... to spread the files over several managers (-F)
+//
+// Every rank runs --threads workers, a worker writes and then reads back
+// --block-size bytes in requests of --transfer-size bytes, either to a file
+// of its own or to its segment of one shared file, in order or shuffled. The
+// bandwidth of a phase is the bytes of all workers over the time between the
+// barriers around it (the slowest rank), like IOR reports it.
+
+struct Options {
+    std::string address = "127.0.0.1";
+    std::string port = "7777";
+    std::vector<std::string> managers;
+    std::string path = "/ior_perf_test";
+    std::string mode = "rw";
+    int threads = 1;
+    size_t stripe_size = 131072;
+    size_t transfer_size = 131072;
+    size_t block_size = 16ul << 20;
+    bool file_per_process = false;
+    bool random = false;
+    bool verify = false;
+    bool keep = false;
+};
+
+struct Phase {
+    const char* name;
+    bool write;
+};
+
+int rank = 0, rank_count = 1;
+Options options;
+
+// the data of a transfer depends on where it is written, so a read returning the wrong stripe is caught
+void fill(std::vector<char>& buffer, size_t offset)
+{
+    for (size_t i = 0; i + 8 <= buffer.size(); i += 8)
+    {
+        uint64_t word = (offset + i) * 0x9e3779b97f4a7c15ull;
+        std::memcpy(buffer.data() + i, &word, 8);
+    }
+}
+
+std::string get_file_path(int worker)
+{
+    if (options.file_per_process)
+        return std::format("{}.{:08}", options.path, worker);
+    return options.path;
+}
+
+// offsets of the transfers of one worker, in the order it issues them
+std::vector<size_t> get_offsets(int worker)
+{
+    size_t base = options.file_per_process ? 0 : worker * options.block_size;
+    std::vector<size_t> offsets;
+    for (size_t offset = 0; offset < options.block_size; offset += options.transfer_size)
+        offsets.push_back(base + offset);
+
+    if (options.random)
+    {
+        std::mt19937_64 generator(worker + 1);
+        std::shuffle(offsets.begin(), offsets.end(), generator);
+    }
+    return offsets;
+}
+
+void run_phase(ShardedStorageClient& client, const Phase& phase)
+{
+    Metrics::Histogram latency; // nanoseconds per transfer
+    std::atomic<uint64_t> errors {0}, bytes {0};
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; t++)
+    {
+        workers.emplace_back([&, t]() {
+            int worker = rank * options.threads + t;
+            std::string path = get_file_path(worker);
+            std::vector<char> buffer(options.transfer_size), expected(options.transfer_size);
+
+            for (size_t offset : get_offsets(worker))
+            {
+                if (phase.write || options.verify)
+                    fill(phase.write ? buffer : expected, offset);
+
+                auto transfer_start = std::chrono::steady_clock::now();
+                int result = phase.write
+                    ? client.write(path, buffer.data(), options.transfer_size, offset)
+                    : client.read(path, buffer.data(), options.transfer_size, offset);
+                latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - transfer_start).count());
+
+                if (result != (int) options.transfer_size || (!phase.write && options.verify && buffer != expected))
+                    errors.fetch_add(1, std::memory_order_relaxed);
+                else
+                    bytes.fetch_add(options.transfer_size, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // the percentiles are taken over the transfers of every rank
+    Metrics::Histogram::Snapshot snapshot, total;
+    latency.read(snapshot);
+    uint64_t local[] = {bytes.load(), errors.load(), snapshot.count}, global[3];
+    double seconds = elapsed.count(), max_seconds;
+    MPI_Reduce(local, global, 3, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&seconds, &max_seconds, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(snapshot.buckets.data(), total.buckets.data(), Metrics::Histogram::bucket_count,
+        MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&snapshot.max, &total.max, 1, MPI_UINT64_T, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (rank != 0)
+        return;
+
+    std::cout << std::format("{:<6} {:>10.2f} MiB/s {:>10.1f} IOPS  latency us p50 {:.1f} p90 {:.1f} p99 {:.1f} max {:.1f}  "
+        "{:.3f} s, {} errors\n", phase.name, global[0] / max_seconds / (1 << 20), global[2] / max_seconds,
+        total.get_percentile(0.5) / 1e3, total.get_percentile(0.9) / 1e3, total.get_percentile(0.99) / 1e3,
+        total.max / 1e3, max_seconds, global[1]);
+}
+
+int main(int argc, char** argv)
+{
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &rank_count);
+
+    CLI::App app {"IOR-style data benchmark of the storage manager."};
+    argv = app.ensure_utf8(argv);
+
+    app.add_option("-a, --address", options.address, "Address of the storage manager.");
+    app.add_option("-p, --port", options.port, "Port of the storage manager.");
+    app.add_option("--managers", options.managers, "Storage managers sharing the nodes, address:port in the same order for every rank.")->delimiter(',');
+    app.add_option("-o, --path", options.path, "File to test (per process files get the worker number appended).");
+    app.add_option("-m, --mode", options.mode, "Phases to run: w, r or rw.")->check(CLI::IsMember({"w", "r", "rw"}));
+    app.add_option("-T, --threads", options.threads, "Workers per rank.")->check(CLI::Range(1, 256));
+    app.add_option("-s, --stripe-size", options.stripe_size, "Stripe size of the client, as given to the FUSE client.")->check(CLI::Range(1, 131072));
+    app.add_option("-t, --transfer-size", options.transfer_size, "Bytes per request.")->check(CLI::Range(1, 1 << 30));
+    app.add_option("-b, --block-size", options.block_size, "Bytes each worker writes and reads.")->check(CLI::Range(1ul, 1ul << 32));
+    app.add_flag("-F, --file-per-process", options.file_per_process, "A file per worker instead of one shared file.");
+    app.add_flag("-z, --random", options.random, "Issue the transfers of a worker in random order.");
+    app.add_flag("-R, --verify", options.verify, "Check the data that is read back.");
+    app.add_flag("-k, --keep", options.keep, "Do not remove the files at the end.");
+    CLI11_PARSE(app, argc, argv);
+
+    int result = 0;
+    try {
+        Logging::init(spdlog::level::warn);
+
+        if (options.block_size % options.transfer_size != 0)
+            throw std::runtime_error("block size has to be a multiple of the transfer size");
+        // StoragePacket offsets are 32 bits wide
+        if ((options.file_per_process ? 1 : (size_t) rank_count * options.threads) * options.block_size > (1ul << 32))
+            throw std::runtime_error("files larger than 4 GiB are not supported");
+
+        ShardedStorageClient client(options.threads, options.stripe_size);
+        if (options.managers.empty())
+            client.connect(options.address, options.port);
+        else
+            client.connect(options.managers);
+
+        if (rank == 0)
+            std::cout << std::format("{} ranks x {} threads, transfer {} B, block {} B, {}, {}\n",
+                rank_count, options.threads, options.transfer_size, options.block_size,
+                options.file_per_process ? "file per process" : "shared file",
+                options.random ? "random" : "sequential");
+
+        if (options.mode.find('w') != std::string::npos)
+            run_phase(client, {"write", true});
+        if (options.mode.find('r') != std::string::npos)
+            run_phase(client, {"read", false});
+
+        if (!options.keep)
+        {
+            MPI_Barrier(MPI_COMM_WORLD);
+            if (options.file_per_process)
+                for (int t = 0; t < options.threads; t++)
+                    client.remove(get_file_path(rank * options.threads + t), options.block_size);
+            else if (rank == 0)
+                client.remove(options.path, (int64_t) rank_count * options.threads * options.block_size);
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << rank << ": " << e.what() << std::endl;
+        result = 1;
+    }
+
+    MPI_Finalize();
+    return result;
+}
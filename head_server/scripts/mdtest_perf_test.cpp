@@ -0,0 +1,220 @@
+#include "../lib/sharded_cache_client.hpp"
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <CLI11.hpp>
+#include <mpi.h>
+
+using namespace CacheAPI;
+
+// mdtest-style metadata benchmark, talks to the cache servers through ShardedCacheClient.
+// usage: mpirun -n <ranks> bin/mdtest_perf_test -a <cache server> -p <port> [options] (built with Makefile_perf)
+// or --servers address:port,... when the namespace is split between several cache servers
+//
+// Every rank runs --threads workers, each with a client of its own like
+// separate FUSE clients. A worker builds a tree of --depth levels with
+// --branch subdirectories per directory, either its own (unique dir) or one
+// tree all workers put their files in (shared dir), and runs every phase over
+// --items files per directory. A phase is timed between barriers, the rates
+// count the operations of all workers.
+
+struct Options {
+    std::string address = "127.0.0.1";
+    std::string port = "8888";
+    std::vector<std::string> servers;
+    int shard_depth = 1;
+    std::string path = "/mdtest_perf_test";
+    int threads = 1;
+    int depth = 1;
+    int branch = 2;
+    int items = 100;
+    bool shared = false;
+};
+
+// what a worker does in a phase with one file, or one directory for the directory phases
+struct Phase {
+    const char* name;
+    bool directories;
+    std::function<bool(ShardedCacheClient&, const std::string&)> run; // false on error
+};
+
+int rank = 0, rank_count = 1;
+Options options;
+
+// directories of a tree rooted at root, parents before their children
+std::vector<std::string> get_tree(const std::string& root)
+{
+    std::vector<std::string> tree = {root};
+    for (size_t first = 0, level = 0; level < (size_t) options.depth; level++)
+    {
+        size_t last = tree.size();
+        for (size_t i = first; i < last; i++)
+            for (int b = 0; b < options.branch; b++)
+                tree.push_back(std::format("{}/d{}", tree[i], b));
+        first = last;
+    }
+    return tree;
+}
+
+std::string get_root(int worker)
+{
+    if (options.shared)
+        return options.path + "/shared";
+    return std::format("{}/w{:06}", options.path, worker);
+}
+
+// in a shared tree the workers share the directories but not the files
+std::vector<std::string> get_files(const std::vector<std::string>& tree, int worker)
+{
+    std::vector<std::string> files;
+    for (const std::string& directory : tree)
+        for (int i = 0; i < options.items; i++)
+            files.push_back(std::format("{}/f{}.{}", directory, worker, i));
+    return files;
+}
+
+void run_phase(std::vector<std::unique_ptr<ShardedCacheClient>>& clients, const Phase& phase)
+{
+    Metrics::Histogram latency; // nanoseconds per operation
+    std::atomic<uint64_t> errors {0};
+    Metrics::Registry& registry = Metrics::get_registry();
+    uint64_t hits = registry.get_counter("cache_client_memcached_hits_total");
+    uint64_t misses = registry.get_counter("cache_client_memcached_misses_total");
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; t++)
+    {
+        workers.emplace_back([&, t]() {
+            int worker = rank * options.threads + t;
+            std::vector<std::string> tree = get_tree(get_root(worker));
+            std::vector<std::string> objects;
+            if (!phase.directories)
+                objects = get_files(tree, worker);
+            // a shared tree is made and removed by the first worker, removals go bottom up
+            else if (!options.shared || worker == 0)
+                objects = tree;
+            if (phase.directories && std::string(phase.name) == "dir_remove")
+                std::reverse(objects.begin(), objects.end());
+
+            for (const std::string& object : objects)
+            {
+                auto operation_start = std::chrono::steady_clock::now();
+                bool success = phase.run(*clients[t], object);
+                latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - operation_start).count());
+                if (!success)
+                    errors.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    Metrics::Histogram::Snapshot snapshot, total;
+    latency.read(snapshot);
+    uint64_t local[] = {snapshot.count, errors.load(),
+        registry.get_counter("cache_client_memcached_hits_total") - hits,
+        registry.get_counter("cache_client_memcached_misses_total") - misses}, global[4];
+    double seconds = elapsed.count(), max_seconds;
+    MPI_Reduce(local, global, 4, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&seconds, &max_seconds, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(snapshot.buckets.data(), total.buckets.data(), Metrics::Histogram::bucket_count,
+        MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&snapshot.max, &total.max, 1, MPI_UINT64_T, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (rank != 0)
+        return;
+
+    std::cout << std::format("{:<12} {:>10} ops {:>12.1f} ops/s  latency us p50 {:.1f} p90 {:.1f} p99 {:.1f} max {:.1f}  "
+        "memcached {} hits {} misses, {} errors\n", phase.name, global[0], global[0] / max_seconds,
+        total.get_percentile(0.5) / 1e3, total.get_percentile(0.9) / 1e3, total.get_percentile(0.99) / 1e3,
+        total.max / 1e3, global[2], global[3], global[1]);
+}
+
+int main(int argc, char** argv)
+{
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &rank_count);
+
+    CLI::App app {"mdtest-style metadata benchmark of the cache server."};
+    argv = app.ensure_utf8(argv);
+
+    app.add_option("-a, --address", options.address, "Address of the cache server.");
+    app.add_option("-p, --port", options.port, "Port of the cache server.");
+    app.add_option("--servers", options.servers, "Cache servers splitting the namespace, address:port in the same order for every rank.")->delimiter(',');
+    app.add_option("--shard-depth", options.shard_depth, "Depth of the directories the namespace is split at, 2 puts the unique trees of the workers on different servers.")->check(CLI::Range(1, 16));
+    app.add_option("-d, --path", options.path, "Directory the trees are made in, it must not exist.");
+    app.add_option("-T, --threads", options.threads, "Workers per rank.")->check(CLI::Range(1, 256));
+    app.add_option("-z, --depth", options.depth, "Levels of subdirectories of a tree.")->check(CLI::Range(0, 16));
+    app.add_option("-b, --branch", options.branch, "Subdirectories of each directory.")->check(CLI::Range(1, 64));
+    app.add_option("-I, --items", options.items, "Files per directory and worker.")->check(CLI::Range(0, 1 << 20));
+    app.add_flag("-S, --shared-dir", options.shared, "Every worker puts its files in one shared tree.");
+    CLI11_PARSE(app, argc, argv);
+
+    int result = 0;
+    try {
+        Logging::init(spdlog::level::warn);
+
+        std::vector<std::unique_ptr<ShardedCacheClient>> clients;
+        for (int t = 0; t < options.threads; t++)
+        {
+            clients.push_back(std::make_unique<ShardedCacheClient>(options.shard_depth));
+            if (options.servers.empty())
+                clients.back()->connect(options.address, options.port);
+            else
+                clients.back()->connect(options.servers);
+        }
+
+        if (rank == 0)
+        {
+            if (clients[0]->set_dir(options.path, std::to_string(S_IFDIR | 0755)) != 0)
+                throw std::runtime_error(std::format("could not create {}", options.path));
+            std::cout << std::format("{} ranks x {} threads, {} tree of depth {} and branch {}, {} files per directory\n",
+                rank_count, options.threads, options.shared ? "shared" : "unique", options.depth,
+                options.branch, options.items);
+        }
+
+        std::string file_mode = std::to_string(S_IFREG | 0644);
+        std::string dir_mode = std::to_string(S_IFDIR | 0755);
+        std::vector<Phase> phases = {
+            {"dir_create", true, [&](ShardedCacheClient& client, const std::string& path) {
+                return client.set_dir(path, dir_mode) == 0; }},
+            {"file_create", false, [&](ShardedCacheClient& client, const std::string& path) {
+                return client.set_file(path, file_mode) == 0; }},
+            {"file_stat", false, [&](ShardedCacheClient& client, const std::string& path) {
+                return client.get_file(path).length() > 0; }},
+            {"file_chsize", false, [&](ShardedCacheClient& client, const std::string& path) {
+                return client.chsize(path, 4096) == 0; }},
+            {"file_rename", false, [&](ShardedCacheClient& client, const std::string& path) {
+                return client.rename(path, path + ".r") == 0; }},
+            {"file_remove", false, [&](ShardedCacheClient& client, const std::string& path) {
+                return client.remove_file(path + ".r") == 0; }},
+            {"dir_remove", true, [&](ShardedCacheClient& client, const std::string& path) {
+                return client.remove_dir(path) == 0; }},
+        };
+        for (const Phase& phase : phases)
+            run_phase(clients, phase);
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (rank == 0)
+            clients[0]->remove_dir(options.path);
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << rank << ": " << e.what() << std::endl;
+        result = 1;
+    }
+
+    MPI_Finalize();
+    return result;
+}
@@ -1,8 +1,10 @@
 #include "../lib/storage_server.hpp"
+#include "../lib/mpi_transport.hpp"
+#include "../lib/tracing.hpp"
 // #include "../../lib/storage_server.hpp"
 #include <iostream>
 #include <CLI11.hpp>
-// #include <mpi.h>
+#include <mpi.h>
 
 using namespace StorageAPI;
 
@@ -21,20 +23,55 @@ int main(int argc, char** argv)
     uint8_t thread_count = 8;
     uint16_t port = 7777;
     int stripe_size = 4096;
+    int replica_count = 1;
+    double hedge_percentile = 0;
+    int data_fragments = 0;
+    int parity_fragments = 2;
+    uint32_t shm_slots = 32;
+    double gc_rate = 10000;
+    std::string placement_file;
+    double rebalance_rate = 1000;
+    uint16_t metrics_port = 0;
+    int manager_count = 1;
 
     app.add_option("-p, --port", port, "Port on which to run the server.")->check(CLI::Range(1, 65535));
     app.add_option("-t, --threads", thread_count, "Number of threads in the thread pool.")->check(CLI::Range(1, 16))->required();
     app.add_option("-s, --stripe-size", stripe_size, "Stripe size to break down large files.")->check(CLI::Range(1, 131072));
+    app.add_option("-r, --replicas", replica_count, "Number of storage nodes holding a copy of each stripe.")->check(CLI::Range(1, 16));
+    app.add_option("--hedge-percentile", hedge_percentile, "Send a second read to another replica after this latency percentile (0 disables).")->check(CLI::Range(0.0, 100.0));
+    app.add_option("-k, --data-fragments", data_fragments, "Erasure code groups of this many stripes instead of replicating them (0 disables).")->check(CLI::Range(0, 64));
+    app.add_option("-m, --parity-fragments", parity_fragments, "Parity fragments per erasure coded group.")->check(CLI::Range(1, 16));
+    app.add_option("--shm-slots", shm_slots, "Requests in flight through the shared memory channel of the clients on this host (0 disables it).")->check(CLI::Range(0, 1024));
+    app.add_option("--gc-rate", gc_rate, "Stripes of removed files deleted per second in the background (0 for no limit).")->check(CLI::Range(0.0, 1e9));
+    app.add_option("--placement-file", placement_file, "File keeping the placement of the stripes, a change of the nodes then moves only the stripes it has to.");
+    app.add_option("--rebalance-rate", rebalance_rate, "Stripes moved to their new nodes per second in the background (0 for no limit).")->check(CLI::Range(0.0, 1e9));
+    app.add_option("--managers", manager_count, "Ranks running a storage manager, the first ones, every manager listens on port + rank.")->check(CLI::Range(1, 1024));
+    app.add_option("--metrics-port", metrics_port, "Port serving the metrics in the Prometheus text format (0 disables).")->check(CLI::Range(0, 65535));
     CLI11_PARSE(app, argc, argv);
 
     try {
         ////// LOGGER //////
-        spdlog::set_level(spdlog::level::debug); // Set global log level to debug
-        spdlog::set_pattern("(%s:%#) [%^%l%$] %v");
+        Logging::init(spdlog::level::debug); // Set global log level, the messages are written asynchronously
+        Tracing::set_process_name("storage_manager");
+
+        // every manager serves its own clients and shares the nodes with the others
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
         // CacheServer object(8, "--FILE=./memcached.conf", "./storage/");
-        StorageServer object((int)thread_count, stripe_size);
-        object.run(port);
+        StorageServer object((int)thread_count, stripe_size, replica_count, hedge_percentile, data_fragments, parity_fragments,
+            std::make_unique<MpiTransport>(stripe_size, manager_count));
+        std::unique_ptr<Metrics::Endpoint> metrics_endpoint;
+        if (metrics_port != 0)
+            metrics_endpoint = std::make_unique<Metrics::Endpoint>(metrics_port + rank);
+        object.set_shm_slots(shm_slots);
+        object.set_gc_rate(gc_rate);
+        // each manager keeps its own copy, they see the same nodes and make the same layouts
+        if (!placement_file.empty() && manager_count > 1)
+            placement_file += "." + std::to_string(rank);
+        object.set_placement_file(placement_file);
+        object.set_rebalance_rate(rebalance_rate);
+        object.run(port + rank);
     }
     catch (std::exception& e){
         SPDLOG_ERROR("{}", e.what());
@@ -1,4 +1,6 @@
 #include "../lib/storage_server.hpp"
+#include "../lib/tcp_transport.hpp"
+#include "../lib/tracing.hpp"
 // #include "../../lib/storage_server.hpp"
 
 #include <iostream>
@@ -6,6 +8,8 @@
 
 using namespace StorageAPI;
 
+// storage manager reaching the storage nodes (storage_server/scripts/slave.cpp) over TCP,
+// same options as mpi_storage_mngr.cpp plus the file listing the nodes
 int main(int argc, char** argv)
 {
     CLI::App app {"Storage manager."};
@@ -15,26 +19,50 @@ int main(int argc, char** argv)
     uint16_t port = 7777;
     int stripe_size = 4096;
     std::string server_file = "storage.conf";
+    int replica_count = 1;
+    double hedge_percentile = 0;
+    int data_fragments = 0;
+    int parity_fragments = 2;
+    uint32_t shm_slots = 32;
+    double gc_rate = 10000;
+    std::string placement_file;
+    double rebalance_rate = 1000;
+    uint16_t metrics_port = 0;
 
     app.add_option("-p, --port", port, "Port on which to run the server.")->check(CLI::Range(1, 65535));
     app.add_option("-t, --threads", thread_count, "Number of threads in the thread pool.")->check(CLI::Range(1, 16))->required();
     app.add_option("-s, --stripe-size", stripe_size, "Stripe size to break down large files.")->check(CLI::Range(1, 131072));
     app.add_option("-f, --file", server_file, "Configuration file for the storage servers.")->check(CLI::ExistingFile)->required();
-
+    app.add_option("-r, --replicas", replica_count, "Number of storage nodes holding a copy of each stripe.")->check(CLI::Range(1, 16));
+    app.add_option("--hedge-percentile", hedge_percentile, "Send a second read to another replica after this latency percentile (0 disables).")->check(CLI::Range(0.0, 100.0));
+    app.add_option("-k, --data-fragments", data_fragments, "Erasure code groups of this many stripes instead of replicating them (0 disables).")->check(CLI::Range(0, 64));
+    app.add_option("-m, --parity-fragments", parity_fragments, "Parity fragments per erasure coded group.")->check(CLI::Range(1, 16));
+    app.add_option("--shm-slots", shm_slots, "Requests in flight through the shared memory channel of the clients on this host (0 disables it).")->check(CLI::Range(0, 1024));
+    app.add_option("--gc-rate", gc_rate, "Stripes of removed files deleted per second in the background (0 for no limit).")->check(CLI::Range(0.0, 1e9));
+    app.add_option("--placement-file", placement_file, "File keeping the placement of the stripes, a change of the nodes then moves only the stripes it has to.");
+    app.add_option("--rebalance-rate", rebalance_rate, "Stripes moved to their new nodes per second in the background (0 for no limit).")->check(CLI::Range(0.0, 1e9));
+    app.add_option("--metrics-port", metrics_port, "Port serving the metrics in the Prometheus text format (0 disables).")->check(CLI::Range(0, 65535));
     CLI11_PARSE(app, argc, argv);
 
-    std::vector<Utils::ConnectionInfo<StoragePacket>> connections = Utils::ConnectionInfo<StoragePacket>::read_server_file(server_file);
-
     try {
         ////// LOGGER //////
-        spdlog::set_level(spdlog::level::debug); // Set global log level to debug
-        spdlog::set_pattern("(%s:%#) [%^%l%$] %v");
-        
-        StorageServer object((int)thread_count, stripe_size, connections);
+        Logging::init(spdlog::level::debug); // Set global log level, the messages are written asynchronously
+        Tracing::set_process_name("storage_manager");
+
+        std::vector<Utils::ConnectionInfo<StoragePacket>> connections = Utils::ConnectionInfo<StoragePacket>::read_server_file(server_file);
+        StorageServer object((int)thread_count, stripe_size, replica_count, hedge_percentile, data_fragments, parity_fragments,
+            std::make_unique<TcpTransport>(stripe_size, connections));
+        std::unique_ptr<Metrics::Endpoint> metrics_endpoint;
+        if (metrics_port != 0)
+            metrics_endpoint = std::make_unique<Metrics::Endpoint>(metrics_port);
+        object.set_shm_slots(shm_slots);
+        object.set_gc_rate(gc_rate);
+        object.set_placement_file(placement_file);
+        object.set_rebalance_rate(rebalance_rate);
         object.run(port);
     }
     catch (std::exception& e){
         SPDLOG_ERROR("{}", e.what());
     }
     return 0;
-}
\ No newline at end of file
+}
@@ -2,21 +2,152 @@
 
 using namespace CacheAPI;
 
+static Metrics::OperationTable client_metrics("cache_client");
+static Metrics::Counter memcached_hits("cache_client_memcached_hits_total", "Metadata lookups answered by memcached.");
+static Metrics::Counter memcached_misses("cache_client_memcached_misses_total", "Metadata lookups sent to the cache server.");
+static Metrics::Counter negative_hits("cache_client_negative_hits_total", "Lookups of missing paths answered without the cache server.");
+
+const size_t CacheClient::max_missing = 4096;
+
 // private
 std::string CacheClient::get_memcached_object(const std::string& key)
 {
     memcached_return_t error;
-    char* result = memcached_get(mem_client, key.c_str(), key.length(), NULL, NULL, &error);
+    size_t value_length;
+    char* result = memcached_get(mem_client, key.c_str(), key.length(), &value_length, NULL, &error);
 
     if (result == NULL)
     {
-        SPDLOG_DEBUG(std::format("get_cache_object: {}", memcached_strerror(mem_client, error)));
+        SPDLOG_TRACE("get_cache_object: {}", memcached_strerror(mem_client, error));
         return "";
     }
 
-    return result;
+    // the records are binary (StatRecord), they hold NUL bytes
+    std::string value(result, value_length);
+    free(result);
+    return value;
+}
+
+bool CacheClient::is_missing(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(missing_mutex);
+    auto it = missing.find(key);
+    if (it == missing.end())
+        return false;
+    if (it->second > std::chrono::steady_clock::now())
+        return true;
+    missing.erase(it);
+    return false;
 }
 
+void CacheClient::set_missing(const std::string& key)
+{
+    if (negative_timeout.count() <= 0)
+        return;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(missing_mutex);
+    // the expired paths are only dropped when looked up again or once there are many
+    if (missing.size() >= max_missing)
+        std::erase_if(missing, [now](const auto& item) { return item.second <= now; });
+    missing[key] = now + negative_timeout;
+}
+
+void CacheClient::forget_missing(const std::string& key, bool subtree)
+{
+    std::string prefix = key + "/";
+    std::lock_guard<std::mutex> lock(missing_mutex);
+    missing.erase(key);
+    if (subtree)
+        std::erase_if(missing, [&prefix](const auto& item) { return item.first.starts_with(prefix); });
+}
+
+void CacheClient::set_watcher(CachePacket& request) const
+{
+    uint32_t id = watcher_id.load();
+    if (id == 0)
+        return;
+    request.message_len = 4;
+    request.message = Utils::get_byte_array_from_int(id);
+}
+
+asio::awaitable<void> CacheClient::watch_async(std::function<void(const std::string&, InvalidationCode::Type)> handler)
+{
+    bool watched = false;
+    while (true)
+    {
+        tcp::socket socket(context);
+        try {
+            tcp::resolver::results_type endpoints =
+                co_await resolver.async_resolve(address, port, asio::use_awaitable);
+            co_await asio::async_connect(socket, endpoints, asio::use_awaitable);
+
+            CachePacket request;
+            request.id = Utils::generate_id();
+            request.opcode = OperationCode::to_byte(OperationCode::Type::WATCH);
+            std::vector<uint8_t> buffer;
+            request.to_buffer(buffer);
+            co_await asio::async_write(socket, asio::buffer(buffer), asio::use_awaitable);
+
+            // the reply, then the INVALIDATE packets until the connection is lost
+            buffer.resize(64 * 1024);
+            std::vector<uint8_t> packet_buffer;
+            bool answered = false;
+            while (true)
+            {
+                size_t bytes_transferred = co_await socket.async_read_some(asio::buffer(buffer), asio::use_awaitable);
+                packet_buffer.insert(packet_buffer.end(), buffer.begin(), buffer.begin() + bytes_transferred);
+
+                while (packet_buffer.size() >= CachePacket::header_size)
+                {
+                    size_t packet_size = CachePacket::get_packet_size(packet_buffer.data(), packet_buffer.size());
+                    if (packet_buffer.size() < packet_size)
+                        break;
+                    CachePacket packet(packet_buffer.data(), packet_size);
+                    packet_buffer.erase(packet_buffer.begin(), packet_buffer.begin() + packet_size);
+
+                    if (!answered)
+                    {
+                        if (packet.id != request.id || packet.rescode != ResultCode::Type::SUCCESS || packet.message_len != 4)
+                            throw std::runtime_error("Invalid reply to WATCH.");
+                        watcher_id = Utils::get_int_from_byte_array(packet.message);
+                        answered = true;
+                        SPDLOG_INFO("Watching {}:{} as watcher {}.", address, port, watcher_id.load());
+                        if (watched)
+                            handler("", InvalidationCode::Type::ALL);
+                        watched = true;
+                        continue;
+                    }
+
+                    if (packet.opcode != OperationCode::Type::INVALIDATE)
+                        continue;
+                    std::string key = Utils::get_string_from_byte_array(packet.key);
+                    InvalidationCode::Type code = InvalidationCode::from_byte(packet.flags);
+                    if (code == InvalidationCode::Type::ENTRY)
+                        forget_missing(key, true);
+                    handler(key, code);
+                }
+            }
+        }
+        catch (std::exception& e)
+        {
+            LOG_RATE_LIMITED(SPDLOG_LEVEL_WARN, 1, "watch_async: {}, watching again.", e.what());
+        }
+
+        // the requests sent meanwhile are echoed back, the kernel drops a little more
+        watcher_id = 0;
+        asio::error_code error;
+        socket.close(error);
+        if (watched)
+        {
+            std::lock_guard<std::mutex> lock(missing_mutex);
+            missing.clear();
+        }
+
+        asio::steady_timer timer(context, std::chrono::seconds(1));
+        co_await timer.async_wait(asio::use_awaitable);
+    }
+} // watch_async
+
 asio::awaitable<int> CacheClient::set_async(const std::string& key, const std::string& value, uint32_t time, uint8_t flags, bool is_file)
 {
     try {
@@ -32,6 +163,7 @@ asio::awaitable<int> CacheClient::set_async(const std::string& key, const std::s
         request.value_len = value.length();
         request.key = Utils::get_byte_array_from_string(key);
         request.value = Utils::get_byte_array_from_string(value);
+        set_watcher(request);
         co_await send_request_async(request, response);
             
         if ((response.id != request.id) || response.rescode == ResultCode::Type::ERRMSG)
@@ -44,8 +176,8 @@ asio::awaitable<int> CacheClient::set_async(const std::string& key, const std::s
             }
             else 
             {
-                int error = Utils::get_int_from_byte_array(response.message);
-                SPDLOG_ERROR(std::format("Server error: {}", std::strerror(error)));
+                error = Utils::get_int_from_byte_array(response.message);
+                LOG_RATE_LIMITED(SPDLOG_LEVEL_ERROR, 10, "Server error: {}", std::strerror(error));
                 if (error == 0) error = -1;
             }             
 
@@ -54,7 +186,7 @@ asio::awaitable<int> CacheClient::set_async(const std::string& key, const std::s
 
         if (response.rescode == ResultCode::Type::SUCCESS)
         {
-            SPDLOG_INFO("Stored!");
+            SPDLOG_TRACE("Stored!");
             co_return 0;
         } 
         
@@ -104,9 +236,25 @@ int CacheClient::set(const std::string& key, const std::string& value, bool is_f
 asio::awaitable<std::string> CacheClient::get_async(const std::string& key, bool is_file)
 {
     try {
+        if (is_missing(key))
+        {
+            negative_hits.add();
+            co_return "";
+        }
+
         std::string mem_value = get_memcached_object(key);
+        if (mem_value == CachePacket::missing_value)
+        {
+            negative_hits.add();
+            set_missing(key);
+            co_return "";
+        }
         if (mem_value.length() > 0)
+        {
+            memcached_hits.add();
             co_return mem_value;
+        }
+        memcached_misses.add();
 
         CachePacket request, response;
         request.id = Utils::generate_id();
@@ -128,7 +276,12 @@ asio::awaitable<std::string> CacheClient::get_async(const std::string& key, bool
             else 
             {
                 int error = Utils::get_int_from_byte_array(response.message);
-                SPDLOG_ERROR(std::format("Server error: {}", std::strerror(error)));
+                if (error == ENOENT)
+                {
+                    set_missing(key);
+                    co_return "";
+                }
+                LOG_RATE_LIMITED(SPDLOG_LEVEL_ERROR, 10, "Server error: {}", std::strerror(error));
             }            
             co_return "";
         }
@@ -169,6 +322,17 @@ std::string CacheClient::get(const std::string& key, bool is_file)
     }
 }
 
+void CacheClient::get(const std::string& key, bool is_file, std::function<void(std::string)> done)
+{
+    spawn_request<std::string>(
+        [this, key, is_file]() -> asio::awaitable<std::string> {
+            co_return co_await get_async(key, is_file);
+        },
+        std::move(done),
+        ""
+    );
+}
+
 asio::awaitable<int> CacheClient::remove_async(const std::string& key, bool is_file)
 {
     try {
@@ -180,6 +344,7 @@ asio::awaitable<int> CacheClient::remove_async(const std::string& key, bool is_f
             request.opcode = OperationCode::to_byte(OperationCode::Type::RM_DIR);
         request.key_len = key.length();
         request.key = Utils::get_byte_array_from_string(key);
+        set_watcher(request);
         co_await send_request_async(request, response);
             
         if ((response.id != request.id) || response.rescode == ResultCode::Type::ERRMSG)
@@ -192,8 +357,8 @@ asio::awaitable<int> CacheClient::remove_async(const std::string& key, bool is_f
             }
             else 
             {
-                int error = Utils::get_int_from_byte_array(response.message);
-                SPDLOG_ERROR(std::format("Server error: {}", std::strerror(error)));
+                error = Utils::get_int_from_byte_array(response.message);
+                LOG_RATE_LIMITED(SPDLOG_LEVEL_ERROR, 10, "Server error: {}", std::strerror(error));
                 if (error == 0) error = -1;
             }             
 
@@ -202,7 +367,7 @@ asio::awaitable<int> CacheClient::remove_async(const std::string& key, bool is_f
 
         if (response.rescode == ResultCode::Type::SUCCESS)
         {
-            SPDLOG_INFO("Removed!");
+            SPDLOG_TRACE("Removed!");
             co_return 0;
         } 
         
@@ -254,6 +419,7 @@ asio::awaitable<int> CacheClient::update_async(const std::string& key, const Upd
         command.to_buffer(request.value);
         request.value_len = request.value.size();
 
+        set_watcher(request);
         co_await send_request_async(request, response);
         // co_await receive_onse_anc(response);
             
@@ -267,8 +433,8 @@ asio::awaitable<int> CacheClient::update_async(const std::string& key, const Upd
             }
             else 
             {
-                int error = Utils::get_int_from_byte_array(response.message);
-                SPDLOG_ERROR(std::format("Server error: {}", std::strerror(error)));
+                error = Utils::get_int_from_byte_array(response.message);
+                LOG_RATE_LIMITED(SPDLOG_LEVEL_ERROR, 10, "Server error: {}", std::strerror(error));
                 if (error == 0) error = -1;
             }             
 
@@ -277,7 +443,7 @@ asio::awaitable<int> CacheClient::update_async(const std::string& key, const Upd
 
         if (response.rescode == ResultCode::Type::SUCCESS)
         {
-            SPDLOG_INFO("Updated!");
+            SPDLOG_TRACE("Updated!");
             co_return 0;
         } 
         
@@ -319,6 +485,82 @@ int CacheClient::update(const std::string& key, const UpdateCommand& command)
     }
 }
 
+void CacheClient::update(const std::string& key, const UpdateCommand& command, std::function<void(int)> done)
+{
+    spawn_request<int>(
+        [this, key, command]() -> asio::awaitable<int> {
+            co_return co_await update_async(key, command);
+        },
+        std::move(done),
+        -1
+    );
+}
+
+asio::awaitable<int> CacheClient::request_async(OperationCode::Type opcode, const std::string& key, const std::string& value)
+{
+    try {
+        CachePacket request, response;
+        request.id = Utils::generate_id();
+        request.opcode = OperationCode::to_byte(opcode);
+        request.key_len = key.length();
+        request.value_len = value.length();
+        request.key = Utils::get_byte_array_from_string(key);
+        request.value = Utils::get_byte_array_from_string(value);
+        set_watcher(request);
+        co_await send_request_async(request, response);
+
+        if ((response.id != request.id) || response.rescode == ResultCode::Type::ERRMSG)
+        {
+            int error = -1;
+            if (response.message_len == 0)
+                SPDLOG_ERROR("Unknown server error");
+            else
+            {
+                error = Utils::get_int_from_byte_array(response.message);
+                LOG_RATE_LIMITED(SPDLOG_LEVEL_ERROR, 10, "Server error: {}", std::strerror(error));
+                if (error == 0) error = -1;
+            }
+
+            co_return error;
+        }
+
+        if (response.rescode == ResultCode::Type::SUCCESS)
+            co_return 0;
+
+        SPDLOG_ERROR("Invalid packet from server.");
+        co_return -1;
+    }
+    catch (std::exception& e)
+    {
+        SPDLOG_ERROR(std::format("request_async: {}", e.what()));
+        co_return -1;
+    }
+} // request_async
+
+int CacheClient::request(OperationCode::Type opcode, const std::string& key, const std::string& value)
+{
+    std::promise<int> result_promise;
+    std::future<int> result_future = result_promise.get_future();
+
+    asio::co_spawn(
+        context,
+        [&]() -> asio::awaitable<void> {
+            int result = co_await request_async(opcode, key, value);
+            result_promise.set_value(result);
+            co_return;
+        },
+        asio::detached
+    );
+
+    try {
+        return result_future.get();
+    }
+    catch (...)
+    {
+        return -1;
+    }
+}
+
 // public
 CacheClient::CacheClient()
     : CacheClient(1, "")
@@ -329,9 +571,11 @@ CacheClient::CacheClient(const std::string& mem_conf_string)
 {}
 
 CacheClient::CacheClient(int thread_count, const std::string& mem_conf_string)
-    : GenericClient<CachePacket>(thread_count)
+    : GenericClient<CachePacket>(thread_count, &client_metrics)
     , mem_conf_string(mem_conf_string)
     , mem_client(NULL)
+    , negative_timeout(1000)
+    , watcher_id(0)
 {
     SPDLOG_INFO("CacheClient:\n\t- memcached config: {}\n\t- thread count: {}", mem_conf_string, thread_count);
 }
@@ -402,14 +646,26 @@ asio::awaitable<void> CacheClient::connect_async(const std::string& address, con
 
     co_return;
 } // connect_async
+
+void CacheClient::set_negative_timeout(std::chrono::milliseconds timeout)
+{
+    negative_timeout = timeout;
+    if (timeout.count() <= 0)
+    {
+        std::lock_guard<std::mutex> lock(missing_mutex);
+        missing.clear();
+    }
+}
  
 int CacheClient::set_file(const std::string& key, const std::string& value)
 {
+    forget_missing(key, false);
     return set(key, value, true);
 }
 
 int CacheClient::set_dir(const std::string& key, const std::string& value)
 {
+    forget_missing(key, false);
     return set(key, value, false);
 }
 
@@ -425,12 +681,35 @@ std::string CacheClient::get_dir(const std::string& key)
 
 int CacheClient::remove_file(const std::string& key)
 {
-    return remove(key, true);
+    int result = remove(key, true);
+    if (result == 0)
+        set_missing(key);
+    return result;
 }
 
 int CacheClient::remove_dir(const std::string& key)
 {
-    return remove(key, false);
+    int result = remove(key, false);
+    if (result == 0)
+        set_missing(key);
+    return result;
+}
+
+int CacheClient::set_entry(const std::string& key)
+{
+    forget_missing(key, false);
+    return request(OperationCode::Type::SET_ENTRY, key, "");
+}
+
+int CacheClient::remove_entry(const std::string& key)
+{
+    return request(OperationCode::Type::RM_ENTRY, key, "");
+}
+
+int CacheClient::put_file(const std::string& key, const std::string& value)
+{
+    forget_missing(key, false);
+    return request(OperationCode::Type::PUT_FILE, key, value);
 }
 
 int CacheClient::chmod(const std::string& key, mode_t new_mode)
@@ -461,11 +740,67 @@ int CacheClient::chsize(const std::string& key, off_t new_size)
     return update(key, command);
 }
 
+void CacheClient::get_file(const std::string& key, std::function<void(std::string)> done)
+{
+    get(key, true, std::move(done));
+}
+
+void CacheClient::get_dir(const std::string& key, std::function<void(std::string)> done)
+{
+    get(key, false, std::move(done));
+}
+
+void CacheClient::chsize(const std::string& key, off_t new_size, std::function<void(int)> done)
+{
+    UpdateCommand command;
+    command.opcode = UpdateCode::to_byte(UpdateCode::Type::CHSIZE);
+    command.argv.push_back(Utils::get_byte_array_from_int64(new_size));
+    command.argc = 1;
+    update(key, command, std::move(done));
+}
+
+int CacheClient::extend(const std::string& key, off_t new_size)
+{
+    UpdateCommand command;
+    command.opcode = UpdateCode::to_byte(UpdateCode::Type::EXTEND);
+    command.argv.push_back(Utils::get_byte_array_from_int64(new_size));
+    command.argc = 1;
+    return update(key, command);
+}
+
+void CacheClient::extend(const std::string& key, off_t new_size, std::function<void(int)> done)
+{
+    UpdateCommand command;
+    command.opcode = UpdateCode::to_byte(UpdateCode::Type::EXTEND);
+    command.argv.push_back(Utils::get_byte_array_from_int64(new_size));
+    command.argc = 1;
+    update(key, command, std::move(done));
+}
+
+void CacheClient::watch(std::function<void(const std::string&, InvalidationCode::Type)> handler)
+{
+    asio::co_spawn(context, watch_async(std::move(handler)), asio::detached);
+}
+
 int CacheClient::rename(const std::string& old_key, const std::string& new_key)
 {
     UpdateCommand command;
     command.opcode = UpdateCode::to_byte(UpdateCode::Type::RENAME);
     command.argv.push_back(Utils::get_byte_array_from_string(new_key));
     command.argc = 1;
-    return update(old_key, command);
+    // a directory brings the objects under it along
+    forget_missing(new_key, true);
+    int result = update(old_key, command);
+    if (result == 0)
+        set_missing(old_key);
+    return result;
+}
+
+int CacheClient::set_compression(const std::string& key, CompressionCode::Type codec)
+{
+    UpdateCommand command;
+    command.opcode = UpdateCode::to_byte(UpdateCode::Type::COMPRESS);
+    command.argv.push_back(Utils::get_byte_array_from_int(CompressionCode::to_byte(codec)));
+    command.argc = 1;
+    return update(key, command);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define CACHE_CLIENT_HPP
 
 #include "generic_client_api.hpp"
+#include "stat_record.hpp"
 using asio::ip::tcp;
 
 namespace CacheAPI {
@@ -11,7 +12,24 @@ namespace CacheAPI {
         uint16_t mem_port;
         std::string mem_conf_string;
 
+        // paths found missing lately, with the time they stop being trusted; memcached
+        // remembers them for the other clients (CachePacket::missing_value)
+        std::unordered_map<std::string, std::chrono::steady_clock::time_point> missing;
+        std::mutex missing_mutex;
+        std::chrono::milliseconds negative_timeout;
+        static const size_t max_missing;
+
+        // given by the server to the connection watch keeps open, 0 when not watching; sent
+        // with the requests that change something so the server does not echo them back
+        std::atomic<uint32_t> watcher_id;
+        void set_watcher(CachePacket& request) const;
+        asio::awaitable<void> watch_async(std::function<void(const std::string&, InvalidationCode::Type)> handler);
+
         std::string get_memcached_object(const std::string& key); 
+        bool is_missing(const std::string& key);
+        void set_missing(const std::string& key);
+        // with subtree, the paths under it too
+        void forget_missing(const std::string& key, bool subtree);
 
         asio::awaitable<int> set_async(const std::string& key, const std::string& value, uint32_t time, uint8_t flags, bool is_file);
         int set(const std::string& key, const std::string& value, uint32_t time, uint8_t flags, bool is_file);
@@ -19,12 +37,18 @@ namespace CacheAPI {
   
         asio::awaitable<std::string> get_async(const std::string& key, bool is_file);
         std::string get(const std::string& key, bool is_file);
+        void get(const std::string& key, bool is_file, std::function<void(std::string)> done);
 
         asio::awaitable<int> remove_async(const std::string& key, bool is_file);
         int remove(const std::string& key, bool is_file);
 
         asio::awaitable<int> update_async(const std::string& key, const UpdateCommand& command);
         int update(const std::string& key, const UpdateCommand& command);
+        void update(const std::string& key, const UpdateCommand& command, std::function<void(int)> done);
+
+        // requests answered with a result code only, 0 or an errno
+        asio::awaitable<int> request_async(OperationCode::Type opcode, const std::string& key, const std::string& value);
+        int request(OperationCode::Type opcode, const std::string& key, const std::string& value);
     public:
         CacheClient();
         CacheClient(const std::string& mem_conf_file);
@@ -32,6 +56,8 @@ namespace CacheAPI {
         ~CacheClient() override;
 
         asio::awaitable<void> connect_async(const std::string& address, const std::string& port) override;
+        // how long a missing path is answered locally, 0 to always ask
+        void set_negative_timeout(std::chrono::milliseconds timeout);
         
         int set_file(const std::string& key, const std::string& value);
         int set_dir(const std::string& key, const std::string& value);
@@ -39,10 +65,26 @@ namespace CacheAPI {
         std::string get_dir(const std::string& key);
         int remove_file(const std::string& key);
         int remove_dir(const std::string& key);
+        // used by ShardedCacheClient for the directories and files that span two cache servers
+        int set_entry(const std::string& key);
+        int remove_entry(const std::string& key);
+        int put_file(const std::string& key, const std::string& value);
         int chmod(const std::string& key, mode_t new_mode);
         int chown(const std::string& key, uid_t new_uid, gid_t new_gid);
         int chsize(const std::string& key, off_t new_size);
+        // the same without waiting, done gets the result on a thread of the client
+        void get_file(const std::string& key, std::function<void(std::string)> done);
+        void get_dir(const std::string& key, std::function<void(std::string)> done);
+        void chsize(const std::string& key, off_t new_size, std::function<void(int)> done);
+        // the size after a write, kept when the file is larger already: the writes of a file
+        // finish in any order
+        int extend(const std::string& key, off_t new_size);
+        void extend(const std::string& key, off_t new_size, std::function<void(int)> done);
+        // handler gets the objects other clients change, on a thread of the client, from now
+        // on; the connection is opened again when lost, with an ALL for what was missed meanwhile
+        void watch(std::function<void(const std::string&, InvalidationCode::Type)> handler);
         int rename(const std::string& old_key, const std::string& new_key);
+        int set_compression(const std::string& key, CompressionCode::Type codec);
     };
 }
 
@@ -2,13 +2,19 @@
 
 using namespace CacheAPI;
 
+static Metrics::OperationTable server_metrics("cache_server");
+
+const time_t CacheConnectionHandler::missing_expiration = 300;
+
 // public
-CacheConnectionHandler::CacheConnectionHandler(asio::io_context& context, memcached_st* mem_client, uint16_t mem_port, std::string file_metadata_dir, std::string dir_metadata_dir)
-    : GenericConnectionHandler<CachePacket>::GenericConnectionHandler(context)
+CacheConnectionHandler::CacheConnectionHandler(asio::io_context& context, memcached_st* mem_client, uint16_t mem_port, std::string file_metadata_dir, std::string dir_metadata_dir, MetadataCache* metadata_cache, InvalidationHub* invalidations)
+    : GenericConnectionHandler<CachePacket>::GenericConnectionHandler(context, &server_metrics)
     , mem_client(mem_client)
     , mem_port(mem_port)
     , file_metadata_dir(file_metadata_dir)
-    , dir_metadata_dir(dir_metadata_dir) {}
+    , dir_metadata_dir(dir_metadata_dir)
+    , metadata_cache(metadata_cache)
+    , invalidations(invalidations) {}
 
 // private
 void CacheConnectionHandler::handle_request(const CachePacket& request, CachePacket& response)
@@ -22,7 +28,9 @@ void CacheConnectionHandler::handle_request(const CachePacket& request, CachePac
     response.id = request.id; 
     response.opcode = request.opcode;
 
-    SPDLOG_DEBUG(std::format("Processing: {}", OperationCode::to_string(OperationCode::from_byte(request.opcode))));
+    SPDLOG_TRACE("Processing: {}", OperationCode::to_string(OperationCode::from_byte(request.opcode)));
+    // the errors a request expects come back as a status, the exceptions are left for the others
+    Utils::Status status;
     try {
         switch (OperationCode::from_byte(request.opcode))
         {
@@ -32,26 +40,38 @@ void CacheConnectionHandler::handle_request(const CachePacket& request, CachePac
             case OperationCode::Type::INIT:
                 init_connection(response);
                 break;
+            case OperationCode::Type::WATCH:
+                watch(response);
+                break;
             case OperationCode::Type::GET_FILE:
-                get(request, response, true);
+                status = get(request, response, true);
                 break;
             case OperationCode::Type::GET_DIR:
-                get(request, response, false);
+                status = get(request, response, false);
                 break;
             case OperationCode::Type::SET_FILE:
-                set(request, response, true);
+                status = set(request, response, true);
                 break;
             case OperationCode::Type::SET_DIR:
-                set(request, response, false);
+                status = set(request, response, false);
                 break;
             case OperationCode::Type::RM_FILE:
-                remove(request, response, true);
+                status = remove(request, response, true);
                 break;
             case OperationCode::Type::RM_DIR:
-                remove(request, response, false);
+                status = remove(request, response, false);
                 break;
             case OperationCode::Type::UPDATE:
-                update(request, response);
+                status = update(request, response);
+                break;
+            case OperationCode::Type::SET_ENTRY:
+                status = set_entry(request, response);
+                break;
+            case OperationCode::Type::RM_ENTRY:
+                status = remove_entry(request, response);
+                break;
+            case OperationCode::Type::PUT_FILE:
+                status = put_file(request, response);
                 break;
             
             default:
@@ -61,27 +81,91 @@ void CacheConnectionHandler::handle_request(const CachePacket& request, CachePac
     }
     catch (std::exception& e)
     {
+        // not a failure a request expects, a malformed packet or a bug
         SPDLOG_ERROR(e.what());
+        status = Utils::Error {EIO};
+    }
+
+    if (!status)
+    {
         response.rescode = ResultCode::to_byte(ResultCode::Type::ERRMSG);
         response.message_len = 4;
-        response.message = Utils::get_byte_array_from_int(errno);
+        response.message = Utils::get_byte_array_from_int(status.error());
     }
+    else if (response.rescode == ResultCode::Type::SUCCESS)
+        publish_change(request);
 } // handle_request
 
-void CacheConnectionHandler::update_parent_dir(const std::string& path)
+void CacheConnectionHandler::handle_written()
 {
-    try 
-    {
-        std::string parent_path = Utils::get_parent_dir(path);
-        std::string parent_value = FileMngr::get_local_dir(file_metadata_dir + parent_path, dir_metadata_dir + parent_path, true);
-        asio::co_spawn(context, set_memcached_object_async(parent_path, parent_value, 0, 0), asio::detached);
-    }
-    catch (std::exception& e)
+    if (watcher_id == 0)
+        return;
+    invalidations->watch(watcher_id, std::move(socket));
+    watcher_id = 0;
+}
+
+void CacheConnectionHandler::watch(CachePacket& response)
+{
+    watcher_id = invalidations->make_id();
+    response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+    response.message_len = 4;
+    response.message = Utils::get_byte_array_from_int(watcher_id);
+}
+
+void CacheConnectionHandler::publish_change(const CachePacket& request)
+{
+    uint32_t origin = request.message_len == 4 ? Utils::get_int_from_byte_array(request.message) : 0;
+    std::string path = Utils::get_string_from_byte_array(request.key);
+
+    switch (OperationCode::from_byte(request.opcode))
     {
-        throw std::runtime_error(std::format("update_parent_dir: {}", e.what()));
+        case OperationCode::Type::SET_FILE:
+        case OperationCode::Type::SET_DIR:
+        case OperationCode::Type::RM_FILE:
+        case OperationCode::Type::RM_DIR:
+        case OperationCode::Type::SET_ENTRY:
+        case OperationCode::Type::RM_ENTRY:
+        case OperationCode::Type::PUT_FILE:
+            invalidations->publish(path, InvalidationCode::Type::ENTRY, origin);
+            break;
+        case OperationCode::Type::UPDATE:
+        {
+            UpdateCommand command(request.value.data(), request.value.size());
+            switch (UpdateCode::from_byte(command.opcode))
+            {
+                case UpdateCode::Type::CHSIZE:
+                case UpdateCode::Type::EXTEND:
+                    // the size follows every write, the data changed along
+                    invalidations->publish(path, InvalidationCode::Type::DATA, origin);
+                    break;
+                case UpdateCode::Type::RENAME:
+                    invalidations->publish(path, InvalidationCode::Type::ENTRY, origin);
+                    invalidations->publish(Utils::get_string_from_byte_array(command.argv[0]), InvalidationCode::Type::ENTRY, origin);
+                    break;
+                default:
+                    invalidations->publish(path, InvalidationCode::Type::ATTR, origin);
+                    break;
+            }
+            break;
+        }
+
+        default:
+            break;
     }
 }
 
+Utils::Status CacheConnectionHandler::update_parent_dir(const std::string& path)
+{
+    std::string parent_path = Utils::get_parent_dir(path);
+    Utils::Result<std::string> parent_value = FileMngr::get_local_dir(file_metadata_dir + parent_path, dir_metadata_dir + parent_path, true);
+    if (!parent_value)
+        return Utils::Error {parent_value.error()};
+
+    metadata_cache->put(parent_path, *parent_value, false);
+    asio::co_spawn(context, set_memcached_object_async(parent_path, *parent_value, 0, 0), asio::detached);
+    return {};
+}
+
 void CacheConnectionHandler::update_memcached_object(const std::string& key, const std::string& value, time_t expiration, uint32_t flags)
 {
     memcached_return_t result = memcached_replace(mem_client,
@@ -145,17 +229,47 @@ asio::awaitable<void> CacheConnectionHandler::set_memcached_object_async(const s
     co_return;
 }
 
+void CacheConnectionHandler::store_memcached_object(const std::string& key, const std::string& value, time_t expiration, uint32_t flags)
+{
+    memcached_return_t result;
+    if (value.empty())
+        result = memcached_delete(mem_client, key.c_str(), key.length(), 0);
+    else
+        result = memcached_set(mem_client, key.c_str(), key.size(), value.c_str(), value.size(), expiration, flags);
+
+    if (result != MEMCACHED_SUCCESS && result != MEMCACHED_NOTFOUND)
+        SPDLOG_ERROR(std::format("store_memcached_object: {}", memcached_strerror(mem_client, result)));
+}
+
+asio::awaitable<void> CacheConnectionHandler::mark_missing_async(const std::string& key)
+{
+    const std::string& value = CachePacket::missing_value;
+    memcached_return_t result = memcached_add(mem_client,
+        key.c_str(), key.length(),
+        value.c_str(), value.length(),
+        missing_expiration, 0);
+
+    if (result != MEMCACHED_SUCCESS && result != MEMCACHED_NOTSTORED)
+        SPDLOG_ERROR(std::format("mark_missing_async: {}", memcached_strerror(mem_client, result)));
+
+    co_return;
+}
+
 std::string CacheConnectionHandler::get_memcached_object(const std::string& key)
 {
     memcached_return_t error;
-    char* result = memcached_get(mem_client, key.c_str(), key.length(), NULL, NULL, &error);
+    size_t value_length;
+    char* result = memcached_get(mem_client, key.c_str(), key.length(), &value_length, NULL, &error);
 
     if (result == NULL)
     {
         throw std::runtime_error(std::format("get_memcached_object: {}", memcached_strerror(mem_client, error)));
     }
 
-    return result;
+    // the records are binary (StatRecord), they hold NUL bytes
+    std::string value(result, value_length);
+    free(result);
+    return value;
 }
 
 void CacheConnectionHandler::remove_memcached_object(const std::string& key) 
@@ -198,143 +312,270 @@ void CacheConnectionHandler::init_connection(CachePacket& response)
     response.message.push_back(mem_port & 0xFF);
 }
 
-void CacheConnectionHandler::set(const CachePacket& request, CachePacket& response, bool is_file)
+Utils::Status CacheConnectionHandler::set(const CachePacket& request, CachePacket& response, bool is_file)
 {
-    try {
-        uint32_t flags = request.flags;
-        time_t time = static_cast<time_t>(request.time);
-        std::string path = Utils::get_string_from_byte_array(request.key);
-        std::string file_path = Utils::process_path(path, file_metadata_dir);
-        std::string dir_path = Utils::process_path(path, dir_metadata_dir);
-        
-        mode_t mode = std::stoul(Utils::get_string_from_byte_array(request.value));
-
-        std::string value;
-        if (is_file)
-        {
-            value = FileMngr::set_local_file(file_path, mode);
-        }
-        else
-        {
-            // creating two directories
-            // 1. for the folder hierarchy of the file system
-            // FileMngr::set_local_dir(file_path, mode);
-            // 2. for storing the metadata about the directory (the file with metadata will be stored in .this file)
-            // inside the directory
-            FileMngr::set_local_dir(file_path, dir_path, mode);
-            value = FileMngr::get_local_dir(file_path, dir_path, true);
-        }
-
-        asio::co_spawn(context, set_memcached_object_async(path, value, time, flags), asio::detached);
-        
-        // when creating an object we need to update the parent directory in 
-        // the memcached server
-        update_parent_dir(path);
-        response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
-    } // try
-    catch (std::exception& e)
+    uint32_t flags = request.flags;
+    time_t time = static_cast<time_t>(request.time);
+    std::string path = Utils::get_string_from_byte_array(request.key);
+    std::string file_path = Utils::process_path(path, file_metadata_dir);
+    std::string dir_path = Utils::process_path(path, dir_metadata_dir);
+    
+    mode_t mode = std::stoul(Utils::get_string_from_byte_array(request.value));
+
+    // new objects get the compression policy of their directory
+    int compression = FileMngr::get_dir_compression(Utils::process_path(Utils::get_parent_dir(path), dir_metadata_dir));
+    if (!is_file)
     {
-        throw std::runtime_error(std::format("set: {}", e.what()));
+        // creating two directories
+        // 1. for the folder hierarchy of the file system
+        // 2. for storing the metadata about the directory (the file with metadata will be stored in .this file)
+        // inside the directory
+        Utils::Status created = FileMngr::set_local_dir(file_path, dir_path, mode);
+        if (!created)
+            return created;
     }
+
+    Utils::Result<std::string> value = is_file
+        ? FileMngr::set_local_file(file_path, mode, compression)
+        : FileMngr::get_local_dir(file_path, dir_path, true);
+    if (value && !is_file && compression != CompressionCode::Type::NONE)
+        value = FileMngr::compress_object(dir_path + "/.this", {Utils::get_byte_array_from_int(compression)});
+    if (!value)
+        return Utils::Error {value.error()};
+
+    // replaces the missing mark of the path, if any, before the client is answered
+    metadata_cache->put(path, *value, is_file);
+    store_memcached_object(path, *value, time, flags);
+    
+    // when creating an object we need to update the parent directory in 
+    // the memcached server
+    Utils::Status updated = update_parent_dir(path);
+    if (!updated)
+        return updated;
+    response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+    return {};
 } // set
 
-void CacheConnectionHandler::get(const CachePacket& request, CachePacket& response, bool is_file)
+Utils::Status CacheConnectionHandler::get(const CachePacket& request, CachePacket& response, bool is_file)
 {
-    try {
-        std::string path = Utils::get_string_from_byte_array(request.key);
-        std::string file_path = Utils::process_path(path, file_metadata_dir);
-        std::string dir_path = Utils::process_path(path, dir_metadata_dir);
-        std::string value;
-
-        if (is_file)
-            value = FileMngr::get_local_file(file_path);
-        else
-            value = FileMngr::get_local_dir(file_path, dir_path);
-
-        if (!value.empty())
-            asio::co_spawn(context, set_memcached_object_async(path, value, 0, 0), asio::detached);
+    std::string path = Utils::get_string_from_byte_array(request.key);
+    std::string value;
 
+    // memcached evicted it or the client is cold, the files are only read on a miss here too
+    if (metadata_cache->get(path, is_file, value))
+    {
+        asio::co_spawn(context, set_memcached_object_async(path, value, 0, 0), asio::detached);
         response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
         response.value_len = value.length();
         response.value = Utils::get_byte_array_from_string(value);
+        return {};
     }
-    catch (std::exception& e)
+    uint64_t version = metadata_cache->get_version(path);
+
+    std::string file_path = Utils::process_path(path, file_metadata_dir);
+    struct stat object_stat;
+    if (stat(file_path.c_str(), &object_stat) != 0)
     {
-        throw std::runtime_error(std::format("get: {}", e.what()));
+        // the misses are remembered in memcached too, the clients looking for the path
+        // next find the mark there instead of asking again
+        if (errno == ENOENT)
+            asio::co_spawn(context, mark_missing_async(path), asio::detached);
+        return Utils::last_error();
     }
 
-} // get
-
-void CacheConnectionHandler::remove(const CachePacket& request, CachePacket& response, bool is_file)
-{
-    try {
-        std::string path = Utils::get_string_from_byte_array(request.key);
-        std::string file_path = Utils::process_path(path, file_metadata_dir);
-        std::string dir_path = Utils::process_path(path, dir_metadata_dir);
-
-        if (is_file)
-            FileMngr::remove_local_file(file_path);
-        else
-            FileMngr::remove_local_dir(file_path, dir_path);
-
-        asio::co_spawn(context, remove_memcached_object_async(path), asio::detached);
-        update_parent_dir(path);    
+    // a file looked up as a directory or the other way around is not found, without an error
+    if (S_ISDIR(object_stat.st_mode) == is_file)
+    {
         response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+        response.value_len = 0;
+        response.value.clear();
+        return {};
     }
-    catch (std::exception& e)
+
+    Utils::Result<std::string> result = is_file
+        ? FileMngr::get_local_file(file_path)
+        : FileMngr::get_local_dir(file_path, Utils::process_path(path, dir_metadata_dir));
+    if (!result)
+        return Utils::Error {result.error()};
+    value = std::move(*result);
+
+    if (!value.empty())
     {
-        throw std::runtime_error(std::format("remove: {}", e.what()));
+        metadata_cache->fill(path, value, is_file, version);
+        asio::co_spawn(context, set_memcached_object_async(path, value, 0, 0), asio::detached);
     }
+
+    response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+    response.value_len = value.length();
+    response.value = Utils::get_byte_array_from_string(value);
+    return {};
+} // get
+
+Utils::Status CacheConnectionHandler::remove(const CachePacket& request, CachePacket& response, bool is_file)
+{
+    std::string path = Utils::get_string_from_byte_array(request.key);
+    std::string file_path = Utils::process_path(path, file_metadata_dir);
+    std::string dir_path = Utils::process_path(path, dir_metadata_dir);
+
+    Utils::Status removed = is_file
+        ? FileMngr::remove_local_file(file_path)
+        : FileMngr::remove_local_dir(file_path, dir_path);
+    if (!removed)
+        return removed;
+
+    metadata_cache->remove_subtree(path);
+    store_memcached_object(path, CachePacket::missing_value, missing_expiration, 0);
+    Utils::Status updated = update_parent_dir(path);
+    if (!updated)
+        return updated;
+    response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+    return {};
 } // remove
 
-void CacheConnectionHandler::update(const CachePacket& request, CachePacket& response) 
+Utils::Status CacheConnectionHandler::update(const CachePacket& request, CachePacket& response) 
 {
-    try {
-        bool is_file;
-        std::string path = Utils::get_string_from_byte_array(request.key);
-        std::string file_path = Utils::process_path(path, file_metadata_dir);
-        std::string dir_path = Utils::process_path(path, dir_metadata_dir);
-        std::string value, rename_content;
-        UpdateCommand command = UpdateCommand(request.value.data(), request.value.size());
-
-        if (std::filesystem::is_regular_file(file_path))
-            is_file = true;
-        else if (std::filesystem::is_directory(file_path))
-            is_file = false;
-        else
-        {
-            errno = ENOENT;
-            throw std::runtime_error(std::strerror(errno));
-        }
+    bool is_file;
+    std::string path = Utils::get_string_from_byte_array(request.key);
+    std::string file_path = Utils::process_path(path, file_metadata_dir);
+    std::string dir_path = Utils::process_path(path, dir_metadata_dir);
+    std::string rename_content;
+    UpdateCommand command = UpdateCommand(request.value.data(), request.value.size());
+
+    struct stat object_stat;
+    if (stat(file_path.c_str(), &object_stat) != 0)
+        return Utils::last_error();
+    if (S_ISREG(object_stat.st_mode))
+        is_file = true;
+    else if (S_ISDIR(object_stat.st_mode))
+        is_file = false;
+    else
+        return Utils::Error {ENOENT};
+
+    // only the entry of the directory is here, its metadata is on another cache server
+    if (!is_file && !std::filesystem::is_directory(dir_path))
+    {
+        if (UpdateCode::from_byte(command.opcode) != UpdateCode::RENAME)
+            return Utils::Error {EREMOTE};
+
+        Utils::Result<std::string> value = FileMngr::update_local_file(path, file_metadata_dir, command);
+        if (!value)
+            return Utils::Error {value.error()};
+        metadata_cache->remove(path);
+        metadata_cache->remove(*value);
+        store_memcached_object(*value, "", 0, 0);
+        Utils::Status updated = update_parent_dir(path);
+        if (updated && Utils::get_parent_dir(*value) != Utils::get_parent_dir(path))
+            updated = update_parent_dir(*value);
+        if (!updated)
+            return updated;
+        response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+        return {};
+    }
 
-        if (UpdateCode::from_byte(command.opcode) == UpdateCode::RENAME)
-        {
-            if (is_file)
-                rename_content = FileMngr::get_local_file(file_path);
-            else
-                rename_content = FileMngr::get_local_dir(file_path, dir_path);
-        }
+    if (UpdateCode::from_byte(command.opcode) == UpdateCode::RENAME)
+    {
+        Utils::Result<std::string> content = is_file
+            ? FileMngr::get_local_file(file_path)
+            : FileMngr::get_local_dir(file_path, dir_path);
+        if (!content)
+            return Utils::Error {content.error()};
+        rename_content = std::move(*content);
+    }
 
-        if (is_file)
-            value = FileMngr::update_local_file(path, file_metadata_dir, command);
-        else
-            value = FileMngr::update_local_dir(path, file_metadata_dir, dir_metadata_dir, command);
+    Utils::Result<std::string> value = is_file
+        ? FileMngr::update_local_file(path, file_metadata_dir, command)
+        : FileMngr::update_local_dir(path, file_metadata_dir, dir_metadata_dir, command);
+    if (!value)
+        return Utils::Error {value.error()};
 
-        if (UpdateCode::from_byte(command.opcode) == UpdateCode::RENAME)
-        {
-            asio::co_spawn(context, remove_memcached_object_async(path), asio::detached);
-            asio::co_spawn(context, set_memcached_object_async(value, rename_content, 0, 0), asio::detached);
-            update_parent_dir(path);
-        }
-        else
+    if (UpdateCode::from_byte(command.opcode) == UpdateCode::RENAME)
+    {
+        metadata_cache->remove_subtree(path);
+        metadata_cache->remove_subtree(*value);
+        metadata_cache->put(*value, rename_content, is_file);
+        store_memcached_object(path, CachePacket::missing_value, missing_expiration, 0);
+        store_memcached_object(*value, rename_content, 0, 0);
+        // the objects under a directory moved with it
+        if (!is_file)
         {
-            asio::co_spawn(context, update_memcached_object_async(path, value, 0, 0), asio::detached);
+            std::string new_path = Utils::process_path(*value, file_metadata_dir);
+            std::error_code error;
+            for (auto entry = std::filesystem::recursive_directory_iterator(new_path, error);
+                entry != std::filesystem::recursive_directory_iterator(); entry.increment(error))
+            {
+                std::string relative = entry->path().string().substr(new_path.length());
+                store_memcached_object(path + relative, CachePacket::missing_value, missing_expiration, 0);
+                store_memcached_object(*value + relative, "", 0, 0);
+            }
+            if (error)
+                SPDLOG_ERROR("update: Cannot list {}: {}", new_path, error.message());
         }
-
-        response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+        Utils::Status updated = update_parent_dir(path);
+        if (updated && Utils::get_parent_dir(*value) != Utils::get_parent_dir(path))
+            updated = update_parent_dir(*value);
+        if (!updated)
+            return updated;
     }
-    catch (std::exception& e)
+    else if (UpdateCode::from_byte(command.opcode) == UpdateCode::EXTEND)
+    {
+        // a concurrent extend may have stored a larger size already, the record is read again
+        metadata_cache->remove(path);
+        store_memcached_object(path, "", 0, 0);
+    }
+    else
     {
-        throw std::runtime_error(std::format("update: {}", e.what()));
+        metadata_cache->put(path, *value, is_file);
+        asio::co_spawn(context, update_memcached_object_async(path, *value, 0, 0), asio::detached);
     }
+
+    response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+    return {};
 } // update
+
+Utils::Status CacheConnectionHandler::set_entry(const CachePacket& request, CachePacket& response)
+{
+    std::string path = Utils::get_string_from_byte_array(request.key);
+    Utils::Status created = FileMngr::set_local_entry(Utils::process_path(path, file_metadata_dir));
+    if (!created)
+        return created;
+
+    metadata_cache->remove(path);
+    store_memcached_object(path, "", 0, 0);
+    Utils::Status updated = update_parent_dir(path);
+    if (!updated)
+        return updated;
+    response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+    return {};
+} // set_entry
+
+Utils::Status CacheConnectionHandler::remove_entry(const CachePacket& request, CachePacket& response)
+{
+    std::string path = Utils::get_string_from_byte_array(request.key);
+    Utils::Status removed = FileMngr::remove_local_entry(Utils::process_path(path, file_metadata_dir));
+    if (!removed)
+        return removed;
+
+    metadata_cache->remove(path);
+    Utils::Status updated = update_parent_dir(path);
+    if (!updated)
+        return updated;
+    response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+    return {};
+} // remove_entry
+
+Utils::Status CacheConnectionHandler::put_file(const CachePacket& request, CachePacket& response)
+{
+    std::string path = Utils::get_string_from_byte_array(request.key);
+    Utils::Result<std::string> value = FileMngr::put_local_file(Utils::process_path(path, file_metadata_dir),
+        Utils::get_string_from_byte_array(request.value));
+    if (!value)
+        return Utils::Error {value.error()};
+
+    metadata_cache->put(path, *value, true);
+    store_memcached_object(path, *value, 0, 0);
+    Utils::Status updated = update_parent_dir(path);
+    if (!updated)
+        return updated;
+    response.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+    return {};
+} // put_file
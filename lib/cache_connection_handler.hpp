@@ -4,6 +4,8 @@
 #include "net_protocol.hpp"
 #include "generic_connection_handler.hpp"
 #include "file_mngr.hpp"
+#include "metadata_cache.hpp"
+#include "invalidation_hub.hpp"
 
 
 using asio::ip::tcp;
@@ -16,10 +18,17 @@ namespace CacheAPI {
         uint16_t mem_port;
         std::string file_metadata_dir;
         std::string dir_metadata_dir;
+        MetadataCache* metadata_cache; // shared by the handlers of the server
+        InvalidationHub* invalidations; // shared as well
+        uint32_t watcher_id = 0; // set by a WATCH request, the connection goes to the hub once answered
+
+        // how long memcached remembers that a path does not exist
+        static const time_t missing_expiration;
 
         void handle_request(const CachePacket& request, CachePacket& response);
+        void handle_written() override;
 
-        void update_parent_dir(const std::string& path);
+        Utils::Status update_parent_dir(const std::string& path);
         void update_memcached_object(const std::string& key, const std::string& path, time_t expiration, uint32_t flags);
         asio::awaitable<void> update_memcached_object_async(const std::string& key, const std::string& path, time_t expiration, uint32_t flags);
 
@@ -27,6 +36,11 @@ namespace CacheAPI {
         void set_memcached_object(const std::string& key, const std::string& value, time_t expiration, uint32_t flags);
         void set_memcached_object(const std::string& key, const std::string& value);
         asio::awaitable<void> set_memcached_object_async(const std::string& key, const std::string& value, time_t expiration, uint32_t flags);
+        // done before the reply, so no client finds the object missing once it was told it exists;
+        // an empty value removes it. Errors are only logged.
+        void store_memcached_object(const std::string& key, const std::string& value, time_t expiration, uint32_t flags);
+        // only if the key has no value yet, a path created meanwhile wins
+        asio::awaitable<void> mark_missing_async(const std::string& key);
 
         std::string get_memcached_object(const std::string& key);
 
@@ -34,11 +48,20 @@ namespace CacheAPI {
         asio::awaitable<void> remove_memcached_object_async(const std::string& key);
 
         void init_connection(CachePacket& response);
+        void watch(CachePacket& response);
+        // tells the watching clients, but the one that sent the request, what it changed
+        void publish_change(const CachePacket& request);
 
-        void set(const CachePacket& request, CachePacket& response, bool is_file);
-        void get(const CachePacket& request, CachePacket& response, bool is_file);
-        void remove(const CachePacket& request, CachePacket& response, bool is_file);
-        void update(const CachePacket& request, CachePacket& response);
+        // the request handlers return the errno of the expected failures, answered with ERRMSG
+        Utils::Status set(const CachePacket& request, CachePacket& response, bool is_file);
+        Utils::Status get(const CachePacket& request, CachePacket& response, bool is_file);
+        Utils::Status remove(const CachePacket& request, CachePacket& response, bool is_file);
+        Utils::Status update(const CachePacket& request, CachePacket& response);
+        // the namespace can be split between cache servers, a directory at the top of a subtree
+        // kept by another server is only listed here (see ShardedCacheClient)
+        Utils::Status set_entry(const CachePacket& request, CachePacket& response);
+        Utils::Status remove_entry(const CachePacket& request, CachePacket& response);
+        Utils::Status put_file(const CachePacket& request, CachePacket& response);
 
     public:
         CacheConnectionHandler(
@@ -46,7 +69,9 @@ namespace CacheAPI {
             memcached_st* mem_client, 
             uint16_t mem_port, 
             std::string file_metadata_dir,
-            std::string dir_metadata_dir
+            std::string dir_metadata_dir,
+            MetadataCache* metadata_cache,
+            InvalidationHub* invalidations
         );
         
         ~CacheConnectionHandler() override = default;
@@ -16,6 +16,7 @@ CacheServer::CacheServer(int thread_count, std::string mem_conf_string, std::str
     , mem_port(0)
     , file_metadata_dir(file_metadata_dir)
     , dir_metadata_dir(dir_metadata_dir)
+    , metadata_cache_size(65536)
 {
     try {
         if (!std::filesystem::exists(file_metadata_dir))
@@ -58,6 +59,7 @@ CacheServer::CacheServer(int thread_count, uint16_t mem_port,std::string file_me
     , mem_conf_string(std::format("--SERVER=127.0.0.1:{}", mem_port))
     , file_metadata_dir(file_metadata_dir)
     , dir_metadata_dir(dir_metadata_dir)
+    , metadata_cache_size(65536)
 {
     if (!std::filesystem::exists(file_metadata_dir) || !std::filesystem::exists(dir_metadata_dir))
     {
@@ -83,10 +85,11 @@ CacheServer::CacheServer(int thread_count, uint16_t mem_port,std::string file_me
         char* const args[] = {(char*)"memcached", (char*)"-p", (char*)std::to_string(mem_port).c_str(), nullptr};
         int result = execvp("memcached", args);
 
+        // the child has no logging thread (Logging::init), and must not join it on the way out
         if (result != 0)
-            SPDLOG_ERROR("execvp: {}", strerror(errno));
+            fprintf(stderr, "execvp: %s\n", strerror(errno));
 
-        exit(0);
+        _exit(1);
     }
     else if (memcached_pid > 0) // parent process
     {
@@ -127,6 +130,14 @@ CacheServer::~CacheServer()
     SPDLOG_INFO("Exiting Cache Server.");
 }
 
+void CacheServer::set_metadata_cache_size(size_t entries)
+{
+    metadata_cache_size = entries;
+}
+
 void CacheServer::run(uint16_t port) {
-    GenericServer<CacheConnectionHandler>::run(port, mem_client, mem_port, file_metadata_dir, dir_metadata_dir);
+    metadata_cache = std::make_unique<MetadataCache>(metadata_cache_size);
+    SPDLOG_INFO("CacheServer: Metadata cache of {} entries.", metadata_cache_size);
+    invalidations = std::make_unique<InvalidationHub>();
+    GenericServer<CacheConnectionHandler>::run(port, mem_client, mem_port, file_metadata_dir, dir_metadata_dir, metadata_cache.get(), invalidations.get());
 }
@@ -13,6 +13,9 @@ namespace CacheAPI {
         std::string file_metadata_dir, dir_metadata_dir;
         uint16_t mem_port;
         pid_t memcached_pid;
+        size_t metadata_cache_size;
+        std::unique_ptr<MetadataCache> metadata_cache;
+        std::unique_ptr<InvalidationHub> invalidations;
 
         void init();
 
@@ -26,6 +29,9 @@ namespace CacheAPI {
         CacheServer(std::string file_metadata_dir, std::string dir_metadata_dir);
         ~CacheServer();
 
+        // entries of the in-memory metadata cache (MetadataCache), 0 disables it
+        void set_metadata_cache_size(size_t entries);
+
         void run(uint16_t port);
     };
 }
@@ -0,0 +1,286 @@
+#include "checksum.hpp"
+
+#include <cstring>
+#include <immintrin.h>
+
+/*##############################*/
+/*---------[ GF(2)[x] ]---------*/
+/*##############################*/
+
+namespace {
+    // CRC32C polynomial 0x1edc6f41, bit reflected: bit 31 is x^0
+    const uint32_t polynomial = 0x82f63b78;
+
+    // a * b mod p
+    uint32_t multmodp(uint32_t a, uint32_t b)
+    {
+        uint32_t m = 1u << 31, product = 0;
+        for (;;)
+        {
+            if (a & m)
+            {
+                product ^= b;
+                if ((a & (m - 1)) == 0)
+                    break;
+            }
+            m >>= 1;
+            b = b & 1 ? (b >> 1) ^ polynomial : b >> 1;
+        }
+        return product;
+    }
+
+    struct Tables {
+        uint32_t slicing[8][256];
+        uint32_t x2n[32]; // x^(2^n) mod p
+
+        Tables()
+        {
+            for (uint32_t n = 0; n < 256; n ++)
+            {
+                uint32_t crc = n;
+                for (int bit = 0; bit < 8; bit ++)
+                    crc = crc & 1 ? (crc >> 1) ^ polynomial : crc >> 1;
+                slicing[0][n] = crc;
+            }
+            for (uint32_t n = 0; n < 256; n ++)
+            {
+                uint32_t crc = slicing[0][n];
+                for (int k = 1; k < 8; k ++)
+                {
+                    crc = slicing[0][crc & 0xff] ^ (crc >> 8);
+                    slicing[k][n] = crc;
+                }
+            }
+
+            uint32_t power = 1u << 30; // x^1
+            x2n[0] = power;
+            for (int n = 1; n < 32; n ++)
+                x2n[n] = power = multmodp(power, power);
+        }
+    };
+
+    const Tables tables;
+
+    // x^(n * 2^k) mod p
+    uint32_t x2nmodp(size_t n, unsigned k)
+    {
+        uint32_t power = 1u << 31; // x^0
+        while (n)
+        {
+            if (n & 1)
+                power = multmodp(tables.x2n[k & 31], power);
+            n >>= 1;
+            k ++;
+        }
+        return power;
+    }
+
+    /*###############################*/
+    /*---------[ Slicing-8 ]---------*/
+    /*###############################*/
+
+    // the kernels work on the raw CRC register (no pre and post inversion) and
+    // copy the bytes to destination on the way when Copy is set
+    using Kernel = uint32_t (*)(uint32_t crc, uint8_t* destination, const uint8_t* source, size_t len);
+
+    template <bool Copy>
+    uint32_t crc32c_portable(uint32_t crc, uint8_t* destination, const uint8_t* source, size_t len)
+    {
+        while (len > 0 && (reinterpret_cast<uintptr_t>(source) & 7) != 0)
+        {
+            if constexpr (Copy)
+                *destination ++ = *source;
+            crc = tables.slicing[0][(crc ^ *source ++) & 0xff] ^ (crc >> 8);
+            len --;
+        }
+
+        // little-endian only: the low byte of the word is the first one in memory
+        while (len >= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, source, 8);
+            if constexpr (Copy)
+            {
+                std::memcpy(destination, &word, 8);
+                destination += 8;
+            }
+
+            word ^= crc;
+            crc = tables.slicing[7][word & 0xff] ^ tables.slicing[6][(word >> 8) & 0xff]
+                ^ tables.slicing[5][(word >> 16) & 0xff] ^ tables.slicing[4][(word >> 24) & 0xff]
+                ^ tables.slicing[3][(word >> 32) & 0xff] ^ tables.slicing[2][(word >> 40) & 0xff]
+                ^ tables.slicing[1][(word >> 48) & 0xff] ^ tables.slicing[0][word >> 56];
+            source += 8;
+            len -= 8;
+        }
+
+        while (len > 0)
+        {
+            if constexpr (Copy)
+                *destination ++ = *source;
+            crc = tables.slicing[0][(crc ^ *source ++) & 0xff] ^ (crc >> 8);
+            len --;
+        }
+
+        return crc;
+    }
+
+    /*#################################*/
+    /*---------[ SSE4.2 CRC32 ]---------*/
+    /*#################################*/
+
+    const size_t long_block = 8192, short_block = 256;
+
+    // crc * x^(8 * block) mod p is crc32(0, clmul(crc, x^(8 * block - 33) mod p)):
+    // the carry-less product of two reflected values is one degree short and
+    // the CRC instruction multiplies by x^32 while reducing
+    const uint32_t long_shift = x2nmodp(8 * long_block - 33, 0);
+    const uint32_t short_shift = x2nmodp(8 * short_block - 33, 0);
+
+    __attribute__((target("sse4.2,pclmul")))
+    inline uint64_t shift_crc(uint32_t constant, uint64_t crc)
+    {
+        __m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128(crc), _mm_cvtsi32_si128(constant), 0);
+        return _mm_crc32_u64(0, _mm_cvtsi128_si64(product));
+    }
+
+    template <bool Copy>
+    __attribute__((target("sse4.2,pclmul")))
+    inline void crc32c_blocks(uint64_t& crc, uint8_t*& destination, const uint8_t*& source, size_t& len,
+        size_t block, uint32_t shift)
+    {
+        while (len >= 3 * block)
+        {
+            // three independent streams keep the CRC unit busy
+            uint64_t crc1 = 0, crc2 = 0;
+            const uint8_t* end = source + block;
+            do {
+                if constexpr (Copy)
+                {
+                    // every 16 bytes are loaded once, stored and split for the CRC
+                    __m128i vector0 = _mm_loadu_si128((const __m128i*) source);
+                    __m128i vector1 = _mm_loadu_si128((const __m128i*) (source + block));
+                    __m128i vector2 = _mm_loadu_si128((const __m128i*) (source + 2 * block));
+                    _mm_storeu_si128((__m128i*) destination, vector0);
+                    _mm_storeu_si128((__m128i*) (destination + block), vector1);
+                    _mm_storeu_si128((__m128i*) (destination + 2 * block), vector2);
+                    crc = _mm_crc32_u64(crc, _mm_cvtsi128_si64(vector0));
+                    crc1 = _mm_crc32_u64(crc1, _mm_cvtsi128_si64(vector1));
+                    crc2 = _mm_crc32_u64(crc2, _mm_cvtsi128_si64(vector2));
+                    crc = _mm_crc32_u64(crc, _mm_extract_epi64(vector0, 1));
+                    crc1 = _mm_crc32_u64(crc1, _mm_extract_epi64(vector1, 1));
+                    crc2 = _mm_crc32_u64(crc2, _mm_extract_epi64(vector2, 1));
+                    destination += 16;
+                    source += 16;
+                }
+                else
+                {
+                    uint64_t word0, word1, word2;
+                    std::memcpy(&word0, source, 8);
+                    std::memcpy(&word1, source + block, 8);
+                    std::memcpy(&word2, source + 2 * block, 8);
+                    crc = _mm_crc32_u64(crc, word0);
+                    crc1 = _mm_crc32_u64(crc1, word1);
+                    crc2 = _mm_crc32_u64(crc2, word2);
+                    source += 8;
+                }
+            } while (source < end);
+
+            crc = shift_crc(shift, crc) ^ crc1;
+            crc = shift_crc(shift, crc) ^ crc2;
+            source += 2 * block;
+            if constexpr (Copy)
+                destination += 2 * block;
+            len -= 3 * block;
+        }
+    }
+
+    template <bool Copy>
+    __attribute__((target("sse4.2,pclmul")))
+    uint32_t crc32c_hardware(uint32_t crc32, uint8_t* destination, const uint8_t* source, size_t len)
+    {
+        uint64_t crc = crc32;
+
+        while (len > 0 && (reinterpret_cast<uintptr_t>(source) & 7) != 0)
+        {
+            if constexpr (Copy)
+                *destination ++ = *source;
+            crc = _mm_crc32_u8(crc, *source ++);
+            len --;
+        }
+
+        crc32c_blocks<Copy>(crc, destination, source, len, long_block, long_shift);
+        crc32c_blocks<Copy>(crc, destination, source, len, short_block, short_shift);
+
+        while (len >= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, source, 8);
+            if constexpr (Copy)
+            {
+                std::memcpy(destination, &word, 8);
+                destination += 8;
+            }
+            crc = _mm_crc32_u64(crc, word);
+            source += 8;
+            len -= 8;
+        }
+
+        while (len > 0)
+        {
+            if constexpr (Copy)
+                *destination ++ = *source;
+            crc = _mm_crc32_u8(crc, *source ++);
+            len --;
+        }
+
+        return crc;
+    }
+
+    bool hardware_supported()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+    }
+
+    Kernel crc_kernel = hardware_supported() ? crc32c_hardware<false> : crc32c_portable<false>;
+    Kernel copy_kernel = hardware_supported() ? crc32c_hardware<true> : crc32c_portable<true>;
+}
+
+/*##############################*/
+/*---------[ Checksum ]---------*/
+/*##############################*/
+
+uint32_t Checksum::crc32c(const uint8_t* data, size_t len, uint32_t crc)
+{
+    return ~crc_kernel(~crc, nullptr, data, len);
+}
+
+uint32_t Checksum::crc32c_copy(uint8_t* destination, const uint8_t* source, size_t len, uint32_t crc)
+{
+    return ~copy_kernel(~crc, destination, source, len);
+}
+
+uint32_t Checksum::crc32c_combine(uint32_t crc_a, uint32_t crc_b, size_t len_b)
+{
+    return multmodp(x2nmodp(len_b, 3), crc_a) ^ crc_b;
+}
+
+uint32_t Checksum::crc32c_zeros(size_t len, uint32_t crc)
+{
+    // a zero byte only shifts the register: crc * x^(8 * len) mod p
+    return ~multmodp(x2nmodp(len, 3), ~crc);
+}
+
+std::string Checksum::get_kernel_name()
+{
+    if (crc_kernel == crc32c_hardware<false>)
+        return "sse4.2+pclmul";
+    return "slicing-by-8";
+}
+
+void Checksum::use_portable_kernel()
+{
+    crc_kernel = crc32c_portable<false>;
+    copy_kernel = crc32c_portable<true>;
+}
@@ -0,0 +1,36 @@
+#ifndef CHECKSUM_HPP
+#define CHECKSUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// CRC32C (Castagnoli) of the stripe data, checked end to end: the client
+// computes it, every hop that copies the data verifies it in the same pass
+// and the storage nodes keep it next to the stripe.
+//
+// On x86 with SSE4.2 the CRC instruction runs on three interleaved streams
+// (its latency is 3 cycles, its throughput 1 per cycle) and the partial CRCs
+// are merged with a carry-less multiply (PCLMUL). Other CPUs use slicing-by-8.
+//
+// All the functions take the CRC of the previous bytes, so a buffer can be
+// processed in pieces: crc32c(b, crc32c(a)) == crc32c(a + b).
+
+namespace Checksum {
+    uint32_t crc32c(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+    // memcpy(destination, source, len) and the CRC of the bytes, in one pass
+    uint32_t crc32c_copy(uint8_t* destination, const uint8_t* source, size_t len, uint32_t crc = 0);
+
+    // CRC of a + b from the CRC of a, the CRC of b and the length of b
+    uint32_t crc32c_combine(uint32_t crc_a, uint32_t crc_b, size_t len_b);
+    // crc32c of len zero bytes without reading them, for the holes of a sparse file
+    uint32_t crc32c_zeros(size_t len, uint32_t crc = 0);
+
+    // name of the implementation picked for this CPU
+    std::string get_kernel_name();
+    // forces slicing-by-8, used to compare against the hardware version
+    void use_portable_kernel();
+}
+
+#endif
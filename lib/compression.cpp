@@ -0,0 +1,74 @@
+#include "compression.hpp"
+
+#include <lz4.h>
+#include <zstd.h>
+
+// zstd level 1 keeps up with the network, the higher ones are too slow for the write path
+static const int zstd_level = 1;
+
+bool Compression::compress(CompressionCode::Type codec, const uint8_t* data, size_t len, std::vector<uint8_t>& output)
+{
+    size_t limit = len - len / 8;
+    size_t size;
+
+    switch (codec)
+    {
+        case CompressionCode::Type::LZ4:
+        {
+            output.resize(LZ4_compressBound(len));
+            int result = LZ4_compress_default((const char*) data, (char*) output.data(), len, output.size());
+            if (result <= 0)
+                return false;
+            size = result;
+            break;
+        }
+        case CompressionCode::Type::ZSTD:
+        {
+            output.resize(ZSTD_compressBound(len));
+            size = ZSTD_compress(output.data(), output.size(), data, len, zstd_level);
+            if (ZSTD_isError(size))
+                return false;
+            break;
+        }
+
+        default:
+            return false;
+    }
+
+    if (size >= limit)
+        return false;
+
+    output.resize(size);
+    return true;
+}
+
+size_t Compression::decompress(CompressionCode::Type codec, const uint8_t* data, size_t len, uint8_t* output, size_t capacity)
+{
+    switch (codec)
+    {
+        case CompressionCode::Type::NONE:
+        {
+            if (len > capacity)
+                throw std::runtime_error(std::format("decompress: {} bytes do not fit in {}", len, capacity));
+            std::memcpy(output, data, len);
+            return len;
+        }
+        case CompressionCode::Type::LZ4:
+        {
+            int result = LZ4_decompress_safe((const char*) data, (char*) output, len, capacity);
+            if (result < 0)
+                throw std::runtime_error("decompress: Corrupted LZ4 stripe");
+            return result;
+        }
+        case CompressionCode::Type::ZSTD:
+        {
+            size_t result = ZSTD_decompress(output, capacity, data, len);
+            if (ZSTD_isError(result))
+                throw std::runtime_error(std::format("decompress: {}", ZSTD_getErrorName(result)));
+            return result;
+        }
+
+        default:
+            throw std::runtime_error(std::format("decompress: Unknown codec {}", (int) codec));
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include "net_protocol.hpp"
+
+// Stripe compression. A stripe is compressed on its own, so any of them can be
+// read back without the others, and the codec travels in the packet flags and
+// in the stripe footer on the storage nodes.
+namespace Compression {
+    // compresses data into output, false when the result is not worth storing
+    // (it did not save at least 1/8 of the stripe), output is left unspecified
+    bool compress(CompressionCode::Type codec, const uint8_t* data, size_t len, std::vector<uint8_t>& output);
+
+    // decompresses into at most capacity bytes of output, returns the size of the
+    // original data, throws when the input is corrupted or does not fit
+    size_t decompress(CompressionCode::Type codec, const uint8_t* data, size_t len, uint8_t* output, size_t capacity);
+}
+
+#endif
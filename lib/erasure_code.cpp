@@ -0,0 +1,299 @@
+#include "erasure_code.hpp"
+
+#include <immintrin.h>
+
+using namespace StorageAPI;
+
+/*#############################*/
+/*---------[ GF(2^8) ]---------*/
+/*#############################*/
+
+namespace {
+    struct GaloisField {
+        uint8_t exp[512];
+        uint8_t log[256];
+
+        GaloisField()
+        {
+            int x = 1;
+            for (int i = 0; i < 255; i ++)
+            {
+                exp[i] = x;
+                log[x] = i;
+                x <<= 1;
+                if (x & 0x100)
+                    x ^= 0x11d;
+            }
+            for (int i = 255; i < 512; i ++)
+                exp[i] = exp[i - 255];
+            log[0] = 0;
+        }
+
+        uint8_t mul(uint8_t a, uint8_t b) const
+        {
+            if (a == 0 || b == 0)
+                return 0;
+            return exp[log[a] + log[b]];
+        }
+
+        uint8_t inv(uint8_t a) const
+        {
+            if (a == 0)
+                throw std::runtime_error("GaloisField: 0 has no inverse");
+            return exp[255 - log[a]];
+        }
+
+        // low nibble products followed by high nibble products of c
+        void nibble_tables(uint8_t c, uint8_t* tables) const
+        {
+            for (int n = 0; n < 16; n ++)
+            {
+                tables[n] = mul(c, n);
+                tables[16 + n] = mul(c, n << 4);
+            }
+        }
+    };
+
+    const GaloisField gf;
+
+    /*#############################*/
+    /*---------[ Kernels ]---------*/
+    /*#############################*/
+
+    void mul_scalar(const uint8_t* tables, const uint8_t* src, uint8_t* dst, size_t len, bool accumulate)
+    {
+        uint8_t row[256];
+        for (int x = 0; x < 256; x ++)
+            row[x] = tables[x & 0x0f] ^ tables[16 + (x >> 4)];
+
+        if (accumulate)
+            for (size_t i = 0; i < len; i ++)
+                dst[i] ^= row[src[i]];
+        else
+            for (size_t i = 0; i < len; i ++)
+                dst[i] = row[src[i]];
+    }
+
+    __attribute__((target("avx2")))
+    void mul_avx2(const uint8_t* tables, const uint8_t* src, uint8_t* dst, size_t len, bool accumulate)
+    {
+        const __m256i low_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) tables));
+        const __m256i high_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) (tables + 16)));
+        const __m256i mask = _mm256_set1_epi8(0x0f);
+
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i*) (src + i));
+            __m256i low = _mm256_shuffle_epi8(low_table, _mm256_and_si256(x, mask));
+            __m256i high = _mm256_shuffle_epi8(high_table, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask));
+            __m256i product = _mm256_xor_si256(low, high);
+            if (accumulate)
+                product = _mm256_xor_si256(product, _mm256_loadu_si256((const __m256i*) (dst + i)));
+            _mm256_storeu_si256((__m256i*) (dst + i), product);
+        }
+
+        if (i < len)
+            mul_scalar(tables, src + i, dst + i, len - i, accumulate);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    void mul_avx512(const uint8_t* tables, const uint8_t* src, uint8_t* dst, size_t len, bool accumulate)
+    {
+        const __m512i low_table = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*) tables));
+        const __m512i high_table = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*) (tables + 16)));
+        const __m512i mask = _mm512_set1_epi8(0x0f);
+
+        size_t i = 0;
+        for (; i + 64 <= len; i += 64)
+        {
+            __m512i x = _mm512_loadu_si512((const void*) (src + i));
+            __m512i low = _mm512_shuffle_epi8(low_table, _mm512_and_si512(x, mask));
+            __m512i high = _mm512_shuffle_epi8(high_table, _mm512_and_si512(_mm512_srli_epi64(x, 4), mask));
+            __m512i product = _mm512_xor_si512(low, high);
+            if (accumulate)
+                product = _mm512_xor_si512(product, _mm512_loadu_si512((const void*) (dst + i)));
+            _mm512_storeu_si512((void*) (dst + i), product);
+        }
+
+        if (i < len)
+            mul_avx2(tables, src + i, dst + i, len - i, accumulate);
+    }
+
+    ReedSolomon::MulKernel select_kernel()
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512bw"))
+            return mul_avx512;
+        if (__builtin_cpu_supports("avx2"))
+            return mul_avx2;
+        return mul_scalar;
+    }
+
+    ReedSolomon::MulKernel mul_kernel = select_kernel();
+
+    // fragments are processed in blocks so the outputs stay in cache while
+    // all the inputs are folded into them
+    const size_t block_size = 16 * 1024;
+}
+
+/*#################################*/
+/*---------[ ReedSolomon ]---------*/
+/*#################################*/
+
+ReedSolomon::ReedSolomon(int data_shards, int parity_shards)
+    : data_shards(data_shards)
+    , parity_shards(parity_shards)
+{
+    if (data_shards <= 0 || parity_shards < 0 || data_shards + parity_shards > 256)
+        throw std::runtime_error(std::format("ReedSolomon: Invalid geometry {}+{}", data_shards, parity_shards));
+
+    // Cauchy matrix: 1 / (x_j + y_i) with x_j = k + j and y_i = i, all distinct
+    parity_matrix.resize(parity_shards * data_shards);
+    parity_tables.resize(parity_shards * data_shards * 32);
+    for (int j = 0; j < parity_shards; j ++)
+    {
+        for (int i = 0; i < data_shards; i ++)
+        {
+            uint8_t coefficient = gf.inv((data_shards + j) ^ i);
+            parity_matrix[j * data_shards + i] = coefficient;
+            gf.nibble_tables(coefficient, &parity_tables[(j * data_shards + i) * 32]);
+        }
+    }
+}
+
+int ReedSolomon::get_data_shards() const
+{
+    return data_shards;
+}
+
+int ReedSolomon::get_parity_shards() const
+{
+    return parity_shards;
+}
+
+void ReedSolomon::multiply_rows(const std::vector<uint8_t>& tables, int rows, const uint8_t* const* inputs,
+    uint8_t* const* outputs, size_t len) const
+{
+    for (size_t start = 0; start < len; start += block_size)
+    {
+        size_t n = std::min(block_size, len - start);
+        for (int r = 0; r < rows; r ++)
+            for (int i = 0; i < data_shards; i ++)
+                mul_kernel(&tables[(r * data_shards + i) * 32], inputs[i] + start, outputs[r] + start, n, i > 0);
+    }
+}
+
+void ReedSolomon::encode(const uint8_t* const* data, uint8_t* const* parity, size_t len) const
+{
+    multiply_rows(parity_tables, parity_shards, data, parity, len);
+}
+
+void ReedSolomon::reconstruct(uint8_t* const* shards, const std::vector<bool>& present, size_t len) const
+{
+    int total = data_shards + parity_shards;
+    if ((int) present.size() != total)
+        throw std::runtime_error("reconstruct: present must have one entry per fragment");
+
+    // the first k fragments still around are the inputs of the decoding
+    std::vector<int> inputs;
+    for (int s = 0; s < total && (int) inputs.size() < data_shards; s ++)
+        if (present[s])
+            inputs.push_back(s);
+
+    if ((int) inputs.size() < data_shards)
+        throw std::runtime_error(std::format("reconstruct: Not enough fragments, need {}, have {}",
+            data_shards, inputs.size()));
+
+    std::vector<int> missing_data;
+    for (int s = 0; s < data_shards; s ++)
+        if (!present[s])
+            missing_data.push_back(s);
+
+    if (!missing_data.empty())
+    {
+        // rows of the generator matrix for the inputs, inverted with Gauss-Jordan
+        int k = data_shards;
+        std::vector<uint8_t> matrix(k * k, 0), inverse(k * k, 0);
+        for (int r = 0; r < k; r ++)
+        {
+            if (inputs[r] < k)
+                matrix[r * k + inputs[r]] = 1;
+            else
+                std::copy_n(&parity_matrix[(inputs[r] - k) * k], k, &matrix[r * k]);
+            inverse[r * k + r] = 1;
+        }
+
+        for (int column = 0; column < k; column ++)
+        {
+            int pivot = column;
+            while (pivot < k && matrix[pivot * k + column] == 0)
+                pivot ++;
+            if (pivot == k)
+                throw std::runtime_error("reconstruct: Singular decoding matrix");
+
+            if (pivot != column)
+            {
+                std::swap_ranges(&matrix[pivot * k], &matrix[pivot * k] + k, &matrix[column * k]);
+                std::swap_ranges(&inverse[pivot * k], &inverse[pivot * k] + k, &inverse[column * k]);
+            }
+
+            uint8_t scale = gf.inv(matrix[column * k + column]);
+            for (int c = 0; c < k; c ++)
+            {
+                matrix[column * k + c] = gf.mul(matrix[column * k + c], scale);
+                inverse[column * k + c] = gf.mul(inverse[column * k + c], scale);
+            }
+
+            for (int r = 0; r < k; r ++)
+            {
+                uint8_t factor = matrix[r * k + column];
+                if (r == column || factor == 0)
+                    continue;
+                for (int c = 0; c < k; c ++)
+                {
+                    matrix[r * k + c] ^= gf.mul(factor, matrix[column * k + c]);
+                    inverse[r * k + c] ^= gf.mul(factor, inverse[column * k + c]);
+                }
+            }
+        }
+
+        // missing data fragment d = row d of the inverse applied to the inputs
+        std::vector<uint8_t> tables(missing_data.size() * k * 32);
+        std::vector<const uint8_t*> input_shards(k);
+        std::vector<uint8_t*> outputs(missing_data.size());
+        for (int r = 0; r < k; r ++)
+            input_shards[r] = shards[inputs[r]];
+        for (size_t d = 0; d < missing_data.size(); d ++)
+        {
+            outputs[d] = shards[missing_data[d]];
+            for (int i = 0; i < k; i ++)
+                gf.nibble_tables(inverse[missing_data[d] * k + i], &tables[(d * k + i) * 32]);
+        }
+        multiply_rows(tables, missing_data.size(), input_shards.data(), outputs.data(), len);
+    }
+
+    // with all the data back the missing parity is a plain encode
+    for (int j = 0; j < parity_shards; j ++)
+    {
+        if (present[data_shards + j])
+            continue;
+        uint8_t* output = shards[data_shards + j];
+        multiply_rows(std::vector<uint8_t>(parity_tables.begin() + j * data_shards * 32,
+            parity_tables.begin() + (j + 1) * data_shards * 32), 1, shards, &output, len);
+    }
+}
+
+std::string ReedSolomon::get_kernel_name()
+{
+    if (mul_kernel == mul_avx512)
+        return "avx512";
+    if (mul_kernel == mul_avx2)
+        return "avx2";
+    return "scalar";
+}
+
+void ReedSolomon::use_scalar_kernel()
+{
+    mul_kernel = mul_scalar;
+}
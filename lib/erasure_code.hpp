@@ -0,0 +1,55 @@
+#ifndef ERASURE_CODE_HPP
+#define ERASURE_CODE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace StorageAPI {
+    // Systematic Reed-Solomon code over GF(2^8) (polynomial 0x11d).
+    // A stripe group is made of k data fragments and m parity fragments of the
+    // same length, any k of them are enough to rebuild the others. The parity
+    // rows come from a Cauchy matrix, so every k x k submatrix is invertible.
+    //
+    // The inner loop multiplies a whole fragment by a constant with the
+    // split-nibble table lookup (PSHUFB), using AVX-512BW or AVX2 when the CPU
+    // has them and a table based scalar loop otherwise.
+    class ReedSolomon {
+    public:
+        // dst ^= c * src (or dst = c * src when accumulate is false), tables holds the
+        // 16 products of c with the low nibbles followed by the 16 with the high nibbles
+        using MulKernel = void (*)(const uint8_t* tables, const uint8_t* src, uint8_t* dst, size_t len, bool accumulate);
+
+    private:
+        int data_shards, parity_shards;
+        std::vector<uint8_t> parity_matrix; // parity_shards x data_shards coefficients
+        std::vector<uint8_t> parity_tables; // nibble tables of every parity coefficient
+
+        void multiply_rows(const std::vector<uint8_t>& matrix, int rows, const uint8_t* const* inputs,
+            uint8_t* const* outputs, size_t len) const;
+
+    public:
+        ReedSolomon(int data_shards, int parity_shards);
+
+        int get_data_shards() const;
+        int get_parity_shards() const;
+
+        // parity[j] = sum over i of parity_matrix[j][i] * data[i], every fragment has len bytes
+        void encode(const uint8_t* const* data, uint8_t* const* parity, size_t len) const;
+
+        // shards holds the k data fragments followed by the m parity fragments,
+        // the ones marked as missing in present are rebuilt in place
+        void reconstruct(uint8_t* const* shards, const std::vector<bool>& present, size_t len) const;
+
+        // name of the multiplication kernel picked for this CPU
+        static std::string get_kernel_name();
+        // forces the scalar kernel, used to compare against the vectorized ones
+        static void use_scalar_kernel();
+    };
+}
+
+#endif
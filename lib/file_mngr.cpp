@@ -1,94 +1,184 @@
 #include "file_mngr.hpp"
+#include <functional>
+#include <sys/file.h>
 
-std::string FileMngr::set_local_file(const std::string& file_path, mode_t mode)
+namespace {
+    // the attributes are at fixed offsets of the record, only its header is written back; the
+    // record is locked meanwhile, two patches of the same object would otherwise lose one
+    Utils::Result<std::string> patch_record(const std::string& path, const std::function<void(std::string&)>& patch)
+    {
+        int fd = open(path.c_str(), O_RDWR);
+        if (fd < 0)
+            return Utils::last_error();
+        if (flock(fd, LOCK_EX) != 0)
+        {
+            Utils::Error error = Utils::last_error();
+            close(fd);
+            return error;
+        }
+
+        struct stat file_stat;
+        std::string content;
+        ssize_t length = -1;
+        if (fstat(fd, &file_stat) == 0)
+        {
+            content.resize(file_stat.st_size);
+            length = pread(fd, content.data(), content.size(), 0);
+        }
+        if (length < 0)
+        {
+            Utils::Error error = Utils::last_error();
+            close(fd);
+            return error;
+        }
+        content.resize(length);
+        if (!StatRecord::is_valid(content))
+        {
+            close(fd);
+            return Utils::Error {EINVAL};
+        }
+
+        patch(content);
+        ssize_t written = pwrite(fd, content.data(), sizeof(StatRecord::Header), 0);
+        Utils::Error error = Utils::last_error();
+        close(fd); // and unlocked
+        if (written < 0)
+            return error;
+        if (written != sizeof(StatRecord::Header))
+            return Utils::Error {EIO};
+        return content;
+    }
+}
+
+Utils::Result<std::string> FileMngr::set_local_file(const std::string& file_path, mode_t mode, int compression)
 {
-    std::string result;
-    Stat file_proto;
     struct stat file_stat;
-    int fd;
-
-    fd = open(file_path.c_str(), O_CREAT | O_RDWR, mode);
+    int fd = open(file_path.c_str(), O_CREAT | O_RDWR, mode);
     if (fd < 0)
-        throw std::runtime_error(std::format("set_local_file: {}", std::strerror(errno)));
+        return Utils::last_error();
 
     if (fstat(fd, &file_stat) != 0)
-        throw std::runtime_error(std::format("set_local_file: {}", std::strerror(errno)));
+    {
+        Utils::Error error = Utils::last_error();
+        close(fd);
+        return error;
+    }
 
-    Utils::struct_stat_to_proto(&file_stat, file_proto);
-    file_proto.SerializeToString(&result);
-    if (write(fd, result.c_str(), result.length()) < 0)
-        throw std::runtime_error(std::format("set_local_file: {}", std::strerror(errno)));
+    std::string result = StatRecord::make(file_stat, compression);
+    ssize_t written = write(fd, result.c_str(), result.length());
+    Utils::Error error = Utils::last_error();
+    close(fd);
+    if (written < 0)
+        return error;
 
     return result;
 }
 
-void FileMngr::set_local_dir(const std::string& path, const std::string& meta_path, mode_t mode)
+Utils::Status FileMngr::set_local_dir(const std::string& path, const std::string& meta_path, mode_t mode)
 {
-    int result;
-
-    result = mkdir(path.c_str(), mode);
-    if (result != 0)
-        throw std::runtime_error(std::format("set_local_dir: {}", std::strerror(errno)));
-    result = mkdir(meta_path.c_str(), mode);
-    if (result != 0)
-        throw std::runtime_error(std::format("set_local_dir: {}", std::strerror(errno)));
+    if (mkdir(path.c_str(), mode) != 0)
+        return Utils::last_error();
+    // the parent of a directory listed by another cache server only exists in the folder hierarchy
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(meta_path).parent_path(), error);
+    if (mkdir(meta_path.c_str(), mode) != 0)
+        return Utils::last_error();
+    return {};
 }
 
+Utils::Status FileMngr::set_local_entry(const std::string& path)
+{
+    if (mkdir(path.c_str(), 0755) != 0)
+        return Utils::last_error();
+    return {};
+}
 
-std::string FileMngr::get_local_file(const std::string& path)
+Utils::Result<std::string> FileMngr::put_local_file(const std::string& file_path, const std::string& content)
 {
-    std::ifstream file(path);
+    if (!StatRecord::is_valid(content))
+        return Utils::Error {EINVAL};
+
+    int fd = open(file_path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, StatRecord::get_mode(content) & 0777);
+    if (fd < 0)
+        return Utils::last_error();
 
-    if (!file)
-        throw std::runtime_error(std::format("get_local_file: {}", std::strerror(errno)));
+    ssize_t written = write(fd, content.c_str(), content.length());
+    Utils::Error error = Utils::last_error();
+    close(fd);
+    if (written < 0)
+        return error;
 
-    std::ostringstream buf;
-    buf << file.rdbuf();
-    return buf.str();
+    return content;
 }
 
-std::string FileMngr::get_local_dir(const std::string& path, const std::string& meta_path, bool update_dir_list)
+Utils::Result<std::string> FileMngr::get_local_file(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return Utils::last_error();
+
+    // the records are small, one read of the size fstat gives
+    struct stat file_stat;
+    std::string content;
+    ssize_t length = -1;
+    if (fstat(fd, &file_stat) == 0)
+    {
+        content.resize(file_stat.st_size);
+        length = pread(fd, content.data(), content.size(), 0);
+    }
+    Utils::Error error = Utils::last_error();
+    close(fd);
+    if (length < 0)
+        return error;
+
+    content.resize(length);
+    return content;
+}
+
+Utils::Result<std::string> FileMngr::get_local_dir(const std::string& path, const std::string& meta_path, bool update_dir_list)
 {
     std::string meta_dir_file = meta_path + "/.this"; // file that contains metadata of directory
-    std::string result;
     if (update_dir_list == false)
     {
-        std::ifstream i_file(meta_dir_file); // looking for metadat in .this
-        if (i_file)
-        {
-            result = std::string((std::istreambuf_iterator<char>(i_file)), std::istreambuf_iterator<char>());
-            i_file.close();
-            return result;
-        }
+        // looking for metadata in .this
+        Utils::Result<std::string> cached = get_local_file(meta_dir_file);
+        if (cached)
+            return cached;
     }
 
+    // the compression policy is not part of the directory listing, it is kept across updates
+    int compression = get_dir_compression(meta_path);
+
     // if we are doing an update we have to make sure that no previous data remains
     // this is in case there is an error before writing to .this
     unlink(meta_dir_file.c_str());
 
-    Stat dir_proto;
+    std::vector<std::string> entries;
     struct stat dir_stat;
     struct dirent* entry;
     std::ofstream o_file;
 
     DIR* dir = opendir(path.c_str());
-
     if (!dir)
-        throw std::runtime_error(std::format("get_local_dir: {}", std::strerror(errno)));
+        return Utils::last_error();
 
     if (stat(path.c_str(), &dir_stat) != 0)
-        throw std::runtime_error(std::format("get_local_dir: {}", std::strerror(errno)));
-
-    Utils::struct_stat_to_proto(&dir_stat, dir_proto);
+    {
+        Utils::Error error = Utils::last_error();
+        closedir(dir);
+        return error;
+    }
 
     errno = 0; // does not work without this line \('_')/
     while ((entry = readdir(dir)) != nullptr)
-        dir_proto.add_dir_list(entry->d_name);
+        entries.push_back(entry->d_name);
 
-    if (errno != 0)
-        throw std::runtime_error(std::format("get_local_dir: {}", std::strerror(errno)));
+    Utils::Error error = Utils::last_error();
+    closedir(dir);
+    if (error.code != 0)
+        return error;
 
-    dir_proto.SerializeToString(&result);
+    std::string result = StatRecord::make(dir_stat, compression, entries);
 
     o_file.open(meta_dir_file);
     if (!o_file.is_open())
@@ -100,6 +190,20 @@ std::string FileMngr::get_local_dir(const std::string& path, const std::string&
     return result;
 } // get_local_dir
 
+int FileMngr::get_dir_compression(const std::string& meta_path)
+{
+    std::ifstream i_file(meta_path + "/.this");
+    if (!i_file)
+        return CompressionCode::Type::NONE;
+
+    // the header is enough, the listing is not read
+    std::string header(sizeof(StatRecord::Header), '\0');
+    i_file.read(header.data(), header.size());
+    if (!StatRecord::is_valid(header))
+        return CompressionCode::Type::NONE;
+    return StatRecord::get_compression(header);
+}
+
 int FileMngr::rmdir_recursive(const char* path)
 {
     struct dirent *entry;
@@ -130,178 +234,136 @@ int FileMngr::rmdir_recursive(const char* path)
     return res;
 } // rmdir_recursive
 
-void FileMngr::remove_local_file(const std::string& path)
+Utils::Status FileMngr::remove_local_file(const std::string& path)
 {
-    int res = unlink(path.c_str());
-    if (res != 0)
-        throw std::runtime_error(std::format("remove_local_dir: {}", std::strerror(errno)));
+    if (unlink(path.c_str()) != 0)
+        return Utils::last_error();
+    return {};
 }
 
-void FileMngr::remove_local_dir(const std::string& path, const std::string& meta_path)
+Utils::Status FileMngr::remove_local_dir(const std::string& path, const std::string& meta_path)
 {
+    if (rmdir(path.c_str()) != 0)
+        return Utils::last_error();
+    if (rmdir_recursive(meta_path.c_str()) != 0)
+        return Utils::last_error();
+    return {};
+}
 
-    int res = rmdir(path.c_str());
-    if (res != 0)
-        throw std::runtime_error(std::format("remove_local_dir: {}", std::strerror(errno)));
-    res = rmdir_recursive(meta_path.c_str());
-    if (res != 0)
-        throw std::runtime_error(std::format("remove_local_dir: {}", std::strerror(errno)));
+Utils::Status FileMngr::remove_local_entry(const std::string& path)
+{
+    if (rmdir(path.c_str()) != 0)
+        return Utils::last_error();
+    return {};
 }
 
-std::string FileMngr::chmod_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv)
+Utils::Result<std::string> FileMngr::chmod_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv)
 {
-    try 
-    {
-        std::string content = get_local_file(path);
-
-        Stat proto;
-        proto.ParseFromString(content);
-        mode_t new_mode = Utils::get_int_from_byte_array(argv[0]);
-        proto.set_mode(new_mode);
-        proto.SerializeToString(&content);
-
-        std::ofstream o_file(path);
-        if (o_file.is_open())
-            o_file << content;
-        else
-            throw std::runtime_error(std::strerror(errno));
-        
-        return content;
-    }
-    catch (std::exception& e)
-    {   
-        throw std::runtime_error(std::format("chmod_object: {}", e.what()));
-    }
+    if (argv.size() < 1 || argv[0].size() != 4)
+        return Utils::Error {EINVAL};
+    mode_t new_mode = Utils::get_int_from_byte_array(argv[0]);
+    return patch_record(path, [new_mode](std::string& content) {
+        StatRecord::set_mode(content, new_mode);
+    });
 }
 
-std::string FileMngr::chown_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv)
+Utils::Result<std::string> FileMngr::chown_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv)
 {
-    try 
-    {
-        std::string content = get_local_file(path);
-
-        Stat proto;
-        proto.ParseFromString(content);
-        uid_t new_uid = Utils::get_int_from_byte_array(argv[0]);
-        gid_t new_gid = Utils::get_int_from_byte_array(argv[1]);
-        proto.set_uid(new_uid);
-        proto.set_gid(new_gid);
-        proto.SerializeToString(&content);
-
-        std::ofstream o_file(path);
-        if (o_file.is_open())
-            o_file << content;
-        else
-            throw std::runtime_error(std::strerror(errno));
-        
-        return content;
-    }
-    catch (std::exception& e)
-    {   
-        throw std::runtime_error(std::format("chmod_object: {}", e.what()));
-    }
+    if (argv.size() < 2 || argv[0].size() != 4 || argv[1].size() != 4)
+        return Utils::Error {EINVAL};
+    uid_t new_uid = Utils::get_int_from_byte_array(argv[0]);
+    gid_t new_gid = Utils::get_int_from_byte_array(argv[1]);
+    return patch_record(path, [new_uid, new_gid](std::string& content) {
+        StatRecord::set_owner(content, new_uid, new_gid);
+    });
+}
 
+Utils::Result<std::string> FileMngr::chsize_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv)
+{
+    if (argv.size() < 1 || argv[0].size() != 8)
+        return Utils::Error {EINVAL};
+    off_t new_size = Utils::get_int64_from_byte_array(argv[0]);
+    return patch_record(path, [new_size](std::string& content) {
+        StatRecord::set_size(content, new_size);
+    });
 }
 
-std::string FileMngr::chsize_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv)
+Utils::Result<std::string> FileMngr::extend_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv)
 {
-    try 
-    {
-        std::string content = get_local_file(path);
-
-        Stat proto;
-        proto.ParseFromString(content);
-        off_t new_size = Utils::get_int64_from_byte_array(argv[0]);
-        proto.set_size(new_size);
-        proto.SerializeToString(&content);
-
-        std::ofstream o_file(path);
-        if (o_file.is_open())
-            o_file << content;
-        else
-            throw std::runtime_error(std::strerror(errno));
-        
-        return content;
-    }
-    catch (std::exception& e)
-    {   
-        throw std::runtime_error(std::format("chmod_object: {}", e.what()));
-    }
+    if (argv.size() < 1 || argv[0].size() != 8)
+        return Utils::Error {EINVAL};
+    off_t new_size = Utils::get_int64_from_byte_array(argv[0]);
+    return patch_record(path, [new_size](std::string& content) {
+        if (StatRecord::get_size(content) < new_size)
+            StatRecord::set_size(content, new_size);
+    });
+}
 
+Utils::Result<std::string> FileMngr::compress_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv)
+{
+    if (argv.size() < 1 || argv[0].size() != 4)
+        return Utils::Error {EINVAL};
+    int new_compression = Utils::get_int_from_byte_array(argv[0]);
+    if (CompressionCode::from_byte(new_compression) == CompressionCode::Type::UNKNOWN)
+        return Utils::Error {EINVAL};
+    return patch_record(path, [new_compression](std::string& content) {
+        StatRecord::set_compression(content, new_compression);
+    });
 }
 
-std::string FileMngr::rename_object(const std::string& path, const std::string& meta_dir, const std::vector<std::vector<uint8_t>>& argv)
+Utils::Result<std::string> FileMngr::rename_object(const std::string& path, const std::string& meta_dir, const std::vector<std::vector<uint8_t>>& argv)
 {
+    if (argv.size() < 1)
+        return Utils::Error {EINVAL};
     std::string new_path = meta_dir + Utils::get_string_from_byte_array(argv[0]);
     std::string old_path = meta_dir + path;
-    int res = rename(old_path.c_str(), new_path.c_str());
-    if (res != 0)
-        throw std::runtime_error(std::format("rename_object: {}", std::strerror(errno)));
+    if (rename(old_path.c_str(), new_path.c_str()) != 0)
+        return Utils::last_error();
     return Utils::get_string_from_byte_array(argv[0]);
 }
 
-std::string FileMngr::update_local_object(const std::string& path, const std::string& file_metadata_dir, const std::string& dir_metadata_dir, const UpdateCommand& command, bool is_file)
+Utils::Result<std::string> FileMngr::update_local_object(const std::string& path, const std::string& file_metadata_dir, const std::string& dir_metadata_dir, const UpdateCommand& command, bool is_file)
 {
-    try {
-        std::string file_meta = file_metadata_dir + path;
-        std::string dir_meta = dir_metadata_dir + path;
-        std::string content;
-        switch (UpdateCode::from_byte(command.opcode))
+    std::string file_meta = file_metadata_dir + path;
+    std::string dir_meta = dir_metadata_dir + path;
+    switch (UpdateCode::from_byte(command.opcode))
+    {
+        case UpdateCode::Type::CHMOD:
+            return chmod_object(is_file ? file_meta : dir_meta + "/.this", command.argv);
+        case UpdateCode::Type::CHOWN:
+            return chown_object(is_file ? file_meta : dir_meta + "/.this", command.argv);
+        case UpdateCode::Type::RENAME:
         {
-            case UpdateCode::Type::CHMOD:
-                if (is_file)
-                    content = chmod_object(file_meta, command.argv);
-                else 
-                    content = chmod_object(dir_meta + "/.this", command.argv);
-                break;
-            case UpdateCode::Type::CHOWN:
-                if (is_file)
-                    content = chown_object(file_meta, command.argv);
-                else 
-                    content = chown_object(dir_meta + "/.this", command.argv);
-                break;
-            case UpdateCode::Type::RENAME:
-                content = rename_object(path, file_metadata_dir, command.argv);
-                if (!is_file)
-                    rename_object(path, dir_metadata_dir, command.argv);    
-                break;
-            case UpdateCode::Type::CHSIZE:
-                if (is_file)
-                    content = chsize_object(file_meta, command.argv);
-                break;
-            default:
-                throw std::runtime_error(std::format("Unknown update command: {}", command.opcode));
+            Utils::Result<std::string> renamed = rename_object(path, file_metadata_dir, command.argv);
+            if (renamed && !is_file)
+            {
+                Utils::Result<std::string> moved = rename_object(path, dir_metadata_dir, command.argv);
+                if (!moved)
+                    return moved;
+            }
+            return renamed;
         }
-
-        return content;
-    }
-    catch (std::exception& e)
-    {
-        throw std::runtime_error(std::format("update_local_file: {}", e.what()));
+        case UpdateCode::Type::CHSIZE:
+            if (!is_file)
+                return Utils::Error {EISDIR};
+            return chsize_object(file_meta, command.argv);
+        case UpdateCode::Type::EXTEND:
+            if (!is_file)
+                return Utils::Error {EISDIR};
+            return extend_object(file_meta, command.argv);
+        case UpdateCode::Type::COMPRESS:
+            return compress_object(is_file ? file_meta : dir_meta + "/.this", command.argv);
+        default:
+            return Utils::Error {EINVAL};
     }
 }
 
-
-std::string FileMngr::update_local_file(const std::string& path, const std::string& file_metadata_dir, const UpdateCommand& command)
+Utils::Result<std::string> FileMngr::update_local_file(const std::string& path, const std::string& file_metadata_dir, const UpdateCommand& command)
 {
-    try 
-    {
-        return update_local_object(path, file_metadata_dir, "", command, true);
-    }
-    catch (std::exception& e)
-    {
-        throw std::runtime_error(e.what());
-    }
+    return update_local_object(path, file_metadata_dir, "", command, true);
 }
 
-std::string FileMngr::update_local_dir(const std::string& path, const std::string& file_metadata_dir, const std::string& dir_metadata_dir, const UpdateCommand& command)
+Utils::Result<std::string> FileMngr::update_local_dir(const std::string& path, const std::string& file_metadata_dir, const std::string& dir_metadata_dir, const UpdateCommand& command)
 {
-    try 
-    {
-        return update_local_object(path, file_metadata_dir, dir_metadata_dir, command, false);
-    }
-    catch (std::exception& e)
-    {
-        throw std::runtime_error(e.what());
-    }
-}
\ No newline at end of file
+    return update_local_object(path, file_metadata_dir, dir_metadata_dir, command, false);
+}
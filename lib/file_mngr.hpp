@@ -3,26 +3,37 @@
 
 #include "utils.hpp"
 #include "net_protocol.hpp"
+#include "stat_record.hpp"
+#include "result.hpp"
 #include <dirent.h>
 
+// The functions on the request path of the cache server return their errno (Utils::Result)
+// instead of throwing it.
 namespace FileMngr {
-    std::string set_local_file(const std::string& path, mode_t mode);
-    void set_local_dir(const std::string& path, const std::string& meta_path, mode_t mode);
+    Utils::Result<std::string> set_local_file(const std::string& path, mode_t mode, int compression=0);
+    Utils::Status set_local_dir(const std::string& path, const std::string& meta_path, mode_t mode);
+    // the entry of a directory whose metadata is on another cache server, only listed here
+    Utils::Status set_local_entry(const std::string& path);
+    Utils::Result<std::string> put_local_file(const std::string& path, const std::string& content);
     
-    std::string get_local_file(const std::string& path);
-    std::string get_local_dir(const std::string& path, const std::string& meta_path, bool update_dir_list=false);
+    Utils::Result<std::string> get_local_file(const std::string& path);
+    Utils::Result<std::string> get_local_dir(const std::string& path, const std::string& meta_path, bool update_dir_list=false);
+    int get_dir_compression(const std::string& meta_path);
 
     int rmdir_recursive(const char* path);
-    void remove_local_file(const std::string& path);
-    void remove_local_dir(const std::string& path, const std::string& meta_path);
+    Utils::Status remove_local_file(const std::string& path);
+    Utils::Status remove_local_dir(const std::string& path, const std::string& meta_path);
+    Utils::Status remove_local_entry(const std::string& path);
 
-    std::string chmod_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv);
-    std::string chown_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv);
-    std::string chsize_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv);
-    std::string rename_object(const std::string& path, const std::string& dir, const std::vector<std::vector<uint8_t>>& argv);    
-    std::string update_local_object(const std::string& path, const std::string& file_metadata_dir, const std::string& dir_metadata_dir, const UpdateCommand& command, bool is_file);
-    std::string update_local_file(const std::string& path, const std::string& file_metadata_dir, const UpdateCommand& command);
-    std::string update_local_dir(const std::string& path, const std::string& file_metadata_dir, const std::string& dir_metadata_dir, const UpdateCommand& command);
+    Utils::Result<std::string> chmod_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv);
+    Utils::Result<std::string> chown_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv);
+    Utils::Result<std::string> chsize_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv);
+    Utils::Result<std::string> extend_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv);
+    Utils::Result<std::string> compress_object(const std::string& path, const std::vector<std::vector<uint8_t>>& argv);
+    Utils::Result<std::string> rename_object(const std::string& path, const std::string& dir, const std::vector<std::vector<uint8_t>>& argv);
+    Utils::Result<std::string> update_local_object(const std::string& path, const std::string& file_metadata_dir, const std::string& dir_metadata_dir, const UpdateCommand& command, bool is_file);
+    Utils::Result<std::string> update_local_file(const std::string& path, const std::string& file_metadata_dir, const UpdateCommand& command);
+    Utils::Result<std::string> update_local_dir(const std::string& path, const std::string& file_metadata_dir, const std::string& dir_metadata_dir, const UpdateCommand& command);
 }
 
 #endif
\ No newline at end of file
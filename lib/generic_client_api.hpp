@@ -11,6 +11,8 @@
 // #endif
 // #include <spdlog/spdlog.h>
 #include "net_protocol.hpp"
+#include "metrics.hpp"
+#include "shm_channel.hpp"
 
 using asio::ip::tcp;
 
@@ -71,20 +73,55 @@ protected:
     std::string port;
     std::vector<std::thread> thread_pool; 
     asio::executor_work_guard<asio::io_context::executor_type> work_guard;
+    Metrics::OperationTable* metrics; // round trips to the server
+    std::unique_ptr<ShmChannel::Client> channel; // nullptr when the server is on another host
+
+    // a server advertises its shared memory channel in the reply to INIT ("shm <address>"),
+    // opening it fails from another host
+    void open_channel(const Packet& response)
+    {
+        std::string message = Utils::get_string_from_byte_array(response.message);
+        if (message.rfind("shm ", 0) != 0)
+            return;
+
+        try {
+            channel = std::make_unique<ShmChannel::Client>(message.substr(4));
+            SPDLOG_INFO("Using the shared memory channel of the server.");
+        }
+        catch (std::exception& e)
+        {
+            SPDLOG_DEBUG("No shared memory channel: {}", e.what());
+        }
+    }
         
     asio::awaitable<void> send_request_async(const Packet& request, Packet& response)
     {
         tcp::socket socket = tcp::socket(context);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t bytes_sent = 0, bytes_received = 0;
         try {
             std::vector<uint8_t> buffer; // buffer to store incoming data
+            bytes_sent = request.to_buffer(buffer);
+
+            // a server on this host is reached through its shared memory channel when it has a free slot
+            std::vector<uint8_t> reply;
+            if (channel && co_await channel->call(buffer, reply))
+            {
+                if (reply.size() < Packet::header_size)
+                    throw std::runtime_error("Server failed to respond.");
+                response.from_buffer(reply.data(), reply.size());
+                metrics->record(request.opcode, start, reply.size(), bytes_sent,
+                    response.rescode != ResultCode::Type::SUCCESS);
+                co_return;
+            }
+
             tcp::resolver::results_type endpoints = 
                 co_await resolver.async_resolve(address, port, asio::use_awaitable);
             co_await asio::async_connect(socket, endpoints, asio::use_awaitable);
             
-            request.to_buffer(buffer);
             co_await asio::async_write(socket, asio::buffer(buffer), asio::use_awaitable);
             
-            size_t bytes_received = co_await read_socket_async(socket, response);
+            bytes_received = co_await read_socket_async(socket, response);
             // socket.async_read_some(asio::buffer(buffer),
             //     [this, self] (std::error_code error, size_t bytes_transferred)
             //     {
@@ -97,21 +134,40 @@ protected:
         catch (std::exception& e)
         {
             socket.close();
+            metrics->record(request.opcode, start, bytes_received, bytes_sent, true);
             throw std::runtime_error(std::format("send_request_async: {}", e.what()));
         }
 
+        metrics->record(request.opcode, start, bytes_received, bytes_sent,
+            response.rescode != ResultCode::Type::SUCCESS);
         co_return;
     }
 
+    // runs the coroutine on the threads of the client and hands its result to done there, or
+    // failure if it threw; nobody waits for it, so the coroutine owns what it refers to (a
+    // lambda capturing by value)
+    template <typename T, typename Coroutine>
+    void spawn_request(Coroutine coroutine, std::function<void(T)> done, T failure)
+    {
+        asio::co_spawn(
+            context,
+            std::move(coroutine),
+            [done = std::move(done), failure = std::move(failure)] (std::exception_ptr error, T result) {
+                done(error ? failure : std::move(result));
+            }
+        );
+    }
+
 public:
     GenericClient(const GenericClient&) = delete;
     GenericClient& operator= (const GenericClient&) = delete;
 
-    GenericClient() : GenericClient(1) {} // default thread count 1
-    GenericClient(int thread_count)
-        : resolver(context) 
+    GenericClient(Metrics::OperationTable* metrics) : GenericClient(1, metrics) {} // default thread count 1
+    GenericClient(int thread_count, Metrics::OperationTable* metrics)
+        : thread_count(thread_count)
+        , resolver(context) 
         , work_guard(asio::make_work_guard(context))
-        , thread_count(thread_count)
+        , metrics(metrics)
     {
         for (int i = 0; i < thread_count; i++)
         {
@@ -157,6 +213,7 @@ public:
             {
                 case ResultCode::Type::SUCCESS:
                     SPDLOG_INFO("Connected successfully!");
+                    open_channel(response);
                     break;                
                 default:
                     throw std::runtime_error(std::format("Response code is not SUCCESS: {}", response.rescode));
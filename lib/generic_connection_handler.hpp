@@ -6,10 +6,8 @@
 #define ASIO_HAS_STD_COROUTINE // c++20 coroutines needed
 #include <asio.hpp>
 
-#ifndef SPDLOG_ACTIVE_LEVEL
-#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
-#endif
-#include <spdlog/spdlog.h>
+#include "logging.hpp"
+#include "metrics.hpp"
 
 using asio::ip::tcp;
 
@@ -22,8 +20,11 @@ protected:
     std::vector<uint8_t> buffer = std::vector<uint8_t>(Packet::max_packet_size); // buffer to store incoming data
     std::vector<uint8_t> packet_buffer; // buffer for dynamic buffering
     size_t expected_size = 0; // expected packet bytes to be received
+    Metrics::OperationTable* metrics; // shared by the connections of a server
 
     virtual void handle_request(const Packet& request, Packet& response) = 0;
+    // the response is sent, a handler that keeps the connection for something else takes it here
+    virtual void handle_written() {}
     
     void read_socket_async()
     {
@@ -54,12 +55,15 @@ protected:
                         if (packet_buffer.size() < expected_size)
                             break;
                         
+                        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
                         Packet request(packet_buffer.data(), packet_buffer.size());
                         // std::cout << request.to_string() << std::endl;
                         Packet response;
                         handle_request(request, response);
 
-                        response.to_buffer(buffer);
+                        size_t response_size = response.to_buffer(buffer);
+                        metrics->record(request.opcode, start, expected_size, response_size,
+                            response.rescode != ResultCode::Type::SUCCESS);
                         self->write_socket_async();
                         return;
                     }
@@ -86,14 +90,16 @@ protected:
                     return;
                 }
 
-                SPDLOG_INFO("Connection handled successfully!");
+                SPDLOG_TRACE("Connection handled successfully!");
+                handle_written();
             });
     }
 
 public:
-    GenericConnectionHandler(asio::io_context& context)
+    GenericConnectionHandler(asio::io_context& context, Metrics::OperationTable* metrics)
         : context(context)
         , socket(context)
+        , metrics(metrics)
     {}
     virtual ~GenericConnectionHandler() { 
         socket.close(); 
@@ -103,11 +109,26 @@ public:
 
     tcp::socket& get_socket() { return socket; }
 
+    // serves a request that did not come through the socket (a shared memory channel),
+    // concurrent calls may share the handler
+    size_t handle_packet(const uint8_t* data, size_t size, std::vector<uint8_t>& response_buffer)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Packet request(data, size);
+        Packet response;
+        handle_request(request, response);
+
+        size_t response_size = response.to_buffer(response_buffer);
+        metrics->record(request.opcode, start, size, response_size,
+            response.rescode != ResultCode::Type::SUCCESS);
+        return response_size;
+    }
+
 
     void start() 
     {
         tcp::endpoint remote_endpoint = socket.remote_endpoint();
-        SPDLOG_INFO("New connection from {}:{}.",
+        LOG_RATE_LIMITED(SPDLOG_LEVEL_DEBUG, 10, "New connection from {}:{}.",
             remote_endpoint.address().to_string(), remote_endpoint.port());
         read_socket_async();
     }
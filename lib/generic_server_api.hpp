@@ -6,10 +6,7 @@
 #define ASIO_HAS_STD_COROUTINE // c++20 coroutines needed
 #include <asio.hpp>
 
-#ifndef SPDLOG_ACTIVE_LEVEL
-#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
-#endif
-#include <spdlog/spdlog.h>
+#include "logging.hpp"
 
 using asio::ip::tcp;
 
@@ -0,0 +1,68 @@
+#include "hole_map.hpp"
+
+using namespace StorageAPI;
+
+const size_t HoleMap::max_files = 16384;
+
+uint64_t& HoleMap::get_bucket(const std::string& path)
+{
+    return epochs[std::hash<std::string>{}(path) % epoch_buckets];
+}
+
+bool HoleMap::is_hole(const std::string& path, size_t stripe)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = holes.find(path);
+    return it != holes.end() && it->second.count(stripe) != 0;
+}
+
+uint64_t HoleMap::get_epoch(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return get_bucket(path);
+}
+
+void HoleMap::add_hole(const std::string& path, size_t stripe, uint64_t epoch)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (get_bucket(path) != epoch)
+        return;
+
+    auto [it, inserted] = holes.try_emplace(path);
+    it->second.insert(stripe);
+    if (!inserted)
+        return;
+
+    generations[path] = next_generation;
+    ages.emplace(next_generation++, path);
+    if (holes.size() > max_files)
+    {
+        std::string oldest = ages.begin()->second;
+        ages.erase(ages.begin());
+        holes.erase(oldest);
+        generations.erase(oldest);
+    }
+}
+
+uint64_t HoleMap::remove_hole(const std::string& path, size_t stripe)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = holes.find(path);
+    if (it != holes.end())
+        it->second.erase(stripe);
+    return ++get_bucket(path);
+}
+
+void HoleMap::forget(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    get_bucket(path)++;
+
+    auto it = generations.find(path);
+    if (it == generations.end())
+        return;
+
+    ages.erase({it->second, path});
+    generations.erase(it);
+    holes.erase(path);
+}
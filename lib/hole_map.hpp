@@ -0,0 +1,56 @@
+#ifndef HOLE_MAP_HPP
+#define HOLE_MAP_HPP
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+namespace StorageAPI {
+    // Stripes the storage manager knows to be holes (never written, or punched
+    // because they only held zeros), so a read fills them with zeros without
+    // asking a node. It is learned from the writes and reads going through the
+    // manager and is not persistent: a stripe that is not in the map is simply
+    // asked for. One instance is shared by all the connection handlers.
+    //
+    // A hole seen by a read may be written while the reply is on its way. A
+    // hole is only added if the epoch of its path did not move since the nodes
+    // were asked, and a write moves it (remove_hole) both before it sends the
+    // stripes and once the nodes stored them: a read that overlapped the write
+    // either comes back after the second move and is ignored, or added its hole
+    // before it and has it removed.
+    class HoleMap {
+    private:
+        static const size_t max_files; // the least recently added files are forgotten past this
+        static const size_t epoch_buckets = 1024; // paths share epochs, a collision only loses a hole
+
+        std::mutex mutex;
+        std::unordered_map<std::string, std::set<size_t>> holes; // by path, stripe indices
+        std::set<std::pair<uint64_t, std::string>> ages; // (generation, path), oldest first
+        std::unordered_map<std::string, uint64_t> generations;
+        uint64_t next_generation = 0;
+        std::array<uint64_t, epoch_buckets> epochs{};
+
+        uint64_t& get_bucket(const std::string& path);
+
+    public:
+        HoleMap(const HoleMap&) = delete;
+        HoleMap& operator= (const HoleMap&) = delete;
+
+        HoleMap() = default;
+
+        bool is_hole(const std::string& path, size_t stripe);
+        // taken before asking the nodes about the stripes of path
+        uint64_t get_epoch(const std::string& path);
+        // ignored if path was written or removed after epoch was taken
+        void add_hole(const std::string& path, size_t stripe, uint64_t epoch);
+        // called before a stripe is written and again once it is, returns the new epoch of path
+        uint64_t remove_hole(const std::string& path, size_t stripe);
+        // the file was removed, nothing is known about it anymore
+        void forget(const std::string& path);
+    };
+}
+
+#endif
@@ -0,0 +1,132 @@
+#include "inode_table.hpp"
+#include <mutex>
+
+using namespace CacheAPI;
+
+const uint64_t InodeTable::root = 1;
+
+InodeTable::InodeTable()
+    : next_inode(root + 1)
+{
+    // the kernel never looks the root up nor forgets it
+    nodes[root] = Node {"/", 1};
+    inodes["/"] = root;
+}
+
+std::string InodeTable::get_path(uint64_t inode) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = nodes.find(inode);
+    if (it == nodes.end())
+        return "";
+    return it->second.path;
+}
+
+uint64_t InodeTable::find(const std::string& path) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = inodes.find(path);
+    if (it == inodes.end())
+        return 0;
+    return it->second;
+}
+
+std::vector<std::string> InodeTable::get_paths() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::vector<std::string> paths;
+    paths.reserve(inodes.size());
+    for (const auto& [path, inode] : inodes)
+    {
+        if (inode != root)
+            paths.push_back(path);
+    }
+    return paths;
+}
+
+uint64_t InodeTable::lookup(const std::string& path)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = inodes.find(path);
+    if (it != inodes.end())
+    {
+        nodes[it->second].lookups++;
+        return it->second;
+    }
+
+    uint64_t inode = next_inode++;
+    nodes[inode] = Node {path, 1};
+    inodes[path] = inode;
+    return inode;
+}
+
+void InodeTable::forget(uint64_t inode, uint64_t lookups)
+{
+    if (inode == root)
+        return;
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = nodes.find(inode);
+    if (it == nodes.end())
+        return;
+    if (it->second.lookups > lookups)
+    {
+        it->second.lookups -= lookups;
+        return;
+    }
+
+    if (!it->second.path.empty())
+        inodes.erase(it->second.path);
+    nodes.erase(it);
+}
+
+void InodeTable::rename(const std::string& old_path, const std::string& new_path)
+{
+    if (old_path == new_path)
+        return;
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    // the object replaced at new_path keeps its inode without a path
+    auto replaced = inodes.find(new_path);
+    if (replaced != inodes.end())
+    {
+        nodes[replaced->second].path.clear();
+        inodes.erase(replaced);
+    }
+
+    // the table holds the paths the kernel knows of, a scan costs less than keeping them sorted
+    std::string prefix = old_path + "/";
+    std::vector<std::pair<std::string, uint64_t>> moved;
+    for (const auto& [path, inode] : inodes)
+    {
+        if (path == old_path)
+            moved.emplace_back(new_path, inode);
+        else if (path.starts_with(prefix))
+            moved.emplace_back(new_path + path.substr(old_path.length()), inode);
+    }
+
+    for (const auto& [path, inode] : moved)
+    {
+        inodes.erase(nodes[inode].path);
+        nodes[inode].path = path;
+    }
+    for (const auto& [path, inode] : moved)
+        inodes[path] = inode;
+}
+
+void InodeTable::remove(const std::string& path)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = inodes.find(path);
+    if (it == inodes.end())
+        return;
+    nodes[it->second].path.clear();
+    inodes.erase(it);
+}
+
+std::string InodeTable::get_child_path(const std::string& parent, const std::string& name)
+{
+    if (parent == "/")
+        return parent + name;
+    return parent + "/" + name;
+}
@@ -0,0 +1,56 @@
+#ifndef INODE_TABLE_HPP
+#define INODE_TABLE_HPP
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace CacheAPI {
+    // The inode numbers the FUSE client gives the kernel for the paths the cache
+    // servers know the objects by. The kernel asks by inode number and counts its
+    // lookups of each, an inode is kept until the kernel forgets as many as it was
+    // given; the numbers are never reused. Inode 1 is the root.
+    //
+    // The inodes of the cache servers are not used: they are those of the files on
+    // a server, the same number can come from two of them.
+    class InodeTable {
+    private:
+        struct Node {
+            std::string path; // "" once the path was removed
+            uint64_t lookups;
+        };
+
+        mutable std::shared_mutex mutex;
+        std::unordered_map<uint64_t, Node> nodes;
+        std::unordered_map<std::string, uint64_t> inodes; // by path
+        uint64_t next_inode;
+
+    public:
+        static const uint64_t root;
+
+        InodeTable(const InodeTable&) = delete;
+        InodeTable& operator= (const InodeTable&) = delete;
+
+        InodeTable();
+
+        // "" when the inode is unknown or its path was removed
+        std::string get_path(uint64_t inode) const;
+        // the inode of path without counting a lookup, 0 when the kernel does not know it
+        uint64_t find(const std::string& path) const;
+        // the paths of all the inodes the kernel knows of but the root
+        std::vector<std::string> get_paths() const;
+        // the inode of path, a new one the first time, and one more lookup of it
+        uint64_t lookup(const std::string& path);
+        void forget(uint64_t inode, uint64_t lookups);
+        // the paths under old_path move along
+        void rename(const std::string& old_path, const std::string& new_path);
+        // the inode stays until forgotten, it no longer has a path
+        void remove(const std::string& path);
+
+        static std::string get_child_path(const std::string& parent, const std::string& name);
+    };
+}
+
+#endif
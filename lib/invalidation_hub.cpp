@@ -0,0 +1,104 @@
+#include "invalidation_hub.hpp"
+#include "metrics.hpp"
+#include "logging.hpp"
+#include "utils.hpp"
+
+using namespace CacheAPI;
+
+static Metrics::Counter invalidations_sent("cache_server_invalidations_total", "INVALIDATE packets sent to the watching clients.");
+static Metrics::Counter watchers_dropped("cache_server_watchers_dropped_total", "Watching clients disconnected for falling behind.");
+
+const size_t InvalidationHub::max_pending = 4096;
+
+// private
+void InvalidationHub::write_next(uint32_t id, std::shared_ptr<Watcher> watcher)
+{
+    asio::async_write(watcher->socket, asio::buffer(watcher->pending.front()),
+        [this, id, watcher] (std::error_code error, size_t) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (error)
+            {
+                SPDLOG_DEBUG("Watcher {} left: {}", id, error.message());
+                remove(id);
+                return;
+            }
+
+            watcher->pending.pop_front();
+            if (!watcher->pending.empty())
+                write_next(id, watcher);
+        });
+}
+
+void InvalidationHub::remove(uint32_t id)
+{
+    auto it = watchers.find(id);
+    if (it == watchers.end())
+        return;
+
+    asio::error_code error;
+    it->second->socket.close(error);
+    watchers.erase(it);
+}
+
+// public
+uint32_t InvalidationHub::make_id()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return next_id++;
+}
+
+void InvalidationHub::watch(uint32_t id, tcp::socket socket)
+{
+    auto watcher = std::make_shared<Watcher>(std::move(socket));
+    std::lock_guard<std::mutex> lock(mutex);
+    watchers[id] = watcher;
+
+    watcher->socket.async_read_some(asio::buffer(&watcher->read_byte, 1),
+        [this, id] (std::error_code, size_t) {
+            // the client left, or sent something it should not have
+            std::lock_guard<std::mutex> lock(mutex);
+            remove(id);
+        });
+    SPDLOG_DEBUG("Watcher {} connected, {} watching.", id, watchers.size());
+}
+
+void InvalidationHub::publish(const std::string& key, InvalidationCode::Type code, uint32_t origin)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (watchers.empty() || (watchers.size() == 1 && watchers.contains(origin)))
+        return;
+
+    CachePacket packet;
+    packet.id = Utils::generate_id();
+    packet.opcode = OperationCode::to_byte(OperationCode::Type::INVALIDATE);
+    packet.rescode = ResultCode::to_byte(ResultCode::Type::SUCCESS);
+    packet.flags = InvalidationCode::to_byte(code);
+    packet.key_len = key.length();
+    packet.key = Utils::get_byte_array_from_string(key);
+    std::vector<uint8_t> buffer;
+    packet.to_buffer(buffer);
+
+    std::vector<uint32_t> behind;
+    for (auto& [id, watcher] : watchers)
+    {
+        if (id == origin)
+            continue;
+        if (watcher->pending.size() >= max_pending)
+        {
+            behind.push_back(id);
+            continue;
+        }
+
+        watcher->pending.push_back(buffer);
+        invalidations_sent.add();
+        if (watcher->pending.size() == 1)
+            write_next(id, watcher);
+    }
+
+    for (uint32_t id : behind)
+    {
+        SPDLOG_WARN("Watcher {} fell behind, disconnecting it.", id);
+        watchers_dropped.add();
+        remove(id);
+    }
+}
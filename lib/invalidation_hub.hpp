@@ -0,0 +1,62 @@
+#ifndef INVALIDATION_HUB_HPP
+#define INVALIDATION_HUB_HPP
+
+#define ASIO_STANALONE // non-boost version
+#define ASIO_NO_DEPRECATED // no need for deprecated stuff
+#define ASIO_HAS_STD_COROUTINE // c++20 coroutines needed
+#include <asio.hpp>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "net_protocol.hpp"
+
+using asio::ip::tcp;
+
+namespace CacheAPI {
+    // The clients watching the cache server, so the kernels of the other clients can
+    // keep what they cached of an object until it changes. A client sends WATCH, gets
+    // its watcher id and leaves the connection open; from then on it is sent an
+    // INVALIDATE packet for every object changed by a request that does not carry its
+    // id (CachePacket::message, set by CacheClient), its own changes are already in
+    // its kernel.
+    //
+    // The packets go out in the order of the changes, a watcher that falls behind by
+    // max_pending packets is disconnected: it drops everything when it watches again.
+    // One instance is shared by all the connection handlers.
+    class InvalidationHub {
+    private:
+        static const size_t max_pending;
+
+        struct Watcher {
+            tcp::socket socket;
+            std::deque<std::vector<uint8_t>> pending; // the first one is being written
+            uint8_t read_byte; // the client sends nothing, the read ends when it leaves
+
+            Watcher(tcp::socket socket) : socket(std::move(socket)) {}
+        };
+
+        std::mutex mutex;
+        std::unordered_map<uint32_t, std::shared_ptr<Watcher>> watchers;
+        uint32_t next_id = 1; // 0 is no watcher
+
+        // the mutex is held
+        void write_next(uint32_t id, std::shared_ptr<Watcher> watcher);
+        void remove(uint32_t id);
+
+    public:
+        InvalidationHub(const InvalidationHub&) = delete;
+        InvalidationHub& operator= (const InvalidationHub&) = delete;
+
+        InvalidationHub() = default;
+
+        uint32_t make_id();
+        // the connection the WATCH request came on, once answered
+        void watch(uint32_t id, tcp::socket socket);
+        // to every watcher but origin (0 when the client does not watch)
+        void publish(const std::string& key, InvalidationCode::Type code, uint32_t origin);
+    };
+}
+
+#endif
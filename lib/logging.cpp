@@ -0,0 +1,222 @@
+#include "logging.hpp"
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <thread>
+
+namespace {
+    // The messages waiting to be written, a bounded ring with a sequence number per
+    // slot (Vyukov): any thread reserves a slot with one compare and swap on tail, the
+    // writer thread takes them in order from head.
+    class RingSink : public spdlog::sinks::sink {
+    private:
+        static constexpr size_t payload_size = 480; // a longer message is cut and ends with "..."
+        static constexpr std::chrono::milliseconds flush_timeout{1000};
+
+        struct Slot {
+            std::atomic<size_t> sequence;
+            spdlog::level::level_enum level;
+            spdlog::log_clock::time_point time;
+            spdlog::source_loc source;
+            size_t thread_id;
+            spdlog::string_view_t logger_name; // the logger outlives the sink
+            uint16_t length;
+            char payload[payload_size];
+        };
+
+        std::unique_ptr<Slot[]> slots;
+        size_t mask;
+        std::atomic<size_t> tail{0};
+        size_t head = 0; // only the writer thread moves it
+        std::atomic<size_t> written{0}; // head, for flush
+        std::atomic<size_t> dropped{0};
+        std::atomic<size_t> truncated{0};
+        std::atomic<bool> stopping{false};
+        std::shared_ptr<spdlog::sinks::sink> output;
+        std::thread thread;
+
+        // false when the ring is empty
+        bool write_one()
+        {
+            Slot& slot = slots[head & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+                return false;
+
+            spdlog::details::log_msg message(slot.time, slot.source, slot.logger_name, slot.level,
+                spdlog::string_view_t(slot.payload, slot.length));
+            message.thread_id = slot.thread_id;
+            output->log(message);
+
+            slot.sequence.store(head + mask + 1, std::memory_order_release);
+            head++;
+            written.store(head, std::memory_order_release);
+            return true;
+        }
+
+        void report_losses()
+        {
+            size_t count = dropped.exchange(0, std::memory_order_relaxed);
+            if (count != 0)
+            {
+                std::string text = std::format("{} log messages dropped, the logging queue was full.", count);
+                output->log(spdlog::details::log_msg(spdlog::source_loc{}, "", spdlog::level::warn, text));
+            }
+
+            count = truncated.exchange(0, std::memory_order_relaxed);
+            if (count != 0)
+            {
+                std::string text = std::format("{} log messages cut to {} bytes.", count, payload_size);
+                output->log(spdlog::details::log_msg(spdlog::source_loc{}, "", spdlog::level::warn, text));
+            }
+        }
+
+        void run()
+        {
+            // idle it checks the ring a hundred times per second, busy it never sleeps
+            std::chrono::microseconds pause(50);
+            while (true)
+            {
+                bool wrote = false;
+                while (write_one())
+                    wrote = true;
+                report_losses();
+
+                if (wrote)
+                {
+                    pause = std::chrono::microseconds(50);
+                    continue;
+                }
+                if (stopping.load(std::memory_order_acquire))
+                    break;
+                std::this_thread::sleep_for(pause);
+                pause = std::min<std::chrono::microseconds>(pause * 2, std::chrono::milliseconds(10));
+            }
+            output->flush();
+        }
+
+    public:
+        RingSink(size_t queue_size, std::shared_ptr<spdlog::sinks::sink> output)
+            : output(std::move(output))
+        {
+            size_t capacity = std::bit_ceil(std::max<size_t>(queue_size, 2));
+            slots = std::make_unique<Slot[]>(capacity);
+            mask = capacity - 1;
+            for (size_t i = 0; i < capacity; i++)
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+            thread = std::thread(&RingSink::run, this);
+        }
+
+        // writes what is left
+        ~RingSink() override
+        {
+            stopping.store(true, std::memory_order_release);
+            if (thread.joinable())
+                thread.join();
+        }
+
+        void log(const spdlog::details::log_msg& message) override
+        {
+            size_t position = tail.load(std::memory_order_relaxed);
+            Slot* slot;
+            while (true)
+            {
+                slot = &slots[position & mask];
+                size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+                if (difference == 0)
+                {
+                    if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (difference < 0)
+                {
+                    // full, the writer is behind
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                else
+                    position = tail.load(std::memory_order_relaxed);
+            }
+
+            slot->level = message.level;
+            slot->time = message.time;
+            slot->source = message.source;
+            slot->thread_id = message.thread_id;
+            slot->logger_name = message.logger_name;
+            if (message.payload.size() <= payload_size)
+            {
+                slot->length = message.payload.size();
+                std::memcpy(slot->payload, message.payload.data(), slot->length);
+            }
+            else
+            {
+                slot->length = payload_size;
+                std::memcpy(slot->payload, message.payload.data(), payload_size - 3);
+                std::memcpy(slot->payload + payload_size - 3, "...", 3);
+                truncated.fetch_add(1, std::memory_order_relaxed);
+            }
+            slot->sequence.store(position + 1, std::memory_order_release);
+        }
+
+        // the messages logged so far are written by the time it returns, unless the writer
+        // takes longer than flush_timeout (it is not there in a child forked after init)
+        void flush() override
+        {
+            size_t target = tail.load(std::memory_order_acquire);
+            auto deadline = std::chrono::steady_clock::now() + flush_timeout;
+            while (written.load(std::memory_order_acquire) < target && !stopping.load(std::memory_order_acquire))
+            {
+                if (std::chrono::steady_clock::now() >= deadline)
+                    break;
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            output->flush();
+        }
+
+        void set_pattern(const std::string& pattern) override
+        {
+            output->set_pattern(pattern);
+        }
+
+        void set_formatter(std::unique_ptr<spdlog::formatter> formatter) override
+        {
+            output->set_formatter(std::move(formatter));
+        }
+    };
+}
+
+void Logging::init(spdlog::level::level_enum level, size_t queue_size)
+{
+    auto sink = std::make_shared<RingSink>(queue_size, std::make_shared<spdlog::sinks::stdout_color_sink_mt>());
+    auto logger = std::make_shared<spdlog::logger>("", sink);
+    logger->set_pattern("(%s:%#) [%^%l%$] %v");
+    logger->set_level(level);
+    // the errors are written before the caller goes on, a crash right after them loses nothing
+    logger->flush_on(spdlog::level::err);
+    spdlog::set_default_logger(logger);
+}
+
+Logging::RateLimiter::RateLimiter(double per_second)
+    : interval(int64_t(1e9 / per_second))
+    , burst(std::max<int64_t>(int64_t(1e9) - interval, 0))
+    , next(0)
+{}
+
+bool Logging::RateLimiter::allow()
+{
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t expected = next.load(std::memory_order_relaxed);
+    while (true)
+    {
+        if (expected > now)
+            return false;
+        // the credit saved while idle is capped at a second of calls
+        int64_t desired = std::max(expected, now - burst) + interval;
+        if (next.compare_exchange_weak(expected, desired, std::memory_order_relaxed))
+            return true;
+    }
+}
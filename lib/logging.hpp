@@ -0,0 +1,66 @@
+#ifndef LOGGING_HPP
+#define LOGGING_HPP
+
+// The minimum level compiled in: the SPDLOG_* calls below it expand to nothing, their
+// arguments are not even evaluated. DEBUG unless the module sets it before its first
+// include, or the build does (-DSPDLOG_ACTIVE_LEVEL=SPDLOG_LEVEL_TRACE for the per
+// request messages).
+#ifndef SPDLOG_ACTIVE_LEVEL
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_DEBUG
+#endif
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Logging of the clients and servers. init makes the default logger asynchronous: the
+// calls copy the message into a lock-free ring and return, a thread formats and writes
+// them. When the ring is full the message is dropped and counted instead of making the
+// caller wait. A message is kept up to 480 bytes, a longer one is cut, ends with "..."
+// and is counted too.
+//
+// A message that can come with every request is logged at TRACE, or sampled at its
+// call site with LOG_EVERY_N and LOG_RATE_LIMITED.
+namespace Logging {
+    // level is the runtime one, the calls below SPDLOG_ACTIVE_LEVEL are gone already
+    void init(spdlog::level::level_enum level, size_t queue_size = 4096);
+
+    // allows per_second calls on average with bursts of as many, the call sites share
+    // nothing, so there is no lock
+    class RateLimiter {
+    private:
+        int64_t interval; // ns per call
+        int64_t burst; // ns of credit at most
+        std::atomic<int64_t> next; // ns of steady_clock, the calls before it are refused
+
+    public:
+        RateLimiter(double per_second);
+        bool allow();
+    };
+}
+
+#define LOG_LEVEL_ENUM(log_level) static_cast<spdlog::level::level_enum>(log_level)
+
+// logs the first call of the site and then one every n, log_level is an SPDLOG_LEVEL_* constant
+#define LOG_EVERY_N(log_level, n, ...) \
+    do { \
+        if constexpr ((log_level) >= SPDLOG_ACTIVE_LEVEL) { \
+            static std::atomic<uint64_t> log_calls_{0}; \
+            if (log_calls_.fetch_add(1, std::memory_order_relaxed) % (n) == 0) \
+                SPDLOG_LOGGER_CALL(spdlog::default_logger_raw(), LOG_LEVEL_ENUM(log_level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+// logs at most per_second calls of the site per second
+#define LOG_RATE_LIMITED(log_level, per_second, ...) \
+    do { \
+        if constexpr ((log_level) >= SPDLOG_ACTIVE_LEVEL) { \
+            static Logging::RateLimiter log_limiter_(per_second); \
+            if (log_limiter_.allow()) \
+                SPDLOG_LOGGER_CALL(spdlog::default_logger_raw(), LOG_LEVEL_ENUM(log_level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#endif
@@ -0,0 +1,154 @@
+#include "metadata_cache.hpp"
+#include "utils.hpp"
+
+using namespace CacheAPI;
+
+const size_t MetadataCache::shard_count = 16;
+
+MetadataCache::MetadataCache(size_t capacity)
+    : shard_capacity((capacity + shard_count - 1) / shard_count)
+    , shards(std::make_unique<Shard[]>(shard_count))
+{
+    for (size_t i = 0; i < shard_count; i++)
+        shards[i].slots.reserve(shard_capacity);
+}
+
+// private
+MetadataCache::Shard& MetadataCache::get_shard(const std::string& key) const
+{
+    return shards[Utils::hash_path(key) % shard_count];
+}
+
+void MetadataCache::insert(Shard& shard, const std::string& key, const std::string& value, bool is_file)
+{
+    auto it = shard.index.find(key);
+    if (it != shard.index.end())
+    {
+        Entry& entry = shard.slots[it->second];
+        entry.value = value;
+        entry.is_file = is_file;
+        entry.referenced = true;
+        return;
+    }
+
+    if (shard.slots.size() < shard_capacity)
+    {
+        shard.index.emplace(key, shard.slots.size());
+        shard.slots.push_back(Entry {key, value, is_file, false});
+        return;
+    }
+
+    // the first entry not used since the hand last passed it makes room
+    while (shard.slots[shard.hand].referenced)
+    {
+        shard.slots[shard.hand].referenced = false;
+        shard.hand = (shard.hand + 1) % shard.slots.size();
+    }
+
+    Entry& victim = shard.slots[shard.hand];
+    shard.index.erase(victim.key);
+    victim = Entry {key, value, is_file, false};
+    shard.index.emplace(key, shard.hand);
+    shard.hand = (shard.hand + 1) % shard.slots.size();
+}
+
+void MetadataCache::erase(Shard& shard, size_t slot)
+{
+    // the last entry takes the place of the removed one
+    shard.index.erase(shard.slots[slot].key);
+    if (slot != shard.slots.size() - 1)
+    {
+        shard.slots[slot] = std::move(shard.slots.back());
+        shard.index[shard.slots[slot].key] = slot;
+    }
+    shard.slots.pop_back();
+    if (shard.hand >= shard.slots.size())
+        shard.hand = 0;
+}
+
+// public
+bool MetadataCache::get(const std::string& key, bool is_file, std::string& value)
+{
+    if (shard_capacity == 0)
+        return false;
+
+    Shard& shard = get_shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end())
+        return false;
+
+    Entry& entry = shard.slots[it->second];
+    if (entry.is_file != is_file)
+        return false;
+    entry.referenced = true;
+    value = entry.value;
+    return true;
+}
+
+uint64_t MetadataCache::get_version(const std::string& key) const
+{
+    Shard& shard = get_shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.version;
+}
+
+void MetadataCache::fill(const std::string& key, const std::string& value, bool is_file, uint64_t version)
+{
+    if (shard_capacity == 0)
+        return;
+
+    Shard& shard = get_shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // a set, an update or a remove ran meanwhile, the value may be older than theirs
+    if (shard.version != version)
+        return;
+    insert(shard, key, value, is_file);
+}
+
+void MetadataCache::put(const std::string& key, const std::string& value, bool is_file)
+{
+    if (shard_capacity == 0)
+        return;
+
+    Shard& shard = get_shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.version++;
+    insert(shard, key, value, is_file);
+}
+
+void MetadataCache::remove(const std::string& key)
+{
+    if (shard_capacity == 0)
+        return;
+
+    Shard& shard = get_shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.version++;
+    auto it = shard.index.find(key);
+    if (it != shard.index.end())
+        erase(shard, it->second);
+}
+
+void MetadataCache::remove_subtree(const std::string& key)
+{
+    if (shard_capacity == 0)
+        return;
+
+    // the objects under key are on every shard, the renames and removals of directories are rare
+    std::string prefix = key == "/" ? key : key + "/";
+    for (size_t i = 0; i < shard_count; i++)
+    {
+        Shard& shard = shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.version++;
+        for (size_t slot = 0; slot < shard.slots.size(); )
+        {
+            const std::string& entry_key = shard.slots[slot].key;
+            if (entry_key == key || entry_key.starts_with(prefix))
+                erase(shard, slot);
+            else
+                slot++;
+        }
+    }
+}
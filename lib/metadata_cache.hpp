@@ -0,0 +1,67 @@
+#ifndef METADATA_CACHE_HPP
+#define METADATA_CACHE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace CacheAPI {
+    // The serialized metadata (what a GET_FILE or GET_DIR answers) of the objects
+    // the cache server used lately, kept in its memory so the lookups that miss
+    // memcached do not read the metadata directories. The keys are spread over
+    // shard_count shards with a lock each, a full shard evicts with the CLOCK
+    // algorithm.
+    //
+    // The handlers change the entries along with the files, the cache never reads
+    // them itself. A value read from the files is added with fill, and dropped if
+    // its shard changed since the read started (get_version).
+    class MetadataCache {
+    private:
+        static const size_t shard_count;
+
+        struct Entry {
+            std::string key;
+            std::string value;
+            bool is_file;
+            bool referenced; // used since the clock hand last passed
+        };
+
+        struct Shard {
+            std::mutex mutex;
+            std::vector<Entry> slots;
+            std::unordered_map<std::string, size_t> index; // key -> slot
+            size_t hand = 0;
+            uint64_t version = 0; // changes with every put and remove
+        };
+
+        size_t shard_capacity; // entries per shard, 0 when disabled
+        std::unique_ptr<Shard[]> shards;
+
+        Shard& get_shard(const std::string& key) const;
+        // the lock of the shard is held
+        void insert(Shard& shard, const std::string& key, const std::string& value, bool is_file);
+        void erase(Shard& shard, size_t slot);
+
+    public:
+        MetadataCache(const MetadataCache&) = delete;
+        MetadataCache& operator= (const MetadataCache&) = delete;
+
+        // capacity in entries over all the shards, 0 disables the cache
+        MetadataCache(size_t capacity);
+
+        // false when key is not cached, or cached as the other kind of object
+        bool get(const std::string& key, bool is_file, std::string& value);
+        uint64_t get_version(const std::string& key) const;
+        // adds a value read from the files, unless key changed since get_version
+        void fill(const std::string& key, const std::string& value, bool is_file, uint64_t version);
+        void put(const std::string& key, const std::string& value, bool is_file);
+        void remove(const std::string& key);
+        // key and the objects under it
+        void remove_subtree(const std::string& key);
+    };
+}
+
+#endif
@@ -0,0 +1,335 @@
+#include "metrics.hpp"
+#include "tracing.hpp"
+
+#include <cmath>
+#include <map>
+
+/*###############################*/
+/*---------[ Histogram ]---------*/
+/*###############################*/
+
+int Metrics::Histogram::get_bucket(uint64_t value)
+{
+    const uint64_t max_value = (1ull << max_value_bits) - 1;
+    if (value > max_value)
+        value = max_value;
+    if (value < sub_bucket_count)
+        return value;
+
+    // group g >= 1 holds [2^(g + 4), 2^(g + 5)) in steps of 2^(g - 1)
+    int msb = 63 - __builtin_clzll(value);
+    int group = msb - sub_bucket_bits + 1;
+    return group * sub_bucket_count + (int) ((value >> (msb - sub_bucket_bits)) - sub_bucket_count);
+}
+
+uint64_t Metrics::Histogram::get_bucket_limit(int bucket)
+{
+    int group = bucket / sub_bucket_count;
+    uint64_t sub_bucket = bucket % sub_bucket_count;
+    if (group == 0)
+        return sub_bucket;
+    return ((sub_bucket_count + sub_bucket + 1) << (group - 1)) - 1;
+}
+
+void Metrics::Histogram::record(uint64_t value)
+{
+    buckets[get_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed));
+}
+
+void Metrics::Histogram::read(Snapshot& snapshot) const
+{
+    // the buckets are not read atomically as a whole, a scrape racing with
+    // record() may be off by the requests in flight
+    for (int i = 0; i < bucket_count; i ++)
+        snapshot.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+    snapshot.count += count.load(std::memory_order_relaxed);
+    snapshot.sum += sum.load(std::memory_order_relaxed);
+    snapshot.max = std::max(snapshot.max, max.load(std::memory_order_relaxed));
+}
+
+uint64_t Metrics::Histogram::Snapshot::get_percentile(double fraction) const
+{
+    uint64_t total = 0;
+    for (uint64_t bucket_value : buckets)
+        total += bucket_value;
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t) std::ceil(fraction * total));
+    uint64_t seen = 0;
+    for (int i = 0; i < bucket_count; i ++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(get_bucket_limit(i), max);
+    }
+    return max;
+}
+
+/*####################################*/
+/*---------[ OperationTable ]---------*/
+/*####################################*/
+
+Metrics::OperationTable::OperationTable(const std::string& component)
+    : component(component)
+{
+    get_registry().add(this);
+}
+
+Metrics::OperationTable::~OperationTable()
+{
+    get_registry().remove(this);
+}
+
+void Metrics::OperationTable::record(uint8_t opcode, std::chrono::steady_clock::time_point start,
+    size_t bytes_in, size_t bytes_out, bool error)
+{
+    if (opcode >= max_operations)
+        return;
+
+    Operation& operation = operations[opcode];
+    operation.requests.fetch_add(1, std::memory_order_relaxed);
+    if (error)
+        operation.errors.fetch_add(1, std::memory_order_relaxed);
+    operation.bytes_in.fetch_add(bytes_in, std::memory_order_relaxed);
+    operation.bytes_out.fetch_add(bytes_out, std::memory_order_relaxed);
+    operation.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+const std::string& Metrics::OperationTable::get_component() const
+{
+    return component;
+}
+
+const Metrics::OperationTable::Operation& Metrics::OperationTable::get_operation(uint8_t opcode) const
+{
+    return operations[opcode];
+}
+
+/*#############################*/
+/*---------[ Counter ]---------*/
+/*#############################*/
+
+Metrics::Counter::Counter(const std::string& name, const std::string& help)
+    : name(name)
+    , help(help)
+{
+    get_registry().add(this);
+}
+
+Metrics::Counter::~Counter()
+{
+    get_registry().remove(this);
+}
+
+void Metrics::Counter::add(uint64_t value)
+{
+    this->value.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Metrics::Counter::get() const
+{
+    return value.load(std::memory_order_relaxed);
+}
+
+const std::string& Metrics::Counter::get_name() const
+{
+    return name;
+}
+
+const std::string& Metrics::Counter::get_help() const
+{
+    return help;
+}
+
+/*##############################*/
+/*---------[ Registry ]---------*/
+/*##############################*/
+
+Metrics::Registry& Metrics::get_registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+void Metrics::Registry::add(const OperationTable* table)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    tables.push_back(table);
+}
+
+void Metrics::Registry::remove(const OperationTable* table)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::erase(tables, table);
+}
+
+void Metrics::Registry::add(const Counter* counter)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.push_back(counter);
+}
+
+void Metrics::Registry::remove(const Counter* counter)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::erase(counters, counter);
+}
+
+uint64_t Metrics::Registry::get_counter(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t total = 0;
+    for (const Counter* counter : counters)
+        if (counter->get_name() == name)
+            total += counter->get();
+    return total;
+}
+
+namespace {
+    struct OperationTotals {
+        uint64_t requests = 0, errors = 0, bytes_in = 0, bytes_out = 0;
+        Metrics::Histogram::Snapshot latency;
+    };
+
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+    std::string get_labels(const std::string& component, uint8_t opcode)
+    {
+        return std::format("component=\"{}\",op=\"{}\"", component,
+            OperationCode::to_string(OperationCode::from_byte(opcode)));
+    }
+}
+
+std::string Metrics::Registry::expose()
+{
+    // component -> opcode -> totals, the samples of a metric have to be consecutive
+    std::map<std::string, std::map<uint8_t, OperationTotals>> components;
+    std::map<std::string, std::pair<std::string, uint64_t>> counter_totals;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const OperationTable* table : tables)
+            for (uint8_t opcode = 0; opcode < OperationTable::max_operations; opcode ++)
+            {
+                const OperationTable::Operation& operation = table->get_operation(opcode);
+                if (operation.requests.load(std::memory_order_relaxed) == 0)
+                    continue;
+
+                OperationTotals& totals = components[table->get_component()][opcode];
+                totals.requests += operation.requests.load(std::memory_order_relaxed);
+                totals.errors += operation.errors.load(std::memory_order_relaxed);
+                totals.bytes_in += operation.bytes_in.load(std::memory_order_relaxed);
+                totals.bytes_out += operation.bytes_out.load(std::memory_order_relaxed);
+                operation.latency.read(totals.latency);
+            }
+
+        for (const Counter* counter : counters)
+        {
+            auto& [help, value] = counter_totals[counter->get_name()];
+            help = counter->get_help();
+            value += counter->get();
+        }
+    }
+
+    std::string result;
+    auto expose_counter = [&](const std::string& name, const std::string& help, uint64_t OperationTotals::* field) {
+        result += std::format("# HELP dfs_{} {}\n# TYPE dfs_{} counter\n", name, help, name);
+        for (const auto& [component, operations] : components)
+            for (const auto& [opcode, totals] : operations)
+                result += std::format("dfs_{}{{{}}} {}\n", name, get_labels(component, opcode), totals.*field);
+    };
+
+    expose_counter("requests_total", "Requests handled.", &OperationTotals::requests);
+    expose_counter("errors_total", "Requests that failed.", &OperationTotals::errors);
+    expose_counter("received_bytes_total", "Bytes received with the requests.", &OperationTotals::bytes_in);
+    expose_counter("sent_bytes_total", "Bytes sent with the responses.", &OperationTotals::bytes_out);
+
+    result += "# HELP dfs_request_latency_seconds Time to handle a request.\n";
+    result += "# TYPE dfs_request_latency_seconds summary\n";
+    for (const auto& [component, operations] : components)
+        for (const auto& [opcode, totals] : operations)
+        {
+            std::string labels = get_labels(component, opcode);
+            for (double quantile : quantiles)
+                result += std::format("dfs_request_latency_seconds{{{},quantile=\"{}\"}} {}\n",
+                    labels, quantile, totals.latency.get_percentile(quantile) / 1e9);
+            result += std::format("dfs_request_latency_seconds_sum{{{}}} {}\n", labels, totals.latency.sum / 1e9);
+            result += std::format("dfs_request_latency_seconds_count{{{}}} {}\n", labels, totals.latency.count);
+        }
+
+    for (const auto& [name, counter] : counter_totals)
+        result += std::format("# HELP dfs_{} {}\n# TYPE dfs_{} counter\ndfs_{} {}\n",
+            name, counter.first, name, name, counter.second);
+
+    return result;
+}
+
+/*##############################*/
+/*---------[ Endpoint ]---------*/
+/*##############################*/
+
+Metrics::Endpoint::Endpoint(uint16_t port)
+    : acceptor(context)
+{
+    try {
+        tcp::endpoint endpoint(tcp::v4(), port);
+        acceptor.open(endpoint.protocol());
+        acceptor.set_option(tcp::acceptor::reuse_address(true));
+        acceptor.bind(endpoint);
+        acceptor.listen();
+    }
+    catch (std::exception& e)
+    {
+        throw std::runtime_error(std::format("Endpoint: {}", e.what()));
+    }
+
+    asio::co_spawn(context, accept_async(), asio::detached);
+    thread = std::thread([this]() { context.run(); });
+    SPDLOG_INFO("Metrics available on 0.0.0.0:{}", port);
+}
+
+Metrics::Endpoint::~Endpoint()
+{
+    context.stop();
+    if (thread.joinable())
+        thread.join();
+}
+
+asio::awaitable<void> Metrics::Endpoint::accept_async()
+{
+    while (true)
+    {
+        tcp::socket socket = co_await acceptor.async_accept(asio::use_awaitable);
+        try {
+            // GET /trace dumps the trace buffer, anything else gets the whole registry
+            std::string request;
+            co_await asio::async_read_until(socket, asio::dynamic_buffer(request, 8192), "\r\n\r\n", asio::use_awaitable);
+
+            std::string body, content_type;
+            if (request.starts_with("GET /trace"))
+            {
+                body = Tracing::dump_chrome_json();
+                content_type = "application/json";
+            }
+            else
+            {
+                body = get_registry().expose();
+                content_type = "text/plain; version=0.0.4";
+            }
+            std::string response = std::format(
+                "HTTP/1.1 200 OK\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+                content_type, body.length(), body);
+            co_await asio::async_write(socket, asio::buffer(response), asio::use_awaitable);
+        }
+        catch (std::exception& e)
+        {
+            SPDLOG_WARN(std::format("accept_async: {}", e.what()));
+        }
+    }
+}
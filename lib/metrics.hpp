@@ -0,0 +1,134 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include "net_protocol.hpp"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+using asio::ip::tcp;
+
+// Live counters and latency histograms of every component, exposed in the
+// Prometheus text format. Recording is lock-free (relaxed atomic adds), the
+// registry lock is only taken when a metric is created or destroyed and when
+// the metrics are scraped.
+namespace Metrics {
+    // HDR-style histogram: a value falls in one of 32 linear buckets of its power
+    // of two (its top 5 significant bits), so every percentile is within ~3%
+    class Histogram {
+    public:
+        static const int sub_bucket_bits = 5;
+        static const int sub_bucket_count = 1 << sub_bucket_bits;
+        static const int max_value_bits = 40; // larger values are clamped, 2^40 ns is 18 minutes
+        static const int bucket_count = (max_value_bits - sub_bucket_bits + 1) * sub_bucket_count;
+
+        // the buckets of one or more histograms, read at some point in time
+        struct Snapshot {
+            std::vector<uint64_t> buckets = std::vector<uint64_t>(bucket_count);
+            uint64_t count = 0, sum = 0, max = 0;
+
+            // highest value of the bucket holding the given fraction (0..1) of the values
+            uint64_t get_percentile(double fraction) const;
+        };
+
+        void record(uint64_t value);
+        // adds the current values to snapshot
+        void read(Snapshot& snapshot) const;
+
+        static int get_bucket(uint64_t value);
+        static uint64_t get_bucket_limit(int bucket); // highest value that falls in the bucket
+
+    private:
+        std::array<std::atomic<uint64_t>, bucket_count> buckets {};
+        std::atomic<uint64_t> count {0}, sum {0}, max {0};
+    };
+
+    // request counters and latencies of one component, by operation code
+    class OperationTable {
+    public:
+        static const size_t max_operations = 16;
+
+        struct Operation {
+            std::atomic<uint64_t> requests {0}, errors {0};
+            std::atomic<uint64_t> bytes_in {0}, bytes_out {0};
+            Histogram latency; // nanoseconds
+        };
+
+        OperationTable(const OperationTable&) = delete;
+        OperationTable& operator= (const OperationTable&) = delete;
+
+        // tables of the same component (e.g. two clients in one process) are added up when scraped
+        OperationTable(const std::string& component);
+        ~OperationTable();
+
+        void record(uint8_t opcode, std::chrono::steady_clock::time_point start, size_t bytes_in, size_t bytes_out, bool error);
+
+        const std::string& get_component() const;
+        const Operation& get_operation(uint8_t opcode) const;
+
+    private:
+        std::string component;
+        std::array<Operation, max_operations> operations;
+    };
+
+    // a named event counter, e.g. stripes that failed their checksum
+    class Counter {
+    public:
+        Counter(const Counter&) = delete;
+        Counter& operator= (const Counter&) = delete;
+
+        Counter(const std::string& name, const std::string& help);
+        ~Counter();
+
+        void add(uint64_t value = 1);
+        uint64_t get() const;
+        const std::string& get_name() const;
+        const std::string& get_help() const;
+
+    private:
+        std::string name, help;
+        std::atomic<uint64_t> value {0};
+    };
+
+    class Registry {
+    public:
+        void add(const OperationTable* table);
+        void remove(const OperationTable* table);
+        void add(const Counter* counter);
+        void remove(const Counter* counter);
+
+        // every metric of the process in the Prometheus text format (version 0.0.4)
+        std::string expose();
+        // sum of the counters with the given name, 0 if there is none
+        uint64_t get_counter(const std::string& name);
+
+    private:
+        std::mutex mutex;
+        std::vector<const OperationTable*> tables;
+        std::vector<const Counter*> counters;
+    };
+
+    Registry& get_registry();
+
+    // answers the HTTP requests on port with the registry (or the trace buffer
+    // for /trace), from its own thread so a scrape never waits behind the server
+    class Endpoint {
+    public:
+        Endpoint(const Endpoint&) = delete;
+        Endpoint& operator= (const Endpoint&) = delete;
+
+        Endpoint(uint16_t port);
+        ~Endpoint();
+
+    private:
+        asio::io_context context;
+        tcp::acceptor acceptor;
+        std::thread thread;
+
+        asio::awaitable<void> accept_async();
+    };
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include "mpi_transport.hpp"
+#include "utils.hpp"
+
+using namespace StorageAPI;
+
+namespace {
+    class MpiCall : public Transport::Call {
+    private:
+        MPI_Request send_request, recv_request;
+        std::vector<uint8_t> message;
+        bool done = false;
+
+        void finish(MPI_Status& status)
+        {
+            int size;
+            MPI_Get_count(&status, MPI_UNSIGNED_CHAR, &size);
+            reply.resize(size);
+            MPI_Wait(&send_request, MPI_STATUS_IGNORE);
+            done = true;
+        }
+
+    public:
+        MpiCall(int node, int tag, std::vector<uint8_t>&& message, size_t max_reply)
+            : message(std::move(message))
+        {
+            reply.resize(max_reply);
+            MPI_Irecv(reply.data(), reply.size(), MPI_UNSIGNED_CHAR, node, tag, MPI_COMM_WORLD, &recv_request);
+            MPI_Isend(this->message.data(), this->message.size(), MPI_UNSIGNED_CHAR, node, tag, MPI_COMM_WORLD, &send_request);
+        }
+
+        // MPI writes to the buffers until the requests complete
+        ~MpiCall() override
+        {
+            wait();
+        }
+
+        bool test() override
+        {
+            if (done)
+                return true;
+
+            int flag = 0;
+            MPI_Status status;
+            MPI_Test(&recv_request, &flag, &status);
+            if (flag)
+                finish(status);
+            return done;
+        }
+
+        void wait() override
+        {
+            if (done)
+                return;
+
+            MPI_Status status;
+            MPI_Wait(&recv_request, &status);
+            finish(status);
+        }
+    };
+}
+
+MpiTransport::MpiTransport(int stripe_size)
+    : MpiTransport(stripe_size, 1) {} // default: a single manager
+
+MpiTransport::MpiTransport(int stripe_size, int manager_count)
+    : manager_count(manager_count)
+{
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+    if (manager_count < 1 || rank >= manager_count || manager_count >= comm_size)
+        throw std::runtime_error(std::format("MpiTransport: rank {} of {} is not one of {} managers with nodes.",
+            rank, comm_size, manager_count));
+
+    int* value;
+    int flag;
+    MPI_Comm_get_attr(MPI_COMM_WORLD, MPI_TAG_UB, &value, &flag);
+    tag_ub = flag ? *value : 32767; // the least the standard allows
+
+    // initializing connection with the nodes, the other managers are left alone
+    for (int i = manager_count; i < comm_size; i ++)
+    {
+        int r = stripe_size;
+        MPI_Send(&r, 1, MPI_INT, i, 1, MPI_COMM_WORLD);
+    }
+
+    SPDLOG_INFO("Server has rank {}, {} managers", rank, manager_count);
+}
+
+int MpiTransport::get_node_count() const
+{
+    return comm_size - manager_count;
+}
+
+std::unique_ptr<Transport::Call> MpiTransport::call(int node, std::vector<uint8_t>&& message, size_t max_reply)
+{
+    int tag = 2 + next_tag.fetch_add(1, std::memory_order_relaxed) % (tag_ub - 1);
+    return std::make_unique<MpiCall>(manager_count + node - 1, tag, std::move(message), max_reply);
+}
+
+MpiNodeTransport::MpiNodeTransport(int manager_count)
+    : manager_count(manager_count)
+    , manager_rank(0)
+    , stripe_size(0)
+{
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    std::cout << rank << ": Connected to " << manager_count << " manager(s)" << std::endl;
+    for (int manager = 0; manager < manager_count; manager++)
+    {
+        int size;
+        MPI_Recv(&size, 1, MPI_INT, manager, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (stripe_size != 0 && size != stripe_size)
+            throw std::runtime_error(std::format("MpiNodeTransport: manager {} sent stripe size {}, others sent {}",
+                manager, size, stripe_size));
+        stripe_size = size;
+    }
+    std::cout << "Received stripe_size: " << stripe_size << std::endl;
+}
+
+int MpiNodeTransport::get_rank() const
+{
+    return rank;
+}
+
+int MpiNodeTransport::get_stripe_size() const
+{
+    return stripe_size;
+}
+
+bool MpiNodeTransport::receive(int& tag, std::vector<uint8_t>& message)
+{
+    MPI_Status status;
+    int data_size;
+
+    // only the managers send to the nodes
+    MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+    MPI_Get_count(&status, MPI_UNSIGNED_CHAR, &data_size);
+
+    tag = status.MPI_TAG;
+    manager_rank = status.MPI_SOURCE;
+    message.resize(data_size);
+    MPI_Recv(message.data(), data_size, MPI_UNSIGNED_CHAR, manager_rank, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    return true;
+}
+
+void MpiNodeTransport::reply(int tag, const uint8_t* data, size_t size)
+{
+    MPI_Send(data, size, MPI_UNSIGNED_CHAR, manager_rank, tag, MPI_COMM_WORLD);
+}
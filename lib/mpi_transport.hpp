@@ -0,0 +1,54 @@
+#ifndef MPI_TRANSPORT_HPP
+#define MPI_TRANSPORT_HPP
+
+#include "transport.hpp"
+#include <atomic>
+#include <mpi.h>
+
+namespace StorageAPI {
+    // the storage managers are the first manager_count ranks of MPI_COMM_WORLD and every
+    // other rank is a storage node, node n is rank manager_count + n - 1
+    class MpiTransport : public Transport {
+    private:
+        int rank, comm_size;
+        int manager_count;
+        // the replies are matched on (node, tag): every call takes the next tag in
+        // 2..tag_ub, the handshake uses 1
+        int tag_ub;
+        std::atomic<uint64_t> next_tag = 0;
+
+    public:
+        MpiTransport(const MpiTransport&) = delete;
+        MpiTransport& operator= (const MpiTransport&) = delete;
+
+        // sends the stripe size to the nodes, they wait for it from every manager before serving
+        MpiTransport(int stripe_size);
+        MpiTransport(int stripe_size, int manager_count);
+
+        int get_node_count() const override;
+        std::unique_ptr<Call> call(int node, std::vector<uint8_t>&& message, size_t max_reply) override;
+    };
+
+    // takes the requests of all the managers in the order they arrive
+    class MpiNodeTransport : public NodeTransport {
+    private:
+        int rank, manager_count;
+        int manager_rank; // of the request last received
+        int stripe_size;
+
+    public:
+        MpiNodeTransport(const MpiNodeTransport&) = delete;
+        MpiNodeTransport& operator= (const MpiNodeTransport&) = delete;
+
+        // blocks until every manager sent the stripe size
+        MpiNodeTransport(int manager_count = 1);
+
+        int get_rank() const;
+        int get_stripe_size() const;
+
+        bool receive(int& tag, std::vector<uint8_t>& message) override;
+        void reply(int tag, const uint8_t* data, size_t size) override;
+    };
+}
+
+#endif
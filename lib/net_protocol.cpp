@@ -1,4 +1,5 @@
 #include "net_protocol.hpp"
+#include "wire_codec.hpp"
 
 /*################################*/
 /*---------[ ResultCode ]---------*/
@@ -92,6 +93,24 @@ uint8_t OperationCode::to_byte(OperationCode::Type opcode)
             return 9;
         case Type::WRITE:
             return 10;
+        case Type::SEEK:
+            return 11;
+        case Type::PUNCH:
+            return 12;
+        case Type::SET_ENTRY:
+            return 13;
+        case Type::RM_ENTRY:
+            return 14;
+        case Type::PUT_FILE:
+            return 15;
+        case Type::ADOPT:
+            return 16;
+        case Type::SCAN:
+            return 17;
+        case Type::WATCH:
+            return 18;
+        case Type::INVALIDATE:
+            return 19;
         default:
             return -1;
     }
@@ -123,6 +142,24 @@ OperationCode::Type OperationCode::from_byte(uint8_t byte)
             return Type::READ;
         case 10:
             return Type::WRITE;
+        case 11:
+            return Type::SEEK;
+        case 12:
+            return Type::PUNCH;
+        case 13:
+            return Type::SET_ENTRY;
+        case 14:
+            return Type::RM_ENTRY;
+        case 15:
+            return Type::PUT_FILE;
+        case 16:
+            return Type::ADOPT;
+        case 17:
+            return Type::SCAN;
+        case 18:
+            return Type::WATCH;
+        case 19:
+            return Type::INVALIDATE;
         default:
             return Type::UNKNOWN;
     }
@@ -154,6 +191,24 @@ std::string OperationCode::to_string(OperationCode::Type opcode)
             return "READ";
         case Type::WRITE:
             return "WRITE";
+        case Type::SEEK:
+            return "SEEK";
+        case Type::PUNCH:
+            return "PUNCH";
+        case Type::SET_ENTRY:
+            return "SET_ENTRY";
+        case Type::RM_ENTRY:
+            return "RM_ENTRY";
+        case Type::PUT_FILE:
+            return "PUT_FILE";
+        case Type::ADOPT:
+            return "ADOPT";
+        case Type::SCAN:
+            return "SCAN";
+        case Type::WATCH:
+            return "WATCH";
+        case Type::INVALIDATE:
+            return "INVALIDATE";
         default:
             return "UNKNOWN";
     }
@@ -174,6 +229,10 @@ uint8_t UpdateCode::to_byte(Type opcode)
             return 3;
         case Type::CHSIZE:
             return 4;
+        case Type::COMPRESS:
+            return 5;
+        case Type::EXTEND:
+            return 6;
         
         default:
             return -1;
@@ -192,6 +251,10 @@ UpdateCode::Type UpdateCode::from_byte(uint8_t byte)
             return Type::RENAME;
         case 4:
             return Type::CHSIZE;
+        case 5:
+            return Type::COMPRESS;
+        case 6:
+            return Type::EXTEND;
         
         default:
             return Type::UNKNOWN;
@@ -210,12 +273,137 @@ std::string UpdateCode::to_string(UpdateCode::Type opcode)
             return "RENAME";
         case Type::CHSIZE:
             return "CHSIZE";
+        case Type::COMPRESS:
+            return "COMPRESS";
+        case Type::EXTEND:
+            return "EXTEND";
 
         default:
             return "UNKNOWN";
     }
 }
 
+/*######################################*/
+/*---------[ InvalidationCode ]---------*/
+/*######################################*/
+
+uint8_t InvalidationCode::to_byte(Type code)
+{
+    switch (code)
+    {
+        case Type::DATA:
+            return 1;
+        case Type::ATTR:
+            return 2;
+        case Type::ENTRY:
+            return 3;
+        case Type::ALL:
+            return 4;
+
+        default:
+            return -1;
+    }
+}
+
+InvalidationCode::Type InvalidationCode::from_byte(uint8_t byte)
+{
+    switch (byte)
+    {
+        case 1:
+            return Type::DATA;
+        case 2:
+            return Type::ATTR;
+        case 3:
+            return Type::ENTRY;
+        case 4:
+            return Type::ALL;
+
+        default:
+            return Type::UNKNOWN;
+    }
+}
+
+std::string InvalidationCode::to_string(InvalidationCode::Type code)
+{
+    switch (code)
+    {
+        case Type::DATA:
+            return "DATA";
+        case Type::ATTR:
+            return "ATTR";
+        case Type::ENTRY:
+            return "ENTRY";
+        case Type::ALL:
+            return "ALL";
+
+        default:
+            return "UNKNOWN";
+    }
+}
+
+/*#####################################*/
+/*---------[ CompressionCode ]---------*/
+/*#####################################*/
+
+uint8_t CompressionCode::to_byte(Type codec)
+{
+    switch (codec)
+    {
+        case Type::NONE:
+            return 0;
+        case Type::LZ4:
+            return 1;
+        case Type::ZSTD:
+            return 2;
+
+        default:
+            return -1;
+    }
+}
+
+CompressionCode::Type CompressionCode::from_byte(uint8_t byte)
+{
+    switch (byte)
+    {
+        case 0:
+            return Type::NONE;
+        case 1:
+            return Type::LZ4;
+        case 2:
+            return Type::ZSTD;
+
+        default:
+            return Type::UNKNOWN;
+    }
+}
+
+std::string CompressionCode::to_string(CompressionCode::Type codec)
+{
+    switch (codec)
+    {
+        case Type::NONE:
+            return "none";
+        case Type::LZ4:
+            return "lz4";
+        case Type::ZSTD:
+            return "zstd";
+
+        default:
+            return "unknown";
+    }
+}
+
+CompressionCode::Type CompressionCode::from_string(const std::string& name)
+{
+    if (name == "none")
+        return Type::NONE;
+    if (name == "lz4")
+        return Type::LZ4;
+    if (name == "zstd")
+        return Type::ZSTD;
+    return Type::UNKNOWN;
+}
+
 /*######################################*/
 /*---------[ BytePacketBuffer ]---------*/
 /*######################################*/
@@ -231,12 +419,7 @@ BytePacketBuffer::BytePacketBuffer()
 BytePacketBuffer::BytePacketBuffer(const uint8_t* new_buf, size_t len)
 {
     c_pos = 0;            
-    buffer = std::vector<uint8_t>(len);
-
-    for (size_t i = 0; i < len; i ++)
-    {
-        buffer[i] = new_buf[i];
-    }
+    buffer.assign(new_buf, new_buf + len);
 }
 
 void BytePacketBuffer::resize(size_t len)
@@ -290,11 +473,6 @@ uint8_t* BytePacketBuffer::get_range(size_t start, size_t len, uint8_t* res)
             std::format("get_range: Index outside of bounds: tried {} and {}, but size is {}", start, len, buffer.size())
         );
 
-    if (len > sizeof(res))
-        throw std::runtime_error(
-            std::format("get_range: Buffer too small. Length given: {}, buffer size: {}", len, sizeof(res))
-        );
-
     std::copy(buffer.begin() + start, buffer.begin() + start + len, res);
     return res;
 }
@@ -393,6 +571,28 @@ void BytePacketBuffer::set_u16(size_t pos, uint16_t val)
 /*#################################*/
 const size_t CachePacket::header_size = 24;
 const size_t CachePacket::max_packet_size = 8192;
+const std::string CachePacket::missing_value = "-";
+
+// wire layout of a CachePacket, header fields in order followed by the body sections
+using CachePacketLayout = Wire::Layout<CachePacket::header_size,
+    Wire::HeaderFields<
+        Wire::Field<&CachePacket::id>,
+        Wire::Field<&CachePacket::opcode>,
+        Wire::Field<&CachePacket::rescode>,
+        Wire::Field<&CachePacket::flags>,
+        Wire::Field<&CachePacket::message_len>,
+        Wire::Pad<1>, // pad8
+        Wire::Field<&CachePacket::time>,
+        Wire::Field<&CachePacket::key_len>,
+        Wire::Field<&CachePacket::value_len>,
+        Wire::Pad<4> // reserved
+    >,
+    Wire::BodySections<
+        Wire::Section<&CachePacket::message_len, &CachePacket::message>,
+        Wire::Section<&CachePacket::key_len, &CachePacket::key>,
+        Wire::Section<&CachePacket::value_len, &CachePacket::value>
+    >
+>;
 
 CachePacket::CachePacket()
 {
@@ -402,6 +602,7 @@ CachePacket::CachePacket()
 
     flags = 0;
     message_len = 0;
+    pad8 = 0;
 
     time = 0;
     key_len = 0;
@@ -414,58 +615,25 @@ CachePacket::CachePacket()
 
 CachePacket::CachePacket(const uint8_t* buffer, size_t len)
 {
+    pad8 = 0;
     from_buffer(buffer, len);
 }
 
 size_t CachePacket::get_packet_size(const uint8_t* buffer, size_t len)
 {
     try {
-        BytePacketBuffer packet_buffer = BytePacketBuffer(buffer, len);
-        size_t final_size = 0;
-        packet_buffer.step(5);
-
-        final_size += (size_t) packet_buffer.read_u16(); // message_len
-        packet_buffer.step(1); // stepping 1 byte (padding)
-
-        final_size += (size_t) packet_buffer.read_u32(); // key_len
-        final_size += (size_t) packet_buffer.read_u32(); // value_len
-        return final_size + header_size;
+        return CachePacketLayout::packet_size(buffer, len);
     }
     catch (std::exception& e)
     {
-        throw std::runtime_error(std::format("from_buffer: {}", e.what()));
-        return 0;
+        throw std::runtime_error(std::format("get_packet_size: {}", e.what()));
     }
 }
 
 void CachePacket::from_buffer(const uint8_t* buffer, size_t len)
 {
-    BytePacketBuffer packet_buffer = BytePacketBuffer(buffer, len);
-
     try {
-        id = packet_buffer.read_u16();
-        opcode = packet_buffer.read_u8();
-        rescode = packet_buffer.read_u8();
-
-        flags = packet_buffer.read_u8();
-        message_len = packet_buffer.read_u16();
-        packet_buffer.step(1); // stepping 1 bytes (padding)
-
-        time = packet_buffer.read_u32();
-        key_len = packet_buffer.read_u32();
-        value_len = packet_buffer.read_u32();
-
-        message.resize(message_len);
-        for (size_t i = 0; i < message_len; i ++)
-            message[i] = packet_buffer.read_u8();
-
-        key.resize(key_len);
-        for (size_t i = 0; i < key_len; i ++)
-            key[i] = packet_buffer.read_u8();
-
-        value.resize(value_len);
-        for (size_t i = 0; i < value_len; i ++)
-            value[i] = packet_buffer.read_u8();
+        CachePacketLayout::load(*this, buffer, len);
     }
     catch (std::exception& e)
     {
@@ -475,36 +643,14 @@ void CachePacket::from_buffer(const uint8_t* buffer, size_t len)
 
 size_t CachePacket::to_buffer(std::vector<uint8_t>& final_buffer) const
 {
-    BytePacketBuffer packet_buffer = BytePacketBuffer();
-    
-    size_t bytes_returned = header_size + message_len + key_len + value_len; // header length + data length 
-    packet_buffer.resize(bytes_returned);
-    final_buffer.resize(bytes_returned);
-
-    packet_buffer.write_u16(id);
-    packet_buffer.write_u8(opcode);
-    packet_buffer.write_u8(rescode);
-    
-    packet_buffer.write_u8(flags);
-    packet_buffer.write_u16(message_len);
-    packet_buffer.step(1); // skipping 1 byte (padding) 
-
-    packet_buffer.write_u32(time);
-    packet_buffer.write_u32(key_len);
-    packet_buffer.write_u32(value_len);
-
-    for (size_t i = 0; i < message_len; i ++)
-        packet_buffer.write_u8(message[i]);
-    
-    for (size_t i = 0; i < key_len; i ++)
-        packet_buffer.write_u8(key[i]);
-    
-    for (size_t i = 0; i < value_len; i ++)
-        packet_buffer.write_u8(value[i]);
-
-    std::copy(packet_buffer.get_buffer().begin(), packet_buffer.get_buffer().end(), final_buffer.begin());
-
-    return packet_buffer.get_size();
+    try {
+        final_buffer.resize(header_size + CachePacketLayout::body_size(*this));
+        return CachePacketLayout::store(*this, final_buffer.data(), final_buffer.size());
+    }
+    catch (std::exception& e)
+    {
+        throw std::runtime_error(std::format("to_buffer: {}", e.what()));
+    }
 }
 
 std::string CachePacket::to_string() const
@@ -608,12 +754,34 @@ std::string UpdateCommand::to_string() const
 /*---------[ StoragePacket ]---------*/
 /*###################################*/
 
-const size_t StoragePacket::header_size = 16;
+const size_t StoragePacket::header_size = 32;
 // 128KB is the fuze chunk size for read/writes operations on my system
 // 4B for the header
 // 1KB for path length
 const size_t StoragePacket::max_packet_size = 256 * 1024 + StoragePacket::header_size + 1024;
 
+// wire layout of a StoragePacket, header fields in order followed by the body sections
+using StoragePacketLayout = Wire::Layout<StoragePacket::header_size,
+    Wire::HeaderFields<
+        Wire::Field<&StoragePacket::id>,
+        Wire::Field<&StoragePacket::opcode>,
+        Wire::Field<&StoragePacket::rescode>,
+        Wire::Field<&StoragePacket::offset>,
+        Wire::Field<&StoragePacket::message_len>,
+        Wire::Field<&StoragePacket::path_len>,
+        Wire::Field<&StoragePacket::data_len>,
+        Wire::Field<&StoragePacket::checksum>,
+        Wire::Field<&StoragePacket::flags>,
+        Wire::Pad<3>,
+        Wire::Field<&StoragePacket::trace_id>
+    >,
+    Wire::BodySections<
+        Wire::Section<&StoragePacket::message_len, &StoragePacket::message>,
+        Wire::Section<&StoragePacket::path_len, &StoragePacket::path>,
+        Wire::Section<&StoragePacket::data_len, &StoragePacket::data>
+    >
+>;
+
 StoragePacket::StoragePacket()
 {
     id = 0;
@@ -624,6 +792,9 @@ StoragePacket::StoragePacket()
     path_len = 0;
     message_len = 0;
     data_len = 0;
+    checksum = 0; // CRC32C of no data
+    flags = 0; // not compressed
+    trace_id = 0; // not traced
 
     path = std::vector<uint8_t>();
     message = std::vector<uint8_t>();
@@ -638,53 +809,18 @@ StoragePacket::StoragePacket(const uint8_t* buffer, size_t len)
 size_t StoragePacket::get_packet_size(const uint8_t* buffer, size_t len)
 {
     try {
-        BytePacketBuffer packet_buffer = BytePacketBuffer(buffer, len);
-        size_t final_size = 0;
-        packet_buffer.step(8);
-
-        final_size += (size_t) packet_buffer.read_u16(); // message_len
-        final_size += (size_t) packet_buffer.read_u16(); // path_len
-        final_size += (size_t) packet_buffer.read_u32(); // data_len
-
-        return final_size + header_size;
+        return StoragePacketLayout::packet_size(buffer, len);
     }
     catch (std::exception& e)
     {
-        throw std::runtime_error(std::format("parse_header: {}", e.what()));
-        return 0;
+        throw std::runtime_error(std::format("get_packet_size: {}", e.what()));
     }
 }
 
 void StoragePacket::from_buffer(const uint8_t* buffer, size_t len)
 {
-    BytePacketBuffer packet_buffer = BytePacketBuffer(buffer, len);
-
     try {
-        id = packet_buffer.read_u16();
-        opcode = packet_buffer.read_u8();
-        rescode = packet_buffer.read_u8();
-
-        offset = packet_buffer.read_u32();
-
-        message_len = packet_buffer.read_u16();
-        path_len = packet_buffer.read_u16();
-
-        data_len = packet_buffer.read_u32();
-
-        message.resize(message_len);
-        // std::cout << "message_len: " << message_len << std::endl;
-        for (size_t i = 0; i < message_len; i ++)
-            message[i] = packet_buffer.read_u8();
-
-        path.resize(path_len);
-        // std::cout << "path_len: " << path_len << std::endl;
-        for (size_t i = 0; i < path_len; i ++)
-            path[i] = packet_buffer.read_u8();
-
-        data.resize(data_len);
-        // std::cout << "data_len: " << data_len << std::endl;
-        for (size_t i = 0; i < data_len; i ++)
-            data[i] = packet_buffer.read_u8();
+        StoragePacketLayout::load(*this, buffer, len);
     }
     catch (std::exception& e)
     {
@@ -694,69 +830,25 @@ void StoragePacket::from_buffer(const uint8_t* buffer, size_t len)
 
 size_t StoragePacket::to_buffer(std::vector<uint8_t>& final_buffer) const
 {
-    BytePacketBuffer packet_buffer = BytePacketBuffer();
-    
-    size_t bytes_returned = header_size + path_len + data_len + message_len; // header length + data length 
-    packet_buffer.resize(bytes_returned);
-    final_buffer.resize(bytes_returned);
-
-    packet_buffer.write_u16(id);
-    packet_buffer.write_u8(opcode);
-    packet_buffer.write_u8(rescode);
-    
-    packet_buffer.write_u32(offset);
-
-    packet_buffer.write_u16(message_len);
-    packet_buffer.write_u16(path_len);
-
-    packet_buffer.write_u32(data_len);
-
-    for (size_t i = 0; i < message_len; i ++)
-        packet_buffer.write_u8(message[i]);
-
-    for (size_t i = 0; i < path_len; i ++)
-        packet_buffer.write_u8(path[i]);
-        
-    for (size_t i = 0; i < data_len; i ++)
-        packet_buffer.write_u8(data[i]);
-    
-
-    std::copy(packet_buffer.get_buffer().begin(), packet_buffer.get_buffer().end(), final_buffer.begin());
-    return packet_buffer.get_size();
+    try {
+        final_buffer.resize(header_size + StoragePacketLayout::body_size(*this));
+        return StoragePacketLayout::store(*this, final_buffer.data(), final_buffer.size());
+    }
+    catch (std::exception& e)
+    {
+        throw std::runtime_error(std::format("to_buffer: {}", e.what()));
+    }
 }
 
 size_t StoragePacket::to_buffer_no_resize(std::vector<uint8_t>& final_buffer) const
 {
-    BytePacketBuffer packet_buffer = BytePacketBuffer();
-    
-    size_t bytes_returned = header_size + path_len + data_len + message_len; // header length + data length 
-    packet_buffer.resize(bytes_returned);
-    // final_buffer.resize(bytes_returned);
-    if (final_buffer.size() < bytes_returned)
-    throw std::runtime_error(std::format("to_buffer_no_resize: Buffer too small. Length given: {}, buffer size: {}", bytes_returned, final_buffer.size()));
-    
-    packet_buffer.write_u16(id);
-    packet_buffer.write_u8(opcode);
-    packet_buffer.write_u8(rescode);
-    
-    packet_buffer.write_u32(offset);
-    
-    packet_buffer.write_u16(message_len);
-    packet_buffer.write_u16(path_len);
-    
-    packet_buffer.write_u32(data_len);
-    
-    for (size_t i = 0; i < message_len; i ++)
-        packet_buffer.write_u8(message[i]);
-    
-    for (size_t i = 0; i < path_len; i ++)
-        packet_buffer.write_u8(path[i]);
-    
-    for (size_t i = 0; i < data_len; i ++)
-        packet_buffer.write_u8(data[i]);
-    
-    std::copy(packet_buffer.get_buffer().begin(), packet_buffer.get_buffer().end(), final_buffer.begin());
-    return bytes_returned;
+    try {
+        return StoragePacketLayout::store(*this, final_buffer.data(), final_buffer.size());
+    }
+    catch (std::exception& e)
+    {
+        throw std::runtime_error(std::format("to_buffer_no_resize: {}", e.what()));
+    }
 }
 
 std::string StoragePacket::to_string() const
@@ -768,7 +860,10 @@ std::string StoragePacket::to_string() const
     result += "--\\ offset: " + std::to_string(offset) + "\n";
     result += "--\\ message_len: " + std::to_string(message_len) + "\n";
     result += "--\\ path_len: " + std::to_string(path_len) + "\n";
-    result += "--\\ data_len: " + std::to_string(data_len) + "\n\n";
+    result += "--\\ data_len: " + std::to_string(data_len) + "\n";
+    result += "--\\ checksum: " + std::format("{:08x}", checksum) + "\n";
+    result += "--\\ flags: " + CompressionCode::to_string(CompressionCode::from_byte(flags)) + "\n";
+    result += "--\\ trace_id: " + std::format("{:016x}", trace_id) + "\n\n";
     result += "--\\ Path:\n";
     result += Utils::get_string_from_byte_array(path);
     result += "\n";
@@ -32,7 +32,16 @@ namespace OperationCode {
         RM_DIR = 7,
         UPDATE = 8,
         READ = 9,
-        WRITE = 10
+        WRITE = 10,
+        SEEK = 11, // finds the next data or hole of a file (SEEK_DATA / SEEK_HOLE)
+        PUNCH = 12, // drops a stripe, it reads as a hole afterwards
+        SET_ENTRY = 13, // lists a directory kept by another cache server in its parent
+        RM_ENTRY = 14,
+        PUT_FILE = 15, // stores a file record as it is, a file moved from another cache server
+        ADOPT = 16, // stores a stripe copied from another node, unless the node has one already
+        SCAN = 17, // lists the stripe files of a node in the order of their paths, a page at a time
+        WATCH = 18, // keeps the connection open, the cache server sends an INVALIDATE on it for every change
+        INVALIDATE = 19 // sent by a cache server: the object of the key changed (flags: InvalidationCode)
     };
 
     uint8_t to_byte(Type opcode);
@@ -47,6 +56,8 @@ namespace UpdateCode {
         CHOWN = 2,
         RENAME = 3,
         CHSIZE = 4,
+        COMPRESS = 5, // sets the stripe compression policy of a file or directory
+        EXTEND = 6, // CHSIZE unless the file is larger already, the writes finish in any order
     };
 
     uint8_t to_byte(Type opcode);
@@ -54,6 +65,35 @@ namespace UpdateCode {
     std::string to_string(Type opcode);
 }
 
+// what a client drops from its caches (the kernel's) when told of a change
+namespace InvalidationCode {
+    enum Type {
+        UNKNOWN,
+        DATA = 1, // the content, and the attributes along
+        ATTR = 2,
+        ENTRY = 3, // the name, created, removed or renamed
+        ALL = 4, // the watch was lost meanwhile, any object may have changed
+    };
+
+    uint8_t to_byte(Type code);
+    Type from_byte(uint8_t byte);
+    std::string to_string(Type code);
+}
+
+namespace CompressionCode {
+    enum Type {
+        NONE = 0,
+        LZ4 = 1, // fast, for data that is read back often
+        ZSTD = 2, // better ratio, for checkpoints and logs
+        UNKNOWN = 255, // distinct from NONE, an unknown codec cannot be read as raw data
+    };
+
+    uint8_t to_byte(Type codec);
+    Type from_byte(uint8_t byte);
+    std::string to_string(Type codec);
+    Type from_string(const std::string& name);
+}
+
 // From: https://github.com/VladSteopoaie/DNS-tunneling/blob/main/dns_server/modules/dns_module.h
 
 // A struct to easily read and write bytes into a buffer
@@ -103,6 +143,8 @@ public:
 struct CachePacket {
     static const size_t max_packet_size;
     static const size_t header_size;
+    // memcached value of a path that does not exist, no StatRecord is a single byte
+    static const std::string missing_value;
 
     // header
     uint16_t id;
@@ -157,6 +199,9 @@ struct StoragePacket {
     uint16_t path_len;
 
     uint32_t data_len;
+    uint32_t checksum; // CRC32C of data, checked by every hop
+    uint8_t flags; // compression codec of data (CompressionCode), for writes the policy of the file
+    uint64_t trace_id; // request trace (see tracing.hpp), 0 when the request is not traced
 
     std::vector<uint8_t> message;
     std::vector<uint8_t> path;
@@ -0,0 +1,203 @@
+#include "placement_map.hpp"
+#include "utils.hpp"
+#include <algorithm>
+
+using namespace StorageAPI;
+
+const int PlacementLayout::virtual_nodes = 128;
+
+namespace {
+    // the FNV-1a hashes of close strings are close too, the points and the keys
+    // are spread over the ring with the splitmix64 finalizer
+    uint64_t mix(uint64_t hash)
+    {
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        return hash ^ (hash >> 31);
+    }
+}
+
+PlacementLayout::PlacementLayout(uint32_t version, const std::vector<std::string>& members)
+    : version(version)
+    , members(members)
+    , numbers(members.size(), 0)
+{
+    if (members.empty())
+        throw std::runtime_error(std::format("PlacementLayout: Version {} has no nodes.", version));
+
+    if (version == 0)
+        return;
+
+    ring.reserve(members.size() * virtual_nodes);
+    for (size_t m = 0; m < members.size(); m++)
+        for (int v = 0; v < virtual_nodes; v++)
+            ring.emplace_back(mix(Utils::hash_path(std::format("{}#{}", members[m], v))), m);
+    std::sort(ring.begin(), ring.end());
+}
+
+uint32_t PlacementLayout::get_version() const
+{
+    return version;
+}
+
+const std::vector<std::string>& PlacementLayout::get_members() const
+{
+    return members;
+}
+
+void PlacementLayout::bind(const std::vector<std::string>& nodes)
+{
+    for (size_t m = 0; m < members.size(); m++)
+    {
+        auto it = std::find(nodes.begin(), nodes.end(), members[m]);
+        numbers[m] = it == nodes.end() ? 0 : it - nodes.begin() + 1;
+    }
+}
+
+std::vector<int> PlacementLayout::get_nodes(const std::string& path, size_t key, int count, int stride) const
+{
+    std::vector<int> nodes(count);
+    if (version == 0)
+    {
+        // the stripes of every file start on the same node, the path plays no part
+        for (int i = 0; i < count; i++)
+            nodes[i] = numbers[(key * stride + i) % members.size()];
+        return nodes;
+    }
+
+    // the first members clockwise from the key, past the points of the ones already taken
+    std::vector<int> taken;
+    taken.reserve(std::min<size_t>(count, members.size()));
+    uint64_t point = mix(Utils::hash_path(std::format("{}#{}", path, key)));
+    auto it = std::lower_bound(ring.begin(), ring.end(), std::make_pair(point, 0));
+    for (size_t step = 0; step < ring.size() && taken.size() < (size_t) count; step++, it++)
+    {
+        if (it == ring.end())
+            it = ring.begin();
+        if (std::find(taken.begin(), taken.end(), it->second) == taken.end())
+            taken.push_back(it->second);
+    }
+
+    // more fragments than nodes, some of them share one
+    for (int i = 0; i < count; i++)
+        nodes[i] = numbers[taken[i % taken.size()]];
+    return nodes;
+}
+
+void PlacementMap::load(const std::vector<std::string>& nodes)
+{
+    // the layouts as "version <v> <nodes>" lines followed by the node names, the current one first
+    std::vector<std::shared_ptr<PlacementLayout>> layouts;
+    std::ifstream input(file);
+    std::string line;
+    while (!file.empty() && input && std::getline(input, line))
+    {
+        std::istringstream header(line);
+        std::string word;
+        uint32_t version;
+        size_t count;
+        if (!(header >> word >> version >> count) || word != "version")
+            throw std::runtime_error(std::format("PlacementMap: Invalid line in {}: {}", file, line));
+
+        std::vector<std::string> members(count);
+        for (std::string& member : members)
+            if (!std::getline(input, member))
+                throw std::runtime_error(std::format("PlacementMap: {} ends in version {}.", file, version));
+        layouts.push_back(std::make_shared<PlacementLayout>(version, members));
+    }
+
+    if (layouts.empty())
+    {
+        // the stripes stored so far, if any, are where the round robin put them
+        layouts.push_back(std::make_shared<PlacementLayout>(0, nodes));
+    }
+    else
+    {
+        // a ring only cares about who the nodes are, the round robin about their order too
+        std::vector<std::string> members = layouts.front()->get_members(), names = nodes;
+        if (layouts.front()->get_version() != 0)
+        {
+            std::sort(members.begin(), members.end());
+            std::sort(names.begin(), names.end());
+        }
+
+        if (members != names)
+        {
+            uint32_t version = layouts.front()->get_version() + 1;
+            SPDLOG_INFO("PlacementMap: The storage nodes changed, placement version {} over {} nodes.", version, nodes.size());
+            layouts.insert(layouts.begin(), std::make_shared<PlacementLayout>(version, nodes));
+        }
+    }
+
+    for (auto& layout : layouts)
+        layout->bind(nodes);
+    current = layouts.front();
+    older.assign(layouts.begin() + 1, layouts.end());
+}
+
+void PlacementMap::save() const
+{
+    if (file.empty())
+        return;
+
+    // written aside and renamed, a crash leaves the old file or the new one
+    std::string temporary = file + ".tmp";
+    {
+        std::ofstream output(temporary, std::ios::trunc);
+        auto write = [&output](const PlacementLayout& layout) {
+            output << "version " << layout.get_version() << " " << layout.get_members().size() << "\n";
+            for (const std::string& member : layout.get_members())
+                output << member << "\n";
+        };
+        write(*current);
+        for (const auto& layout : older)
+            write(*layout);
+        if (!output.flush())
+            throw std::runtime_error(std::format("PlacementMap: Cannot write {}.", temporary));
+    }
+
+    if (std::rename(temporary.c_str(), file.c_str()) != 0)
+        throw std::runtime_error(std::format("PlacementMap: Cannot replace {}: {}", file, std::strerror(errno)));
+}
+
+PlacementMap::PlacementMap(const std::string& file, const std::vector<std::string>& nodes)
+    : file(file)
+{
+    load(nodes);
+    save();
+    moving = !older.empty();
+
+    SPDLOG_INFO("Placement: version {}{}", current->get_version(),
+        moving ? std::format(", stripes of {} older versions to move", older.size()) : "");
+}
+
+std::shared_ptr<const PlacementLayout> PlacementMap::get_current() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+std::vector<std::shared_ptr<const PlacementLayout>> PlacementMap::get_older() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return older;
+}
+
+bool PlacementMap::is_moving() const
+{
+    return moving.load(std::memory_order_acquire);
+}
+
+void PlacementMap::finish_move()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    older.clear();
+    save();
+    moving.store(false, std::memory_order_release);
+    SPDLOG_INFO("Placement: Every stripe follows version {}.", current->get_version());
+}
+
+std::mutex& PlacementMap::get_path_lock(const std::string& path)
+{
+    return path_locks[Utils::hash_path(path) % path_locks.size()];
+}
@@ -0,0 +1,78 @@
+#ifndef PLACEMENT_MAP_HPP
+#define PLACEMENT_MAP_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace StorageAPI {
+    // One version of the placement of the stripes: the nodes it was made for, by
+    // name, and how a key (a stripe of a replicated file, a group of an erasure
+    // coded one) maps onto them. Version 0 is the round robin placement the stripes
+    // had before the layouts existed, the later versions are consistent hashing
+    // rings with virtual_nodes points per node, so a node that joins or leaves only
+    // takes or gives away its share of the keys.
+    class PlacementLayout {
+    private:
+        static const int virtual_nodes;
+
+        uint32_t version;
+        std::vector<std::string> members;
+        std::vector<int> numbers; // transport node of each member, 0 when it is gone
+        std::vector<std::pair<uint64_t, int>> ring; // (point, member), sorted
+
+    public:
+        PlacementLayout(uint32_t version, const std::vector<std::string>& members);
+
+        uint32_t get_version() const;
+        const std::vector<std::string>& get_members() const;
+        // finds the members among the nodes of the transport, node n is nodes[n - 1]
+        void bind(const std::vector<std::string>& nodes);
+
+        // the count nodes holding the copies or the fragments of key in path, distinct
+        // while there are enough of them; in the round robin layout consecutive keys
+        // start stride nodes apart. A member that is gone is node 0.
+        std::vector<int> get_nodes(const std::string& path, size_t key, int count, int stride) const;
+    };
+
+    // The current layout of the stripes and the older ones some of them may still
+    // follow, until the rebalancing moved them (StripeRebalancer). A change of the
+    // nodes since the last run makes a new version. Saved to file, so the layouts
+    // survive the restarts of the manager.
+    class PlacementMap {
+    private:
+        std::string file; // empty when the layouts are not kept
+        mutable std::mutex mutex;
+        std::shared_ptr<const PlacementLayout> current;
+        std::vector<std::shared_ptr<const PlacementLayout>> older; // newest first
+        std::atomic<bool> moving{false};
+        std::array<std::mutex, 64> path_locks;
+
+        void load(const std::vector<std::string>& nodes);
+        void save() const;
+
+    public:
+        PlacementMap(const PlacementMap&) = delete;
+        PlacementMap& operator= (const PlacementMap&) = delete;
+
+        // nodes are the names of the nodes of the transport (Transport::get_node_name);
+        // without a file every run starts with the round robin layout over them
+        PlacementMap(const std::string& file, const std::vector<std::string>& nodes);
+
+        std::shared_ptr<const PlacementLayout> get_current() const;
+        std::vector<std::shared_ptr<const PlacementLayout>> get_older() const;
+        // some stripes may not be where the current layout puts them
+        bool is_moving() const;
+        // every stripe follows the current layout, the older ones are dropped
+        void finish_move();
+
+        // serializes the moves and the removals of the stripes of a path
+        std::mutex& get_path_lock(const std::string& path);
+    };
+}
+
+#endif
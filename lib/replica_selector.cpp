@@ -0,0 +1,132 @@
+#include "replica_selector.hpp"
+
+using namespace StorageAPI;
+
+const size_t ReplicaSelector::latency_window = 1024;
+
+ReplicaSelector::ReplicaSelector(int first_node, int node_count, int replica_count, double hedge_percentile)
+    : first_node(first_node)
+    , node_count(node_count)
+    , replica_count(std::clamp(replica_count, 1, std::max(node_count, 1)))
+    , hedge_percentile(hedge_percentile)
+    , loads(std::make_unique<NodeLoad[]>(std::max(node_count, 1)))
+    , next_sample(0)
+    , hedge_delay_us(0)
+{
+    if (node_count <= 0)
+        throw std::runtime_error("ReplicaSelector: No storage nodes available.");
+
+    if (replica_count > node_count)
+        SPDLOG_WARN("ReplicaSelector: {} replicas requested, but only {} nodes are available.", replica_count, node_count);
+
+    latency_samples.reserve(latency_window);
+}
+
+int ReplicaSelector::get_replica_count() const
+{
+    return replica_count;
+}
+
+bool ReplicaSelector::hedging_enabled() const
+{
+    return hedge_percentile > 0 && replica_count > 1;
+}
+
+int ReplicaSelector::pick(const std::vector<int>& replicas, const std::vector<bool>& tried) const
+{
+    int best = -1;
+    uint64_t best_cost = 0;
+
+    for (size_t r = 0; r < replicas.size(); r ++)
+    {
+        if (tried[r])
+            continue;
+
+        const NodeLoad& load = loads[replicas[r] - first_node];
+        // expected wait: requests in front of us times the usual response time
+        uint64_t cost = (load.outstanding.load(std::memory_order_relaxed) + 1)
+            * std::max<uint64_t>(load.latency_us.load(std::memory_order_relaxed), 1);
+
+        if (best == -1 || cost < best_cost)
+        {
+            best = r;
+            best_cost = cost;
+        }
+    }
+
+    return best;
+}
+
+void ReplicaSelector::start_request(int node)
+{
+    loads[node - first_node].outstanding.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ReplicaSelector::end_request(int node, std::chrono::steady_clock::time_point start)
+{
+    uint64_t latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    NodeLoad& load = loads[node - first_node];
+    load.outstanding.fetch_sub(1, std::memory_order_relaxed);
+
+    // exponential moving average with a weight of 1/8 for the new sample
+    uint64_t old_latency = load.latency_us.load(std::memory_order_relaxed);
+    uint64_t new_latency = old_latency == 0 ? latency_us : (old_latency * 7 + latency_us) / 8;
+    load.latency_us.store(new_latency, std::memory_order_relaxed);
+
+    if (hedging_enabled())
+        record_latency(latency_us);
+}
+
+void ReplicaSelector::record_latency(uint64_t latency_us)
+{
+    std::lock_guard<std::mutex> lock(latency_mutex);
+
+    if (latency_samples.size() < latency_window)
+        latency_samples.push_back(latency_us);
+    else
+        latency_samples[next_sample] = latency_us;
+    next_sample = (next_sample + 1) % latency_window;
+
+    // recomputing the percentile on every sample is not worth it
+    if (next_sample % 64 != 0 || latency_samples.size() < 64)
+        return;
+
+    std::vector<uint64_t> sorted = latency_samples;
+    size_t index = static_cast<size_t>(sorted.size() * hedge_percentile / 100.0);
+    index = std::min(index, sorted.size() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    hedge_delay_us.store(sorted[index], std::memory_order_relaxed);
+}
+
+uint64_t ReplicaSelector::get_hedge_delay_us() const
+{
+    if (!hedging_enabled())
+        return 0;
+    return hedge_delay_us.load(std::memory_order_relaxed);
+}
+
+void ReplicaSelector::adopt(int node, std::chrono::steady_clock::time_point start, std::unique_ptr<Transport::Call>&& call)
+{
+    std::lock_guard<std::mutex> lock(pending_mutex);
+    pending.push_back({node, start, std::move(call)});
+}
+
+void ReplicaSelector::reap()
+{
+    std::lock_guard<std::mutex> lock(pending_mutex);
+
+    for (size_t i = 0; i < pending.size(); )
+    {
+        PendingRequest& request = pending[i];
+        if (request.call->test())
+        {
+            end_request(request.node, request.start);
+            pending[i] = std::move(pending.back());
+            pending.pop_back();
+        }
+        else
+            i ++;
+    }
+}
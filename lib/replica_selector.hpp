@@ -0,0 +1,69 @@
+#ifndef REPLICA_SELECTOR_HPP
+#define REPLICA_SELECTOR_HPP
+
+#include "utils.hpp"
+#include "transport.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace StorageAPI {
+    // Keeps track of how loaded each storage node is, so reads can go to the
+    // replica that should answer first (PlacementMap knows where they live).
+    // One instance is shared by all the connection handlers of a storage manager.
+    class ReplicaSelector {
+    private:
+        struct NodeLoad {
+            std::atomic<int> outstanding{0}; // requests sent and not answered yet
+            std::atomic<uint64_t> latency_us{0}; // moving average of the response time
+        };
+
+        // a hedged request that lost the race, its reply still has to be received
+        struct PendingRequest {
+            int node;
+            std::chrono::steady_clock::time_point start;
+            std::unique_ptr<Transport::Call> call;
+        };
+
+        static const size_t latency_window;
+
+        int first_node, node_count, replica_count;
+        double hedge_percentile;
+        std::unique_ptr<NodeLoad[]> loads;
+
+        std::mutex latency_mutex;
+        std::vector<uint64_t> latency_samples; // ring of the last latency_window response times
+        size_t next_sample;
+        std::atomic<uint64_t> hedge_delay_us;
+
+        std::mutex pending_mutex;
+        std::vector<PendingRequest> pending;
+
+        void record_latency(uint64_t latency_us);
+
+    public:
+        ReplicaSelector(const ReplicaSelector&) = delete;
+        ReplicaSelector& operator= (const ReplicaSelector&) = delete;
+
+        ReplicaSelector(int first_node, int node_count, int replica_count, double hedge_percentile);
+
+        int get_replica_count() const;
+        bool hedging_enabled() const;
+
+        // least loaded replica that was not tried yet, -1 if all of them were
+        int pick(const std::vector<int>& replicas, const std::vector<bool>& tried) const;
+
+        void start_request(int node);
+        void end_request(int node, std::chrono::steady_clock::time_point start);
+
+        // how long to wait for a replica before sending a hedged request, 0 when unknown
+        uint64_t get_hedge_delay_us() const;
+
+        // takes ownership of an unfinished request so its buffers outlive the caller
+        void adopt(int node, std::chrono::steady_clock::time_point start, std::unique_ptr<Transport::Call>&& call);
+        // completes the adopted requests whose replies arrived in the meantime
+        void reap();
+    };
+}
+
+#endif
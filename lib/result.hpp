@@ -0,0 +1,85 @@
+#ifndef RESULT_HPP
+#define RESULT_HPP
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <variant>
+
+// A value, or the errno of why there is none, in the manner of std::expected (the
+// tree builds as C++20). The failures a request expects, a missing path or a name
+// already taken, are returned this way on the request paths instead of being thrown
+// and caught again at every level; value() turns them into the usual exception, with
+// errno set, for the callers that cannot do anything else with them.
+namespace Utils {
+    struct Error {
+        int code; // errno
+    };
+
+    inline Error last_error()
+    {
+        return Error {errno};
+    }
+
+    template <typename T>
+    class Result {
+    private:
+        std::variant<T, Error> content;
+
+        void check() const
+        {
+            if (!has_value())
+            {
+                errno = error();
+                throw std::runtime_error(std::strerror(errno));
+            }
+        }
+
+    public:
+        Result(T value) : content(std::in_place_index<0>, std::move(value)) {}
+        Result(Error error) : content(std::in_place_index<1>, error) {}
+
+        bool has_value() const { return content.index() == 0; }
+        explicit operator bool() const { return has_value(); }
+        // 0 when there is a value
+        int error() const { return has_value() ? 0 : std::get<1>(content).code; }
+
+        // unchecked, the caller tested has_value
+        T& operator*() { return std::get<0>(content); }
+        const T& operator*() const { return std::get<0>(content); }
+        T* operator->() { return &std::get<0>(content); }
+        const T* operator->() const { return &std::get<0>(content); }
+
+        T& value() & { check(); return std::get<0>(content); }
+        const T& value() const& { check(); return std::get<0>(content); }
+        T&& value() && { check(); return std::move(std::get<0>(content)); }
+    };
+
+    template <>
+    class Result<void> {
+    private:
+        int code;
+
+    public:
+        Result() : code(0) {}
+        Result(Error error) : code(error.code) {}
+
+        bool has_value() const { return code == 0; }
+        explicit operator bool() const { return has_value(); }
+        int error() const { return code; }
+
+        void value() const
+        {
+            if (!has_value())
+            {
+                errno = code;
+                throw std::runtime_error(std::strerror(errno));
+            }
+        }
+    };
+
+    using Status = Result<void>;
+}
+
+#endif
@@ -0,0 +1,281 @@
+#include "sharded_cache_client.hpp"
+#include <algorithm>
+
+using namespace CacheAPI;
+
+// private
+int ShardedCacheClient::get_depth(const std::string& path)
+{
+    if (path == "/")
+        return 0;
+    return std::count(path.begin(), path.end(), '/');
+}
+
+size_t ShardedCacheClient::get_dir_shard(const std::string& path) const
+{
+    if (shards.size() == 1 || get_depth(path) < subtree_depth)
+        return 0;
+
+    // the root of the subtree: the path up to the slash after its subtree_depth components
+    size_t end = 0;
+    for (int i = 0; i < subtree_depth && end != std::string::npos; i++)
+        end = path.find('/', end + 1);
+    return Utils::hash_path(path.substr(0, end)) % shards.size();
+}
+
+size_t ShardedCacheClient::get_entry_shard(const std::string& path) const
+{
+    return get_dir_shard(Utils::get_parent_dir(path));
+}
+
+int ShardedCacheClient::set_subtree_root(const std::string& key, const std::string& value)
+{
+    CacheClient& parent = *shards[get_entry_shard(key)];
+    CacheClient& subtree = *shards[get_dir_shard(key)];
+
+    // the entry first, it fails when the parent is missing or the name is taken
+    int error = parent.set_entry(key);
+    if (error != 0)
+        return error;
+
+    error = subtree.set_dir(key, value);
+    if (error == ENOENT)
+    {
+        // the first subtree of its parent on that server, the directories above it
+        // are only there for the hierarchy
+        for (size_t end = key.find('/', 1); end != std::string::npos; end = key.find('/', end + 1))
+            subtree.set_entry(key.substr(0, end));
+        error = subtree.set_dir(key, value);
+    }
+
+    if (error != 0)
+    {
+        parent.remove_entry(key);
+        return error;
+    }
+
+    // a new directory gets the compression policy of its parent, which is not on that server
+    std::string parent_record = get_dir(Utils::get_parent_dir(key));
+    if (StatRecord::is_valid(parent_record)
+        && StatRecord::get_compression(parent_record) != CompressionCode::Type::NONE)
+        subtree.set_compression(key, CompressionCode::from_byte(StatRecord::get_compression(parent_record)));
+    return 0;
+}
+
+int ShardedCacheClient::remove_subtree_root(const std::string& key)
+{
+    // the subtree first, it fails when the directory is not empty
+    int error = shards[get_dir_shard(key)]->remove_dir(key);
+    if (error != 0)
+        return error;
+    return shards[get_entry_shard(key)]->remove_entry(key);
+}
+
+int ShardedCacheClient::rename_dir(const std::string& old_key, const std::string& new_key)
+{
+    // the subtrees are placed by the path of their root, a directory above them or a subtree
+    // root hashing to another server would take every subtree below it along
+    size_t shard = get_dir_shard(old_key);
+    if (get_depth(old_key) != subtree_depth || get_depth(new_key) != subtree_depth
+        || get_dir_shard(new_key) != shard)
+        return EXDEV;
+
+    int error = shards[shard]->rename(old_key, new_key);
+    size_t parent = get_entry_shard(old_key);
+    if (error != 0 || parent == shard)
+        return error;
+
+    error = shards[parent]->rename(old_key, new_key);
+    if (error != 0)
+        shards[shard]->rename(new_key, old_key);
+    return error;
+}
+
+int ShardedCacheClient::move_file(const std::string& old_key, const std::string& new_key, const std::string& value)
+{
+    // a copy on the new server before the removal, a failure leaves at least one of them
+    int error = shards[get_entry_shard(new_key)]->put_file(new_key, value);
+    if (error != 0)
+        return error;
+    return shards[get_entry_shard(old_key)]->remove_file(old_key);
+}
+
+int ShardedCacheClient::update(const std::string& key, const std::function<int(CacheClient&)>& command)
+{
+    int error = command(*shards[get_entry_shard(key)]);
+    if (error == EREMOTE)
+        error = command(*shards[get_dir_shard(key)]);
+    return error;
+}
+
+// public
+ShardedCacheClient::ShardedCacheClient()
+    : ShardedCacheClient(1) // default: a subtree per top level directory
+{}
+
+ShardedCacheClient::ShardedCacheClient(int subtree_depth)
+    : subtree_depth(subtree_depth)
+    , negative_timeout(1000)
+{}
+
+void ShardedCacheClient::connect(const std::vector<std::string>& servers)
+{
+    if (servers.empty())
+        throw std::runtime_error("connect: No cache server.");
+
+    shards.clear();
+    for (const std::string& server : servers)
+    {
+        size_t separator = server.rfind(':');
+        if (separator == std::string::npos)
+            throw std::runtime_error(std::format("connect: {} is not address:port.", server));
+
+        shards.push_back(std::make_unique<CacheClient>());
+        shards.back()->set_negative_timeout(negative_timeout);
+        shards.back()->connect(server.substr(0, separator), server.substr(separator + 1));
+    }
+    SPDLOG_INFO("ShardedCacheClient: {} cache servers, subtrees at depth {}", shards.size(), subtree_depth);
+}
+
+void ShardedCacheClient::connect(const std::string& address, const std::string& port)
+{
+    connect(std::vector<std::string> {std::format("{}:{}", address, port)});
+}
+
+void ShardedCacheClient::set_subtree_depth(int depth)
+{
+    if (depth < 1)
+        throw std::runtime_error(std::format("set_subtree_depth: Invalid depth {}.", depth));
+    subtree_depth = depth;
+}
+
+void ShardedCacheClient::set_negative_timeout(std::chrono::milliseconds timeout)
+{
+    negative_timeout = timeout;
+    for (auto& shard : shards)
+        shard->set_negative_timeout(timeout);
+}
+
+size_t ShardedCacheClient::get_shard_count() const
+{
+    return shards.size();
+}
+
+int ShardedCacheClient::set_file(const std::string& key, const std::string& value)
+{
+    return shards[get_entry_shard(key)]->set_file(key, value);
+}
+
+int ShardedCacheClient::set_dir(const std::string& key, const std::string& value)
+{
+    if (get_entry_shard(key) != get_dir_shard(key))
+        return set_subtree_root(key, value);
+    return shards[get_dir_shard(key)]->set_dir(key, value);
+}
+
+std::string ShardedCacheClient::get_file(const std::string& key)
+{
+    return shards[get_entry_shard(key)]->get_file(key);
+}
+
+std::string ShardedCacheClient::get_dir(const std::string& key)
+{
+    return shards[get_dir_shard(key)]->get_dir(key);
+}
+
+int ShardedCacheClient::remove_file(const std::string& key)
+{
+    return shards[get_entry_shard(key)]->remove_file(key);
+}
+
+int ShardedCacheClient::remove_dir(const std::string& key)
+{
+    if (get_entry_shard(key) != get_dir_shard(key))
+        return remove_subtree_root(key);
+    return shards[get_dir_shard(key)]->remove_dir(key);
+}
+
+int ShardedCacheClient::chmod(const std::string& key, mode_t new_mode)
+{
+    return update(key, [&](CacheClient& shard) { return shard.chmod(key, new_mode); });
+}
+
+int ShardedCacheClient::chown(const std::string& key, uid_t new_uid, gid_t new_gid)
+{
+    return update(key, [&](CacheClient& shard) { return shard.chown(key, new_uid, new_gid); });
+}
+
+int ShardedCacheClient::chsize(const std::string& key, off_t new_size)
+{
+    return update(key, [&](CacheClient& shard) { return shard.chsize(key, new_size); });
+}
+
+void ShardedCacheClient::get_file(const std::string& key, std::function<void(std::string)> done)
+{
+    shards[get_entry_shard(key)]->get_file(key, std::move(done));
+}
+
+void ShardedCacheClient::get_dir(const std::string& key, std::function<void(std::string)> done)
+{
+    shards[get_dir_shard(key)]->get_dir(key, std::move(done));
+}
+
+void ShardedCacheClient::chsize(const std::string& key, off_t new_size, std::function<void(int)> done)
+{
+    // as update: the server keeping the object answers EREMOTE when the listing one is asked
+    CacheClient* dir_shard = shards[get_dir_shard(key)].get();
+    shards[get_entry_shard(key)]->chsize(key, new_size,
+        [dir_shard, key, new_size, done = std::move(done)] (int error) {
+            if (error == EREMOTE)
+                dir_shard->chsize(key, new_size, done);
+            else
+                done(error);
+        });
+}
+
+int ShardedCacheClient::extend(const std::string& key, off_t new_size)
+{
+    return update(key, [&](CacheClient& shard) { return shard.extend(key, new_size); });
+}
+
+void ShardedCacheClient::extend(const std::string& key, off_t new_size, std::function<void(int)> done)
+{
+    // as chsize
+    CacheClient* dir_shard = shards[get_dir_shard(key)].get();
+    shards[get_entry_shard(key)]->extend(key, new_size,
+        [dir_shard, key, new_size, done = std::move(done)] (int error) {
+            if (error == EREMOTE)
+                dir_shard->extend(key, new_size, done);
+            else
+                done(error);
+        });
+}
+
+void ShardedCacheClient::watch(std::function<void(const std::string&, InvalidationCode::Type)> handler)
+{
+    for (auto& shard : shards)
+        shard->watch(handler);
+}
+
+int ShardedCacheClient::set_compression(const std::string& key, CompressionCode::Type codec)
+{
+    return update(key, [&](CacheClient& shard) { return shard.set_compression(key, codec); });
+}
+
+int ShardedCacheClient::rename(const std::string& old_key, const std::string& new_key)
+{
+    size_t old_shard = get_entry_shard(old_key);
+    size_t new_shard = get_entry_shard(new_key);
+
+    // inside the subtrees of one server a directory and everything in it moves with it
+    if (shards.size() == 1
+        || (old_shard == new_shard && get_depth(old_key) > subtree_depth && get_depth(new_key) > subtree_depth))
+        return shards[old_shard]->rename(old_key, new_key);
+
+    std::string value = shards[old_shard]->get_file(old_key);
+    if (value.empty())
+        return rename_dir(old_key, new_key);
+    if (old_shard == new_shard)
+        return shards[old_shard]->rename(old_key, new_key);
+    return move_file(old_key, new_key, value);
+}
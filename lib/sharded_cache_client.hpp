@@ -0,0 +1,74 @@
+#ifndef SHARDED_CACHE_CLIENT_HPP
+#define SHARDED_CACHE_CLIENT_HPP
+
+#include "cache_client.hpp"
+#include <functional>
+
+namespace CacheAPI {
+    // Splits the namespace between several cache servers by subtree. The directories at
+    // subtree_depth ("/a" for 1, "/a/b" for 2) are the roots of the subtrees, each subtree
+    // is kept by the server its root hashes to (Utils::hash_path), the directories above them
+    // by the first server. The root of a subtree is the only object on two servers: the server
+    // of its parent lists it, the server of the subtree keeps its metadata. With one server it
+    // is a CacheClient.
+    //
+    // A rename inside a server is done by that server. A file renamed into another subtree is
+    // copied to the server of the new parent and removed from the old one, a directory whose
+    // subtree would have to move answers EXDEV (mv copies it then).
+    class ShardedCacheClient {
+    private:
+        int subtree_depth;
+        std::chrono::milliseconds negative_timeout;
+        std::vector<std::unique_ptr<CacheClient>> shards;
+
+        static int get_depth(const std::string& path);
+        // server keeping the metadata of the directory and its entries
+        size_t get_dir_shard(const std::string& path) const;
+        // server listing the object in its parent, the one keeping it unless it is a subtree root
+        size_t get_entry_shard(const std::string& path) const;
+
+        int set_subtree_root(const std::string& key, const std::string& value);
+        int remove_subtree_root(const std::string& key);
+        int rename_dir(const std::string& old_key, const std::string& new_key);
+        int move_file(const std::string& old_key, const std::string& new_key, const std::string& value);
+        // sent to the server listing the object, then to the one keeping it if that is another server
+        int update(const std::string& key, const std::function<int(CacheClient&)>& command);
+
+    public:
+        ShardedCacheClient(const ShardedCacheClient&) = delete;
+        ShardedCacheClient& operator= (const ShardedCacheClient&) = delete;
+
+        ShardedCacheClient();
+        ShardedCacheClient(int subtree_depth);
+
+        // the servers as address:port, all the clients have to list them in the same order
+        void connect(const std::vector<std::string>& servers);
+        void connect(const std::string& address, const std::string& port);
+        void set_subtree_depth(int depth);
+        // see CacheClient::set_negative_timeout, kept for the servers connected later too
+        void set_negative_timeout(std::chrono::milliseconds timeout);
+        size_t get_shard_count() const;
+
+        int set_file(const std::string& key, const std::string& value);
+        int set_dir(const std::string& key, const std::string& value);
+        std::string get_file(const std::string& key);
+        std::string get_dir(const std::string& key);
+        int remove_file(const std::string& key);
+        int remove_dir(const std::string& key);
+        int chmod(const std::string& key, mode_t new_mode);
+        int chown(const std::string& key, uid_t new_uid, gid_t new_gid);
+        int chsize(const std::string& key, off_t new_size);
+        int extend(const std::string& key, off_t new_size);
+        int rename(const std::string& old_key, const std::string& new_key);
+        int set_compression(const std::string& key, CompressionCode::Type codec);
+        // the same without waiting, done gets the result on a thread of a CacheClient
+        void get_file(const std::string& key, std::function<void(std::string)> done);
+        void get_dir(const std::string& key, std::function<void(std::string)> done);
+        void chsize(const std::string& key, off_t new_size, std::function<void(int)> done);
+        void extend(const std::string& key, off_t new_size, std::function<void(int)> done);
+        // see CacheClient::watch, handler hears from every server
+        void watch(std::function<void(const std::string&, InvalidationCode::Type)> handler);
+    };
+}
+
+#endif
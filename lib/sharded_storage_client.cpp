@@ -0,0 +1,80 @@
+#include "sharded_storage_client.hpp"
+
+using namespace StorageAPI;
+
+// private
+StorageClient& ShardedStorageClient::get_manager(const std::string& path)
+{
+    if (managers.size() == 1)
+        return *managers[0];
+    return *managers[Utils::hash_path(path) % managers.size()];
+}
+
+// public
+ShardedStorageClient::ShardedStorageClient(size_t stripe_size)
+    : ShardedStorageClient(1, stripe_size) {}
+
+ShardedStorageClient::ShardedStorageClient(int thread_count, size_t stripe_size)
+    : thread_count(thread_count)
+    , stripe_size(stripe_size) {}
+
+void ShardedStorageClient::connect(const std::vector<std::string>& servers)
+{
+    if (servers.empty())
+        throw std::runtime_error("connect: No storage manager.");
+
+    managers.clear();
+    for (const std::string& server : servers)
+    {
+        size_t separator = server.rfind(':');
+        if (separator == std::string::npos)
+            throw std::runtime_error(std::format("connect: {} is not address:port.", server));
+
+        managers.push_back(std::make_unique<StorageClient>(thread_count, stripe_size));
+        managers.back()->connect(server.substr(0, separator), server.substr(separator + 1));
+    }
+    SPDLOG_INFO("ShardedStorageClient: {} storage managers", managers.size());
+}
+
+void ShardedStorageClient::connect(const std::string& address, const std::string& port)
+{
+    connect(std::vector<std::string> {std::format("{}:{}", address, port)});
+}
+
+size_t ShardedStorageClient::get_manager_count() const
+{
+    return managers.size();
+}
+
+int ShardedStorageClient::read(const std::string& path, char* buffer, size_t size, off_t offset)
+{
+    return get_manager(path).read(path, buffer, size, offset);
+}
+
+int ShardedStorageClient::write(const std::string& path, const char* buffer, size_t size, off_t offset,
+    CompressionCode::Type compression)
+{
+    return get_manager(path).write(path, buffer, size, offset, compression);
+}
+
+void ShardedStorageClient::read(const std::string& path, char* buffer, size_t size, off_t offset, uint64_t trace_id,
+    std::function<void(int)> done)
+{
+    get_manager(path).read(path, buffer, size, offset, trace_id, std::move(done));
+}
+
+void ShardedStorageClient::write(const std::string& path, const char* buffer, size_t size, off_t offset,
+    CompressionCode::Type compression, uint64_t trace_id, std::function<void(int)> done)
+{
+    get_manager(path).write(path, buffer, size, offset, compression, trace_id, std::move(done));
+}
+
+int ShardedStorageClient::remove(const std::string& path, int64_t file_size)
+{
+    return get_manager(path).remove(path, file_size);
+}
+
+off_t ShardedStorageClient::seek(const std::string& path, off_t offset, int whence, size_t file_size)
+{
+    return get_manager(path).seek(path, offset, whence, file_size);
+}
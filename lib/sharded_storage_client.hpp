@@ -0,0 +1,44 @@
+#ifndef SHARDED_STORAGE_CLIENT_HPP
+#define SHARDED_STORAGE_CLIENT_HPP
+
+#include "storage_client.hpp"
+
+namespace StorageAPI {
+    // Spreads the files over several storage managers sharing the storage nodes, a file
+    // goes to the manager its path hashes to (Utils::hash_path). All the requests of a file
+    // go through one manager, what that manager knows about the file (its holes, a pending
+    // removal) stays true. With one manager it is a StorageClient.
+    class ShardedStorageClient {
+    private:
+        int thread_count;
+        size_t stripe_size;
+        std::vector<std::unique_ptr<StorageClient>> managers;
+
+        StorageClient& get_manager(const std::string& path);
+
+    public:
+        ShardedStorageClient(const ShardedStorageClient&) = delete;
+        ShardedStorageClient& operator= (const ShardedStorageClient&) = delete;
+
+        ShardedStorageClient(size_t stripe_size);
+        ShardedStorageClient(int thread_count, size_t stripe_size);
+
+        // the managers as address:port, all the clients have to list them in the same order
+        void connect(const std::vector<std::string>& servers);
+        void connect(const std::string& address, const std::string& port);
+        size_t get_manager_count() const;
+
+        // same as StorageClient
+        int read(const std::string& path, char* buffer, size_t size, off_t offset);
+        int write(const std::string& path, const char* buffer, size_t size, off_t offset,
+            CompressionCode::Type compression = CompressionCode::Type::NONE);
+        void read(const std::string& path, char* buffer, size_t size, off_t offset, uint64_t trace_id,
+            std::function<void(int)> done);
+        void write(const std::string& path, const char* buffer, size_t size, off_t offset,
+            CompressionCode::Type compression, uint64_t trace_id, std::function<void(int)> done);
+        int remove(const std::string& path, int64_t file_size = -1);
+        off_t seek(const std::string& path, off_t offset, int whence, size_t file_size);
+    };
+}
+
+#endif
@@ -0,0 +1,359 @@
+#include "shm_channel.hpp"
+
+#include <climits>
+#include <csignal>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+namespace ShmChannel {
+    constexpr uint64_t segment_magic = 0x316d68735f736664; // "dfs_shm1"
+    constexpr uint32_t empty_entry = UINT32_MAX;
+    constexpr uint32_t too_large = UINT32_MAX; // size of a response that did not fit its slot
+
+    enum SlotState : uint32_t {
+        FREE = 0,
+        CLAIMED, // a client is copying its request in
+        REQUEST, // on the ring or being handled
+        RESPONSE, // the client has not copied the response out yet
+    };
+
+    // at the start of the shared memory, followed by the ring of slot_count
+    // entries and the slots, each slot_stride bytes long
+    struct Segment {
+        uint64_t magic;
+        uint64_t nonce; // tells this server from an earlier one with the same name
+        pid_t server_pid;
+        uint32_t slot_count;
+        uint64_t slot_size;
+        uint64_t slot_stride;
+        uint64_t slots_offset;
+        std::atomic<uint32_t> closed;
+
+        alignas(64) std::atomic<uint64_t> tail; // next ring position to fill
+        alignas(64) std::atomic<uint32_t> doorbell; // rung for every submission
+        std::atomic<uint32_t> server_waiting; // the server sleeps on the doorbell
+        alignas(64) std::atomic<uint32_t> completions; // rung for every response
+
+        std::atomic<uint32_t>* ring() { return reinterpret_cast<std::atomic<uint32_t>*>(this + 1); }
+    };
+
+    struct Slot {
+        std::atomic<uint32_t> state;
+        uint32_t size;
+
+        uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+    };
+
+    template <typename Handler>
+    struct Client::HandlerWaiter : Client::Waiter {
+        Handler handler;
+
+        HandlerWaiter(Handler&& handler) : handler(std::move(handler)) {}
+
+        void complete() override
+        {
+            auto executor = asio::get_associated_executor(handler);
+            asio::post(executor, std::move(handler));
+        }
+    };
+}
+
+using namespace ShmChannel;
+
+namespace {
+    static_assert(std::atomic<uint32_t>::is_always_lock_free && sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+
+    size_t align(size_t size)
+    {
+        return (size + 63) & ~size_t(63);
+    }
+
+    // the words live in memory shared between processes, so no FUTEX_PRIVATE_FLAG
+    long futex_wait(std::atomic<uint32_t>& word, uint32_t expected, const timespec* timeout)
+    {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+    }
+
+    void futex_wake(std::atomic<uint32_t>& word)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+// Server
+
+Server::Server(const std::string& name, uint32_t slot_count, size_t slot_size)
+    : name(name)
+{
+    size_t slot_stride = align(sizeof(Slot) + slot_size);
+    size_t slots_offset = align(sizeof(Segment) + slot_count * sizeof(uint32_t));
+    segment_size = slots_offset + slot_count * slot_stride;
+
+    shm_unlink(name.c_str()); // left behind by a server that crashed
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        throw std::runtime_error(std::format("ShmChannel::Server: {}: {}", name, std::strerror(errno)));
+
+    if (ftruncate(fd, segment_size) != 0)
+    {
+        int error = errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error(std::format("ShmChannel::Server: {}: {}", name, std::strerror(error)));
+    }
+
+    void* memory = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        throw std::runtime_error(std::format("ShmChannel::Server: {}: {}", name, std::strerror(errno)));
+    }
+
+    std::random_device random;
+    segment = new (memory) Segment();
+    segment->nonce = (uint64_t) random() << 32 | random();
+    segment->server_pid = getpid();
+    segment->slot_count = slot_count;
+    segment->slot_size = slot_size;
+    segment->slot_stride = slot_stride;
+    segment->slots_offset = slots_offset;
+    for (uint32_t i = 0; i < slot_count; i++)
+    {
+        new (&segment->ring()[i]) std::atomic<uint32_t>(empty_entry);
+        new (&get_slot(i)) Slot();
+    }
+    segment->magic = segment_magic; // last, a client checks it first
+
+    SPDLOG_INFO("Shared memory channel {}: {} slots of {} bytes", name, slot_count, slot_size);
+}
+
+Server::~Server()
+{
+    stopping = true;
+    segment->closed.store(1);
+    segment->completions.fetch_add(1);
+    futex_wake(segment->completions);
+    segment->doorbell.fetch_add(1);
+    futex_wake(segment->doorbell);
+    if (thread.joinable())
+        thread.join();
+
+    munmap(segment, segment_size);
+    shm_unlink(name.c_str());
+}
+
+Slot& Server::get_slot(uint32_t slot)
+{
+    uint8_t* base = reinterpret_cast<uint8_t*>(segment) + segment->slots_offset;
+    return *reinterpret_cast<Slot*>(base + slot * segment->slot_stride);
+}
+
+void Server::start(asio::io_context& context, Handler handler)
+{
+    this->handler = std::move(handler);
+    thread = std::thread(&Server::serve, this, std::ref(context));
+}
+
+std::string Server::get_address() const
+{
+    return std::format("{} {:x}", name, segment->nonce);
+}
+
+void Server::serve(asio::io_context& context)
+{
+    std::atomic<uint32_t>* ring = segment->ring();
+    uint64_t head = 0;
+
+    while (!stopping.load())
+    {
+        uint32_t ticket = segment->doorbell.load();
+        std::atomic<uint32_t>& entry = ring[head % segment->slot_count];
+        uint32_t slot = entry.exchange(empty_entry);
+        if (slot == empty_entry)
+        {
+            // a submitter either sees the flag or its entry is seen by the second look
+            segment->server_waiting.store(1);
+            slot = entry.exchange(empty_entry);
+            if (slot == empty_entry)
+                futex_wait(segment->doorbell, ticket, nullptr);
+            segment->server_waiting.store(0);
+            if (slot == empty_entry)
+                continue;
+        }
+
+        head++;
+        if (slot >= segment->slot_count)
+            continue;
+
+        asio::post(context, [this, slot]() {
+            thread_local std::vector<uint8_t> response;
+            Slot& request = get_slot(slot);
+            size_t size = 0;
+            try {
+                size = handler(request.data(), std::min<size_t>(request.size, segment->slot_size), response);
+                if (size <= segment->slot_size)
+                    std::memcpy(request.data(), response.data(), size);
+                else
+                    size = too_large; // the client repeats the request over the socket
+            }
+            catch (std::exception& e)
+            {
+                SPDLOG_ERROR(std::format("ShmChannel::Server: {}", e.what()));
+                size = 0;
+            }
+
+            request.size = size;
+            request.state.store(RESPONSE, std::memory_order_release);
+            segment->completions.fetch_add(1);
+            futex_wake(segment->completions);
+        });
+    }
+}
+
+// Client
+
+Client::Client(const std::string& address)
+{
+    std::stringstream stream(address);
+    std::string name;
+    uint64_t nonce = 0;
+    if (!(stream >> name >> std::hex >> nonce))
+        throw std::runtime_error(std::format("ShmChannel::Client: invalid address {}", address));
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        throw std::runtime_error(std::format("ShmChannel::Client: {}: {}", name, std::strerror(errno)));
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(Segment))
+    {
+        close(fd);
+        throw std::runtime_error(std::format("ShmChannel::Client: {}: not a channel", name));
+    }
+
+    segment_size = info.st_size;
+    void* memory = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+        throw std::runtime_error(std::format("ShmChannel::Client: {}: {}", name, std::strerror(errno)));
+
+    segment = static_cast<Segment*>(memory);
+    if (segment->magic != segment_magic || segment->nonce != nonce
+        || segment->slots_offset + segment->slot_count * segment->slot_stride > segment_size)
+    {
+        munmap(memory, segment_size);
+        throw std::runtime_error(std::format("ShmChannel::Client: {} belongs to another server", name));
+    }
+
+    thread = std::thread(&Client::complete_calls, this);
+}
+
+Client::~Client()
+{
+    stopping = true;
+    segment->completions.fetch_add(1);
+    futex_wake(segment->completions);
+    thread.join();
+
+    waiters.clear();
+    munmap(segment, segment_size);
+}
+
+Slot& Client::get_slot(uint32_t slot)
+{
+    uint8_t* base = reinterpret_cast<uint8_t*>(segment) + segment->slots_offset;
+    return *reinterpret_cast<Slot*>(base + slot * segment->slot_stride);
+}
+
+int Client::claim()
+{
+    uint32_t count = segment->slot_count;
+    uint32_t start = next_slot.fetch_add(1, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t slot = (start + i) % count;
+        uint32_t expected = FREE;
+        if (get_slot(slot).state.compare_exchange_strong(expected, CLAIMED, std::memory_order_acquire))
+            return slot;
+    }
+    return -1;
+}
+
+void Client::submit(uint32_t slot)
+{
+    get_slot(slot).state.store(REQUEST, std::memory_order_release);
+    uint64_t position = segment->tail.fetch_add(1);
+    segment->ring()[position % segment->slot_count].store(slot);
+    segment->doorbell.fetch_add(1);
+    if (segment->server_waiting.load())
+        futex_wake(segment->doorbell);
+}
+
+void Client::complete_calls()
+{
+    timespec timeout {0, 100 * 1000 * 1000}; // how often a silent server is checked on
+    bool timed_out = false;
+
+    while (!stopping.load())
+    {
+        uint32_t ticket = segment->completions.load();
+        if (!broken && (segment->closed.load() || (timed_out && kill(segment->server_pid, 0) != 0 && errno == ESRCH)))
+        {
+            SPDLOG_WARN("Shared memory channel closed, falling back to the socket");
+            broken = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto it = waiters.begin(); it != waiters.end();)
+            {
+                if (broken || get_slot(it->first).state.load(std::memory_order_acquire) == RESPONSE)
+                {
+                    it->second->complete();
+                    it = waiters.erase(it);
+                }
+                else
+                    it++;
+            }
+        }
+
+        timed_out = futex_wait(segment->completions, ticket, &timeout) != 0 && errno == ETIMEDOUT;
+    }
+}
+
+asio::awaitable<bool> Client::call(const std::vector<uint8_t>& request, std::vector<uint8_t>& response)
+{
+    if (broken || request.size() > segment->slot_size)
+        co_return false;
+
+    int slot = claim();
+    if (slot < 0)
+        co_return false;
+
+    Slot& entry = get_slot(slot);
+    std::memcpy(entry.data(), request.data(), request.size());
+    entry.size = request.size();
+
+    // registered before the submission, so the completion cannot be missed
+    co_await asio::async_initiate<decltype(asio::use_awaitable), void()>(
+        [this, slot](auto handler) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                waiters[slot] = std::make_unique<HandlerWaiter<decltype(handler)>>(std::move(handler));
+            }
+            submit(slot);
+        }, asio::use_awaitable);
+
+    bool answered = entry.state.load(std::memory_order_acquire) == RESPONSE;
+    bool fits = answered && entry.size != too_large;
+    if (fits)
+        response.assign(entry.data(), entry.data() + entry.size);
+    entry.state.store(FREE, std::memory_order_release);
+
+    if (!answered)
+        throw std::runtime_error("ShmChannel::Client: the server went away");
+    co_return fits;
+}
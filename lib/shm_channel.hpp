@@ -0,0 +1,92 @@
+#ifndef SHM_CHANNEL_HPP
+#define SHM_CHANNEL_HPP
+
+#include "utils.hpp"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// Request / response channel between a server and the clients on its host,
+// through a POSIX shared memory segment instead of a socket. The segment holds
+// a pool of slots of one packet each and a submission ring of slot numbers:
+// a client copies its serialized request into a free slot and pushes the slot
+// on the ring, the server writes the response into the same slot. Both sides
+// sleep on futexes in the segment, the server on a doorbell rung for every
+// submission and the clients on one rung for every response.
+namespace ShmChannel {
+    struct Segment;
+    struct Slot;
+
+    class Server {
+    public:
+        // serializes the response to request into response, returns its size
+        using Handler = std::function<size_t(const uint8_t* request, size_t size, std::vector<uint8_t>& response)>;
+
+    private:
+        std::string name;
+        Segment* segment = nullptr;
+        size_t segment_size = 0;
+        Handler handler;
+        std::thread thread;
+        std::atomic<bool> stopping = false;
+
+        Slot& get_slot(uint32_t slot);
+        void serve(asio::io_context& context);
+
+    public:
+        Server(const Server&) = delete;
+        Server& operator= (const Server&) = delete;
+
+        // creates the segment, replacing a stale one of a previous server
+        Server(const std::string& name, uint32_t slot_count, size_t slot_size);
+        ~Server();
+
+        // handler runs on the threads of context
+        void start(asio::io_context& context, Handler handler);
+        // what a client needs to find the segment, sent in the reply to INIT
+        std::string get_address() const;
+    };
+
+    class Client {
+    private:
+        // a coroutine waiting for the response in a slot
+        struct Waiter {
+            virtual ~Waiter() = default;
+            virtual void complete() = 0;
+        };
+        template <typename Handler>
+        struct HandlerWaiter;
+
+        Segment* segment = nullptr;
+        size_t segment_size = 0;
+        std::mutex mutex;
+        std::map<uint32_t, std::unique_ptr<Waiter>> waiters; // by slot
+        std::atomic<bool> broken = false; // the server is gone, every call fails
+        std::atomic<bool> stopping = false;
+        std::atomic<uint32_t> next_slot = 0; // where the search for a free slot starts
+        std::thread thread;
+
+        Slot& get_slot(uint32_t slot);
+        int claim();
+        void submit(uint32_t slot);
+        void complete_calls();
+
+    public:
+        Client(const Client&) = delete;
+        Client& operator= (const Client&) = delete;
+
+        // maps the segment of the server at address (Server::get_address), throws if
+        // it is not there, as for a server on another host
+        Client(const std::string& address);
+        ~Client();
+
+        // false when the channel cannot carry the request or its response (no free
+        // slot, too large, server gone) and it should go over the socket instead,
+        // throws if the server went away after taking it
+        asio::awaitable<bool> call(const std::vector<uint8_t>& request, std::vector<uint8_t>& response);
+    };
+}
+
+#endif
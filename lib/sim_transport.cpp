@@ -0,0 +1,212 @@
+#include "sim_transport.hpp"
+#include "utils.hpp"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace StorageAPI;
+using Clock = std::chrono::steady_clock;
+
+void LinkProfile::parse(const std::string& profile)
+{
+    std::stringstream stream(profile);
+    std::string field;
+    double* fields[] = {&latency_us, &bandwidth_gbps, &jitter_us};
+
+    try {
+        for (double* value : fields)
+        {
+            if (!std::getline(stream, field, ':'))
+                break;
+            if (!field.empty())
+                *value = std::stod(field);
+        }
+    }
+    catch (std::exception& e)
+    {
+        throw std::runtime_error(std::format("LinkProfile: invalid profile {}", profile));
+    }
+}
+
+namespace {
+    // the reply of a call, filled in by the node
+    struct Reply {
+        std::mutex mutex;
+        std::condition_variable ready;
+        bool done = false;
+        Clock::time_point arrival;
+        std::vector<uint8_t> data;
+    };
+
+    struct Message {
+        int tag; // always 0, the reply goes straight to its call
+        std::vector<uint8_t> data;
+        std::shared_ptr<Reply> reply;
+    };
+
+    class SimCall : public Transport::Call {
+    private:
+        std::shared_ptr<Reply> state;
+        bool done = false;
+
+    public:
+        SimCall(std::shared_ptr<Reply> state) : state(std::move(state)) {}
+
+        bool test() override
+        {
+            if (done)
+                return true;
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (!state->done || Clock::now() < state->arrival)
+                return false;
+            reply.swap(state->data);
+            done = true;
+            return true;
+        }
+
+        void wait() override
+        {
+            if (done)
+                return;
+
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->ready.wait(lock, [this]() { return state->done; });
+            lock.unlock();
+            std::this_thread::sleep_until(state->arrival);
+            lock.lock();
+            reply.swap(state->data);
+            done = true;
+        }
+    };
+}
+
+class SimTransport::Node : public NodeTransport {
+public:
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::multimap<Clock::time_point, Message> queue; // by arrival, a burst is delivered in order
+    LinkProfile profile;
+    Clock::time_point busy_until[2]; // to the node and back
+    std::mt19937_64 generator;
+    bool closed = false;
+    std::shared_ptr<Reply> current; // of the request being handled
+
+    Node(int node, const LinkProfile& profile) : profile(profile), generator(node) {}
+
+    // when a message of size bytes sent now arrives, mutex held
+    Clock::time_point transmit(int direction, size_t size)
+    {
+        Clock::time_point start = std::max(Clock::now(), busy_until[direction]);
+        if (profile.bandwidth_gbps > 0)
+            start += std::chrono::nanoseconds((int64_t) (size * 8 / profile.bandwidth_gbps)); // bits / Gb/s = ns
+        busy_until[direction] = start;
+
+        double delay_us = profile.latency_us;
+        if (profile.jitter_us > 0)
+            delay_us += std::exponential_distribution<double>(1 / profile.jitter_us)(generator);
+        return start + std::chrono::nanoseconds((int64_t) (delay_us * 1000));
+    }
+
+    bool receive(int& tag, std::vector<uint8_t>& message) override
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!closed)
+        {
+            if (queue.empty())
+            {
+                changed.wait(lock);
+                continue;
+            }
+
+            auto first = queue.begin();
+            if (first->first > Clock::now())
+            {
+                changed.wait_until(lock, first->first);
+                continue;
+            }
+
+            tag = first->second.tag;
+            message = std::move(first->second.data);
+            current = std::move(first->second.reply);
+            queue.erase(first);
+            return true;
+        }
+        return false;
+    }
+
+    void reply(int tag, const uint8_t* data, size_t size) override
+    {
+        (void) tag; // the node serves one request at a time, current is the one answered
+        Clock::time_point arrival;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            arrival = transmit(1, size);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(current->mutex);
+            current->data.assign(data, data + size);
+            current->arrival = arrival;
+            current->done = true;
+        }
+        current->ready.notify_all();
+        current.reset();
+    }
+};
+
+SimTransport::SimTransport(int node_count, const LinkProfile& profile)
+{
+    for (int node = 1; node <= node_count; node++)
+        nodes.push_back(std::make_unique<Node>(node, profile));
+}
+
+SimTransport::~SimTransport()
+{
+    close();
+}
+
+void SimTransport::set_link(int node, const LinkProfile& profile)
+{
+    Node& link = *nodes.at(node - 1);
+    std::lock_guard<std::mutex> lock(link.mutex);
+    link.profile = profile;
+}
+
+NodeTransport& SimTransport::get_node(int node)
+{
+    return *nodes.at(node - 1);
+}
+
+void SimTransport::close()
+{
+    for (auto& node : nodes)
+    {
+        std::lock_guard<std::mutex> lock(node->mutex);
+        node->closed = true;
+        node->changed.notify_all();
+    }
+}
+
+int SimTransport::get_node_count() const
+{
+    return nodes.size();
+}
+
+std::unique_ptr<Transport::Call> SimTransport::call(int node, std::vector<uint8_t>&& message, size_t max_reply)
+{
+    (void) max_reply; // the replies are not copied into a fixed buffer
+    auto reply = std::make_shared<Reply>();
+    Node& target = *nodes.at(node - 1);
+    {
+        std::lock_guard<std::mutex> lock(target.mutex);
+        Clock::time_point arrival = target.transmit(0, message.size());
+        target.queue.emplace(arrival, Message {0, std::move(message), reply});
+    }
+    target.changed.notify_one();
+    return std::make_unique<SimCall>(reply);
+}
@@ -0,0 +1,47 @@
+#ifndef SIM_TRANSPORT_HPP
+#define SIM_TRANSPORT_HPP
+
+#include "transport.hpp"
+#include <string>
+
+namespace StorageAPI {
+    // how one link between the manager and a node delays the messages, both
+    // directions alike but each with its own bandwidth
+    struct LinkProfile {
+        double latency_us = 0; // one way
+        double bandwidth_gbps = 0; // 0 is unlimited
+        double jitter_us = 0; // mean of an exponentially distributed extra delay
+
+        // "latency_us:bandwidth_gbps:jitter_us", missing fields keep their value
+        void parse(const std::string& profile);
+    };
+
+    // In-memory transport to storage nodes living in the same process, for the
+    // cluster simulator. A message is delivered once the link would have carried
+    // it: it waits for the link to be free, takes size / bandwidth to send and
+    // latency + jitter to arrive. The waits use the steady clock, so delays
+    // below the timer slack of the system (tens of us) are not exact.
+    class SimTransport : public Transport {
+    public:
+        class Node;
+
+        SimTransport(const SimTransport&) = delete;
+        SimTransport& operator= (const SimTransport&) = delete;
+
+        SimTransport(int node_count, const LinkProfile& profile);
+        ~SimTransport() override;
+
+        void set_link(int node, const LinkProfile& profile);
+        NodeTransport& get_node(int node);
+        // the nodes stop receiving, replies that were not sent yet never arrive
+        void close();
+
+        int get_node_count() const override;
+        std::unique_ptr<Call> call(int node, std::vector<uint8_t>&& message, size_t max_reply) override;
+
+    private:
+        std::vector<std::unique_ptr<Node>> nodes; // node n is nodes[n - 1]
+    };
+}
+
+#endif
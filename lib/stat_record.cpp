@@ -0,0 +1,99 @@
+#include "stat_record.hpp"
+
+std::string StatRecord::make(const struct stat& object_stat, int compression, const std::vector<std::string>& entries)
+{
+    size_t length = sizeof(Header);
+    for (const std::string& entry : entries)
+        length += entry.length() + 1;
+
+    std::string record(length, '\0');
+    store(record, offsetof(Header, magic), magic);
+    store(record, offsetof(Header, version), version);
+    store(record, offsetof(Header, compression), uint16_t(compression));
+    store(record, offsetof(Header, dev), int64_t(object_stat.st_dev));
+    store(record, offsetof(Header, ino), int64_t(object_stat.st_ino));
+    store(record, offsetof(Header, mode), uint32_t(object_stat.st_mode));
+    store(record, offsetof(Header, nlink), uint32_t(object_stat.st_nlink));
+    store(record, offsetof(Header, uid), uint32_t(object_stat.st_uid));
+    store(record, offsetof(Header, gid), uint32_t(object_stat.st_gid));
+    store(record, offsetof(Header, rdev), int64_t(object_stat.st_rdev));
+    store(record, offsetof(Header, size), int64_t(object_stat.st_size));
+    store(record, offsetof(Header, blksize), int64_t(object_stat.st_blksize));
+    store(record, offsetof(Header, blocks), int64_t(object_stat.st_blocks));
+    store(record, offsetof(Header, atime), int64_t(object_stat.st_atime));
+    store(record, offsetof(Header, mtime), int64_t(object_stat.st_mtime));
+    store(record, offsetof(Header, ctime), int64_t(object_stat.st_ctime));
+    store(record, offsetof(Header, entry_count), uint32_t(entries.size()));
+
+    // the nulls are already there, only the names are copied
+    size_t offset = sizeof(Header);
+    for (const std::string& entry : entries)
+    {
+        std::memcpy(record.data() + offset, entry.data(), entry.length());
+        offset += entry.length() + 1;
+    }
+    return record;
+}
+
+bool StatRecord::to_struct_stat(const std::string& record, struct stat* object_stat)
+{
+    if (!is_valid(record))
+        return false;
+
+    if constexpr (std::endian::native == std::endian::little)
+    {
+        // the header is laid out as in memory, one copy and the fields are where they belong
+        Header header;
+        std::memcpy(&header, record.data(), sizeof(Header));
+        object_stat->st_dev = header.dev;
+        object_stat->st_ino = header.ino;
+        object_stat->st_mode = header.mode;
+        object_stat->st_nlink = header.nlink;
+        object_stat->st_uid = header.uid;
+        object_stat->st_gid = header.gid;
+        object_stat->st_rdev = header.rdev;
+        object_stat->st_size = header.size;
+        object_stat->st_blksize = header.blksize;
+        object_stat->st_blocks = header.blocks;
+        object_stat->st_atime = header.atime;
+        object_stat->st_mtime = header.mtime;
+        object_stat->st_ctime = header.ctime;
+    }
+    else
+    {
+        object_stat->st_dev = load<int64_t>(record, offsetof(Header, dev));
+        object_stat->st_ino = load<int64_t>(record, offsetof(Header, ino));
+        object_stat->st_mode = load<uint32_t>(record, offsetof(Header, mode));
+        object_stat->st_nlink = load<uint32_t>(record, offsetof(Header, nlink));
+        object_stat->st_uid = load<uint32_t>(record, offsetof(Header, uid));
+        object_stat->st_gid = load<uint32_t>(record, offsetof(Header, gid));
+        object_stat->st_rdev = load<int64_t>(record, offsetof(Header, rdev));
+        object_stat->st_size = load<int64_t>(record, offsetof(Header, size));
+        object_stat->st_blksize = load<int64_t>(record, offsetof(Header, blksize));
+        object_stat->st_blocks = load<int64_t>(record, offsetof(Header, blocks));
+        object_stat->st_atime = load<int64_t>(record, offsetof(Header, atime));
+        object_stat->st_mtime = load<int64_t>(record, offsetof(Header, mtime));
+        object_stat->st_ctime = load<int64_t>(record, offsetof(Header, ctime));
+    }
+    return true;
+}
+
+std::vector<std::string> StatRecord::get_entries(const std::string& record)
+{
+    std::vector<std::string> entries;
+    if (!is_valid(record))
+        return entries;
+
+    uint32_t count = load<uint32_t>(record, offsetof(Header, entry_count));
+    entries.reserve(count);
+    size_t offset = sizeof(Header);
+    for (uint32_t i = 0; i < count && offset < record.size(); i++)
+    {
+        size_t end = record.find('\0', offset);
+        if (end == std::string::npos)
+            end = record.size();
+        entries.emplace_back(record, offset, end - offset);
+        offset = end + 1;
+    }
+    return entries;
+}
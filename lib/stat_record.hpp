@@ -0,0 +1,105 @@
+#ifndef STAT_RECORD_HPP
+#define STAT_RECORD_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <type_traits>
+#include <vector>
+
+// The metadata of a file or a directory as the cache servers store it and memcached
+// and the clients get it: a fixed size header with the attributes, followed for a
+// directory by its entries, each ending with a null byte. Every integer is little
+// endian at a fixed offset, so an attribute is read or patched where it is, with no
+// parsing and no allocation; the listing is only walked by readdir.
+//
+// The version changes with the layout of the header, a record of another version (or
+// the protobuf Stat of the servers before it) is invalid and answered as missing.
+namespace StatRecord {
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t compression; // CompressionCode, inherited from the parent directory
+        int64_t dev;
+        int64_t ino;
+        uint32_t mode;
+        uint32_t nlink;
+        uint32_t uid;
+        uint32_t gid;
+        int64_t rdev;
+        int64_t size;
+        int64_t blksize;
+        int64_t blocks;
+        int64_t atime;
+        int64_t mtime;
+        int64_t ctime;
+        uint32_t entry_count; // entries of the directory after the header
+        uint32_t reserved;
+    };
+    static_assert(std::is_trivially_copyable_v<Header> && sizeof(Header) == 104, "StatRecord: the header has no padding");
+
+    constexpr uint32_t magic = 0x52534644; // "DFSR"
+    constexpr uint16_t version = 1;
+
+    template <typename T>
+    constexpr T to_little_endian(T value)
+    {
+        using Bits = std::make_unsigned_t<T>;
+        if constexpr (std::endian::native == std::endian::little || sizeof(T) == 1)
+            return value;
+        else if constexpr (sizeof(T) == 2)
+            return std::bit_cast<T>(Bits(__builtin_bswap16(std::bit_cast<Bits>(value))));
+        else if constexpr (sizeof(T) == 4)
+            return std::bit_cast<T>(Bits(__builtin_bswap32(std::bit_cast<Bits>(value))));
+        else
+            return std::bit_cast<T>(Bits(__builtin_bswap64(std::bit_cast<Bits>(value))));
+    }
+
+    // the field at offset of record, 0 when the record is too short to hold it
+    template <typename T>
+    inline T load(const std::string& record, size_t offset)
+    {
+        T value{};
+        if (record.size() >= offset + sizeof(T))
+            std::memcpy(&value, record.data() + offset, sizeof(T));
+        return to_little_endian(value);
+    }
+
+    template <typename T>
+    inline void store(std::string& record, size_t offset, T value)
+    {
+        value = to_little_endian(value);
+        std::memcpy(record.data() + offset, &value, sizeof(T));
+    }
+
+    inline bool is_valid(const std::string& record)
+    {
+        return record.size() >= sizeof(Header)
+            && load<uint32_t>(record, offsetof(Header, magic)) == magic
+            && load<uint16_t>(record, offsetof(Header, version)) == version;
+    }
+
+    inline int64_t get_size(const std::string& record) { return load<int64_t>(record, offsetof(Header, size)); }
+    inline uint32_t get_mode(const std::string& record) { return load<uint32_t>(record, offsetof(Header, mode)); }
+    inline int get_compression(const std::string& record) { return load<uint16_t>(record, offsetof(Header, compression)); }
+
+    // the record is valid, checked by the callers
+    inline void set_size(std::string& record, int64_t size) { store(record, offsetof(Header, size), size); }
+    inline void set_mode(std::string& record, uint32_t mode) { store(record, offsetof(Header, mode), mode); }
+    inline void set_owner(std::string& record, uint32_t uid, uint32_t gid)
+    {
+        store(record, offsetof(Header, uid), uid);
+        store(record, offsetof(Header, gid), gid);
+    }
+    inline void set_compression(std::string& record, int compression) { store(record, offsetof(Header, compression), uint16_t(compression)); }
+
+    std::string make(const struct stat& object_stat, int compression, const std::vector<std::string>& entries = {});
+    // false when the record is invalid
+    bool to_struct_stat(const std::string& record, struct stat* object_stat);
+    std::vector<std::string> get_entries(const std::string& record);
+}
+
+#endif
@@ -1,11 +1,13 @@
 #include "storage_client.hpp"
+#include "checksum.hpp"
+#include "tracing.hpp"
 
 using namespace StorageAPI;
 
-std::ofstream s_log_file("/mnt/tmpfs/s_client.log", std::ios::app);
+static Metrics::OperationTable client_metrics("storage_client");
 
 // private
-asio::awaitable<int> StorageClient::read_async(const std::string& path, char* buffer, size_t size, off_t offset)
+asio::awaitable<int> StorageClient::read_async(const std::string& path, char* buffer, size_t size, off_t offset, uint64_t trace_id)
 {
     try 
     {
@@ -17,29 +19,41 @@ asio::awaitable<int> StorageClient::read_async(const std::string& path, char* bu
         request.path = Utils::get_byte_array_from_string(path);
         request.data_len = 4;
         request.data = Utils::get_byte_array_from_int(size);
+        request.trace_id = trace_id;
         
+        uint64_t start = Tracing::now();
         co_await send_request_async(request, response);
+        Tracing::record(trace_id, "round_trip", start, Tracing::now(), "offset", offset);
  
+        // an empty read is the end of the data, a failure is -errno: the caller pads only the former
         if ((response.id != request.id) || response.rescode == ResultCode::Type::ERRMSG)
         {
-            if (response.message_len == 0)
+            int error = EIO;
+            if (response.message_len != 4)
                 SPDLOG_ERROR("Unknown server error");
             else 
             {
-                std::string error = Utils::get_string_from_byte_array(response.message);
-                SPDLOG_ERROR(std::format("Server error: {}", error));
+                error = Utils::get_int_from_byte_array(response.message);
+                LOG_RATE_LIMITED(SPDLOG_LEVEL_ERROR, 10, "Server error: {}", std::strerror(error));
+                if (error == 0) error = EIO;
             }            
-            co_return 0;
+            co_return -error;
         }
 
-        memcpy(buffer, response.data.data(), response.data_len);
+        uint32_t checksum = Checksum::crc32c_copy((uint8_t*) buffer, response.data.data(), response.data_len);
+        if (checksum != response.checksum)
+        {
+            SPDLOG_ERROR(std::format("Checksum mismatch reading {} at offset {}: expected {:08x}, got {:08x}",
+                path, offset, response.checksum, checksum));
+            co_return -EIO;
+        }
 
         co_return response.data_len;
     }
     catch (std::exception& e)
     {
-        SPDLOG_ERROR(std::format("write_async: {}", e.what()));
-        co_return 0;
+        SPDLOG_ERROR(std::format("read_async: {}", e.what()));
+        co_return -EIO;
     }
 }
 
@@ -48,7 +62,9 @@ asio::awaitable<int> StorageClient::write_async(
       const std::string& path
     , const char* buffer
     , size_t size
-    , off_t offset)
+    , off_t offset
+    , CompressionCode::Type compression
+    , uint64_t trace_id)
 {
     try 
     {
@@ -59,11 +75,14 @@ asio::awaitable<int> StorageClient::write_async(
         request.path_len = path.length();
         request.path = Utils::get_byte_array_from_string(path);
         request.data_len = size;
-        request.data.assign(buffer, buffer + size);
-        {
-            // Utils::PerformanceTimer timer("StorageClient::read_async", s_log_file);
-            co_await send_request_async(request, response);
-        }
+        request.data.resize(size);
+        request.checksum = Checksum::crc32c_copy(request.data.data(), (const uint8_t*) buffer, size);
+        request.flags = CompressionCode::to_byte(compression);
+        request.trace_id = trace_id;
+
+        uint64_t start = Tracing::now();
+        co_await send_request_async(request, response);
+        Tracing::record(trace_id, "round_trip", start, Tracing::now(), "offset", offset);
         // std::cout << response.to_string() << std::endl;
         if ((response.id != request.id) || response.rescode == ResultCode::Type::ERRMSG)
         {
@@ -72,7 +91,7 @@ asio::awaitable<int> StorageClient::write_async(
             else 
             {
                 std::string error = Utils::get_string_from_byte_array(response.message);
-                SPDLOG_ERROR(std::format("Server error: {}", error));
+                LOG_RATE_LIMITED(SPDLOG_LEVEL_ERROR, 10, "Server error: {}", error);
             }            
             co_return 0;
         }
@@ -86,7 +105,7 @@ asio::awaitable<int> StorageClient::write_async(
     }
 }
 
-asio::awaitable<int> StorageClient::remove_async(const std::string& path)
+asio::awaitable<int> StorageClient::remove_async(const std::string& path, int64_t file_size)
 {
     try 
     {
@@ -95,6 +114,11 @@ asio::awaitable<int> StorageClient::remove_async(const std::string& path)
         request.opcode = OperationCode::to_byte(OperationCode::Type::RM_FILE);
         request.path_len = path.length();
         request.path = Utils::get_byte_array_from_string(path);
+        if (file_size >= 0)
+        {
+            request.data = Utils::get_byte_array_from_int(file_size);
+            request.data_len = request.data.size();
+        }
         co_await send_request_async(request, response);
 
         if ((response.id != request.id) || response.rescode == ResultCode::Type::ERRMSG)
@@ -104,7 +128,7 @@ asio::awaitable<int> StorageClient::remove_async(const std::string& path)
             else 
             {
                 std::string error = Utils::get_string_from_byte_array(response.message);
-                SPDLOG_ERROR(std::format("Server error: {}", error));
+                LOG_RATE_LIMITED(SPDLOG_LEVEL_ERROR, 10, "Server error: {}", error);
             }            
             co_return -1;
         }
@@ -117,11 +141,45 @@ asio::awaitable<int> StorageClient::remove_async(const std::string& path)
     co_return 0;
 } // remove_async
 
+asio::awaitable<off_t> StorageClient::seek_async(const std::string& path, off_t offset, int whence, size_t file_size)
+{
+    try 
+    {
+        StoragePacket request, response;
+        request.id = Utils::generate_id();
+        request.opcode = OperationCode::to_byte(OperationCode::Type::SEEK);
+        request.offset = (uint32_t)offset;
+        request.path_len = path.length();
+        request.path = Utils::get_byte_array_from_string(path);
+        request.data = Utils::get_byte_array_from_int(whence);
+        std::vector<uint8_t> size_bytes = Utils::get_byte_array_from_int(file_size);
+        request.data.insert(request.data.end(), size_bytes.begin(), size_bytes.end());
+        request.data_len = request.data.size();
+        co_await send_request_async(request, response);
+
+        if (response.id != request.id || response.rescode != ResultCode::Type::SUCCESS || response.data.size() != 4)
+        {
+            // ENXIO is not an error, there is no data after offset
+            if (response.rescode == ResultCode::Type::ERRMSG && response.message_len == 4)
+                co_return -(off_t) Utils::get_int_from_byte_array(response.message);
+            SPDLOG_ERROR("Server error in seek");
+            co_return -EIO;
+        }
+
+        co_return Utils::get_int_from_byte_array(response.data);
+    }
+    catch (std::exception& e)
+    {
+        SPDLOG_ERROR(std::format("seek_async: {}", e.what()));
+        co_return -EIO;
+    }
+} // seek_async
+
 // public
 StorageClient::StorageClient() : StorageClient(1, 4096) {} // default stipe size 4KB
 StorageClient::StorageClient(size_t stripe_size) : StorageClient(1, stripe_size) {}
 StorageClient::StorageClient(int thread_count, size_t stripe_size) 
-    : GenericClient<StoragePacket>(thread_count)
+    : GenericClient<StoragePacket>(thread_count, &client_metrics)
     , stripe_size(stripe_size) 
 {
     // SPDLOG_INFO("StorageClient:\n\t- stripe size: {}\n\t- thread count: {}", stripe_size, thread_count);   
@@ -131,11 +189,12 @@ int StorageClient::read(const std::string& path, char* buffer, size_t size, off_
 {
     std::promise<int> result_promise;
     std::future<int> result_future = result_promise.get_future();
+    uint64_t trace_id = Tracing::get_current_trace(); // the coroutine runs on another thread
     
     asio::co_spawn(
         context,
         [&]() -> asio::awaitable<void> {
-            int result = co_await read_async(path, buffer, size, offset);
+            int result = co_await read_async(path, buffer, size, offset, trace_id);
             result_promise.set_value(result);
             co_return;
         },
@@ -150,19 +209,21 @@ int StorageClient::read(const std::string& path, char* buffer, size_t size, off_
     }
     catch (...)
     {
-        return 0;
+        return -EIO;
     }
 }
 
-int StorageClient::write(const std::string& path, const char* buffer, size_t size, off_t offset)
+int StorageClient::write(const std::string& path, const char* buffer, size_t size, off_t offset,
+    CompressionCode::Type compression)
 {
     std::promise<int> result_promise;
     std::future<int> result_future = result_promise.get_future();
+    uint64_t trace_id = Tracing::get_current_trace(); // the coroutine runs on another thread
     
     asio::co_spawn(
         context,
         [&]() -> asio::awaitable<void> {
-            int result = co_await write_async(path, buffer, size, offset);
+            int result = co_await write_async(path, buffer, size, offset, compression, trace_id);
             result_promise.set_value(result);
             co_return;
         },
@@ -233,7 +294,31 @@ int StorageClient::write(const std::string& path, const char* buffer, size_t siz
 //     }
 // }
 
-int StorageClient::remove(const std::string& path)
+void StorageClient::read(const std::string& path, char* buffer, size_t size, off_t offset, uint64_t trace_id,
+    std::function<void(int)> done)
+{
+    spawn_request<int>(
+        [this, path, buffer, size, offset, trace_id]() -> asio::awaitable<int> {
+            co_return co_await read_async(path, buffer, size, offset, trace_id);
+        },
+        std::move(done),
+        -EIO
+    );
+}
+
+void StorageClient::write(const std::string& path, const char* buffer, size_t size, off_t offset,
+    CompressionCode::Type compression, uint64_t trace_id, std::function<void(int)> done)
+{
+    spawn_request<int>(
+        [this, path, buffer, size, offset, compression, trace_id]() -> asio::awaitable<int> {
+            co_return co_await write_async(path, buffer, size, offset, compression, trace_id);
+        },
+        std::move(done),
+        0
+    );
+}
+
+int StorageClient::remove(const std::string& path, int64_t file_size)
 {
     std::promise<int> result_promise;
     std::future<int> result_future = result_promise.get_future();
@@ -241,7 +326,7 @@ int StorageClient::remove(const std::string& path)
     asio::co_spawn(
         context,
         [&]() -> asio::awaitable<void> {
-            int res = co_await remove_async(path);
+            int res = co_await remove_async(path, file_size);
             result_promise.set_value(res);
             co_return;
         },
@@ -255,4 +340,28 @@ int StorageClient::remove(const std::string& path)
     {
         return -1;
     }
-}
\ No newline at end of file
+}
+
+off_t StorageClient::seek(const std::string& path, off_t offset, int whence, size_t file_size)
+{
+    std::promise<off_t> result_promise;
+    std::future<off_t> result_future = result_promise.get_future();
+    
+    asio::co_spawn(
+        context,
+        [&]() -> asio::awaitable<void> {
+            off_t res = co_await seek_async(path, offset, whence, file_size);
+            result_promise.set_value(res);
+            co_return;
+        },
+        asio::detached
+    );
+
+    try {
+        return result_future.get();
+    }
+    catch (...)
+    {
+        return -EIO;
+    }
+}
@@ -9,14 +9,17 @@ namespace StorageAPI {
     class StorageClient : public GenericClient<StoragePacket>{
     private:
         size_t stripe_size;
-        asio::awaitable<int> read_async(const std::string& path, char* buffer, size_t size, off_t offset);
+        asio::awaitable<int> read_async(const std::string& path, char* buffer, size_t size, off_t offset, uint64_t trace_id);
         asio::awaitable<int> write_async(
               const std::string& path
             , const char* buffer
             , size_t size
-            , off_t offset);
+            , off_t offset
+            , CompressionCode::Type compression
+            , uint64_t trace_id);
         
-        asio::awaitable<int> remove_async(const std::string& path);
+        asio::awaitable<int> remove_async(const std::string& path, int64_t file_size);
+        asio::awaitable<off_t> seek_async(const std::string& path, off_t offset, int whence, size_t file_size);
     public:
         StorageClient(const StorageClient&) = delete;
         StorageClient& operator= (const StorageClient&) = delete;
@@ -26,11 +29,25 @@ namespace StorageAPI {
         StorageClient(int thread_count, size_t stripe_size);
         ~StorageClient() override = default;
 
+        // read and write carry the current trace of the calling thread (Tracing::Span); read
+        // answers the bytes up to the last stripe holding data, or -errno
         int read(const std::string& path, char* buffer, size_t size, off_t offset);
         // int write(const std::string& path, const std::vector<uint8_t>& buffer, size_t size, off_t offset);
-        int write(const std::string& path, const char* buffer, size_t size, off_t offset);
+        // compression is the policy of the file, the storage manager applies it per stripe
+        int write(const std::string& path, const char* buffer, size_t size, off_t offset,
+            CompressionCode::Type compression = CompressionCode::Type::NONE);
         // int write_stripes(const std::string& path, const std::vector<uint8_t>& buffer, size_t size, off_t offset);
-        int remove(const std::string& path);
+        // the same without waiting: done gets the result on a thread of the client, buffer stays
+        // valid until then; the caller's thread moves on, so the trace is given
+        void read(const std::string& path, char* buffer, size_t size, off_t offset, uint64_t trace_id,
+            std::function<void(int)> done);
+        void write(const std::string& path, const char* buffer, size_t size, off_t offset,
+            CompressionCode::Type compression, uint64_t trace_id, std::function<void(int)> done);
+        // returns once the file is queued for removal, its stripes are deleted in the background;
+        // file_size (-1 when unknown) tells the storage manager which stripes there are
+        int remove(const std::string& path, int64_t file_size = -1);
+        // SEEK_DATA / SEEK_HOLE, file_size is the one of the metadata; the new offset or -errno
+        off_t seek(const std::string& path, off_t offset, int whence, size_t file_size);
     };
 }
 
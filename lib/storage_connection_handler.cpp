@@ -1,9 +1,13 @@
 #include "storage_connection_handler.hpp"
+#include "wire_codec.hpp"
+#include "checksum.hpp"
+#include "compression.hpp"
+#include "tracing.hpp"
 
 using namespace StorageAPI;
 
-std::ofstream write_storage_log_file("/mnt/tmpfs/storage_mngr_write.log", std::ios::app);
-std::ofstream read_storage_log_file("/mnt/tmpfs/storage_mngr_read.log", std::ios::app);
+static Metrics::OperationTable server_metrics("storage_manager");
+static Metrics::Counter checksum_errors("checksum_errors_total", "Stripes or fragments that failed their checksum.");
 
 void StorageConnectionHandler::handle_request(const StoragePacket& request, StoragePacket& response)
 {
@@ -17,8 +21,18 @@ void StorageConnectionHandler::handle_request(const StoragePacket& request, Stor
     response.opcode = request.opcode;
     response.path_len = request.path_len;
     response.path = request.path;
-    SPDLOG_DEBUG(std::format("Processing: {}", OperationCode::to_string(OperationCode::from_byte(request.opcode))));
+    SPDLOG_TRACE("Processing: {}", OperationCode::to_string(OperationCode::from_byte(request.opcode)));
+
+    // the node requests sent while handling the request carry its trace
+    Tracing::Span span(request.opcode == OperationCode::Type::READ ? "manager_read"
+        : request.opcode == OperationCode::Type::WRITE ? "manager_write" : "manager_request",
+        request.trace_id, "offset", request.offset);
     try {
+        // the stripes of a file removed under the same path have to go first
+        if (request.opcode == OperationCode::Type::READ || request.opcode == OperationCode::Type::WRITE
+            || request.opcode == OperationCode::Type::SEEK)
+            reclaimer->flush(Utils::get_string_from_byte_array(request.path));
+
         switch (OperationCode::from_byte(request.opcode))
         {
             case OperationCode::Type::NOP:
@@ -28,21 +42,18 @@ void StorageConnectionHandler::handle_request(const StoragePacket& request, Stor
                 init_connection(request.id, response);
                 break;
             case OperationCode::Type::READ:
-                {
-                    // Utils::PerformanceTimer timer("read", read_storage_log_file);
-                    read(request, response);
-                }
+                read(request, response);
                 // std::cout << response.to_string() << std::endl;
                 break;
             case OperationCode::Type::WRITE:
-                {
-                    // Utils::PerformanceTimer timer("write", write_storage_log_file);
-                    write(request, response);
-                }
+                write(request, response);
                 break;
             case OperationCode::Type::RM_FILE:
                 remove(request, response);
                 break;
+            case OperationCode::Type::SEEK:
+                seek(request, response);
+                break;
             
             default:
                 response.rescode = ResultCode::to_byte(ResultCode::Type::INVOP);
@@ -61,121 +72,256 @@ void StorageConnectionHandler::handle_request(const StoragePacket& request, Stor
 void StorageConnectionHandler::init_connection(uint16_t id, StoragePacket& response)
 {
     response.rescode = ResultCode::Type::SUCCESS;
+
+    // a client on this host switches to the channel, see GenericClient::open_channel
+    if (channel)
+    {
+        response.message = Utils::get_byte_array_from_string("shm " + channel->get_address());
+        response.message_len = response.message.size();
+    }
+}
+
+
+void StorageConnectionHandler::send_stripe_request(StripeRead& stripe, StoragePacket& node_request, std::vector<StripeRequest>& in_flight)
+{
+    int replica = selector->pick(stripe.replicas, stripe.tried);
+    stripe.tried[replica] = true;
+    stripe.in_flight++;
+
+    StripeRequest stripe_request;
+    stripe_request.stripe = stripe.index;
+    stripe_request.node = stripe.replicas[replica];
+    stripe_request.id = Utils::generate_id();
+    stripe_request.start = std::chrono::steady_clock::now();
+    stripe_request.trace_start = Tracing::now();
+    stripe_request.generation = stripe.generation;
+
+    node_request.id = stripe_request.id;
+    node_request.offset = stripe.offset;
+    std::vector<uint8_t> message;
+    node_request.to_buffer(message);
+
+    // the reply holds the path back, the stripe data or an errno on failure
+    selector->start_request(stripe_request.node);
+    stripe_request.call = transport->call(stripe_request.node, std::move(message),
+        StoragePacket::header_size + node_request.path_len + stripe_size + 4);
+
+    in_flight.push_back(std::move(stripe_request));
 }
 
+bool StorageConnectionHandler::copy_stripe(const StoragePacket& node_response, StripeRead& stripe,
+    uint8_t* destination, size_t capacity, std::vector<uint8_t>& scratch)
+{
+    CompressionCode::Type compression = CompressionCode::from_byte(node_response.flags);
+    const uint8_t* source = node_response.data.data();
+    size_t source_len = node_response.data_len;
+
+    if (compression != CompressionCode::Type::NONE)
+    {
+        // the node checksum covers the stored bytes, they are checked before being decompressed
+        if (Checksum::crc32c(node_response.data.data(), node_response.data_len) != node_response.checksum)
+            return false;
+
+        try
+        {
+            scratch.resize(stripe_size);
+            source_len = Compression::decompress(compression, node_response.data.data(), node_response.data_len,
+                scratch.data(), scratch.size());
+            source = scratch.data();
+        }
+        catch (std::exception& e)
+        {
+            SPDLOG_WARN(std::format("copy_stripe: {}", e.what()));
+            return false;
+        }
+    }
+
+    // the last stripe may hold more than what was asked for
+    stripe.size = std::min(source_len, capacity);
+    stripe.checksum = Checksum::crc32c_copy(destination, source, stripe.size);
+    if (compression != CompressionCode::Type::NONE)
+        return true;
+
+    // the node checksum covers the whole stripe, the rest is hashed without copying it
+    size_t rest = source_len - stripe.size;
+    uint32_t rest_checksum = Checksum::crc32c(source + stripe.size, rest);
+    return Checksum::crc32c_combine(stripe.checksum, rest_checksum, rest) == node_response.checksum;
+}
 
 void StorageConnectionHandler::read(const StoragePacket& request, StoragePacket& response)
 {
+    if (codec != nullptr)
+    {
+        ec_read(request, response);
+        return;
+    }
+
     response.rescode = ResultCode::Type::SUCCESS;
     int data_len = Utils::get_int_from_byte_array(request.data);
     size_t stripes_num = data_len / stripe_size + (data_len % stripe_size != 0 ? 1 : 0);
-    StoragePacket node_request;
-    std::vector<uint8_t> raw_buffer;
-    // size_t raw_buffer_size;
-    int node, offset;
-    std::vector<int> responses = std::vector<int>(stripes_num);
-    std::vector<MPI_Request> requests = std::vector<MPI_Request>(stripes_num);
-    
+    std::string path = Utils::get_string_from_byte_array(request.path);
+    uint64_t epoch = holes->get_epoch(path);
+    StoragePacket node_request, node_response;
+    std::vector<uint8_t> scratch; // compressed stripes are expanded here first
+    std::vector<StripeRead> stripes = std::vector<StripeRead>(stripes_num);
+    std::vector<StripeRequest> in_flight;
+    in_flight.reserve(stripes_num * selector->get_replica_count());
+    std::shared_ptr<const PlacementLayout> layout = placement->get_current();
+
+    selector->reap();
+
     node_request.opcode = OperationCode::Type::READ;
     node_request.path_len = request.path_len;
     node_request.path = request.path;
+    node_request.trace_id = request.trace_id;
+    response.data.resize(data_len); // holes read as zeros
+    response.data_len = data_len;
+
+    size_t completed = 0;
     for (size_t i = 0; i < stripes_num; i++) {
-        node = ((i + request.offset / stripe_size) % (comm_size - 1)) + 1; // !!! assuming master node has rank 0 !!!
-        offset = request.offset + i * stripe_size;
+        StripeRead& stripe = stripes[i];
+        stripe.index = i;
+        stripe.offset = request.offset + i * stripe_size;
+        if (holes->is_hole(path, i + request.offset / stripe_size))
+        {
+            stripe.done = true;
+            completed++;
+            continue;
+        }
 
-        node_request.id = Utils::generate_id();
-        node_request.offset = offset;
-        node_request.to_buffer(raw_buffer);
-        // raw_buffer_size = raw_buffer.size();
-        // std::cout << "data_size: " << raw_buffer_size  << "\n"
-        //     << "node: " << node << "\n"
-        //     << "offset: " << offset << "\n";
-        MPI_Send(raw_buffer.data(), raw_buffer.size(), MPI_UNSIGNED_CHAR, node, offset, MPI_COMM_WORLD);
-    }
-
-    int completed = 0, flag;
-    int offset_sizes[stripes_num] = {0};
-    // bool valid_response = true;
-    std::vector<uint8_t> received_bytes;
-    received_bytes.reserve(StoragePacket::header_size + stripe_size);
-    StoragePacket node_response;
-    response.data.resize(data_len);
-    response.data_len = data_len;
-    MPI_Status status;
+        stripe.replicas = get_nodes(*layout, path, i + request.offset / stripe_size);
+        stripe.tried = std::vector<bool>(stripe.replicas.size(), false);
+        send_stripe_request(stripe, node_request, in_flight);
+    }
+
+    uint64_t hedge_delay_us = selector->get_hedge_delay_us();
     while (completed < stripes_num) {
-        for (int i = 0; i < stripes_num; ++i) {
-            node = ((i + request.offset / stripe_size) % (comm_size - 1)) + 1; // !!! assuming master node has rank 0 !!!
-            offset = request.offset + i * stripe_size;
-            flag = 0;
+        for (size_t k = 0; k < in_flight.size(); ) {
+            StripeRequest& stripe_request = in_flight[k];
+            StripeRead& stripe = stripes[stripe_request.stripe];
+            if (!stripe_request.call->test()) {
+                // hedging: the replica is slower than usual, ask another one as well
+                if (hedge_delay_us > 0 && !stripe.done && stripe.in_flight == 1
+                    && std::chrono::steady_clock::now() - stripe_request.start > std::chrono::microseconds(hedge_delay_us)
+                    && std::find(stripe.tried.begin(), stripe.tried.end(), false) != stripe.tried.end())
+                {
+                    send_stripe_request(stripe, node_request, in_flight);
+                    continue; // in_flight may have been reallocated
+                }
+                k++;
+                continue;
+            }
 
-            MPI_Iprobe(node, offset, MPI_COMM_WORLD, &flag, &status);
-            
-            if (flag) {
-                int size;
-                MPI_Get_count(&status, MPI_UNSIGNED_CHAR, &size);
-                if (received_bytes.size() != size)
-                    received_bytes.resize(size);
-
-                MPI_Recv(received_bytes.data(), size, MPI_UNSIGNED_CHAR, node, offset, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                completed++;
-                // std::cout << completed << " < " << stripes_num << std::endl;
-                // if (valid_response)
-                // {
-                node_response.from_buffer(received_bytes.data(), received_bytes.size());
-
-                // if (node_response.rescode == ResultCode::Type::ERRMSG)
-                // {
-                //     // response.rescode = ResultCode::Type::ERRMSG;
-                //     // response.message_len = node_response.message_len;
-                //     // response.message = node_response.message;
-                //     // valid_response = false;
-                //     // std::cout << "Stripe offset: " << offset << " Error!" << std::endl;
-                //     ;
-                // }
-                if (node_response.rescode == ResultCode::Type::SUCCESS)
+            const std::vector<uint8_t>& reply = stripe_request.call->get_reply();
+            selector->end_request(stripe_request.node, stripe_request.start);
+            Tracing::record(request.trace_id, "stripe_read", stripe_request.trace_start, Tracing::now(), "node", stripe_request.node);
+            stripe.in_flight--;
+
+            if (!stripe.done && stripe_request.generation == stripe.generation)
+            {
+                node_response.from_buffer(reply.data(), reply.size());
+                bool valid = node_response.id == stripe_request.id && node_response.rescode == ResultCode::Type::SUCCESS;
+                if (valid)
+                {
+                    valid = copy_stripe(node_response, stripe, response.data.data() + (stripe.offset - request.offset),
+                        data_len - (stripe.offset - request.offset), scratch);
+                    if (!valid)
+                    {
+                        SPDLOG_WARN("read: Corrupted stripe from node {} for offset {}.", stripe_request.node, stripe.offset);
+                        checksum_errors.add();
+                        stripe.size = 0;
+                        stripe.checksum = 0;
+                    }
+                }
+
+                bool missing = !valid && node_response.message_len == 4
+                    && Utils::get_int_from_byte_array(node_response.message) == ENOENT;
+                if (missing && !stripe.relocated && placement->is_moving())
+                {
+                    // it may still be where an older layout put it, it is moved before being read again
+                    stripe.relocated = true;
+                    stripe.generation++;
+                    int error = relocate(request.path, stripe.offset / stripe_size);
+                    if (error != 0)
+                    {
+                        SPDLOG_ERROR("read: Cannot move offset {} of {}: {}", stripe.offset, path, std::strerror(error));
+                        stripe.done = true;
+                        stripe.failed = true;
+                    }
+                    else
+                    {
+                        stripe.tried.assign(stripe.tried.size(), false);
+                        send_stripe_request(stripe, node_request, in_flight);
+                    }
+                }
+                else if (valid)
+                    stripe.done = true;
+                else if (missing)
                 {
-                    // std::cout << node_response.to_string() << std::endl;
-                    offset_sizes[i] = node_response.data_len;
-                    std::copy(node_response.data.begin(), node_response.data.end(), response.data.begin() + offset - request.offset);
-                    // std::cout << "Stripe offset: " << offset << " recovered!" << std::endl;
+                    // the stripe was never written, the other replicas don't have it either;
+                    // a corrupted reply of another replica may have been copied in already
+                    size_t begin = stripe.offset - request.offset;
+                    std::fill(response.data.begin() + begin, response.data.begin() + std::min<size_t>(begin + stripe_size, data_len), 0);
+                    holes->add_hole(path, stripe.offset / stripe_size, epoch);
+                    stripe.done = true;
                 }
-                // } // if (valid_response)
-            } // if (flag)
+                else if (stripe.in_flight == 0)
+                {
+                    if (std::find(stripe.tried.begin(), stripe.tried.end(), false) != stripe.tried.end())
+                    {
+                        SPDLOG_WARN("read: Node {} failed for offset {}, trying another replica.", stripe_request.node, stripe.offset);
+                        send_stripe_request(stripe, node_request, in_flight);
+                    }
+                    else
+                    {
+                        stripe.done = true;
+                        stripe.failed = true;
+                    }
+                }
+
+                if (stripe.done)
+                    completed++;
+            }
+
+            in_flight[k] = std::move(in_flight.back());
+            in_flight.pop_back();
         } // for
     } // while
 
-    int final_size = 0;
-    bool encountered_null = false;
-    // std::cout << stripes_num << std::endl;
-    for (int i = 0; i < stripes_num; i++)
+    // replies of the hedged requests that lost the race are received later
+    for (StripeRequest& stripe_request : in_flight)
+        selector->adopt(stripe_request.node, stripe_request.start, std::move(stripe_request.call));
+
+    // the data ends with the last stripe that has some, the holes before it are zeros
+    size_t final_size = 0;
+    for (size_t i = 0; i < stripes_num; i++)
     {
-        final_size += offset_sizes[i];
-        // std::cout << i << " " << offset_sizes[i] << std::endl;
-        // std::cout << encountered_null << std::endl;
-        if (encountered_null == false)
+        if (stripes[i].failed)
         {
-            if (offset_sizes[i] == 0)
-                encountered_null = true;
-            // std::cout << "first branch" << std::endl;
-        }
-        else {
-            // std::cout << "second branch" << std::endl;
-            if (offset_sizes[i] != 0)
-            {
-                std::string message = "Fragmented result, something bad happened!"; 
-                response.rescode = ResultCode::Type::ERRMSG;
-                response.message_len = message.length();
-                response.message = Utils::get_byte_array_from_string(message);
-                response.data_len = 0;
-                response.data.clear();
-                return;
-            }
+            SPDLOG_ERROR("read: No replica returned valid data for offset {}.", stripes[i].offset);
+            response.rescode = ResultCode::Type::ERRMSG;
+            response.message = Utils::get_byte_array_from_int(EIO);
+            response.message_len = response.message.size();
+            response.data_len = 0;
+            response.data.clear();
+            return;
         }
-        // std::cout << "i = " << i << std::endl;
+
+        if (stripes[i].size > 0)
+            final_size = i * stripe_size + stripes[i].size;
+    }
+
+    uint32_t checksum = 0;
+    for (size_t i = 0; i < stripes_num && i * stripe_size < final_size; i++)
+    {
+        size_t length = std::min(stripe_size, final_size - i * stripe_size);
+        checksum = Checksum::crc32c_combine(checksum, stripes[i].checksum, stripes[i].size);
+        checksum = Checksum::crc32c_zeros(length - stripes[i].size, checksum);
     }
-    // std::cout << std::endl;
+
     response.data_len = final_size;
     response.data.resize(final_size);
+    response.checksum = checksum;
 }
 
 // void StorageConnectionHandler::write(const StoragePacket& request, StoragePacket& response)
@@ -313,55 +459,567 @@ void StorageConnectionHandler::read(const StoragePacket& request, StoragePacket&
 
 void StorageConnectionHandler::write(const StoragePacket& request, StoragePacket& response)
 {    
+    if (codec != nullptr)
+    {
+        ec_write(request, response);
+        return;
+    }
+
     size_t stripes_num = request.data.size() / stripe_size + (request.data.size() % stripe_size != 0 ? 1 : 0);
     size_t last_stripe_size = request.data.size() % stripe_size;
     if (last_stripe_size == 0 && stripes_num > 0) {
         last_stripe_size = stripe_size;
     }
     
+    int replica_count = selector->get_replica_count();
+    size_t requests_num = stripes_num * replica_count;
+    std::string path = Utils::get_string_from_byte_array(request.path);
     StoragePacket node_request;
     std::vector<std::vector<uint8_t>> raw_buffers = std::vector<std::vector<uint8_t>>(stripes_num);
-    int responses[stripes_num];
-    MPI_Request requests[stripes_num], send_requests[stripes_num];
-    node_request.opcode = OperationCode::Type::WRITE;
+    std::vector<bool> punched = std::vector<bool>(stripes_num, false);
+    std::vector<int> nodes = std::vector<int>(requests_num);
+    std::vector<std::unique_ptr<Transport::Call>> calls = std::vector<std::unique_ptr<Transport::Call>>(requests_num);
     node_request.path_len = request.path_len;
     node_request.path = request.path;
+    node_request.trace_id = request.trace_id;
 
     size_t offset, final_size;
-    int node;
+    uint32_t checksum = 0;
+    CompressionCode::Type compression = CompressionCode::from_byte(request.flags);
+    std::vector<uint8_t> compressed;
+
+    selector->reap();
 
+    // the stripe checksums come out of the copies and add up to the one of the client
+    uint64_t prepare_start = Tracing::now();
     for (size_t i = 0; i < stripes_num; i++) {
         final_size = (i == stripes_num - 1) ? last_stripe_size : stripe_size;
-        node = ((i + request.offset / stripe_size) % (comm_size - 1)) + 1; // !!! assuming master node has rank 0 !!!
         offset = request.offset + i * stripe_size;
+        size_t index = offset / stripe_size;
+        const uint8_t* source = request.data.data() + i * stripe_size;
 
+        // zeros are not stored: a whole stripe of them is punched out and becomes a hole,
+        // nothing is sent at all when the stripe already is one
+        if (Utils::is_zero(source, final_size) && (final_size == stripe_size || holes->is_hole(path, index)))
+        {
+            checksum = Checksum::crc32c_zeros(final_size, checksum);
+            if (holes->is_hole(path, index))
+                continue;
+
+            holes->remove_hole(path, index);
+            node_request.id = Utils::generate_id();
+            node_request.opcode = OperationCode::Type::PUNCH;
+            node_request.offset = offset;
+            node_request.data_len = 0;
+            node_request.data.clear();
+            node_request.checksum = 0;
+            node_request.flags = CompressionCode::Type::NONE;
+            node_request.to_buffer(raw_buffers[i]);
+            punched[i] = true;
+            continue;
+        }
+
+        holes->remove_hole(path, index);
         node_request.id = Utils::generate_id();
+        node_request.opcode = OperationCode::Type::WRITE;
         node_request.data_len = final_size;
         node_request.offset = offset;
-        node_request.data.assign(request.data.begin() + i * stripe_size, request.data.begin() + i * stripe_size + final_size);
+        node_request.flags = CompressionCode::Type::NONE;
+        node_request.data.resize(final_size);
+        node_request.checksum = Checksum::crc32c_copy(node_request.data.data(), source, final_size);
+        checksum = Checksum::crc32c_combine(checksum, node_request.checksum, final_size);
+
+        // only whole stripes are compressed, a partial one would have to be merged
+        // with the stored data by the node; stripes that don't shrink are sent raw
+        if (compression != CompressionCode::Type::NONE && compression != CompressionCode::Type::UNKNOWN
+            && final_size == stripe_size
+            && Compression::compress(compression, node_request.data.data(), final_size, compressed))
+        {
+            node_request.data.swap(compressed);
+            node_request.data_len = node_request.data.size();
+            node_request.flags = compression;
+            node_request.checksum = Checksum::crc32c(node_request.data.data(), node_request.data_len);
+        }
+
         node_request.to_buffer(raw_buffers[i]);
-        // std::cout << "data_size: " << raw_buffer_size  << "\n"
-        //     << "node: " << node << "\n"
-        //     << "offset: " << offset << "\n";
-        MPI_Isend(raw_buffers[i].data(), raw_buffers[i].size(), MPI_UNSIGNED_CHAR, node, offset, MPI_COMM_WORLD, &send_requests[i]);
-        MPI_Irecv(&responses[i], 1, MPI_INT, node, offset, MPI_COMM_WORLD, &requests[i]);    
     }
+    uint64_t epoch = holes->get_epoch(path); // after the stripes of this write moved it, for the punched ones
+    Tracing::record(request.trace_id, "prepare_stripes", prepare_start, Tracing::now(), "stripes", stripes_num);
 
-    // MPI_Waitall(stripes_num, send_requests, MPI_STATUSES_IGNORE);
-    MPI_Waitall(stripes_num, requests, MPI_STATUSES_IGNORE);
+    if (checksum != request.checksum)
+    {
+        SPDLOG_ERROR("write: Checksum mismatch for {} at offset {}.", path, request.offset);
+        checksum_errors.add();
+        response.rescode = ResultCode::Type::ERRMSG;
+        response.message = Utils::get_byte_array_from_int(EIO);
+        response.message_len = response.message.size();
+        return;
+    }
 
-    for (int i =0; i < stripes_num; i ++)
+    // the stripes still where an older layout put them are moved first, the copy
+    // would otherwise bring back what a partial write or a punch leaves out
+    if (placement->is_moving())
     {
-        node = ((i + request.offset / stripe_size) % (comm_size - 1)) + 1; // !!! assuming master node has rank 0 !!!
+        for (size_t i = 0; i < stripes_num; i++)
+        {
+            int error = raw_buffers[i].empty() ? 0 : relocate(request.path, i + request.offset / stripe_size);
+            if (error != 0)
+            {
+                SPDLOG_ERROR("write: Cannot move offset {} of {}: {}", request.offset + i * stripe_size, path, std::strerror(error));
+                response.rescode = ResultCode::Type::ERRMSG;
+                response.message = Utils::get_byte_array_from_int(error);
+                response.message_len = response.message.size();
+                return;
+            }
+        }
+    }
+
+    std::shared_ptr<const PlacementLayout> layout = placement->get_current();
+    uint64_t send_start = Tracing::now();
+    for (size_t i = 0; i < stripes_num; i++) {
+        if (raw_buffers[i].empty())
+            continue; // already a hole
+
         offset = request.offset + i * stripe_size;
-        // std::cout << "Node: " << node << ", Offset: " << offset << ", Sent ack: " << responses[i] << std::endl;
-        if (responses[i] != 0)
+
+        // every replica gets the same packet, the last one takes the buffer
+        std::vector<int> replicas = get_nodes(*layout, path, i + request.offset / stripe_size);
+        for (int r = 0; r < replica_count; r++)
+        {
+            size_t k = i * replica_count + r;
+            nodes[k] = replicas[r];
+            std::vector<uint8_t> message;
+            if (r + 1 < replica_count)
+                message = raw_buffers[i];
+            else
+                message.swap(raw_buffers[i]);
+            calls[k] = transport->call(nodes[k], std::move(message), sizeof(int));
+        }
+    }
+
+    std::vector<int> responses = std::vector<int>(requests_num, 0);
+    for (size_t k = 0; k < requests_num; k ++)
+    {
+        if (calls[k] == nullptr)
+            continue;
+        calls[k]->wait();
+        responses[k] = get_result(*calls[k]);
+    }
+    Tracing::record(request.trace_id, "stripe_writes", send_start, Tracing::now(), "requests", requests_num);
+
+    // a write only succeeds when all the replicas have it, otherwise they would diverge
+    size_t failed = requests_num;
+    for (size_t k = 0; k < requests_num && failed == requests_num; k ++)
+    {
+        if (responses[k] != 0)
+            failed = k;
+    }
+
+    if (failed == requests_num)
+    {
+        for (size_t i = 0; i < stripes_num; i++)
+            if (punched[i])
+                holes->add_hole(path, request.offset / stripe_size + i, epoch);
+    }
+
+    // a read that took the epoch while the stripes were on their way may have found them
+    // missing on the nodes and recorded them as holes: they are removed again, and the epoch
+    // moves past any such read still to come back
+    for (size_t i = 0; i < stripes_num; i++)
+    {
+        if (calls[i * replica_count] != nullptr && (!punched[i] || failed != requests_num))
+            holes->remove_hole(path, request.offset / stripe_size + i);
+    }
+
+    if (failed != requests_num)
+    {
+        SPDLOG_ERROR("write: Node {} failed to store offset {}: {}", nodes[failed], request.offset + (failed / replica_count) * stripe_size, std::strerror(responses[failed]));
+        response.rescode = ResultCode::Type::ERRMSG;
+        response.message = Utils::get_byte_array_from_int(responses[failed]);
+        response.message_len = response.message.size();
+        return;
+    }
+
+    response.rescode = ResultCode::Type::SUCCESS;
+}
+
+// Erasure coded layout: the file is cut in groups of k stripes, the stripes of
+// a group are the data fragments and m parity fragments are computed from them.
+// Stripe s of group g is stored as usual (path#offset) and parity j is stored
+// as path#pj#group_offset, prefixed with the lengths of the k data fragments so
+// a degraded read knows how much of each rebuilt fragment is real data.
+
+std::vector<int> StorageConnectionHandler::get_nodes(const PlacementLayout& layout, const std::string& path, size_t index) const
+{
+    if (codec == nullptr)
+        return layout.get_nodes(path, index, selector->get_replica_count(), 1);
+
+    // in the round robin layout consecutive groups start on different nodes, so the parity
+    // is spread over all of them
+    int fragments_num = codec->get_data_shards() + codec->get_parity_shards();
+    return layout.get_nodes(path, index, fragments_num, fragments_num);
+}
+
+std::vector<uint8_t> StorageConnectionHandler::get_parity_path(const std::vector<uint8_t>& path, int parity) const
+{
+    std::vector<uint8_t> parity_path = path;
+    std::string suffix = "#p" + std::to_string(parity);
+    parity_path.insert(parity_path.end(), suffix.begin(), suffix.end());
+    return parity_path;
+}
+
+void StorageConnectionHandler::fetch_fragments(std::vector<Fragment>& fragments, const std::vector<int>& indices)
+{
+    size_t requests_num = indices.size();
+    std::vector<uint16_t> ids = std::vector<uint16_t>(requests_num);
+    std::vector<std::unique_ptr<Transport::Call>> calls = std::vector<std::unique_ptr<Transport::Call>>(requests_num);
+    StoragePacket node_request, node_response;
+    node_request.opcode = OperationCode::Type::READ;
+    node_request.trace_id = Tracing::get_current_trace();
+    Tracing::Span span("fetch_fragments", node_request.trace_id, "fragments", requests_num);
+
+    // parity fragments are the largest: the length table followed by a full stripe
+    size_t max_data_len = stripe_size + 4 * codec->get_data_shards();
+
+    for (size_t i = 0; i < requests_num; i++)
+    {
+        Fragment& fragment = fragments[indices[i]];
+        ids[i] = Utils::generate_id();
+        node_request.id = ids[i];
+        node_request.offset = fragment.offset;
+        node_request.path_len = fragment.path.size();
+        node_request.path = fragment.path;
+        std::vector<uint8_t> message;
+        node_request.to_buffer(message);
+
+        calls[i] = transport->call(fragment.node, std::move(message),
+            StoragePacket::header_size + fragment.path.size() + max_data_len + 4);
+    }
+
+    for (size_t i = 0; i < requests_num; i++)
+    {
+        Fragment& fragment = fragments[indices[i]];
+        calls[i]->wait();
+        const std::vector<uint8_t>& reply = calls[i]->get_reply();
+
+        try {
+            node_response.from_buffer(reply.data(), reply.size());
+        }
+        catch (std::exception& e) {
+            SPDLOG_WARN("fetch_fragments: Bad reply from node {}: {}", fragment.node, e.what());
+            fragment.error = EIO;
+            continue;
+        }
+
+        if (node_response.id != ids[i])
+            fragment.error = EIO;
+        else if (node_response.rescode != ResultCode::Type::SUCCESS)
+            fragment.error = node_response.message_len == 4 ? Utils::get_int_from_byte_array(node_response.message) : EIO;
+        else if (Checksum::crc32c(node_response.data.data(), node_response.data.size()) != node_response.checksum)
+        {
+            SPDLOG_WARN("fetch_fragments: Corrupted fragment from node {} for offset {}.", fragment.node, fragment.offset);
+            checksum_errors.add();
+            fragment.error = EIO;
+        }
+        else
+        {
+            fragment.error = 0;
+            fragment.data = std::move(node_response.data);
+        }
+    }
+}
+
+void StorageConnectionHandler::store_fragments(std::vector<Fragment>& fragments, const std::vector<int>& indices)
+{
+    size_t requests_num = indices.size();
+    std::vector<std::unique_ptr<Transport::Call>> calls = std::vector<std::unique_ptr<Transport::Call>>(requests_num);
+    StoragePacket node_request;
+    node_request.opcode = OperationCode::Type::WRITE;
+    node_request.trace_id = Tracing::get_current_trace();
+    Tracing::Span span("store_fragments", node_request.trace_id, "fragments", requests_num);
+
+    for (size_t i = 0; i < requests_num; i++)
+    {
+        Fragment& fragment = fragments[indices[i]];
+        node_request.id = Utils::generate_id();
+        node_request.offset = fragment.offset;
+        node_request.path_len = fragment.path.size();
+        node_request.path = fragment.path;
+        node_request.data_len = fragment.data.size();
+        node_request.checksum = Checksum::crc32c(fragment.data.data(), fragment.data.size());
+        std::vector<uint8_t> message;
+        node_request.data.swap(fragment.data);
+        node_request.to_buffer(message);
+        node_request.data.swap(fragment.data);
+
+        calls[i] = transport->call(fragment.node, std::move(message), sizeof(int));
+    }
+
+    for (size_t i = 0; i < requests_num; i++)
+    {
+        calls[i]->wait();
+        fragments[indices[i]].error = get_result(*calls[i]);
+    }
+}
+
+bool StorageConnectionHandler::fetch_relocated(const std::vector<uint8_t>& path, size_t group,
+    std::vector<Fragment>& fragments, const std::vector<int>& indices)
+{
+    if (!placement->is_moving()
+        || std::all_of(indices.begin(), indices.end(), [&](int f) { return fragments[f].error == 0; }))
+        return true;
+
+    int error = relocate(path, group);
+    fetch_fragments(fragments, indices);
+    if (error == 0)
+        return true;
+
+    // a failed node is rebuilt from the parity as usual, a fragment that is missing may not be
+    SPDLOG_ERROR("Cannot move group {} of {}: {}", group, Utils::get_string_from_byte_array(path), std::strerror(error));
+    return std::none_of(indices.begin(), indices.end(), [&](int f) { return fragments[f].error == ENOENT; });
+}
+
+void StorageConnectionHandler::ec_read(const StoragePacket& request, StoragePacket& response)
+{
+    int k = codec->get_data_shards(), m = codec->get_parity_shards();
+    size_t group_size = k * stripe_size;
+    size_t table_size = 4 * k;
+    size_t data_len = Utils::get_int_from_byte_array(request.data);
+    size_t start = request.offset, end = start + data_len;
+    size_t final_size = 0;
+
+    std::string path = Utils::get_string_from_byte_array(request.path);
+    std::shared_ptr<const PlacementLayout> layout = placement->get_current();
+
+    response.rescode = ResultCode::Type::SUCCESS;
+    response.data.assign(data_len, 0); // holes read as zeros
+
+    for (size_t group = start / group_size; group * group_size < end; group++)
+    {
+        size_t group_offset = group * group_size;
+        std::vector<Fragment> fragments = std::vector<Fragment>(k + m);
+        std::vector<int> nodes = get_nodes(*layout, path, group);
+        for (int f = 0; f < k + m; f++)
+        {
+            fragments[f].node = nodes[f];
+            fragments[f].offset = f < k ? group_offset + f * stripe_size : group_offset;
+            fragments[f].path = f < k ? request.path : get_parity_path(request.path, f - k);
+        }
+
+        // only the stripes overlapping the request, unless a node fails
+        int first = start > group_offset ? (start - group_offset) / stripe_size : 0;
+        int last = std::min<size_t>((end - 1 - group_offset) / stripe_size, k - 1);
+        std::vector<int> wanted, others;
+        for (int f = 0; f < k + m; f++)
+            (f >= first && f <= last ? wanted : others).push_back(f);
+
+        fetch_fragments(fragments, wanted);
+        if (!fetch_relocated(request.path, group, fragments, wanted))
+        {
+            response.rescode = ResultCode::Type::ERRMSG;
+            response.message = Utils::get_byte_array_from_int(EIO);
+            response.message_len = response.message.size();
+            response.data_len = 0;
+            response.data.clear();
+            return;
+        }
+
+        bool degraded = false;
+        for (int f : wanted)
+            if (fragments[f].error != 0 && fragments[f].error != ENOENT)
+                degraded = true;
+
+        if (degraded)
+        {
+            SPDLOG_WARN("read: Degraded read of group {} of {}, rebuilding it from the parity.",
+                group, Utils::get_string_from_byte_array(request.path));
+            fetch_fragments(fragments, others);
+
+            // any parity fragment knows how long the data fragments are
+            int table = -1;
+            for (int j = 0; j < m && table == -1; j++)
+                if (fragments[k + j].error == 0 && fragments[k + j].data.size() == table_size + stripe_size)
+                    table = k + j;
+
+            std::vector<bool> present = std::vector<bool>(k + m);
+            std::vector<uint8_t*> shards = std::vector<uint8_t*>(k + m);
+            std::vector<uint32_t> lengths = std::vector<uint32_t>(k, 0);
+            if (table != -1)
+                for (int f = 0; f < k; f++)
+                    lengths[f] = Wire::load_be<uint32_t>(fragments[table].data.data() + 4 * f);
+
+            for (int f = 0; f < k + m; f++)
+            {
+                Fragment& fragment = fragments[f];
+                if (f < k)
+                {
+                    // a fragment that was never written is known to be all zeros
+                    present[f] = fragment.error == 0 || (fragment.error == ENOENT && lengths[f] == 0);
+                    fragment.data.resize(stripe_size);
+                    shards[f] = fragment.data.data();
+                }
+                else
+                {
+                    present[f] = fragment.error == 0 && fragment.data.size() == table_size + stripe_size;
+                    fragment.data.resize(table_size + stripe_size);
+                    shards[f] = fragment.data.data() + table_size;
+                }
+            }
+
+            try {
+                if (table == -1)
+                    throw std::runtime_error("No parity fragment available");
+                codec->reconstruct(shards.data(), present, stripe_size);
+            }
+            catch (std::exception& e) {
+                SPDLOG_ERROR("read: Cannot rebuild group {}: {}", group, e.what());
+                response.rescode = ResultCode::Type::ERRMSG;
+                response.message = Utils::get_byte_array_from_int(EIO);
+                response.message_len = response.message.size();
+                response.data_len = 0;
+                response.data.clear();
+                return;
+            }
+
+            for (int f = 0; f < k; f++)
+            {
+                fragments[f].data.resize(lengths[f]);
+                fragments[f].error = 0;
+            }
+        }
+
+        for (int f : wanted)
+        {
+            Fragment& fragment = fragments[f];
+            if (fragment.error != 0)
+                continue; // never written
+
+            size_t low = std::max<size_t>(start, fragment.offset);
+            size_t high = std::min<size_t>(end, fragment.offset + fragment.data.size());
+            if (high <= low)
+                continue;
+
+            std::copy(fragment.data.begin() + (low - fragment.offset), fragment.data.begin() + (high - fragment.offset),
+                response.data.begin() + (low - start));
+            final_size = std::max(final_size, high - start);
+        }
+    }
+
+    response.data_len = final_size;
+    response.data.resize(final_size);
+    response.checksum = Checksum::crc32c(response.data.data(), final_size);
+}
+
+void StorageConnectionHandler::ec_write(const StoragePacket& request, StoragePacket& response)
+{
+    int k = codec->get_data_shards(), m = codec->get_parity_shards();
+    size_t group_size = k * stripe_size;
+    size_t table_size = 4 * k;
+    size_t start = request.offset, end = start + request.data.size();
+    std::string path = Utils::get_string_from_byte_array(request.path);
+    std::shared_ptr<const PlacementLayout> layout = placement->get_current();
+
+    if (Checksum::crc32c(request.data.data(), request.data.size()) != request.checksum)
+    {
+        SPDLOG_ERROR("write: Checksum mismatch for {} at offset {}.", path, request.offset);
+        checksum_errors.add();
+        response.rescode = ResultCode::Type::ERRMSG;
+        response.message = Utils::get_byte_array_from_int(EIO);
+        response.message_len = response.message.size();
+        return;
+    }
+
+    for (size_t group = start / group_size; group * group_size < end; group++)
+    {
+        size_t group_offset = group * group_size;
+        std::vector<Fragment> fragments = std::vector<Fragment>(k + m);
+        std::vector<int> partial, changed;
+        std::vector<int> nodes = get_nodes(*layout, path, group);
+        for (int f = 0; f < k + m; f++)
+        {
+            fragments[f].node = nodes[f];
+            fragments[f].offset = f < k ? group_offset + f * stripe_size : group_offset;
+            fragments[f].path = f < k ? request.path : get_parity_path(request.path, f - k);
+
+            if (f >= k)
+                changed.push_back(f);
+            else if (start > fragments[f].offset || end < fragments[f].offset + stripe_size)
+                partial.push_back(f); // the parity needs whatever the write does not cover
+        }
+
+        // read-modify-write of the stripes that are not fully overwritten
+        fetch_fragments(fragments, partial);
+        if (!fetch_relocated(request.path, group, fragments, partial))
         {
             response.rescode = ResultCode::Type::ERRMSG;
-            response.message = Utils::get_byte_array_from_int(responses[i]);
+            response.message = Utils::get_byte_array_from_int(EIO);
             response.message_len = response.message.size();
             return;
         }
+
+        for (int f : partial)
+        {
+            if (fragments[f].error != 0 && fragments[f].error != ENOENT)
+            {
+                // degraded writes are not supported, the parity would not match the lost stripe
+                SPDLOG_ERROR("write: Node {} failed to read offset {} for the parity update: {}",
+                    fragments[f].node, fragments[f].offset, std::strerror(fragments[f].error));
+                response.rescode = ResultCode::Type::ERRMSG;
+                response.message = Utils::get_byte_array_from_int(EIO);
+                response.message_len = response.message.size();
+                return;
+            }
+        }
+
+        std::vector<uint32_t> lengths = std::vector<uint32_t>(k);
+        std::vector<const uint8_t*> data_shards = std::vector<const uint8_t*>(k);
+        std::vector<uint8_t*> parity_shards = std::vector<uint8_t*>(m);
+        for (int f = 0; f < k; f++)
+        {
+            Fragment& fragment = fragments[f];
+            size_t low = std::max<size_t>(start, fragment.offset);
+            size_t high = std::min<size_t>(end, fragment.offset + stripe_size);
+            if (high > low)
+            {
+                if (fragment.data.size() < high - fragment.offset)
+                    fragment.data.resize(high - fragment.offset);
+                std::copy(request.data.begin() + (low - start), request.data.begin() + (high - start),
+                    fragment.data.begin() + (low - fragment.offset));
+                changed.push_back(f);
+            }
+
+            // the code works on full stripes, the missing tail counts as zeros
+            lengths[f] = fragment.data.size();
+            fragment.data.resize(stripe_size);
+            data_shards[f] = fragment.data.data();
+        }
+
+        for (int j = 0; j < m; j++)
+        {
+            std::vector<uint8_t>& parity = fragments[k + j].data;
+            parity.resize(table_size + stripe_size);
+            for (int f = 0; f < k; f++)
+                Wire::store_be<uint32_t>(parity.data() + 4 * f, lengths[f]);
+            parity_shards[j] = parity.data() + table_size;
+        }
+
+        codec->encode(data_shards.data(), parity_shards.data(), stripe_size);
+
+        for (int f = 0; f < k; f++)
+            fragments[f].data.resize(lengths[f]);
+
+        store_fragments(fragments, changed);
+        for (int f : changed)
+        {
+            if (fragments[f].error != 0)
+            {
+                SPDLOG_ERROR("write: Node {} failed to store offset {}: {}", fragments[f].node, fragments[f].offset, std::strerror(fragments[f].error));
+                response.rescode = ResultCode::Type::ERRMSG;
+                response.message = Utils::get_byte_array_from_int(fragments[f].error);
+                response.message_len = response.message.size();
+                return;
+            }
+        }
     }
 
     response.rescode = ResultCode::Type::SUCCESS;
@@ -369,34 +1027,418 @@ void StorageConnectionHandler::write(const StoragePacket& request, StoragePacket
 
 void StorageConnectionHandler::remove(const StoragePacket& request, StoragePacket& response)
 {
-    std::vector<uint8_t> raw_buffer;
-    request.to_buffer(raw_buffer);
-    std::vector<int> responses = std::vector<int>(comm_size - 1);
-    std::vector<MPI_Request> requests = std::vector<MPI_Request>(comm_size - 1);
-    for (int i = 1; i < comm_size; i++)
+    std::string path = Utils::get_string_from_byte_array(request.path);
+    int64_t file_size = request.data_len == 4 ? Utils::get_int_from_byte_array(request.data) : -1;
+    holes->forget(path);
+    reclaimer->enqueue(path, file_size);
+    response.rescode = ResultCode::Type::SUCCESS;
+}
+
+size_t StorageConnectionHandler::reclaim(const std::string& path, int64_t file_size)
+{
+    const size_t batch_size = 4096; // offsets per node request
+    std::vector<uint8_t> raw_path = Utils::get_byte_array_from_string(path);
+    // (node, path) -> offsets, parity fragments have a path of their own
+    std::map<std::pair<int, std::vector<uint8_t>>, std::vector<uint32_t>> batches;
+    size_t stripes = 0;
+
+    // while the placement changes a stripe may be where any of the layouts put it,
+    // the path is not moved meanwhile
+    std::vector<std::shared_ptr<const PlacementLayout>> layouts = placement->get_older();
+    layouts.insert(layouts.begin(), placement->get_current());
+    std::lock_guard<std::mutex> lock(placement->get_path_lock(path));
+
+    // the nodes of the replicas, or of each fragment when erasure coded, in any layout
+    auto get_holders = [&](size_t index) {
+        std::vector<std::vector<int>> holders;
+        for (const auto& layout : layouts)
+        {
+            std::vector<int> nodes = get_nodes(*layout, path, index);
+            holders.resize(codec == nullptr ? 1 : nodes.size());
+            for (size_t f = 0; f < nodes.size(); f++)
+            {
+                std::vector<int>& slot = holders[codec == nullptr ? 0 : f];
+                if (nodes[f] != 0 && std::find(slot.begin(), slot.end(), nodes[f]) == slot.end())
+                    slot.push_back(nodes[f]);
+            }
+        }
+        return holders;
+    };
+
+    if (file_size < 0)
+    {
+        // the nodes remove whatever they find for the path
+        for (int node = 1; node <= transport->get_node_count(); node++)
+            batches[{node, raw_path}];
+        stripes = transport->get_node_count(); // a directory scan each
+    }
+    else if (codec == nullptr)
     {
-        MPI_Send(raw_buffer.data(), raw_buffer.size(), MPI_UNSIGNED_CHAR, i, i, MPI_COMM_WORLD);
-        MPI_Irecv(&responses[i - 1], 1, MPI_INT, i, i, MPI_COMM_WORLD, &requests[i - 1]);
+        size_t stripes_num = file_size / stripe_size + (file_size % stripe_size != 0 ? 1 : 0);
+        for (size_t index = 0; index < stripes_num; index++)
+            for (int node : get_holders(index)[0])
+                batches[{node, raw_path}].push_back(index * stripe_size);
+        stripes = stripes_num;
+    }
+    else
+    {
+        int k = codec->get_data_shards(), m = codec->get_parity_shards();
+        size_t group_size = k * stripe_size;
+        for (size_t group = 0; group * group_size < (size_t) file_size; group++)
+        {
+            size_t group_offset = group * group_size;
+            std::vector<std::vector<int>> holders = get_holders(group);
+            for (int f = 0; f < k && group_offset + f * stripe_size < (size_t) file_size; f++, stripes++)
+                for (int node : holders[f])
+                    batches[{node, raw_path}].push_back(group_offset + f * stripe_size);
+            for (int j = 0; j < m; j++, stripes++)
+                for (int node : holders[k + j])
+                    batches[{node, get_parity_path(raw_path, j)}].push_back(group_offset);
+        }
     }
 
-    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+    StoragePacket node_request;
+    node_request.opcode = OperationCode::Type::RM_FILE;
+    std::vector<int> nodes;
+    std::vector<std::unique_ptr<Transport::Call>> calls;
+    for (const auto& [key, offsets] : batches)
+    {
+        node_request.path_len = key.second.size();
+        node_request.path = key.second;
+        size_t sent = 0;
+        do {
+            size_t count = std::min(batch_size, offsets.size() - sent);
+            node_request.id = Utils::generate_id();
+            node_request.data.resize(4 * count);
+            for (size_t i = 0; i < count; i++)
+                Wire::store_be<uint32_t>(node_request.data.data() + 4 * i, offsets[sent + i]);
+            node_request.data_len = node_request.data.size();
+            sent += count;
 
-    for (int i = 1; i < comm_size; i ++)
+            std::vector<uint8_t> message;
+            node_request.to_buffer(message);
+            nodes.push_back(key.first);
+            calls.push_back(transport->call(key.first, std::move(message), sizeof(int)));
+        } while (sent < offsets.size());
+    }
+
+    for (size_t i = 0; i < calls.size(); i++)
+    {
+        calls[i]->wait();
+        int result = get_result(*calls[i]);
+        if (result != 0)
+            SPDLOG_ERROR("reclaim: Node {} failed to remove stripes of {}: {}", nodes[i], path, std::strerror(result));
+    }
+
+    return stripes;
+}
+
+int StorageConnectionHandler::move_stripe(const std::vector<uint8_t>& path, uint32_t offset,
+    const std::vector<int>& sources, const std::vector<int>& targets)
+{
+    std::vector<int> missing, stale;
+    for (int node : targets)
+        if (std::find(sources.begin(), sources.end(), node) == sources.end())
+            missing.push_back(node);
+    for (int node : sources)
+        if (std::find(targets.begin(), targets.end(), node) == targets.end())
+            stale.push_back(node);
+
+    StoragePacket node_request, node_response;
+    node_request.path_len = path.size();
+    node_request.path = path;
+    node_request.offset = offset;
+    node_request.trace_id = Tracing::get_current_trace();
+    size_t max_data_len = stripe_size + (codec != nullptr ? 4 * codec->get_data_shards() : 0);
+
+    // any copy will do, the node checks it before sending it
+    bool found = false;
+    int error = ENOENT;
+    for (size_t s = 0; s < sources.size() && !missing.empty() && !found; s++)
+    {
+        node_request.id = Utils::generate_id();
+        node_request.opcode = OperationCode::Type::READ;
+        std::vector<uint8_t> message;
+        node_request.to_buffer(message);
+        std::unique_ptr<Transport::Call> call = transport->call(sources[s], std::move(message),
+            StoragePacket::header_size + path.size() + max_data_len + 4);
+        call->wait();
+
+        try {
+            node_response.from_buffer(call->get_reply().data(), call->get_reply().size());
+        }
+        catch (std::exception& e) {
+            error = EIO;
+            continue;
+        }
+
+        if (node_response.id != node_request.id)
+            error = EIO;
+        else if (node_response.rescode == ResultCode::Type::SUCCESS)
+            found = true;
+        else if (node_response.message_len != 4 || Utils::get_int_from_byte_array(node_response.message) != ENOENT)
+            error = node_response.message_len == 4 ? Utils::get_int_from_byte_array(node_response.message) : EIO;
+    }
+
+    // a source that failed may have the only copy, the others are kept until it answers
+    if (!missing.empty() && !found && error != ENOENT)
+        return error;
+
+    std::vector<std::unique_ptr<Transport::Call>> calls;
+    if (found)
     {
-        if (responses[i - 1] != 0)
+        // stored as it is, compressed or not, a node that was written meanwhile keeps its own
+        node_request.opcode = OperationCode::Type::ADOPT;
+        node_request.data = std::move(node_response.data);
+        node_request.data_len = node_request.data.size();
+        node_request.checksum = node_response.checksum;
+        node_request.flags = node_response.flags;
+        for (int node : missing)
         {
-            response.rescode = ResultCode::Type::ERRMSG;
-            response.message = Utils::get_byte_array_from_string("Error removing file");
-            response.message_len = response.message.size();
+            node_request.id = Utils::generate_id();
+            std::vector<uint8_t> message;
+            node_request.to_buffer(message);
+            calls.push_back(transport->call(node, std::move(message), sizeof(int)));
+        }
+
+        for (auto& call : calls)
+        {
+            call->wait();
+            int result = get_result(*call);
+            if (result != 0)
+                return result;
+        }
+        calls.clear();
+    }
+
+    // the copies are in place, the old ones go
+    node_request.opcode = OperationCode::Type::PUNCH;
+    node_request.data.clear();
+    node_request.data_len = 0;
+    node_request.checksum = 0;
+    node_request.flags = CompressionCode::Type::NONE;
+    for (int node : stale)
+    {
+        node_request.id = Utils::generate_id();
+        std::vector<uint8_t> message;
+        node_request.to_buffer(message);
+        calls.push_back(transport->call(node, std::move(message), sizeof(int)));
+    }
+
+    int result = 0;
+    for (auto& call : calls)
+    {
+        call->wait();
+        if (get_result(*call) != 0)
+            result = get_result(*call);
+    }
+    return result;
+}
+
+int StorageConnectionHandler::relocate(const std::vector<uint8_t>& path, size_t index)
+{
+    std::shared_ptr<const PlacementLayout> layout = placement->get_current();
+    std::vector<std::shared_ptr<const PlacementLayout>> older = placement->get_older();
+    if (older.empty())
+        return 0;
+
+    std::string name = Utils::get_string_from_byte_array(path);
+    std::vector<int> targets = get_nodes(*layout, name, index);
+
+    // the replicas are all alike, a fragment only moves to the node of the same fragment
+    std::vector<std::vector<int>> sources = std::vector<std::vector<int>>(codec == nullptr ? 1 : targets.size());
+    for (const auto& old_layout : older)
+    {
+        std::vector<int> nodes = get_nodes(*old_layout, name, index);
+        for (size_t f = 0; f < nodes.size(); f++)
+        {
+            std::vector<int>& slot = sources[codec == nullptr ? 0 : f];
+            if (nodes[f] != 0 && std::find(slot.begin(), slot.end(), nodes[f]) == slot.end())
+                slot.push_back(nodes[f]);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(placement->get_path_lock(name));
+    if (codec == nullptr)
+        return move_stripe(path, index * stripe_size, sources[0], targets);
+
+    int k = codec->get_data_shards();
+    size_t group_offset = index * k * stripe_size;
+    int result = 0;
+    for (size_t f = 0; f < targets.size(); f++)
+    {
+        int error = (int) f < k
+            ? move_stripe(path, group_offset + f * stripe_size, sources[f], std::vector<int> {targets[f]})
+            : move_stripe(get_parity_path(path, f - k), group_offset, sources[f], std::vector<int> {targets[f]});
+        if (error != 0)
+            result = error;
+    }
+    return result;
+}
+
+size_t StorageConnectionHandler::rebalance(int node, std::string& cursor)
+{
+    const size_t page_size = 65536; // bytes of stripe paths per listing
+
+    StoragePacket node_request, node_response;
+    node_request.id = Utils::generate_id();
+    node_request.opcode = OperationCode::Type::SCAN;
+    node_request.path = Utils::get_byte_array_from_string(cursor);
+    node_request.path_len = node_request.path.size();
+    node_request.data = Utils::get_byte_array_from_int(page_size);
+    node_request.data_len = node_request.data.size();
+    std::vector<uint8_t> message;
+    node_request.to_buffer(message);
+
+    std::unique_ptr<Transport::Call> call = transport->call(node, std::move(message),
+        StoragePacket::header_size + cursor.size() + page_size + 4);
+    call->wait();
+    node_response.from_buffer(call->get_reply().data(), call->get_reply().size());
+    if (node_response.id != node_request.id || node_response.rescode != ResultCode::Type::SUCCESS)
+        throw std::runtime_error(std::format("The node did not list its stripes after {}.", cursor));
+
+    // the fragments of a group and the replicas of a stripe are moved together
+    std::set<std::pair<std::string, size_t>> moved;
+    size_t group_size = stripe_size * (codec != nullptr ? codec->get_data_shards() : 1);
+    size_t listed = 0;
+    std::string last;
+    const std::vector<uint8_t>& data = node_response.data;
+    for (auto begin = data.begin(), end = data.begin(); begin != data.end(); begin = end + 1)
+    {
+        end = std::find(begin, data.end(), 0);
+        if (end == data.end())
+            break;
+        std::string entry(begin, end);
+        listed++;
+
+        // path#offset, or path#p<j>#offset for a parity fragment
+        size_t separator = entry.rfind('#');
+        if (separator == std::string::npos || separator + 1 == entry.size()
+            || entry.find_first_not_of("0123456789", separator + 1) != std::string::npos)
+        {
+            last = entry;
+            continue;
+        }
+
+        std::string name = entry.substr(0, separator);
+        size_t offset = std::stoul(entry.substr(separator + 1));
+        size_t parity = name.rfind("#p");
+        if (codec != nullptr && parity != std::string::npos && parity + 2 < name.size()
+            && name.find_first_not_of("0123456789", parity + 2) == std::string::npos)
+            name.resize(parity);
+
+        if (moved.emplace(name, offset / group_size).second)
+        {
+            int error = relocate(Utils::get_byte_array_from_string(name), offset / group_size);
+            if (error != 0)
+                throw std::runtime_error(std::format("Cannot move {}: {}", entry, std::strerror(error)));
+        }
+        last = entry;
+    }
+
+    cursor = last;
+    return listed;
+}
+
+void StorageConnectionHandler::seek(const StoragePacket& request, StoragePacket& response)
+{
+    if (request.data.size() != 8)
+    {
+        response.rescode = ResultCode::Type::INVPKT;
+        return;
+    }
+
+    int whence = Utils::get_int_from_byte_array(std::vector<uint8_t>(request.data.begin(), request.data.begin() + 4));
+    size_t file_size = Utils::get_int_from_byte_array(std::vector<uint8_t>(request.data.begin() + 4, request.data.end()));
+    size_t position = request.offset;
+    std::string path = Utils::get_string_from_byte_array(request.path);
+    size_t stripes_num = file_size / stripe_size + (file_size % stripe_size != 0 ? 1 : 0);
+
+    auto fail = [&response](int error) {
+        response.rescode = ResultCode::Type::ERRMSG;
+        response.message = Utils::get_byte_array_from_int(error);
+        response.message_len = response.message.size();
+    };
+
+    if ((whence != SEEK_DATA && whence != SEEK_HOLE) || position >= file_size)
+    {
+        fail(whence != SEEK_DATA && whence != SEEK_HOLE ? EINVAL : ENXIO);
+        return;
+    }
+
+    // every node lists the stripes of the file it stores, up to the end of the file
+    StoragePacket node_request, node_response;
+    node_request.id = Utils::generate_id();
+    node_request.opcode = OperationCode::Type::SEEK;
+    node_request.path_len = request.path_len;
+    node_request.path = request.path;
+    node_request.data = Utils::get_byte_array_from_int(file_size);
+    node_request.data_len = node_request.data.size();
+    node_request.trace_id = request.trace_id;
+    std::vector<uint8_t> raw_buffer;
+    node_request.to_buffer(raw_buffer);
+
+    uint64_t epoch = holes->get_epoch(path);
+    int node_count = transport->get_node_count();
+    std::vector<std::unique_ptr<Transport::Call>> calls = std::vector<std::unique_ptr<Transport::Call>>(node_count);
+    for (int i = 1; i <= node_count; i++)
+        calls[i - 1] = transport->call(i, std::vector<uint8_t>(raw_buffer),
+            StoragePacket::header_size + request.path_len + 4 * stripes_num);
+
+    std::vector<bool> present = std::vector<bool>(stripes_num, false);
+    for (int i = 1; i <= node_count; i++)
+    {
+        calls[i - 1]->wait();
+        const std::vector<uint8_t>& reply = calls[i - 1]->get_reply();
+        try {
+            node_response.from_buffer(reply.data(), reply.size());
+        }
+        catch (std::exception& e) {
+            node_response.rescode = ResultCode::Type::ERRMSG;
+        }
+
+        if (node_response.id != node_request.id || node_response.rescode != ResultCode::Type::SUCCESS)
+        {
+            // a hole could be data on the missing node
+            SPDLOG_ERROR("seek: Node {} did not list the stripes of {}.", i, path);
+            fail(EIO);
             return;
         }
+
+        for (size_t k = 0; k + 4 <= node_response.data.size(); k += 4)
+        {
+            size_t index = Wire::load_be<uint32_t>(node_response.data.data() + k) / stripe_size;
+            if (index < stripes_num)
+                present[index] = true;
+        }
     }
 
+    // the listing is complete, so the stripes missing from it are holes
+    for (size_t index = 0; index < stripes_num; index++)
+        if (!present[index])
+            holes->add_hole(path, index, epoch);
+
+    // a partly written stripe counts as data, the end of the file as a hole
+    size_t index = position / stripe_size;
+    while (index < stripes_num && present[index] != (whence == SEEK_DATA))
+        index++;
+
+    if (whence == SEEK_DATA && index == stripes_num)
+    {
+        fail(ENXIO);
+        return;
+    }
+
+    position = std::min(std::max(position, index * stripe_size), file_size);
     response.rescode = ResultCode::Type::SUCCESS;
+    response.data = Utils::get_byte_array_from_int(position);
+    response.data_len = response.data.size();
 }
 
-
-StorageConnectionHandler::StorageConnectionHandler(asio::io_context& context, int rank, int comm_size, size_t stripe_size)
-    : GenericConnectionHandler<StoragePacket>::GenericConnectionHandler(context)
-    , rank(rank), comm_size(comm_size), stripe_size(stripe_size) {}
+StorageConnectionHandler::StorageConnectionHandler(asio::io_context& context, Transport* transport, size_t stripe_size,
+    ReplicaSelector* selector, PlacementMap* placement, const ReedSolomon* codec, HoleMap* holes,
+    StripeReclaimer* reclaimer, const ShmChannel::Server* channel)
+    : GenericConnectionHandler<StoragePacket>::GenericConnectionHandler(context, &server_metrics)
+    , transport(transport), stripe_size(stripe_size), selector(selector), placement(placement), codec(codec), holes(holes)
+    , reclaimer(reclaimer), channel(channel) {}
 
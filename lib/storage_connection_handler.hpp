@@ -3,7 +3,13 @@
 
 #include "net_protocol.hpp"
 #include "generic_connection_handler.hpp"
-#include <mpi.h>
+#include "replica_selector.hpp"
+#include "placement_map.hpp"
+#include "erasure_code.hpp"
+#include "transport.hpp"
+#include "hole_map.hpp"
+#include "stripe_reclaimer.hpp"
+#include "shm_channel.hpp"
 
 using asio::ip::tcp;
 
@@ -11,18 +17,97 @@ namespace StorageAPI {
     class StorageConnectionHandler : public GenericConnectionHandler<StoragePacket>
     {
     private:
-        int rank, comm_size;
+        // state of one stripe of a read
+        struct StripeRead {
+            size_t index = 0;
+            uint32_t offset = 0;
+            std::vector<int> replicas;
+            std::vector<bool> tried; // replicas already asked for the stripe
+            int in_flight = 0; // requests not answered yet
+            bool done = false;
+            bool failed = false; // no replica returned valid data
+            bool relocated = false; // moved from where an older layout put it
+            int generation = 0; // bumped by the move, the replies to the requests sent before are stale
+            int size = 0;
+            uint32_t checksum = 0; // CRC32C of the size bytes copied to the response
+        };
+
+        // a read request sent to one replica
+        struct StripeRequest {
+            size_t stripe;
+            int node;
+            uint16_t id;
+            std::chrono::steady_clock::time_point start;
+            uint64_t trace_start; // same as start, on the clock of the traces
+            int generation; // of the stripe when the request was sent
+            std::unique_ptr<Transport::Call> call;
+        };
+
+        // one fragment of an erasure coded stripe group, data or parity
+        struct Fragment {
+            int node;
+            uint32_t offset;
+            std::vector<uint8_t> path;
+            std::vector<uint8_t> data;
+            int error = 0; // errno reported by the node, 0 on success
+        };
+
+        Transport* transport; // to the storage nodes
         size_t stripe_size;
+        ReplicaSelector* selector;
+        PlacementMap* placement; // which nodes hold the stripes
+        const ReedSolomon* codec; // nullptr when the stripes are replicated instead
+        HoleMap* holes; // stripes known to read as zeros
+        StripeReclaimer* reclaimer; // deletes the stripes of the removed files
+        const ShmChannel::Server* channel; // advertised to the clients, nullptr when there is none
+
+        void send_stripe_request(StripeRead& stripe, StoragePacket& node_request, std::vector<StripeRequest>& in_flight);
+        // checks a node reply and copies (decompressing if needed) at most capacity bytes of it
+        // to destination, fills in the size and checksum of the stripe, false if the data is corrupted
+        bool copy_stripe(const StoragePacket& node_response, StripeRead& stripe,
+            uint8_t* destination, size_t capacity, std::vector<uint8_t>& scratch);
+
+        // the nodes of the replicas of stripe index, or of the fragments of group index
+        // when erasure coded, in the given layout
+        std::vector<int> get_nodes(const PlacementLayout& layout, const std::string& path, size_t index) const;
+        // copies the stripe at offset from one of sources to the targets that are not among
+        // them (ADOPT), then drops it from the sources that are not targets
+        int move_stripe(const std::vector<uint8_t>& path, uint32_t offset, const std::vector<int>& sources,
+            const std::vector<int>& targets);
+        // moves stripe index (group index when erasure coded) from where the older layouts
+        // put it to where the current one does, errno on failure
+        int relocate(const std::vector<uint8_t>& path, size_t index);
+        std::vector<uint8_t> get_parity_path(const std::vector<uint8_t>& path, int parity) const;
+        // both act on the fragments listed in indices and fill in their error
+        void fetch_fragments(std::vector<Fragment>& fragments, const std::vector<int>& indices);
+        void store_fragments(std::vector<Fragment>& fragments, const std::vector<int>& indices);
+        // fetches the fragments again after moving the group when some of them could not be read
+        // while the placement changes, false when a missing one may still be elsewhere
+        bool fetch_relocated(const std::vector<uint8_t>& path, size_t group, std::vector<Fragment>& fragments,
+            const std::vector<int>& indices);
+        void ec_read(const StoragePacket& request, StoragePacket& response);
+        void ec_write(const StoragePacket& request, StoragePacket& response);
 
         void handle_request(const StoragePacket& request, StoragePacket& response);
         void init_connection(uint16_t id, StoragePacket& response);
         void read(const StoragePacket& request, StoragePacket& response);
         void write(const StoragePacket& request, StoragePacket& response);
+        // queues the file for the reclaimer, the client sends the file size
         void remove(const StoragePacket& request, StoragePacket& response);
+        // SEEK_DATA / SEEK_HOLE from request.offset, the client sends the whence and the file size
+        void seek(const StoragePacket& request, StoragePacket& response);
 
     public:
-        StorageConnectionHandler(asio::io_context& context, int rank, int comm_size, size_t stripe_size);
+        StorageConnectionHandler(asio::io_context& context, Transport* transport, size_t stripe_size,
+            ReplicaSelector* selector, PlacementMap* placement, const ReedSolomon* codec, HoleMap* holes, StripeReclaimer* reclaimer,
+            const ShmChannel::Server* channel);
         ~StorageConnectionHandler() override = default;
+
+        // deletes the stripes of a removed file of file_size bytes, one request per node
+        // and path, or lets the nodes look for them when the size is unknown (-1)
+        size_t reclaim(const std::string& path, int64_t file_size);
+        // one page of the stripes of node after cursor moved to the current layout, see StripeRebalancer::Step
+        size_t rebalance(int node, std::string& cursor);
     };
 }
 
@@ -0,0 +1,503 @@
+#include "storage_node.hpp"
+#include "checksum.hpp"
+#include "compression.hpp"
+#include "wire_codec.hpp"
+#include "metrics.hpp"
+#include "tracing.hpp"
+#include <sys/stat.h>
+
+using namespace StorageAPI;
+
+static Metrics::OperationTable node_metrics("storage_node");
+static Metrics::Counter checksum_errors("checksum_errors_total", "Stripes that failed their checksum.");
+
+namespace {
+    // every stripe file ends with a footer describing the data in front of it,
+    // files written before the footer existed are read as plain data
+    struct StripeFooter {
+        static const size_t size = 16;
+        static const uint32_t magic_value = 0x44465343; // "DFSC"
+        static const uint16_t current_version = 1;
+
+        uint32_t checksum = 0; // CRC32C of the data
+        uint32_t length = 0; // bytes of data before the footer
+        uint16_t version = current_version;
+        uint16_t flags = 0; // compression codec of the data (CompressionCode)
+        uint32_t magic = magic_value;
+
+        void store(uint8_t* destination) const
+        {
+            Wire::store_be<uint32_t>(destination, checksum);
+            Wire::store_be<uint32_t>(destination + 4, length);
+            Wire::store_be<uint16_t>(destination + 8, version);
+            Wire::store_be<uint16_t>(destination + 10, flags);
+            Wire::store_be<uint32_t>(destination + 12, magic);
+        }
+
+        // false when the last bytes of a file of file_size bytes are not a footer
+        bool load(const uint8_t* source, size_t file_size)
+        {
+            checksum = Wire::load_be<uint32_t>(source);
+            length = Wire::load_be<uint32_t>(source + 4);
+            version = Wire::load_be<uint16_t>(source + 8);
+            flags = Wire::load_be<uint16_t>(source + 10);
+            magic = Wire::load_be<uint32_t>(source + 12);
+            return magic == magic_value && version == current_version && (size_t) length + size == file_size;
+        }
+    };
+}
+
+int StorageNode::open_stripe(const std::string& stripe_path, int flags)
+{
+    int fd = open(stripe_path.c_str(), flags, 0666);
+    if (fd < 0 && errno == ENOENT && (flags & O_CREAT))
+    {
+        // a node that joined after the directory was made has none of its stripes yet
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(stripe_path).parent_path(), error);
+        fd = open(stripe_path.c_str(), flags, 0666);
+    }
+    return fd;
+}
+
+int StorageNode::write(const StoragePacket& request)
+{
+    std::string stripe_path = storage_path + Utils::get_string_from_byte_array(request.path) + "#" + std::to_string(request.offset);
+    // std::cout << rank << ": path " << stripe_path << std::endl;
+
+    // damaged on the way, nothing is written so the old stripe stays valid
+    if (Checksum::crc32c(request.data.data(), request.data_len) != request.checksum)
+    {
+        std::cout << rank << ": Checksum mismatch writing " << stripe_path << std::endl;
+        checksum_errors.add();
+        return EIO;
+    }
+
+    Tracing::Span span("disk_write", request.trace_id, "bytes", request.data_len);
+    int fd = open_stripe(stripe_path, O_CREAT | O_RDWR);
+    if (fd < 0) {
+        // std::cout << rank << ": " << std::strerror(errno) << std::endl;
+        return errno;
+    }
+
+    StripeFooter footer;
+    footer.checksum = request.checksum;
+    footer.length = request.data_len;
+    footer.flags = request.flags;
+    uint8_t raw_footer[StripeFooter::size];
+    const uint8_t* data = request.data.data();
+    size_t data_len = request.data_len;
+    std::vector<uint8_t> merged;
+
+    // a shorter write keeps the old tail of the stripe, which is part of the checksum;
+    // compressed writes always carry a whole stripe and replace the old one
+    struct stat st;
+    if (request.flags == CompressionCode::Type::NONE && fstat(fd, &st) == 0 && (size_t) st.st_size > request.data_len)
+    {
+        StripeFooter old_footer;
+        size_t old_length = st.st_size;
+        bool has_footer = old_length >= StripeFooter::size
+            && pread(fd, raw_footer, StripeFooter::size, old_length - StripeFooter::size) == (ssize_t) StripeFooter::size
+            && old_footer.load(raw_footer, old_length);
+        if (has_footer)
+            old_length = old_footer.length;
+
+        if (has_footer && old_footer.flags != CompressionCode::Type::NONE)
+        {
+            // the old stripe is compressed, it is expanded under the new data and stored raw
+            std::vector<uint8_t> old_data(old_length);
+            if (pread(fd, old_data.data(), old_length, 0) != (ssize_t) old_length)
+            {
+                int error = errno != 0 ? errno : EIO;
+                close(fd);
+                return error;
+            }
+
+            merged.resize(stripe_size);
+            try
+            {
+                size_t merged_len = Compression::decompress(CompressionCode::from_byte(old_footer.flags),
+                    old_data.data(), old_length, merged.data(), merged.size());
+                merged.resize(std::max(merged_len, data_len));
+            }
+            catch (std::exception& e)
+            {
+                std::cout << rank << ": " << e.what() << " in " << stripe_path << std::endl;
+                close(fd);
+                return EIO;
+            }
+            std::memcpy(merged.data(), request.data.data(), request.data_len);
+
+            data = merged.data();
+            data_len = merged.size();
+            footer.checksum = Checksum::crc32c(data, data_len);
+            footer.length = data_len;
+        }
+        else if (old_length > request.data_len)
+        {
+            std::vector<uint8_t> tail(old_length - request.data_len);
+            if (pread(fd, tail.data(), tail.size(), request.data_len) != (ssize_t) tail.size())
+            {
+                int error = errno != 0 ? errno : EIO;
+                close(fd);
+                return error;
+            }
+            footer.checksum = Checksum::crc32c(tail.data(), tail.size(), request.checksum);
+            footer.length = old_length;
+        }
+    }
+
+    footer.store(raw_footer);
+    bool written = pwrite(fd, data, data_len, 0) == (ssize_t) data_len
+        && pwrite(fd, raw_footer, StripeFooter::size, footer.length) == (ssize_t) StripeFooter::size
+        && ftruncate(fd, footer.length + StripeFooter::size) == 0;
+    int error = errno != 0 ? errno : EIO;
+    close(fd);
+    return written ? 0 : error;
+}
+
+int StorageNode::adopt(const StoragePacket& request)
+{
+    std::string stripe_path = storage_path + Utils::get_string_from_byte_array(request.path) + "#" + std::to_string(request.offset);
+    if (Checksum::crc32c(request.data.data(), request.data_len) != request.checksum)
+    {
+        std::cout << rank << ": Checksum mismatch adopting " << stripe_path << std::endl;
+        checksum_errors.add();
+        return EIO;
+    }
+
+    // a stripe written here since the placement changed is newer than the copy
+    int fd = open_stripe(stripe_path, O_CREAT | O_EXCL | O_WRONLY);
+    if (fd < 0)
+        return errno == EEXIST ? 0 : errno;
+
+    // stored as it was on the other node, compressed or not
+    StripeFooter footer;
+    footer.checksum = request.checksum;
+    footer.length = request.data_len;
+    footer.flags = request.flags;
+    uint8_t raw_footer[StripeFooter::size];
+    footer.store(raw_footer);
+
+    bool written = pwrite(fd, request.data.data(), request.data_len, 0) == (ssize_t) request.data_len
+        && pwrite(fd, raw_footer, StripeFooter::size, request.data_len) == (ssize_t) StripeFooter::size;
+    int error = errno != 0 ? errno : EIO;
+    close(fd);
+    if (written)
+        return 0;
+
+    unlink(stripe_path.c_str()); // the next copy must not find half a stripe
+    return error;
+}
+
+int StorageNode::read(const StoragePacket& request, std::vector<uint8_t>& result, uint32_t& checksum, uint8_t& compression)
+{
+    std::string stripe_path = storage_path + Utils::get_string_from_byte_array(request.path) + "#" + std::to_string(request.offset);
+    // std::cout << "Path: " << stripe_path << std::endl;
+    Tracing::Span span("disk_read", request.trace_id);
+    int fd = open(stripe_path.c_str(), O_RDONLY, 0600);
+    if (fd < 0)
+    {
+        // result = Utils::get_byte_array_from_int(errno);
+        // std::cout << rank << ": " << std::strerror(errno) << std::endl;
+        return -1; // errno is sent back, ENOENT tells the master the stripe was never written
+    }
+    
+    // the whole file, parity fragments are longer than a stripe
+    struct stat st;
+    size_t file_size = fstat(fd, &st) == 0 ? st.st_size : stripe_size + StripeFooter::size;
+    result.resize(file_size);
+    ssize_t nbytes = ::read(fd, result.data(), file_size);
+    
+    if (nbytes == -1)
+    {
+        // result = Utils::get_byte_array_from_int(errno);
+        // std::cout << rank << ": " << std::strerror(errno) << std::endl;
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    
+    if ((size_t) nbytes < file_size)
+        result.resize(nbytes);
+    close(fd);
+
+    StripeFooter footer;
+    if (result.size() >= StripeFooter::size && footer.load(result.data() + result.size() - StripeFooter::size, result.size()))
+    {
+        result.resize(footer.length);
+        checksum = footer.checksum; // checked while the data is copied to the response
+        compression = footer.flags;
+    }
+    else
+    {
+        checksum = Checksum::crc32c(result.data(), result.size());
+        compression = CompressionCode::Type::NONE;
+    }
+
+    return 0;
+}
+
+int StorageNode::remove(const StoragePacket& request)
+{
+    std::string stripe_path = storage_path + Utils::get_string_from_byte_array(request.path) + "#";
+    int error = 0;
+
+    // the manager lists the offsets, a missing stripe was a hole
+    if (request.data_len > 0)
+    {
+        for (size_t i = 0; i + 4 <= request.data.size(); i += 4)
+        {
+            std::string path = stripe_path + std::to_string(Wire::load_be<uint32_t>(request.data.data() + i));
+            if (unlink(path.c_str()) != 0 && errno != ENOENT)
+                error = errno;
+        }
+        return error;
+    }
+
+    // otherwise every stripe and parity fragment of the file, found in its directory
+    std::filesystem::path file_path = storage_path + Utils::get_string_from_byte_array(request.path);
+    std::string prefix = file_path.filename().string() + "#";
+    std::error_code scan_error;
+    std::filesystem::directory_iterator directory(file_path.parent_path(), scan_error);
+    if (scan_error)
+        return scan_error == std::errc::no_such_file_or_directory ? 0 : scan_error.value();
+
+    for (const std::filesystem::directory_entry& entry : directory)
+    {
+        if (entry.path().filename().string().compare(0, prefix.size(), prefix) != 0)
+            continue;
+        if (unlink(entry.path().c_str()) != 0 && errno != ENOENT)
+            error = errno;
+    }
+
+    return error;
+}
+
+int StorageNode::punch(const StoragePacket& request)
+{
+    std::string stripe_path = storage_path + Utils::get_string_from_byte_array(request.path) + "#" + std::to_string(request.offset);
+    if (unlink(stripe_path.c_str()) != 0 && errno != ENOENT)
+        return errno;
+    return 0;
+}
+
+int StorageNode::list_stripes(const StoragePacket& request, std::vector<uint8_t>& result)
+{
+    std::filesystem::path file_path = storage_path + Utils::get_string_from_byte_array(request.path);
+    std::string prefix = file_path.filename().string() + "#";
+    uint32_t limit = request.data_len == 4 ? Utils::get_int_from_byte_array(request.data) : UINT32_MAX;
+
+    std::error_code error;
+    std::filesystem::directory_iterator directory(file_path.parent_path(), error);
+    if (error)
+        return error == std::errc::no_such_file_or_directory ? 0 : error.value();
+
+    result.clear();
+    for (const std::filesystem::directory_entry& entry : directory)
+    {
+        // data stripes only, the parity fragments are named path#p<j>#offset
+        std::string name = entry.path().filename().string();
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0
+            || name.find_first_not_of("0123456789", prefix.size()) != std::string::npos)
+            continue;
+
+        unsigned long offset = std::stoul(name.substr(prefix.size()));
+        if (offset >= limit)
+            continue;
+
+        result.resize(result.size() + 4);
+        Wire::store_be<uint32_t>(result.data() + result.size() - 4, offset);
+    }
+
+    return 0;
+}
+
+bool StorageNode::scan_dir(const std::string& dir, const std::string& after, size_t budget, std::vector<uint8_t>& result)
+{
+    std::vector<std::pair<std::string, bool>> entries; // name, is a directory
+    std::error_code error;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(storage_path + dir, error))
+    {
+        std::string name = entry.path().filename().string();
+        if (name > after)
+            entries.emplace_back(name, entry.is_directory(error));
+    }
+    std::sort(entries.begin(), entries.end());
+
+    for (const auto& [name, is_dir] : entries)
+    {
+        std::string path = dir + "/" + name;
+        if (is_dir)
+        {
+            if (!scan_dir(path, "", budget, result))
+                return false;
+            continue;
+        }
+
+        if (result.size() + path.size() + 1 > budget)
+            return false;
+        result.insert(result.end(), path.begin(), path.end());
+        result.push_back(0);
+    }
+
+    return true;
+}
+
+int StorageNode::scan(const StoragePacket& request, std::vector<uint8_t>& result)
+{
+    // the walk goes on from the directory of the cursor, then from its parents, only
+    // the directories on the way are listed again for the next page
+    std::string cursor = Utils::get_string_from_byte_array(request.path);
+    size_t budget = request.data_len == 4 ? Utils::get_int_from_byte_array(request.data) : stripe_size;
+    size_t separator = cursor.rfind('/');
+    std::string dir = separator == std::string::npos ? "" : cursor.substr(0, separator);
+    std::string after = separator == std::string::npos ? "" : cursor.substr(separator + 1);
+
+    result.clear();
+    while (scan_dir(dir, after, budget, result) && !dir.empty())
+    {
+        separator = dir.rfind('/');
+        after = dir.substr(separator + 1);
+        dir = dir.substr(0, separator);
+    }
+
+    return 0;
+}
+
+void StorageNode::handle_task(const std::vector<uint8_t>& message, int tag)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int result;
+    StoragePacket response, request, node_response;
+    int err;
+    uint32_t checksum;
+    uint8_t compression;
+    std::vector<uint8_t> node_data;
+    // std::cout << rank << ": Received task (size = " << message.size() << ") on tag " << tag << "\n";
+
+    request.from_buffer(message.data(), message.size());
+    Tracing::Span span(request.opcode == OperationCode::Type::READ ? "node_read"
+        : request.opcode == OperationCode::Type::WRITE ? "node_write" : "node_request",
+        request.trace_id, "offset", request.offset);
+    // std::cout << request.to_string() << std::endl;
+    response.id = request.id;
+    response.opcode = request.opcode;
+    response.offset = request.offset;
+    response.path_len = request.path_len;
+    response.path = request.path;
+    
+    switch (request.opcode)
+    {
+        case OperationCode::Type::NOP:
+            result = 0;
+            break;
+        case OperationCode::Type::RM_FILE:
+            result = remove(request);
+            break;
+        case OperationCode::Type::WRITE:
+            result = write(request);
+            break;
+        case OperationCode::Type::PUNCH:
+            result = punch(request);
+            break;
+        case OperationCode::Type::ADOPT:
+            result = adopt(request);
+            break;
+        case OperationCode::Type::SEEK:
+        case OperationCode::Type::SCAN:
+            node_response.id = request.id;
+            node_response.opcode = request.opcode;
+            node_response.path_len = request.path_len;
+            node_response.path = request.path;
+            err = request.opcode == OperationCode::Type::SEEK ? list_stripes(request, node_response.data)
+                : scan(request, node_response.data);
+            if (err != 0)
+            {
+                node_response.rescode = ResultCode::Type::ERRMSG;
+                node_response.message = Utils::get_byte_array_from_int(err);
+                node_response.message_len = node_response.message.size();
+                node_response.data.clear();
+            }
+            else
+                node_response.rescode = ResultCode::Type::SUCCESS;
+            node_response.data_len = node_response.data.size();
+            node_response.to_buffer(node_data);
+            transport.reply(tag, node_data.data(), node_data.size());
+            node_metrics.record(request.opcode, start, message.size(), node_data.size(), err != 0);
+            return;
+        case OperationCode::Type::READ:
+            node_response.id = request.id;
+            node_response.opcode = request.opcode;
+            node_response.path_len = request.path_len;
+            node_response.path = request.path;
+            node_response.offset = request.offset;
+            err = read(request, node_data, checksum, compression);
+            if (err == 0)
+            {
+                node_response.data.resize(node_data.size());
+                if (Checksum::crc32c_copy(node_response.data.data(), node_data.data(), node_data.size()) != checksum)
+                {
+                    // the stripe rotted on disk, the master reads another copy instead
+                    std::cout << rank << ": Checksum mismatch reading offset " << request.offset << std::endl;
+                    checksum_errors.add();
+                    errno = EIO;
+                    err = -1;
+                }
+            }
+
+            if (err == -1)
+            {
+                node_response.rescode = ResultCode::Type::ERRMSG;
+                node_response.message_len = 4;
+                node_response.message = Utils::get_byte_array_from_int(errno);
+                node_response.data_len = 0;
+                node_response.data.clear();
+            }
+            else
+            {
+                node_response.rescode = ResultCode::Type::SUCCESS;
+                node_response.data_len = node_data.size();
+                node_response.checksum = checksum;
+                node_response.flags = compression; // the master decompresses
+            }
+            node_response.to_buffer(node_data); // reusing node_data vector
+            transport.reply(tag, node_data.data(), node_data.size());
+            node_metrics.record(request.opcode, start, message.size(), node_data.size(), err == -1);
+            return;
+        default:
+            result = EINVAL;
+            break;
+    }
+    transport.reply(tag, (const uint8_t*) &result, sizeof(result));
+    node_metrics.record(request.opcode, start, message.size(), sizeof(result), result != 0);
+    
+    // std::cout << rank << ": Sent " << result << " for offset " << request.offset << "\n";
+}
+
+StorageNode::StorageNode(int rank, const std::string& storage_path, int stripe_size, NodeTransport& transport)
+    : rank(rank)
+    , storage_path(storage_path)
+    , stripe_size(stripe_size)
+    , transport(transport) {}
+
+void StorageNode::run()
+{
+    int tag;
+    std::vector<uint8_t> message;
+
+    while (transport.receive(tag, message))
+    {
+        try {
+            handle_task(message, tag);
+        }
+        catch (std::exception& e)
+        {
+            // a packet that cannot be parsed, the manager gets an error instead of waiting forever
+            std::cout << rank << ": " << e.what() << std::endl;
+            int result = EINVAL;
+            transport.reply(tag, (const uint8_t*) &result, sizeof(result));
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef STORAGE_NODE_HPP
+#define STORAGE_NODE_HPP
+
+#include "net_protocol.hpp"
+#include "transport.hpp"
+
+namespace StorageAPI {
+    // Stores the stripes the storage manager sends it, one file per stripe
+    // (storage_path + path#offset), and serves them back. The requests are
+    // handled one at a time in the order the transport delivers them.
+    class StorageNode {
+    private:
+        int rank;
+        std::string storage_path;
+        int stripe_size;
+        NodeTransport& transport;
+
+        // creates the missing directories of the stripe when flags has O_CREAT
+        int open_stripe(const std::string& stripe_path, int flags);
+        int write(const StoragePacket& request);
+        // stores a stripe copied from another node as it is, keeps the one already there
+        int adopt(const StoragePacket& request);
+        // result gets the stripe data as stored, checksum the CRC32C it had when it was
+        // written and compression the codec it is stored with
+        int read(const StoragePacket& request, std::vector<uint8_t>& result, uint32_t& checksum, uint8_t& compression);
+        // the stripes at the offsets listed in request.data, all of them when there are none
+        int remove(const StoragePacket& request);
+        // drops the stripe at request.offset, a stripe that is not there is not an error
+        int punch(const StoragePacket& request);
+        // offsets of the stripes of request.path below the limit in request.data
+        int list_stripes(const StoragePacket& request, std::vector<uint8_t>& result);
+        // appends the stripe files of dir (relative to storage_path) named after after, depth
+        // first, false once result would grow beyond budget bytes
+        bool scan_dir(const std::string& dir, const std::string& after, size_t budget, std::vector<uint8_t>& result);
+        // the stripe files after the one in request.path (none to start), relative to storage_path
+        // and in the order of their paths, each ending with a null byte, at most request.data bytes
+        int scan(const StoragePacket& request, std::vector<uint8_t>& result);
+        void handle_task(const std::vector<uint8_t>& message, int tag);
+
+    public:
+        StorageNode(const StorageNode&) = delete;
+        StorageNode& operator= (const StorageNode&) = delete;
+
+        StorageNode(int rank, const std::string& storage_path, int stripe_size, NodeTransport& transport);
+
+        // serves the requests until the transport is shut down
+        void run();
+    };
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "storage_server.hpp"
+#include "mpi_transport.hpp"
 
 using namespace StorageAPI;
 
@@ -11,49 +12,119 @@ StorageServer::StorageServer(int thread_count)
     : StorageServer(thread_count, 4096) {} // default stripe size: 4KB
 
 StorageServer::StorageServer(int thread_count, int stripe_size)
+    : StorageServer(thread_count, stripe_size, 1, 0) {} // default: no replication, no hedging
+
+StorageServer::StorageServer(int thread_count, int stripe_size, int replica_count, double hedge_percentile)
+    : StorageServer(thread_count, stripe_size, replica_count, hedge_percentile, 0, 0) {} // default: no erasure coding
+
+StorageServer::StorageServer(int thread_count, int stripe_size, int replica_count, double hedge_percentile,
+    int data_fragments, int parity_fragments)
+    : StorageServer(thread_count, stripe_size, replica_count, hedge_percentile, data_fragments, parity_fragments,
+        std::make_unique<MpiTransport>(stripe_size)) {}
+
+StorageServer::StorageServer(int thread_count, int stripe_size, int replica_count, double hedge_percentile,
+    int data_fragments, int parity_fragments, std::unique_ptr<Transport> transport)
     : GenericServer<StorageConnectionHandler>::GenericServer(thread_count)
     , stripe_size(stripe_size)
+    , transport(std::move(transport))
 {
-    // MPI_Datatype dtype;
-    // int err = MPI_Type_match_size(MPI_TYPECLASS_INTEGER, sizeof(stripe_size), &dtype);
-
-    // if (err == MPI_SUCCESS) {
-    //     if (dtype == MPI_INT)
-    //         std::cout << "master matches MPI_INT\n";
-    //     else if (dtype == MPI_UNSIGNED)
-    //         std::cout << "master matches MPI_UNSIGNED\n";
-    //     else if (dtype == MPI_LONG)
-    //         std::cout << "master matches MPI_LONG\n";
-    //     else if (dtype == MPI_UNSIGNED_LONG)
-    //         std::cout << "master matches MPI_UNSIGNED_LONG\n";
-    //     else if (dtype == MPI_LONG_LONG)
-    //         std::cout << "master matches MPI_LONG_LONG\n";
-    //     else
-    //         std::cout << "master matches some other integer MPI type\n";
-    // } else {
-    //     std::cerr << "No matching MPI integer type found for master\n";
-    // }
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
-    // comm_size = 2; // for testing purposes, set comm_size to 2
-
-    // initializing connection with mpi masters
-    // sending the rank of the master process
-    for (int i = 0; i < comm_size; i ++)
+    int node_count = this->transport->get_node_count();
+
+    selector = std::make_unique<ReplicaSelector>(1, node_count, replica_count, hedge_percentile);
+
+    if (data_fragments > 0)
     {
-        if (i == rank)
-            continue;
-        
-        // MPI_Send(&rank, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
-        int r = stripe_size;
-        MPI_Send(&r, 1, MPI_INT, i, 1, MPI_COMM_WORLD);
+        if (replica_count > 1)
+            throw std::runtime_error("StorageServer: Erasure coding and replication cannot be used together.");
+
+        codec = std::make_unique<ReedSolomon>(data_fragments, parity_fragments);
+        if (data_fragments + parity_fragments > node_count)
+            SPDLOG_WARN("StorageServer: {}+{} fragments on {} nodes, a node failure may lose more than one fragment.",
+                data_fragments, parity_fragments, node_count);
+        SPDLOG_INFO("Erasure coding: {}+{}, {} kernel", data_fragments, parity_fragments, ReedSolomon::get_kernel_name());
     }
 
-    SPDLOG_INFO("Server has rank {}", rank);
+    SPDLOG_INFO("Storage nodes: {}", node_count);
+    SPDLOG_INFO("Replicas per stripe: {}, hedging: {}", selector->get_replica_count(),
+        selector->hedging_enabled() ? std::format("after p{} latency", hedge_percentile) : "off");
+}
+
+void StorageServer::set_shm_slots(uint32_t slot_count)
+{
+    shm_slots = slot_count;
+}
+
+void StorageServer::set_gc_rate(double stripes_per_second)
+{
+    gc_rate = stripes_per_second;
+}
+
+void StorageServer::set_placement_file(const std::string& file)
+{
+    placement_file = file;
+}
+
+void StorageServer::set_rebalance_rate(double stripes_per_second)
+{
+    rebalance_rate = stripes_per_second;
 }
 
 void StorageServer::run(uint16_t port) {
-    GenericServer<StorageConnectionHandler>::run(port, rank, comm_size, stripe_size);
+    std::vector<std::string> nodes;
+    for (int node = 1; node <= transport->get_node_count(); node++)
+        nodes.push_back(transport->get_node_name(node));
+    placement = std::make_unique<PlacementMap>(placement_file, nodes);
+
+    // removed files are reclaimed by a handler of their own, outside of the io_context
+    reclaimer = std::make_unique<StripeReclaimer>(gc_rate);
+    auto reclaim_handler = std::make_shared<StorageConnectionHandler>(context, transport.get(), stripe_size,
+        selector.get(), placement.get(), codec.get(), &holes, reclaimer.get(), nullptr);
+    reclaimer->start([reclaim_handler](const std::string& path, int64_t file_size) {
+        return reclaim_handler->reclaim(path, file_size);
+    });
+
+    // the nodes of an older layout still there are listed, the new ones hold no old stripe
+    if (placement->is_moving())
+    {
+        std::vector<int> sources;
+        for (const auto& layout : placement->get_older())
+            for (const std::string& member : layout->get_members())
+            {
+                auto it = std::find(nodes.begin(), nodes.end(), member);
+                int node = it - nodes.begin() + 1;
+                if (it != nodes.end() && std::find(sources.begin(), sources.end(), node) == sources.end())
+                    sources.push_back(node);
+            }
+
+        rebalancer = std::make_unique<StripeRebalancer>(rebalance_rate);
+        auto rebalance_handler = std::make_shared<StorageConnectionHandler>(context, transport.get(), stripe_size,
+            selector.get(), placement.get(), codec.get(), &holes, reclaimer.get(), nullptr);
+        rebalancer->start(sources,
+            [rebalance_handler](int node, std::string& cursor) { return rebalance_handler->rebalance(node, cursor); },
+            [this]() { placement->finish_move(); });
+    }
+
+    if (shm_slots > 0)
+    {
+        try {
+            channel = std::make_unique<ShmChannel::Server>(std::format("/dfs_storage_{}", port), shm_slots, StoragePacket::max_packet_size);
+            auto handler = std::make_shared<StorageConnectionHandler>(context, transport.get(), stripe_size, selector.get(), placement.get(), codec.get(), &holes, reclaimer.get(), channel.get());
+            channel->start(context, [handler](const uint8_t* request, size_t size, std::vector<uint8_t>& response) {
+                return handler->handle_packet(request, size, response);
+            });
+        }
+        catch (std::exception& e)
+        {
+            SPDLOG_WARN("No shared memory channel: {}", e.what());
+            channel.reset();
+        }
+    }
+
+    GenericServer<StorageConnectionHandler>::run(port, transport.get(), stripe_size, selector.get(), placement.get(), codec.get(), &holes, reclaimer.get(), channel.get());
+    rebalancer.reset();
+    channel.reset();
+    reclaimer.reset();
+    placement.reset();
 }
 
 StorageServer::~StorageServer()
@@ -3,12 +3,24 @@
 
 #include "storage_connection_handler.hpp"
 #include "generic_server_api.hpp"
+#include "stripe_rebalancer.hpp"
 
 namespace StorageAPI {
     class StorageServer : public GenericServer<StorageConnectionHandler> {
     private:
-        int rank, comm_size;
         int stripe_size; // stripe size for breaking down large files 
+        std::unique_ptr<Transport> transport; // to the storage nodes
+        std::unique_ptr<ReplicaSelector> selector; // load of the nodes holding the stripe replicas
+        std::string placement_file; // keeps the placement layouts, none when empty
+        std::unique_ptr<PlacementMap> placement; // while running
+        double rebalance_rate = 1000; // stripes moved to their new nodes per second, 0 for no limit
+        std::unique_ptr<StripeRebalancer> rebalancer; // while running and moving stripes
+        std::unique_ptr<ReedSolomon> codec; // erasure code of the stripe groups, nullptr when replicating
+        HoleMap holes; // stripes known to read as zeros
+        double gc_rate = 10000; // stripes of removed files deleted per second, 0 for no limit
+        std::unique_ptr<StripeReclaimer> reclaimer; // while running
+        uint32_t shm_slots = 32; // requests the shared memory channel holds at once, 0 disables it
+        std::unique_ptr<ShmChannel::Server> channel; // for the clients on this host, while running
     public:
         StorageServer(const StorageServer&) = delete;
         StorageServer& operator= (const StorageServer&) = delete;
@@ -16,8 +28,23 @@ namespace StorageAPI {
         StorageServer();
         StorageServer(int thread_count);
         StorageServer(int thread_count, int stripe_size);
+        StorageServer(int thread_count, int stripe_size, int replica_count, double hedge_percentile);
+        StorageServer(int thread_count, int stripe_size, int replica_count, double hedge_percentile,
+            int data_fragments, int parity_fragments);
+        // the other constructors use MPI, with the manager as rank 0
+        StorageServer(int thread_count, int stripe_size, int replica_count, double hedge_percentile,
+            int data_fragments, int parity_fragments, std::unique_ptr<Transport> transport);
         ~StorageServer();
 
+        // before run, the channel is named after the port (/dfs_storage_<port>)
+        void set_shm_slots(uint32_t slot_count);
+        // before run
+        void set_gc_rate(double stripes_per_second);
+        // before run, without one the stripes stay where the round robin placement puts them
+        // and a change of the nodes loses track of them
+        void set_placement_file(const std::string& file);
+        // before run
+        void set_rebalance_rate(double stripes_per_second);
         void run(uint16_t port);
     };
 }
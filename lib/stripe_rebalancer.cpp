@@ -0,0 +1,77 @@
+#include "stripe_rebalancer.hpp"
+
+#include "logging.hpp"
+
+using namespace StorageAPI;
+
+const std::chrono::seconds StripeRebalancer::retry_delay(5);
+
+StripeRebalancer::StripeRebalancer(double rate) : rate(rate) {}
+
+StripeRebalancer::~StripeRebalancer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+
+void StripeRebalancer::start(const std::vector<int>& nodes, Step step, std::function<void()> done)
+{
+    this->nodes = nodes;
+    this->step = std::move(step);
+    this->done = std::move(done);
+    thread = std::thread(&StripeRebalancer::run, this);
+}
+
+bool StripeRebalancer::wait_until(std::chrono::steady_clock::time_point time)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return !changed.wait_until(lock, time, [&]() { return stopping; });
+}
+
+void StripeRebalancer::run()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point next_page = start;
+    size_t total = 0;
+
+    for (int node : nodes)
+    {
+        std::string cursor;
+        while (true)
+        {
+            // the rate limit: the stripes of the last page are paid for before the next one
+            if (!wait_until(next_page))
+                return;
+
+            size_t stripes;
+            try {
+                stripes = step(node, cursor);
+            }
+            catch (std::exception& e)
+            {
+                SPDLOG_WARN("StripeRebalancer: Node {}: {}, trying again in {}s.", node, e.what(), retry_delay.count());
+                next_page = std::chrono::steady_clock::now() + retry_delay;
+                continue;
+            }
+
+            total += stripes;
+            next_page = std::chrono::steady_clock::now();
+            if (rate > 0)
+                next_page += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(stripes / rate));
+            if (cursor.empty())
+                break;
+        }
+
+        SPDLOG_INFO("StripeRebalancer: Node {} done, {} stripes listed so far.", node, total);
+    }
+
+    SPDLOG_INFO("StripeRebalancer: {} stripes listed in {}s.", total,
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count());
+    done();
+}
@@ -0,0 +1,58 @@
+#ifndef STRIPE_REBALANCER_HPP
+#define STRIPE_REBALANCER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace StorageAPI {
+    // Moves the stripes to the nodes the current placement layout puts them on,
+    // in the background and at most rate stripes per second. The nodes that may
+    // hold stripes of an older layout are listed one after the other, a page at a
+    // time, and every stripe found is moved if it has to. The reads and writes go
+    // on meanwhile, a stripe they need before its turn is moved by them.
+    //
+    // A page that fails is tried again later, the layouts are only dropped once
+    // every node was listed to the end.
+    class StripeRebalancer {
+    public:
+        // moves the stripes of the page of the listing of node after cursor (empty to start)
+        // and sets cursor to the last of them, empty at the end; returns how many were listed,
+        // throws when one could not be moved
+        using Step = std::function<size_t(int node, std::string& cursor)>;
+
+    private:
+        static const std::chrono::seconds retry_delay;
+
+        double rate; // stripes per second, 0 for no limit
+        std::vector<int> nodes;
+        Step step;
+        std::function<void()> done;
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool stopping = false;
+        std::thread thread;
+
+        void run();
+        // false when stopped meanwhile
+        bool wait_until(std::chrono::steady_clock::time_point time);
+
+    public:
+        StripeRebalancer(const StripeRebalancer&) = delete;
+        StripeRebalancer& operator= (const StripeRebalancer&) = delete;
+
+        StripeRebalancer(double rate);
+        // stops where it is, the next run starts over
+        ~StripeRebalancer();
+
+        // done is called once every stripe of the nodes follows the current layout
+        void start(const std::vector<int>& nodes, Step step, std::function<void()> done);
+    };
+}
+
+#endif
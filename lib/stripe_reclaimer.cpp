@@ -0,0 +1,111 @@
+#include "stripe_reclaimer.hpp"
+
+#include "logging.hpp"
+
+using namespace StorageAPI;
+
+StripeReclaimer::StripeReclaimer(double rate) : rate(rate) {}
+
+StripeReclaimer::~StripeReclaimer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        if (!queue.empty())
+            SPDLOG_WARN("StripeReclaimer: {} removed files were not reclaimed.", queue.size());
+    }
+    changed.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+
+void StripeReclaimer::start(Reclaim reclaim)
+{
+    this->reclaim = std::move(reclaim);
+    thread = std::thread(&StripeReclaimer::run, this);
+}
+
+void StripeReclaimer::enqueue(const std::string& path, int64_t file_size)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = pending.find(path);
+        if (it != pending.end())
+        {
+            // removed twice before its turn, the larger size covers both
+            Job& job = *it->second;
+            job.file_size = job.file_size < 0 || file_size < 0 ? -1 : std::max(job.file_size, file_size);
+            return;
+        }
+
+        queue.push_back({path, file_size});
+        pending[path] = std::prev(queue.end());
+    }
+    changed.notify_all();
+}
+
+void StripeReclaimer::flush(const std::string& path)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (pending.empty() && active.empty())
+        return;
+
+    changed.wait(lock, [&]() { return active.count(path) == 0; });
+    auto it = pending.find(path);
+    if (it == pending.end())
+        return;
+
+    Job job = std::move(*it->second);
+    queue.erase(it->second);
+    pending.erase(it);
+    active.insert(job.path);
+    lock.unlock();
+
+    execute(job);
+}
+
+size_t StripeReclaimer::execute(const Job& job)
+{
+    size_t stripes = 0;
+    try {
+        stripes = reclaim(job.path, job.file_size);
+    }
+    catch (std::exception& e)
+    {
+        SPDLOG_ERROR("StripeReclaimer: {}: {}", job.path, e.what());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        active.erase(active.find(job.path));
+    }
+    changed.notify_all();
+    return stripes;
+}
+
+void StripeReclaimer::run()
+{
+    std::chrono::steady_clock::time_point next_start = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // the rate limit: the stripes of the last file are paid for before the next one starts
+        changed.wait_until(lock, next_start, [&]() { return stopping; });
+        changed.wait(lock, [&]() { return stopping || !queue.empty(); });
+        if (stopping)
+            return;
+
+        Job job = std::move(queue.front());
+        queue.pop_front();
+        pending.erase(job.path);
+        active.insert(job.path);
+        lock.unlock();
+
+        size_t stripes = execute(job);
+        next_start = std::chrono::steady_clock::now();
+        if (rate > 0)
+            next_start += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(stripes / rate));
+    }
+}
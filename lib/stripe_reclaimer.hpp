@@ -0,0 +1,62 @@
+#ifndef STRIPE_RECLAIMER_HPP
+#define STRIPE_RECLAIMER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace StorageAPI {
+    // Deletes the stripes of removed files in the background, so an unlink only
+    // costs the storage manager a queue insertion. The files are reclaimed in
+    // the order they were removed, at most rate stripes per second.
+    //
+    // A file that is written or read again under the same path before its turn
+    // has to be reclaimed first (flush), otherwise the new stripes would go too.
+    class StripeReclaimer {
+    public:
+        // deletes the stripes of a file of file_size bytes (-1 when unknown), returns how many
+        using Reclaim = std::function<size_t(const std::string& path, int64_t file_size)>;
+
+    private:
+        struct Job {
+            std::string path;
+            int64_t file_size;
+        };
+
+        double rate; // stripes per second, 0 for no limit
+        Reclaim reclaim;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::list<Job> queue;
+        std::unordered_map<std::string, std::list<Job>::iterator> pending; // by path, into queue
+        std::multiset<std::string> active; // being reclaimed right now
+        bool stopping = false;
+        std::thread thread;
+
+        void run();
+        // job was taken out of the queue and its path added to active
+        size_t execute(const Job& job);
+
+    public:
+        StripeReclaimer(const StripeReclaimer&) = delete;
+        StripeReclaimer& operator= (const StripeReclaimer&) = delete;
+
+        StripeReclaimer(double rate);
+        // the files still queued are not reclaimed, their stripes stay on the nodes
+        ~StripeReclaimer();
+
+        void start(Reclaim reclaim);
+        void enqueue(const std::string& path, int64_t file_size);
+        // reclaims path now if it is queued, waits if it is being reclaimed
+        void flush(const std::string& path);
+    };
+}
+
+#endif
@@ -0,0 +1,377 @@
+#include "tcp_transport.hpp"
+#include <array>
+#include <atomic>
+
+using namespace StorageAPI;
+using asio::ip::tcp;
+
+namespace {
+    struct Frame {
+        TcpFrameHeader header;
+        std::vector<uint8_t> message;
+
+        std::array<asio::const_buffer, 2> buffers() const
+        {
+            return {asio::buffer(&header, sizeof(header)), asio::buffer(message)};
+        }
+    };
+
+    // the reply of a call, filled in by the thread of the transport
+    struct Reply {
+        int tag;
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::atomic<bool> done = false;
+        std::vector<uint8_t> data;
+
+        void complete(std::vector<uint8_t>&& reply)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                data = std::move(reply);
+                done.store(true, std::memory_order_release);
+            }
+            ready.notify_all();
+        }
+    };
+
+    class TcpCall : public Transport::Call {
+    private:
+        std::shared_ptr<Reply> state;
+        bool finished = false;
+
+    public:
+        TcpCall(std::shared_ptr<Reply> state) : state(std::move(state)) {}
+
+        bool test() override
+        {
+            if (finished)
+                return true;
+            if (!state->done.load(std::memory_order_acquire))
+                return false;
+            reply.swap(state->data);
+            finished = true;
+            return true;
+        }
+
+        void wait() override
+        {
+            if (finished)
+                return;
+
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->ready.wait(lock, [this]() { return state->done.load(std::memory_order_relaxed); });
+            reply.swap(state->data);
+            finished = true;
+        }
+    };
+
+    asio::awaitable<void> read_frame(tcp::socket& socket, TcpFrameHeader& header, std::vector<uint8_t>& message)
+    {
+        co_await asio::async_read(socket, asio::buffer(&header, sizeof(header)), asio::use_awaitable);
+        message.resize(header.size);
+        co_await asio::async_read(socket, asio::buffer(message), asio::use_awaitable);
+    }
+}
+
+// the connection to one node, only touched by the thread of the transport
+class TcpTransport::Link : public std::enable_shared_from_this<TcpTransport::Link> {
+public:
+    int node;
+    tcp::socket socket;
+    std::deque<std::shared_ptr<Reply>> pending; // calls waiting for their reply, in order
+    std::deque<Frame> outgoing; // frames not written yet, the first one is being written
+    int32_t next_tag = 2; // the node echoes it, 1 is the handshake
+    bool broken = false;
+
+    Link(int node, asio::io_context& context) : node(node), socket(context) {}
+
+    void send(Frame&& frame, std::shared_ptr<Reply> state)
+    {
+        if (broken)
+        {
+            state->complete({});
+            return;
+        }
+
+        frame.header.tag = state->tag = next_tag;
+        next_tag = next_tag == INT32_MAX ? 2 : next_tag + 1;
+        pending.push_back(std::move(state));
+        outgoing.push_back(std::move(frame));
+        if (outgoing.size() == 1)
+            asio::co_spawn(socket.get_executor(), write_frames(shared_from_this()), asio::detached);
+    }
+
+    asio::awaitable<void> write_frames(std::shared_ptr<Link> self)
+    {
+        (void) self; // keeps the link alive until the coroutine ends
+        try {
+            while (!outgoing.empty())
+            {
+                co_await asio::async_write(socket, outgoing.front().buffers(), asio::use_awaitable);
+                outgoing.pop_front();
+            }
+        }
+        catch (std::exception& e)
+        {
+            outgoing.clear();
+            fail(e.what());
+        }
+    }
+
+    asio::awaitable<void> read_replies(std::shared_ptr<Link> self)
+    {
+        (void) self; // keeps the link alive until the coroutine ends
+        TcpFrameHeader header;
+        std::vector<uint8_t> reply;
+
+        try {
+            for (;;)
+            {
+                co_await read_frame(socket, header, reply);
+                if (pending.empty() || pending.front()->tag != header.tag)
+                    throw std::runtime_error(std::format("unexpected reply with tag {}", header.tag));
+
+                pending.front()->complete(std::move(reply));
+                pending.pop_front();
+            }
+        }
+        catch (std::exception& e)
+        {
+            fail(e.what());
+        }
+    }
+
+    void fail(const std::string& reason)
+    {
+        if (!broken)
+            SPDLOG_ERROR("Storage node {}: {}", node, reason);
+        broken = true;
+
+        asio::error_code error;
+        socket.close(error);
+        for (auto& state : pending)
+            state->complete({});
+        pending.clear();
+    }
+};
+
+TcpTransport::TcpTransport(int stripe_size, const std::vector<Utils::ConnectionInfo<StoragePacket>>& nodes)
+{
+    tcp::resolver resolver(context);
+    for (const auto& info : nodes)
+    {
+        auto link = std::make_shared<Link>(links.size() + 1, context);
+        names.push_back(std::format("{}:{}", info.address, info.port));
+        try {
+            asio::connect(link->socket, resolver.resolve(info.address, std::to_string(info.port)));
+            link->socket.set_option(tcp::no_delay(true));
+
+            int32_t size = stripe_size;
+            TcpFrameHeader header {sizeof(size), 1};
+            asio::write(link->socket, std::array<asio::const_buffer, 2> {asio::buffer(&header, sizeof(header)), asio::buffer(&size, sizeof(size))});
+        }
+        catch (std::exception& e)
+        {
+            throw std::runtime_error(std::format("TcpTransport: storage node {}:{}: {}", info.address, info.port, e.what()));
+        }
+
+        SPDLOG_INFO("Connected to storage node {} at {}:{}", link->node, info.address, info.port);
+        asio::co_spawn(context, link->read_replies(link), asio::detached);
+        links.push_back(std::move(link));
+    }
+
+    // the readers keep the context busy until the sockets close
+    thread = std::thread([this]() { context.run(); });
+}
+
+TcpTransport::~TcpTransport()
+{
+    context.stop();
+    thread.join();
+    for (auto& link : links)
+    {
+        link->broken = true; // not worth an error
+        link->fail("transport closed");
+    }
+}
+
+int TcpTransport::get_node_count() const
+{
+    return links.size();
+}
+
+std::string TcpTransport::get_node_name(int node) const
+{
+    return names.at(node - 1);
+}
+
+std::unique_ptr<Transport::Call> TcpTransport::call(int node, std::vector<uint8_t>&& message, size_t max_reply)
+{
+    (void) max_reply; // the frames carry their size
+    auto state = std::make_shared<Reply>();
+
+    std::shared_ptr<Link> link = links.at(node - 1);
+    Frame frame {{(uint32_t) message.size(), 0}, std::move(message)}; // tagged by the link
+    asio::post(context, [link, state, frame = std::move(frame)]() mutable {
+        link->send(std::move(frame), state);
+    });
+    return std::make_unique<TcpCall>(state);
+}
+
+// a manager connected to the node, the reader lives on the thread of the transport
+class TcpNodeTransport::Connection : public std::enable_shared_from_this<TcpNodeTransport::Connection> {
+public:
+    TcpNodeTransport& transport;
+    tcp::socket socket;
+    std::deque<Frame> outgoing; // replies not written yet, the first one is being written
+
+    Connection(TcpNodeTransport& transport, tcp::socket&& socket)
+        : transport(transport), socket(std::move(socket)) {}
+
+    asio::awaitable<void> read_requests(std::shared_ptr<Connection> self)
+    {
+        (void) self; // keeps the connection alive until the coroutine ends
+        TcpFrameHeader header;
+        std::vector<uint8_t> message;
+
+        try {
+            co_await read_frame(socket, header, message);
+            int32_t stripe_size;
+            if (message.size() != sizeof(stripe_size))
+                throw std::runtime_error("no stripe size");
+            std::memcpy(&stripe_size, message.data(), sizeof(stripe_size));
+            transport.set_stripe_size(stripe_size);
+
+            for (;;)
+            {
+                co_await read_frame(socket, header, message);
+                transport.push(Request {shared_from_this(), header.tag, std::move(message)});
+            }
+        }
+        catch (std::exception& e)
+        {
+            SPDLOG_INFO("Manager disconnected: {}", e.what());
+        }
+    }
+
+    void send(Frame&& frame)
+    {
+        outgoing.push_back(std::move(frame));
+        if (outgoing.size() == 1)
+            asio::co_spawn(socket.get_executor(), write_frames(shared_from_this()), asio::detached);
+    }
+
+    asio::awaitable<void> write_frames(std::shared_ptr<Connection> self)
+    {
+        (void) self; // keeps the connection alive until the coroutine ends
+        try {
+            while (!outgoing.empty())
+            {
+                co_await asio::async_write(socket, outgoing.front().buffers(), asio::use_awaitable);
+                outgoing.pop_front();
+            }
+        }
+        catch (std::exception& e)
+        {
+            outgoing.clear();
+            asio::error_code error;
+            socket.close(error);
+        }
+    }
+};
+
+TcpNodeTransport::TcpNodeTransport(uint16_t port)
+    : acceptor(context)
+{
+    tcp::endpoint endpoint(tcp::v4(), port);
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(tcp::acceptor::reuse_address(true));
+    acceptor.bind(endpoint);
+    acceptor.listen();
+    SPDLOG_INFO("Storage node listening on port {}", port);
+
+    asio::co_spawn(context, accept(), asio::detached);
+    thread = std::thread([this]() { context.run(); });
+
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return stripe_size != 0 || closed; });
+}
+
+TcpNodeTransport::~TcpNodeTransport()
+{
+    close();
+    context.stop();
+    thread.join();
+}
+
+asio::awaitable<void> TcpNodeTransport::accept()
+{
+    for (;;)
+    {
+        tcp::socket socket = co_await acceptor.async_accept(asio::use_awaitable);
+        SPDLOG_INFO("Accepted connection from {}", socket.remote_endpoint().address().to_string());
+        socket.set_option(tcp::no_delay(true));
+
+        auto connection = std::make_shared<Connection>(*this, std::move(socket));
+        asio::co_spawn(context, connection->read_requests(connection), asio::detached);
+    }
+}
+
+void TcpNodeTransport::set_stripe_size(int size)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stripe_size != 0 && stripe_size != size)
+            SPDLOG_WARN("Manager sent stripe size {}, keeping {}", size, stripe_size);
+        if (stripe_size == 0)
+            stripe_size = size;
+    }
+    changed.notify_all();
+}
+
+void TcpNodeTransport::push(Request&& request)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(std::move(request));
+    }
+    changed.notify_one();
+}
+
+int TcpNodeTransport::get_stripe_size() const
+{
+    return stripe_size;
+}
+
+void TcpNodeTransport::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    changed.notify_all();
+}
+
+bool TcpNodeTransport::receive(int& tag, std::vector<uint8_t>& message)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return closed || !requests.empty(); });
+    if (closed)
+        return false;
+
+    Request& request = requests.front();
+    tag = request.tag;
+    message = std::move(request.message);
+    current = std::move(request.connection);
+    requests.pop_front();
+    return true;
+}
+
+void TcpNodeTransport::reply(int tag, const uint8_t* data, size_t size)
+{
+    Frame frame {{(uint32_t) size, tag}, std::vector<uint8_t>(data, data + size)};
+    asio::post(context, [connection = std::move(current), frame = std::move(frame)]() mutable {
+        connection->send(std::move(frame));
+    });
+}
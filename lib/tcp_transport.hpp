@@ -0,0 +1,90 @@
+#ifndef TCP_TRANSPORT_HPP
+#define TCP_TRANSPORT_HPP
+
+#include "transport.hpp"
+#include "net_protocol.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace StorageAPI {
+    // A message on a connection between the manager and a node is this header
+    // followed by size bytes. The first frame the manager sends on a connection
+    // carries the stripe size, like the MPI handshake.
+    struct TcpFrameHeader {
+        uint32_t size;
+        int32_t tag;
+    };
+
+    // Storage nodes reached over TCP (storage_server/scripts/slave.cpp), one
+    // connection per node served by a thread of its own. A node handles the
+    // frames of a connection in order, so the replies are matched to the calls
+    // in the order they were sent. When a connection breaks, its calls and every
+    // later call to the node fail with an empty reply (EIO).
+    class TcpTransport : public Transport {
+    public:
+        class Link;
+
+        TcpTransport(const TcpTransport&) = delete;
+        TcpTransport& operator= (const TcpTransport&) = delete;
+
+        // connects to the nodes, node n is nodes[n - 1]
+        TcpTransport(int stripe_size, const std::vector<Utils::ConnectionInfo<StoragePacket>>& nodes);
+        ~TcpTransport() override;
+
+        int get_node_count() const override;
+        // address:port
+        std::string get_node_name(int node) const override;
+        std::unique_ptr<Call> call(int node, std::vector<uint8_t>&& message, size_t max_reply) override;
+
+    private:
+        asio::io_context context;
+        std::vector<std::shared_ptr<Link>> links;
+        std::vector<std::string> names; // of the nodes, node n is names[n - 1]
+        std::thread thread;
+    };
+
+    class TcpNodeTransport : public NodeTransport {
+    public:
+        class Connection;
+
+        TcpNodeTransport(const TcpNodeTransport&) = delete;
+        TcpNodeTransport& operator= (const TcpNodeTransport&) = delete;
+
+        // blocks until a manager connected and sent the stripe size
+        TcpNodeTransport(uint16_t port);
+        ~TcpNodeTransport() override;
+
+        int get_stripe_size() const;
+        // receive returns false from now on
+        void close();
+
+        bool receive(int& tag, std::vector<uint8_t>& message) override;
+        void reply(int tag, const uint8_t* data, size_t size) override;
+
+    private:
+        struct Request {
+            std::shared_ptr<Connection> connection;
+            int tag;
+            std::vector<uint8_t> message;
+        };
+
+        asio::io_context context;
+        asio::ip::tcp::acceptor acceptor;
+        std::thread thread;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<Request> requests; // of all the connections, in arrival order
+        bool closed = false;
+        int stripe_size = 0;
+        std::shared_ptr<Connection> current; // of the request being handled
+
+        asio::awaitable<void> accept();
+        void push(Request&& request);
+        void set_stripe_size(int size);
+    };
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "tracing.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unistd.h>
+
+namespace {
+    const size_t capacity = 1 << 16; // spans kept, the oldest ones are overwritten
+
+    // every slot is a seqlock: its sequence is 0 while the event is written and
+    // the index of the event + 1 after, a dump skips the slots that change under it
+    struct Slot {
+        std::atomic<uint64_t> sequence {0};
+        Tracing::Event event;
+    };
+
+    std::unique_ptr<Slot[]> slots(new Slot[capacity]);
+    std::atomic<uint64_t> head {0};
+
+    // a trace is sampled when a random 64-bit value falls below the threshold
+    std::atomic<uint64_t> sample_threshold {0};
+
+    std::atomic<uint32_t> thread_count {0};
+    thread_local uint32_t thread_id = ++ thread_count;
+    thread_local uint64_t current_trace = 0;
+
+    std::mutex name_mutex;
+    std::string process_name = "pid " + std::to_string(getpid());
+
+    uint64_t get_random()
+    {
+        thread_local std::mt19937_64 generator(std::random_device{}());
+        return generator();
+    }
+}
+
+void Tracing::set_sample_rate(double rate)
+{
+    uint64_t threshold;
+    if (rate <= 0)
+        threshold = 0;
+    else if (rate >= 1)
+        threshold = UINT64_MAX;
+    else
+        threshold = (uint64_t) (rate * 18446744073709551616.0); // rate * 2^64
+    sample_threshold.store(threshold, std::memory_order_relaxed);
+}
+
+uint64_t Tracing::start_trace()
+{
+    uint64_t threshold = sample_threshold.load(std::memory_order_relaxed);
+    if (threshold == 0 || (threshold != UINT64_MAX && get_random() >= threshold))
+        return 0;
+
+    uint64_t trace_id = get_random();
+    return trace_id != 0 ? trace_id : 1;
+}
+
+uint64_t Tracing::get_current_trace()
+{
+    return current_trace;
+}
+
+uint64_t Tracing::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void Tracing::record(uint64_t trace_id, const char* name, uint64_t start, uint64_t end,
+    const char* arg_name, int64_t arg)
+{
+    if (trace_id == 0)
+        return;
+
+    uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[index & (capacity - 1)];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event = Event {trace_id, name, start, end, thread_id, arg_name, arg};
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+Tracing::Span::Span(const char* name, uint64_t trace_id, const char* arg_name, int64_t arg)
+    : name(name)
+    , trace_id(trace_id)
+    , previous_trace_id(current_trace)
+    , start(trace_id != 0 ? now() : 0)
+    , arg_name(arg_name)
+    , arg(arg)
+{
+    current_trace = trace_id;
+}
+
+Tracing::Span::~Span()
+{
+    current_trace = previous_trace_id;
+    if (trace_id != 0)
+        record(trace_id, name, start, now(), arg_name, arg);
+}
+
+void Tracing::set_process_name(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(name_mutex);
+    process_name = name;
+}
+
+std::string Tracing::dump_chrome_json()
+{
+    std::string name;
+    {
+        std::lock_guard<std::mutex> lock(name_mutex);
+        name = process_name;
+    }
+    // the tiers run on different hosts, a pid derived from the name keeps them apart when merged
+    size_t pid = std::hash<std::string>{}(name) & 0x7fffffff;
+
+    std::string result = std::format("{{\"traceEvents\":[\n"
+        "{{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":{},\"args\":{{\"name\":\"{}\"}}}}", pid, name);
+
+    for (size_t i = 0; i < capacity; i ++)
+    {
+        uint64_t sequence = slots[i].sequence.load(std::memory_order_acquire);
+        if (sequence == 0)
+            continue;
+        Event event = slots[i].event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slots[i].sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+
+        std::string args = std::format("\"trace_id\":\"{:016x}\"", event.trace_id);
+        if (event.arg_name != nullptr)
+            args += std::format(",\"{}\":{}", event.arg_name, event.arg);
+
+        // Chrome wants microseconds
+        result += std::format(",\n{{\"name\":\"{}\",\"cat\":\"dfs\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},"
+            "\"pid\":{},\"tid\":{},\"args\":{{{}}}}}",
+            event.name, event.start / 1e3, (event.end - event.start) / 1e3, pid, event.thread, args);
+    }
+
+    result += "\n]}\n";
+    return result;
+}
@@ -0,0 +1,65 @@
+#ifndef TRACING_HPP
+#define TRACING_HPP
+
+#include <cstdint>
+#include <string>
+
+// Sampled request tracing across the tiers. The FUSE client decides whether a
+// request is traced and gives it a trace id, which travels in the StoragePacket
+// header to the storage manager and from there in the stripe requests to the
+// storage nodes. Every tier records the spans of traced requests in a ring
+// buffer, untraced requests (trace id 0) cost a branch.
+//
+// The buffer is dumped in the Chrome trace event format (chrome://tracing,
+// Perfetto); the dumps of the tiers can be concatenated to see a request end
+// to end. Timestamps come from the system clock so they line up across hosts
+// as well as the clocks are synchronized.
+
+namespace Tracing {
+    // one finished span
+    struct Event {
+        uint64_t trace_id;
+        const char* name; // string literal
+        uint64_t start, end; // nanoseconds since the epoch
+        uint32_t thread;
+        const char* arg_name; // optional argument shown with the span, string literal or nullptr
+        int64_t arg;
+    };
+
+    // fraction of the traces started in this process that are recorded, 0 disables tracing
+    void set_sample_rate(double rate);
+    // a new trace id, 0 when the trace is not sampled
+    uint64_t start_trace();
+
+    // trace of the request the calling thread is working on (set by Span), 0 if none
+    uint64_t get_current_trace();
+
+    uint64_t now();
+    void record(uint64_t trace_id, const char* name, uint64_t start, uint64_t end,
+        const char* arg_name = nullptr, int64_t arg = 0);
+
+    // records its lifetime as a span and makes trace_id the current trace of the
+    // thread meanwhile; not for coroutines, they may resume on another thread
+    class Span {
+    public:
+        Span(const Span&) = delete;
+        Span& operator= (const Span&) = delete;
+
+        Span(const char* name, uint64_t trace_id, const char* arg_name = nullptr, int64_t arg = 0);
+        ~Span();
+
+    private:
+        const char* name;
+        uint64_t trace_id, previous_trace_id;
+        uint64_t start;
+        const char* arg_name;
+        int64_t arg;
+    };
+
+    // name of this process in the dumps
+    void set_process_name(const std::string& name);
+    // the spans still in the ring buffer, as Chrome trace event JSON
+    std::string dump_chrome_json();
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// How the storage manager and the storage nodes exchange the stripe requests.
+// The manager sends a message to a node and gets exactly one reply back, tagged
+// like the request. The transport picks the tags so that the calls in flight to
+// a node never share one, and the node echoes them back. The nodes are numbered 1..node count,
+// the number 0 is the manager. Several managers can share the nodes, a node
+// answers every request to the manager it came from.
+namespace StorageAPI {
+    class Transport {
+    public:
+        // a request sent to a node, complete once its reply arrived
+        class Call {
+        public:
+            virtual ~Call() = default;
+
+            // true when the reply is there, never blocks
+            virtual bool test() = 0;
+            virtual void wait() = 0;
+
+            // valid once test() returned true or wait() returned
+            const std::vector<uint8_t>& get_reply() const { return reply; }
+
+        protected:
+            std::vector<uint8_t> reply;
+        };
+
+        virtual ~Transport() = default;
+
+        virtual int get_node_count() const = 0;
+        // identifies the node across restarts, its number changes when nodes come and go
+        virtual std::string get_node_name(int node) const { return std::to_string(node); }
+        // the reply is at most max_reply bytes long
+        virtual std::unique_ptr<Call> call(int node, std::vector<uint8_t>&& message, size_t max_reply) = 0;
+    };
+
+    // the end of a storage node
+    class NodeTransport {
+    public:
+        virtual ~NodeTransport() = default;
+
+        // waits for the next request, false once the transport is shut down
+        virtual bool receive(int& tag, std::vector<uint8_t>& message) = 0;
+        // answers the request last received
+        virtual void reply(int tag, const uint8_t* data, size_t size) = 0;
+    };
+
+    // writes and removes are answered with an errno (0 on success) in a native int
+    inline int get_result(const Transport::Call& call)
+    {
+        int result;
+        if (call.get_reply().size() != sizeof(result))
+            return EIO;
+        std::memcpy(&result, call.get_reply().data(), sizeof(result));
+        return result;
+    }
+}
+
+#endif
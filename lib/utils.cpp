@@ -1,4 +1,5 @@
 #include "utils.hpp"
+#include <immintrin.h>
 
 void Utils::read_conf_file(std::string conf_file, std::string& conf_string)
 {
@@ -134,6 +135,17 @@ std::string Utils::get_parent_dir(std::string path) {
     return path.substr(0, last_slash);
 }
 
+uint64_t Utils::hash_path(const std::string& path)
+{
+    uint64_t result = 0xcbf29ce484222325;
+    for (unsigned char c : path)
+    {
+        result ^= c;
+        result *= 0x100000001b3;
+    }
+    return result;
+}
+
 void Utils::trim_trailing_nulls(std::vector<uint8_t>& vec) {
     auto it = std::find_if(vec.rbegin(), vec.rend(), [](uint8_t byte) {
         return byte != 0x00;
@@ -195,6 +207,57 @@ std::string Utils::get_string_from_byte_array(std::vector<uint8_t> byte_array)
     return result;
 }
 
+namespace {
+    bool is_zero_portable(const uint8_t* data, size_t len)
+    {
+        uint64_t bits = 0;
+        while (len >= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data, 8);
+            bits |= word;
+            data += 8;
+            len -= 8;
+        }
+        while (len > 0)
+        {
+            bits |= *data ++;
+            len --;
+        }
+        return bits == 0;
+    }
+
+    // most data is not zero, so every 128 bytes are checked before going on
+    __attribute__((target("avx2")))
+    bool is_zero_avx2(const uint8_t* data, size_t len)
+    {
+        while (len >= 128)
+        {
+            __m256i bits = _mm256_or_si256(
+                _mm256_or_si256(_mm256_loadu_si256((const __m256i*) data), _mm256_loadu_si256((const __m256i*) (data + 32))),
+                _mm256_or_si256(_mm256_loadu_si256((const __m256i*) (data + 64)), _mm256_loadu_si256((const __m256i*) (data + 96))));
+            if (!_mm256_testz_si256(bits, bits))
+                return false;
+            data += 128;
+            len -= 128;
+        }
+        return is_zero_portable(data, len);
+    }
+
+    bool avx2_supported()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+
+    bool (*const is_zero_kernel)(const uint8_t*, size_t) = avx2_supported() ? is_zero_avx2 : is_zero_portable;
+}
+
+bool Utils::is_zero(const uint8_t* data, size_t len)
+{
+    return is_zero_kernel(data, len);
+}
+
 // std::vector<Utils::ConnectionInfo> Utils::read_server_file(const std::string& server_file)
 // {
 //     std::vector<Utils::ConnectionInfo> connections;
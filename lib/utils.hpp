@@ -23,10 +23,7 @@
 #include <unistd.h>
 #include "metadata.pb.h"
 
-#ifndef SPDLOG_ACTIVE_LEVEL
-#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
-#endif
-#include <spdlog/spdlog.h>
+#include "logging.hpp"
 
 #define ASIO_STANALONE // non-boost version
 #define ASIO_NO_DEPRECATED // no need for deprecated stuff
@@ -44,6 +41,8 @@ namespace Utils
     void set_dir_list(Stat& proto_stat, const std::vector<std::string>& dir_list);
     std::string process_path(std::string path, const std::string& absolute_path);
     std::string get_parent_dir(std::string path);
+    // FNV-1a of the path, the same in every client and server whatever library they were built with
+    uint64_t hash_path(const std::string& path);
 
     void trim_trailing_nulls(std::vector<uint8_t>& vec);
     std::vector<uint8_t> get_byte_array_from_int(uint32_t value);
@@ -52,31 +51,8 @@ namespace Utils
     uint64_t get_int64_from_byte_array(std::vector<uint8_t> byte_array);
     std::vector<uint8_t> get_byte_array_from_string(std::string string); 
     std::string get_string_from_byte_array(std::vector<uint8_t> byte_array);
-
-    class PerformanceTimer {
-    private:
-        // std::chrono::time_point<std::chrono::high_resolution_clock> start_time;
-        // std::chrono::time_point<std::chrono::high_resolution_clock> end_time;
-        std::string operation_name;
-        std::ofstream& log_file;
-
-    public:
-        PerformanceTimer(const std::string& name, std::ofstream& file) 
-            : operation_name(name), log_file(file) {
-            // log_file.open(file, std::ios::app);
-            // start_time = std::chrono::high_resolution_clock::now();
-            log_file << operation_name << " start: " << std::chrono::high_resolution_clock::now() << " microseconds\n";
-        }
-        
-        ~PerformanceTimer() {
-            // end_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now()).count();
-            // end_time = std::chrono::high_resolution_clock::now();
-            // auto endTime = std::chrono::high_resolution_clock::now();
-            // auto duration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - start_time).count();
-            log_file << operation_name << " end: " << std::chrono::high_resolution_clock::now() << " microseconds\n";
-            log_file.flush();
-        }
-    };
+    // true when the len bytes of data are all 0, 32 bytes per step with AVX2
+    bool is_zero(const uint8_t* data, size_t len);
 
     template<typename Packet>
     struct ConnectionInfo {
@@ -0,0 +1,233 @@
+#ifndef WIRE_CODEC_HPP
+#define WIRE_CODEC_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Compile-time described packet layouts.
+//
+// A packet is described once as a list of header fields (in wire order) followed
+// by a list of body sections. Every header byte has to be covered by a field or by
+// explicit padding, so the schema fails to compile if it disagrees with the
+// declared header size. The load/store code is generated from that single
+// description: each field is a memcpy at a fixed offset plus a byteswap, and the
+// body sections are copied in bulk.
+//
+// All multi-byte integers are big-endian on the wire (same as BytePacketBuffer).
+
+namespace Wire {
+
+    template <typename T>
+    constexpr T byteswap(T value)
+    {
+        static_assert(std::is_unsigned_v<T>, "byteswap: only unsigned integers are supported");
+        if constexpr (sizeof(T) == 1)
+            return value;
+        else if constexpr (sizeof(T) == 2)
+            return __builtin_bswap16(value);
+        else if constexpr (sizeof(T) == 4)
+            return __builtin_bswap32(value);
+        else
+            return __builtin_bswap64(value);
+    }
+
+    template <typename T>
+    constexpr T to_big_endian(T value)
+    {
+        if constexpr (std::endian::native == std::endian::big)
+            return value;
+        else
+            return byteswap(value);
+    }
+
+    template <typename T>
+    inline T load_be(const uint8_t* source)
+    {
+        T value;
+        std::memcpy(&value, source, sizeof(T));
+        return to_big_endian(value);
+    }
+
+    template <typename T>
+    inline void store_be(uint8_t* destination, T value)
+    {
+        value = to_big_endian(value);
+        std::memcpy(destination, &value, sizeof(T));
+    }
+
+    template <typename MemberPointer>
+    struct member_traits;
+
+    template <typename Class, typename Member>
+    struct member_traits<Member Class::*> {
+        using class_type = Class;
+        using member_type = Member;
+    };
+
+    // a fixed-width integer stored in the header
+    template <auto Member>
+    struct Field {
+        using type = typename member_traits<decltype(Member)>::member_type;
+        static_assert(std::is_unsigned_v<type>, "Field: header fields must be unsigned integers");
+        static constexpr size_t size = sizeof(type);
+
+        template <typename Packet>
+        static void load(Packet& packet, const uint8_t* source) { packet.*Member = load_be<type>(source); }
+
+        template <typename Packet>
+        static void store(const Packet& packet, uint8_t* destination) { store_be<type>(destination, packet.*Member); }
+    };
+
+    // header bytes reserved for future add-ons, always written as zeros
+    template <size_t Bytes>
+    struct Pad {
+        static constexpr size_t size = Bytes;
+
+        template <typename Packet>
+        static void load(Packet&, const uint8_t*) {}
+
+        template <typename Packet>
+        static void store(const Packet&, uint8_t* destination) { std::memset(destination, 0, Bytes); }
+    };
+
+    // a variable length body section, its length is the header field Length
+    template <auto Length, auto Bytes>
+    struct Section {
+        using length_field = Field<Length>;
+        static constexpr auto length = Length;
+        static constexpr auto bytes = Bytes;
+    };
+
+    template <typename... Fields>
+    struct HeaderFields {};
+
+    template <typename... Sections>
+    struct BodySections {};
+
+    template <size_t HeaderSize, typename Header, typename Body>
+    struct Layout;
+
+    template <size_t HeaderSize, typename... Fields, typename... Sections>
+    struct Layout<HeaderSize, HeaderFields<Fields...>, BodySections<Sections...>> {
+        static constexpr size_t header_size = HeaderSize;
+        static_assert((Fields::size + ... + 0) == HeaderSize,
+            "Layout: header fields and padding must cover exactly header_size bytes");
+
+    private:
+        static constexpr size_t field_count = sizeof...(Fields);
+        static constexpr size_t sizes[field_count] = { Fields::size... };
+
+        static constexpr size_t offset_at(size_t index)
+        {
+            size_t offset = 0;
+            for (size_t i = 0; i < index; i ++)
+                offset += sizes[i];
+            return offset;
+        }
+
+        // offset of the header field describing Member, or header_size when it is not in the header
+        template <auto Member, size_t Index, typename First, typename... Rest>
+        static constexpr size_t find_offset()
+        {
+            if constexpr (std::is_same_v<First, Field<Member>>)
+                return offset_at(Index);
+            else if constexpr (sizeof...(Rest) > 0)
+                return find_offset<Member, Index + 1, Rest...>();
+            else
+                return HeaderSize;
+        }
+
+        template <typename Packet, size_t... I>
+        static void load_header(Packet& packet, const uint8_t* source, std::index_sequence<I...>)
+        {
+            (Fields::load(packet, source + offset_at(I)), ...);
+        }
+
+        template <typename Packet, size_t... I>
+        static void store_header(const Packet& packet, uint8_t* destination, std::index_sequence<I...>)
+        {
+            (Fields::store(packet, destination + offset_at(I)), ...);
+        }
+
+    public:
+        static_assert(((find_offset<Sections::length, 0, Fields...>() < HeaderSize) && ... && true),
+            "Layout: every body section needs its length field in the header");
+
+        template <auto Member>
+        static constexpr size_t offset_of()
+        {
+            constexpr size_t offset = find_offset<Member, 0, Fields...>();
+            static_assert(offset < HeaderSize, "Layout: member is not a header field");
+            return offset;
+        }
+
+        // reads the length fields straight from the raw header, no copy of the buffer
+        static size_t packet_size(const uint8_t* buffer, size_t len)
+        {
+            if (len < HeaderSize)
+                throw std::runtime_error(std::format("packet_size: Buffer shorter than the header: {} < {}", len, HeaderSize));
+
+            return HeaderSize + (static_cast<size_t>(
+                load_be<typename Sections::length_field::type>(buffer + offset_of<Sections::length>())) + ... + 0);
+        }
+
+        // body size according to the length fields of an already filled packet
+        template <typename Packet>
+        static size_t body_size(const Packet& packet)
+        {
+            return (static_cast<size_t>(packet.*(Sections::length)) + ... + 0);
+        }
+
+        template <typename Packet>
+        static void load(Packet& packet, const uint8_t* buffer, size_t len)
+        {
+            if (len < HeaderSize)
+                throw std::runtime_error(std::format("load: Buffer shorter than the header: {} < {}", len, HeaderSize));
+
+            load_header(packet, buffer, std::make_index_sequence<field_count>{});
+
+            size_t total = HeaderSize + body_size(packet);
+            if (len < total)
+                throw std::runtime_error(std::format("load: Truncated packet: got {} bytes, expected {}", len, total));
+
+            const uint8_t* cursor = buffer + HeaderSize;
+            ([&] {
+                size_t section_len = packet.*(Sections::length);
+                (packet.*(Sections::bytes)).assign(cursor, cursor + section_len);
+                cursor += section_len;
+            }(), ...);
+        }
+
+        // writes the whole packet at the start of destination, returns the number of bytes written
+        template <typename Packet>
+        static size_t store(const Packet& packet, uint8_t* destination, size_t capacity)
+        {
+            size_t total = HeaderSize + body_size(packet);
+            if (capacity < total)
+                throw std::runtime_error(std::format("store: Buffer too small. Length given: {}, buffer size: {}", total, capacity));
+
+            store_header(packet, destination, std::make_index_sequence<field_count>{});
+
+            uint8_t* cursor = destination + HeaderSize;
+            ([&] {
+                size_t section_len = packet.*(Sections::length);
+                const auto& bytes = packet.*(Sections::bytes);
+                if (bytes.size() < section_len)
+                    throw std::runtime_error("store: Section shorter than its length field");
+                if (section_len > 0)
+                    std::memcpy(cursor, bytes.data(), section_len);
+                cursor += section_len;
+            }(), ...);
+
+            return total;
+        }
+    };
+}
+
+#endif
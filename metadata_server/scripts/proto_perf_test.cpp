@@ -0,0 +1,256 @@
+#include "../lib/net_protocol.hpp"
+#include "../lib/file_mngr.hpp"
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+// usage: proto_perf_test [filter] [min_seconds] (built with Makefile_perf)
+// Measures the protocol and metadata hot paths: packet (de)serialization,
+// UpdateCommand parsing, the Stat and StatRecord conversions and the metadata files of
+// FileMngr. Every case prints ns/op, allocations/op and bytes allocated/op,
+// only the cases whose name contains filter are run.
+
+std::string filter;
+double min_seconds = 0.2; // per case, after one warm up round
+
+// every allocation of the process goes through here, so the cases can count theirs
+size_t allocations = 0, allocated_bytes = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    allocated_bytes += size;
+    if (void* pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+
+// keeps the compiler from dropping a result that is never used
+template <typename T>
+void keep(const T& value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+template <typename Function>
+void measure(const std::string& name, Function function)
+{
+    if (name.find(filter) == std::string::npos)
+        return;
+
+    function(); // warm up, first-time allocations (e.g. buffer growth) are not counted
+
+    size_t rounds = 0, batch = 1;
+    size_t start_allocations = allocations, start_bytes = allocated_bytes;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed;
+    do {
+        for (size_t r = 0; r < batch; r++)
+            function();
+        rounds += batch;
+        batch *= 2;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < min_seconds);
+
+    std::cout << std::format("{:<40} {:>12.1f} ns/op {:>8.2f} allocs/op {:>10.1f} B/op\n", name,
+        elapsed.count() * 1e9 / rounds, (double) (allocations - start_allocations) / rounds,
+        (double) (allocated_bytes - start_bytes) / rounds);
+}
+
+std::vector<uint8_t> get_bytes(size_t size)
+{
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; i++)
+        bytes[i] = 'a' + i % 26;
+    return bytes;
+}
+
+void cache_packet_cases()
+{
+    // a metadata request: a path as key, a serialized Stat or directory listing as value
+    for (size_t value_size : {0ul, 256ul, 4096ul, 65536ul})
+    {
+        CachePacket packet;
+        packet.opcode = OperationCode::to_byte(OperationCode::Type::WRITE);
+        packet.key = get_bytes(48);
+        packet.key_len = packet.key.size();
+        packet.value = get_bytes(value_size);
+        packet.value_len = packet.value.size();
+
+        std::vector<uint8_t> buffer;
+        measure(std::format("CachePacket::to_buffer/{}", value_size), [&] {
+            keep(packet.to_buffer(buffer));
+        });
+
+        packet.to_buffer(buffer);
+        measure(std::format("CachePacket::from_buffer/{}", value_size), [&] {
+            CachePacket result(buffer.data(), buffer.size());
+            keep(result);
+        });
+    }
+}
+
+void storage_packet_cases()
+{
+    // a write of a stripe, from a small write up to the FUSE request size
+    for (size_t data_size : {0ul, 4096ul, 131072ul, 1048576ul})
+    {
+        StoragePacket packet;
+        packet.opcode = OperationCode::to_byte(OperationCode::Type::WRITE);
+        packet.path = get_bytes(48);
+        packet.path_len = packet.path.size();
+        packet.data = get_bytes(data_size);
+        packet.data_len = packet.data.size();
+
+        std::vector<uint8_t> buffer;
+        measure(std::format("StoragePacket::to_buffer/{}", data_size), [&] {
+            keep(packet.to_buffer(buffer));
+        });
+
+        packet.to_buffer(buffer);
+        measure(std::format("StoragePacket::from_buffer/{}", data_size), [&] {
+            StoragePacket result(buffer.data(), buffer.size());
+            keep(result);
+        });
+    }
+}
+
+void update_command_cases()
+{
+    UpdateCommand chmod;
+    chmod.opcode = UpdateCode::to_byte(UpdateCode::Type::CHMOD);
+    chmod.argv.push_back(Utils::get_byte_array_from_int(0644));
+    chmod.argc = 1;
+
+    UpdateCommand rename;
+    rename.opcode = UpdateCode::to_byte(UpdateCode::Type::RENAME);
+    rename.argv.push_back(Utils::get_byte_array_from_string("/some/directory/with/a/new_file_name.dat"));
+    rename.argc = 1;
+
+    for (auto [name, command] : {std::pair {"chmod", chmod}, std::pair {"rename", rename}})
+    {
+        std::vector<uint8_t> buffer;
+        measure(std::format("UpdateCommand::to_buffer/{}", name), [&] {
+            keep(command.to_buffer(buffer));
+        });
+
+        command.to_buffer(buffer);
+        measure(std::format("UpdateCommand::from_buffer/{}", name), [&] {
+            UpdateCommand result(buffer.data(), buffer.size());
+            keep(result);
+        });
+    }
+}
+
+void stat_cases()
+{
+    struct stat file_stat;
+    if (stat(".", &file_stat) != 0)
+        throw std::runtime_error(std::strerror(errno));
+
+    measure("struct_stat_to_proto+serialize", [&] {
+        Stat proto;
+        std::string result;
+        Utils::struct_stat_to_proto(&file_stat, proto);
+        proto.SerializeToString(&result);
+        keep(result);
+    });
+
+    // what a getattr does with the cached metadata, directories carry their listing
+    for (size_t entries : {0ul, 16ul, 1024ul})
+    {
+        Stat proto;
+        std::string content;
+        Utils::struct_stat_to_proto(&file_stat, proto);
+        for (size_t i = 0; i < entries; i++)
+            proto.add_dir_list(std::format("file_{:06}", i));
+        proto.SerializeToString(&content);
+
+        measure(std::format("parse+proto_to_struct_stat/{}", entries), [&] {
+            Stat result_proto;
+            struct stat result;
+            result_proto.ParseFromString(content);
+            Utils::proto_to_struct_stat(result_proto, &result);
+            keep(result);
+        });
+    }
+
+    // the same with the StatRecord the servers store now, the listing is not touched
+    measure("StatRecord::make", [&] {
+        keep(StatRecord::make(file_stat, 0));
+    });
+
+    for (size_t entries : {0ul, 16ul, 1024ul})
+    {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < entries; i++)
+            names.push_back(std::format("file_{:06}", i));
+        std::string record = StatRecord::make(file_stat, 0, names);
+
+        measure(std::format("StatRecord::to_struct_stat/{}", entries), [&] {
+            struct stat result;
+            StatRecord::to_struct_stat(record, &result);
+            keep(result);
+        });
+    }
+}
+
+void file_mngr_cases(const std::string& root)
+{
+    std::string file_path = root + "/file";
+    FileMngr::set_local_file(file_path, 0644);
+    measure("FileMngr::get_local_file", [&] {
+        keep(FileMngr::get_local_file(file_path));
+    });
+
+    for (size_t entries : {16ul, 1024ul})
+    {
+        std::string path = std::format("{}/dir{}", root, entries);
+        std::string meta_path = std::format("{}/meta{}", root, entries);
+        FileMngr::set_local_dir(path, meta_path, 0755);
+        for (size_t i = 0; i < entries; i++)
+            close(open(std::format("{}/file_{:06}", path, i).c_str(), O_CREAT | O_WRONLY, 0644));
+
+        measure(std::format("FileMngr::get_local_dir/cached/{}", entries), [&] {
+            keep(FileMngr::get_local_dir(path, meta_path));
+        });
+        measure(std::format("FileMngr::get_local_dir/update/{}", entries), [&] {
+            keep(FileMngr::get_local_dir(path, meta_path, true));
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) filter = argv[1];
+    if (argc > 2) min_seconds = std::atof(argv[2]);
+
+    char root_template[] = "/tmp/proto_perf_test.XXXXXX";
+    if (mkdtemp(root_template) == nullptr)
+    {
+        std::cerr << "mkdtemp: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::string root = root_template;
+
+    try {
+        cache_packet_cases();
+        storage_packet_cases();
+        update_command_cases();
+        stat_cases();
+        file_mngr_cases(root);
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::filesystem::remove_all(root);
+        return 1;
+    }
+
+    std::filesystem::remove_all(root);
+    return 0;
+}
@@ -33,8 +33,7 @@ void print_menu()
 
 int main()
 {
-    spdlog::set_level(spdlog::level::trace); // Set global log level to debug
-    spdlog::set_pattern("(%s:%#) [%^%l%$] %v");
+    Logging::init(spdlog::level::trace); // Set global log level, the messages are written asynchronously
     CacheAPI::CacheClient *client = NULL;
     std::string address, port, option, mem_conf_string;
     bool connected = false;
@@ -14,21 +14,28 @@ int main(int argc, char** argv)
     uint8_t thread_count = 1;
     uint16_t port = 8888;
     uint16_t mem_port = 11211;
+    uint16_t metrics_port = 0;
+    size_t metadata_cache_size = 65536;
 
     app.add_option("-f, --file-meta", file_meta, "A directory to store cached file metadata.")->required();
     app.add_option("-d, --dir-meta", dir_meta, "A directory to store cached directory metadata.")->required();
     app.add_option("-p, --port", port, "Port on which to run the server.")->check(CLI::Range(1, 65535));
     app.add_option("-m, --mport", mem_port, "Port on which to run the MEMECACHED server.")->check(CLI::Range(1, 65535));
     app.add_option("-t, --threads", thread_count, "Number of threads in the thread pool.")->check(CLI::Range(1, 16))->required();
+    app.add_option("--metrics-port", metrics_port, "Port serving the metrics in the Prometheus text format (0 disables).")->check(CLI::Range(0, 65535));
+    app.add_option("--metadata-cache", metadata_cache_size, "Entries of the in-memory metadata cache (0 disables it).");
     CLI11_PARSE(app, argc, argv);
 
     try {
         ////// LOGGER //////
-        spdlog::set_level(spdlog::level::debug); // Set global log level to debug
-        spdlog::set_pattern("(%s:%#) [%^%l%$] %v");
+        Logging::init(spdlog::level::debug); // Set global log level, the messages are written asynchronously
 
         // CacheServer object(8, "--FILE=./memcached.conf", "./storage/");
         CacheServer object((int)thread_count, mem_port, file_meta, dir_meta);
+        object.set_metadata_cache_size(metadata_cache_size);
+        std::unique_ptr<Metrics::Endpoint> metrics_endpoint;
+        if (metrics_port != 0)
+            metrics_endpoint = std::make_unique<Metrics::Endpoint>(metrics_port);
         object.run(port);
     } 
     catch (std::exception& e){
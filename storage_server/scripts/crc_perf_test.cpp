@@ -0,0 +1,94 @@
+#include "../lib/checksum.hpp"
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// usage: crc_perf_test [link_gbps] [max_overhead_percent] [chunk_size] (built with Makefile_perf)
+// The stripe checksums are computed while the data is copied between buffers,
+// so what they cost is the difference between a plain copy and a copy that also
+// runs the CRC. That difference is compared to the time the same bytes take on
+// a link_gbps network, and has to stay under max_overhead_percent of it.
+
+double link_gbps = 10.0, max_overhead = 5.0;
+size_t chunk_size = 128 * 1024; // FUSE request size
+size_t buffer_size = 256ul << 20; // larger than the caches, like the data of real requests
+int rounds = 8;
+
+template <typename Function>
+double measure(Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        function();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / rounds;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) link_gbps = std::atof(argv[1]);
+    if (argc > 2) max_overhead = std::atof(argv[2]);
+    if (argc > 3) chunk_size = std::atol(argv[3]);
+
+    std::vector<uint8_t> source(buffer_size), destination(buffer_size);
+    std::mt19937_64 rng(42);
+    for (size_t i = 0; i + 8 <= buffer_size; i += 8)
+    {
+        uint64_t word = rng();
+        std::memcpy(&source[i], &word, 8);
+    }
+    std::memset(destination.data(), 0, buffer_size); // fault the pages in before timing
+
+    uint32_t expected = Checksum::crc32c(source.data(), buffer_size);
+    double link_seconds = buffer_size / (link_gbps * 1e9);
+    bool passed = true;
+
+    std::cout << "CRC32C, " << chunk_size << " byte chunks over " << (buffer_size >> 20) << " MB" << std::endl;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1)
+        {
+            if (Checksum::get_kernel_name() == "slicing-by-8")
+                break;
+            Checksum::use_portable_kernel();
+        }
+
+        uint32_t crc = 0, copy_crc = 0;
+        double copy = measure([&] {
+            for (size_t offset = 0; offset < buffer_size; offset += chunk_size)
+                std::memcpy(destination.data() + offset, source.data() + offset, std::min(chunk_size, buffer_size - offset));
+        });
+        double checksum = measure([&] {
+            crc = 0;
+            for (size_t offset = 0; offset < buffer_size; offset += chunk_size)
+                crc = Checksum::crc32c(source.data() + offset, std::min(chunk_size, buffer_size - offset), crc);
+        });
+        double checksum_copy = measure([&] {
+            copy_crc = 0;
+            for (size_t offset = 0; offset < buffer_size; offset += chunk_size)
+                copy_crc = Checksum::crc32c_copy(destination.data() + offset, source.data() + offset,
+                    std::min(chunk_size, buffer_size - offset), copy_crc);
+        });
+
+        bool correct = crc == expected && copy_crc == expected && source == destination;
+        double overhead = std::max(checksum_copy - copy, 0.0) / link_seconds * 100;
+
+        std::cout << Checksum::get_kernel_name() << ": crc " << buffer_size / checksum / 1e9 << " GB/s"
+            << ", copy " << buffer_size / copy / 1e9 << " GB/s"
+            << ", copy+crc " << buffer_size / checksum_copy / 1e9 << " GB/s"
+            << ", overhead at " << link_gbps << " GB/s: " << overhead << "%"
+            << (correct ? "" : " (WRONG RESULT)") << std::endl;
+
+        // slicing-by-8 is only there for comparison
+        if (pass == 0)
+            passed = correct && overhead <= max_overhead;
+        else
+            passed = passed && correct;
+    }
+
+    std::cout << (passed ? "PASS" : "FAIL") << ": target " << max_overhead << "%" << std::endl;
+    return passed ? 0 : 1;
+}
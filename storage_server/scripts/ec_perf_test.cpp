@@ -0,0 +1,91 @@
+#include "../lib/erasure_code.hpp"
+#include <iostream>
+#include <chrono>
+#include <random>
+
+using namespace StorageAPI;
+
+// usage: ec_perf_test [k] [m] [stripe_size] [target_gbps] (built with Makefile_perf)
+// Measures how fast stripe groups are encoded and rebuilt after losing m
+// fragments, first with the kernel picked for this CPU and then with the
+// scalar one. The encode rate has to stay above the target, which should be
+// the write bandwidth of the storage manager, so the parity is never the bottleneck.
+
+int k = 4, m = 2, stripe_size = 131072;
+double target_gbps = 2.0;
+size_t total_bytes = 1ul << 30; // data encoded per measurement
+
+double measure(const ReedSolomon& codec, std::vector<std::vector<uint8_t>>& fragments, bool decode)
+{
+    std::vector<uint8_t*> shards;
+    for (auto& fragment : fragments)
+        shards.push_back(fragment.data());
+
+    // the first m data fragments are lost, the worst case for the decoder
+    std::vector<bool> present(k + m, true);
+    for (int f = 0; f < m && f < k; f++)
+        present[f] = false;
+
+    size_t rounds = std::max<size_t>(total_bytes / ((size_t) k * stripe_size), 1);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++)
+    {
+        if (decode)
+            codec.reconstruct(shards.data(), present, stripe_size);
+        else
+            codec.encode(shards.data(), shards.data() + k, stripe_size);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return rounds * (double) k * stripe_size / elapsed.count() / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) k = std::atoi(argv[1]);
+    if (argc > 2) m = std::atoi(argv[2]);
+    if (argc > 3) stripe_size = std::atoi(argv[3]);
+    if (argc > 4) target_gbps = std::atof(argv[4]);
+
+    ReedSolomon codec(k, m);
+    std::vector<std::vector<uint8_t>> fragments(k + m, std::vector<uint8_t>(stripe_size));
+    std::mt19937 rng(42);
+    for (int f = 0; f < k; f++)
+        for (auto& byte : fragments[f])
+            byte = rng();
+
+    std::vector<uint8_t*> shards;
+    for (auto& fragment : fragments)
+        shards.push_back(fragment.data());
+    codec.encode(shards.data(), shards.data() + k, stripe_size);
+    std::vector<std::vector<uint8_t>> expected = fragments;
+
+    std::cout << "Reed-Solomon " << k << "+" << m << ", stripe size " << stripe_size << std::endl;
+
+    bool passed = true;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1)
+        {
+            if (ReedSolomon::get_kernel_name() == "scalar")
+                break;
+            ReedSolomon::use_scalar_kernel();
+        }
+
+        double encode_gbps = measure(codec, fragments, false);
+        double decode_gbps = measure(codec, fragments, true);
+        bool correct = fragments == expected;
+
+        std::cout << ReedSolomon::get_kernel_name() << ": encode " << encode_gbps << " GB/s, decode "
+            << decode_gbps << " GB/s" << (correct ? "" : " (WRONG RESULT)") << std::endl;
+
+        // the scalar kernel is only there for comparison
+        if (pass == 0)
+            passed = correct && encode_gbps >= target_gbps;
+        else
+            passed = passed && correct;
+    }
+
+    std::cout << (passed ? "PASS" : "FAIL") << ": target " << target_gbps << " GB/s" << std::endl;
+    return passed ? 0 : 1;
+}